@@ -0,0 +1,139 @@
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+/**
+ * @class PerfCounters
+ * @brief Hardware performance counters of the calling thread, read with Linux perf_event_open
+ *
+ * Every counter is opened on its own, so a CPU or virtual machine that lacks one of them (LLC misses are often missing
+ * in VMs) still reports the others. When the kernel refuses all of them (perf_event_paranoid, containers without
+ * CAP_PERFMON, or a system other than Linux) available() is false and the benchmarks report wall time only. Counts are
+ * scaled by time_enabled / time_running when the kernel had to multiplex the counters.
+ *
+ * Only the calling thread is counted, so benchmarks that fan out to worker threads (RandomForest::fit, score) are
+ * under-counted; the single-threaded inference benchmarks are what the counters are meant for.
+ *
+ * @code
+ * PerfCounters counters;
+ * counters.start();
+ * run_kernel();
+ * counters.stop();
+ * for (const auto& [name, value] : counters.read()) { ... }
+ * @endcode
+ */
+class PerfCounters {
+    private:
+        std::vector<std::pair<std::string, int>> counters; ///< Name and file descriptor of every counter that opened
+
+#ifdef __linux__
+        void open_counter(const std::string& name, uint32_t type, uint64_t config) {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = type;
+            attr.config = config;
+            attr.disabled = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            int fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (fd >= 0) {
+                counters.emplace_back(name, fd);
+            }
+        }
+#endif
+
+    public:
+        /**
+         * @brief Constructor for PerfCounters, which opens cycles, instructions, L1 data cache read misses, last level
+         *        cache misses, and branch misses for the calling thread
+         */
+        PerfCounters() {
+#ifdef __linux__
+            const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            open_counter("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+            open_counter("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+            open_counter("l1d_misses", PERF_TYPE_HW_CACHE, l1d_read_miss);
+            open_counter("llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+            open_counter("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+#endif
+        }
+
+        ~PerfCounters() {
+#ifdef __linux__
+            for (const auto& counter : counters) {
+                close(counter.second);
+            }
+#endif
+        }
+
+        PerfCounters(const PerfCounters&) = delete;
+        PerfCounters& operator=(const PerfCounters&) = delete;
+
+        /**
+         * @brief Check whether any counter could be opened
+         * @return True if read() reports at least one counter
+         */
+        bool available() const {
+            return !counters.empty();
+        }
+
+        /**
+         * @brief Reset the counters to 0 and start counting
+         */
+        void start() {
+#ifdef __linux__
+            for (const auto& counter : counters) {
+                ioctl(counter.second, PERF_EVENT_IOC_RESET, 0);
+                ioctl(counter.second, PERF_EVENT_IOC_ENABLE, 0);
+            }
+#endif
+        }
+
+        /**
+         * @brief Stop counting; the counts stay readable until the next start()
+         */
+        void stop() {
+#ifdef __linux__
+            for (const auto& counter : counters) {
+                ioctl(counter.second, PERF_EVENT_IOC_DISABLE, 0);
+            }
+#endif
+        }
+
+        /**
+         * @brief Read the counts since the last start()
+         * @return Name and count of every open counter, in the order they were opened; counters that could not be
+         *         read are left out
+         */
+        std::vector<std::pair<std::string, double>> read() const {
+            std::vector<std::pair<std::string, double>> values;
+#ifdef __linux__
+            for (const auto& counter : counters) {
+                uint64_t data[3] = {0, 0, 0};   // value, time enabled, time running
+                if (::read(counter.second, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data)) || data[2] == 0) {
+                    continue;
+                }
+                values.emplace_back(counter.first, static_cast<double>(data[0]) * data[1] / data[2]);
+            }
+#endif
+            return values;
+        }
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,349 @@
+/**
+ * @file benchmark_suite.cpp
+ * @brief Repeatable timings of data ingestion, training and inference on synthetic data sets
+ *
+ * Every benchmark runs on a synthetic data set of each requested size (see SyntheticData): numeric features drawn from
+ * a fixed seed and a class label that depends on them, so the trees have structure to learn. Each benchmark is run the
+ * requested number of times after one warm-up run, and the median and fastest run are reported as JSON, together with
+ * the rows processed per second, the time per prediction for the inference benchmarks, and the peak resident set size
+ * of the process once the benchmark has run (the peak never decreases, so compare it between runs of the same list).
+ * The training benchmarks also report the TrainingStats of their last fit, so a change can be checked to cut the work
+ * done as well as the time.
+ *
+ * With --perf the hardware counters of PerfCounters (cycles, instructions, L1 and last level cache misses, branch
+ * misses) are read around the timed runs and reported per prediction for the inference benchmarks and per run for the
+ * others. If the kernel does not grant the counters, the suite says so once and reports "counters": null.
+ *
+ * The suite links AllocationTracking_lib, so the warm-up run of every benchmark also counts the heap allocations of all
+ * threads, reported with the same unit as the counters; the timed runs are not counted separately.
+ *
+ * Usage: benchmark_suite [--rows 200,500] [--features 8] [--classes 3] [--repetitions 3] [--filter name]
+ *                        [--output results.json] [--perf]
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <sys/resource.h>
+
+#include "../src/DataFrame.h"
+#include "../src/DecisionTree.h"
+#include "../src/RandomForest.h"
+#include "../src/GradientBoostedTrees.h"
+#include "../src/MicroBatcher.h"
+#include "../src/SyntheticData.h"
+#include "../src/AllocationTracking.h"
+#include "PerfCounters.h"
+
+using std::string;
+using std::vector;
+
+
+/// Timing of one benchmark on one data set size
+struct BenchmarkResult {
+    string name;
+    size_t rows = 0;
+    size_t features = 0;
+    int repetitions = 0;
+    double median_ns = 0.0;
+    double min_ns = 0.0;
+    double rows_per_second = 0.0;
+    double ns_per_prediction = -1.0; ///< Negative for benchmarks that do not predict
+    long peak_rss_kb = 0;
+    bool has_training = false; ///< Whether training holds the statistics of a fit
+    TrainingStats training;
+    std::vector<std::pair<string, double>> counters; ///< Hardware counts per prediction, or per run without predictions
+    double allocations = 0.0; ///< Heap allocations of the warm-up run, with the same unit as counters
+    double allocated_bytes = 0.0; ///< Bytes requested by those allocations
+};
+
+/// Settings shared by every benchmark
+struct SuiteOptions {
+    vector<size_t> rows = {200, 500};
+    size_t features = 8;
+    size_t classes = 3;
+    int repetitions = 3;
+    string filter;
+    string output;
+    bool perf = false;
+    PerfCounters* counters = nullptr; ///< Counters read around every benchmark; null without --perf
+};
+
+
+static long peak_rss_kb() {
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;   // kilobytes on Linux
+}
+
+// Runs the body once to warm up, then times it repetitions times
+static BenchmarkResult measure(const SuiteOptions& options, const string& name, size_t rows, size_t predictions,
+                               const std::function<void()>& body) {
+    AllocationScope warm_up(true);
+    body();
+    AllocationCounts allocated = warm_up.counts();
+    vector<double> times;
+    if (options.counters) {
+        options.counters->start();
+    }
+    for (int r = 0; r < options.repetitions; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        body();
+        times.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    }
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+
+    BenchmarkResult result;
+    result.name = name;
+    result.rows = rows;
+    result.features = options.features;
+    result.repetitions = options.repetitions;
+    result.median_ns = median;
+    result.min_ns = times.front();
+    result.rows_per_second = rows / (median * 1e-9);
+    result.ns_per_prediction = predictions ? median / predictions : -1.0;
+    result.peak_rss_kb = peak_rss_kb();
+    double per_call = predictions ? static_cast<double>(predictions) : 1.0;
+    if (options.counters) {
+        options.counters->stop();
+        for (const auto& [counter, count] : options.counters->read()) {
+            result.counters.emplace_back(counter, count / (options.repetitions * per_call));
+        }
+    }
+    result.allocations = allocated.allocations / per_call;
+    result.allocated_bytes = allocated.bytes / per_call;
+    std::cerr << name << " rows=" << rows << " median=" << median / 1e6 << " ms" << std::endl;
+    return result;
+}
+
+static string to_json(const vector<BenchmarkResult>& results, const SuiteOptions& options) {
+    std::ostringstream out;
+    out.precision(10);
+    out << "{\n  \"suite\": \"random_forest\",\n  \"classes\": " << options.classes << ",\n  \"benchmarks\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchmarkResult& r = results[i];
+        out << (i ? "," : "") << "\n    {\"name\": \"" << r.name << "\", \"rows\": " << r.rows << ", \"features\": " << r.features
+            << ", \"repetitions\": " << r.repetitions << ", \"median_ns\": " << r.median_ns << ", \"min_ns\": " << r.min_ns
+            << ", \"rows_per_second\": " << r.rows_per_second << ", \"ns_per_prediction\": ";
+        if (r.ns_per_prediction < 0) {
+            out << "null";
+        } else {
+            out << r.ns_per_prediction;
+        }
+        out << ", \"peak_rss_kb\": " << r.peak_rss_kb << ", \"allocations\": {\"per\": \""
+            << (r.ns_per_prediction < 0 ? "run" : "prediction") << "\", \"count\": " << r.allocations
+            << ", \"bytes\": " << r.allocated_bytes << "}";
+        if (options.perf) {
+            out << ", \"counters\": ";
+            if (r.counters.empty()) {
+                out << "null";
+            } else {
+                out << "{\"per\": \"" << (r.ns_per_prediction < 0 ? "run" : "prediction") << "\"";
+                for (const auto& [counter, value] : r.counters) {
+                    out << ", \"" << counter << "\": " << value;
+                }
+                out << "}";
+            }
+        }
+        if (r.has_training) {
+            out << ", \"training\": {\"trees\": " << r.training.num_trees << ", \"nodes\": " << r.training.nodes
+                << ", \"depth\": " << r.training.depth << ", \"rows_scanned\": " << r.training.rows_scanned
+                << ", \"candidate_thresholds\": " << r.training.candidate_thresholds
+                << ", \"bytes_allocated\": " << r.training.bytes_allocated << "}";
+        }
+        out << "}";
+    }
+    out << "\n  ]\n}\n";
+    return out.str();
+}
+
+static vector<size_t> parse_sizes(const string& list) {
+    vector<size_t> sizes;
+    std::istringstream stream(list);
+    string item;
+    while (std::getline(stream, item, ',')) {
+        sizes.push_back(std::stoul(item));
+    }
+    return sizes;
+}
+
+
+int main(int argc, char* argv[]) {
+    SuiteOptions options;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--perf") {
+            options.perf = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Usage: benchmark_suite [--rows 200,500] [--features 8] [--classes 3] [--repetitions 3] "
+                      << "[--filter name] [--output results.json] [--perf]" << std::endl;
+            return 1;
+        }
+        string value = argv[++i];
+        if (arg == "--rows") {
+            options.rows = parse_sizes(value);
+        } else if (arg == "--features") {
+            options.features = std::stoul(value);
+        } else if (arg == "--classes") {
+            options.classes = std::stoul(value);
+        } else if (arg == "--repetitions") {
+            options.repetitions = std::max(1, std::stoi(value));
+        } else if (arg == "--filter") {
+            options.filter = value;
+        } else if (arg == "--output") {
+            options.output = value;
+        } else {
+            std::cerr << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    PerfCounters counters;
+    if (options.perf) {
+        if (counters.available()) {
+            options.counters = &counters;
+        } else {
+            std::cerr << "Hardware counters are not available (see /proc/sys/kernel/perf_event_paranoid); "
+                      << "reporting wall time only" << std::endl;
+        }
+    }
+
+    vector<BenchmarkResult> results;
+    auto run = [&](const string& name, size_t rows, size_t predictions, const std::function<void()>& body) {
+        if (name.find(options.filter) != string::npos) {
+            results.push_back(measure(options, name, rows, predictions, body));
+        }
+    };
+    // Like run, for a body that stores the statistics of its fit in stats
+    TrainingStats stats;
+    auto run_fit = [&](const string& name, size_t rows, const std::function<void()>& body) {
+        if (name.find(options.filter) != string::npos) {
+            results.push_back(measure(options, name, rows, 0, body));
+            results.back().has_training = true;
+            results.back().training = stats;
+        }
+    };
+    volatile double sink = 0.0;   // keeps the predictions alive
+
+    for (size_t num_rows : options.rows) {
+        SyntheticSpec spec;
+        spec.num_rows = num_rows;
+        spec.num_numeric = options.features;
+        spec.num_classes = options.classes;
+        spec.label_noise = 0.05;
+        SyntheticData generator(spec);
+        std::shared_ptr<DataFrame> data = generator.to_dataframe();
+
+        vector<double> samples;
+        vector<vector<double>> sample_rows;
+        for (size_t i = 0; i < num_rows; ++i) {
+            vector<Cell> row = data->get_row(i);
+            sample_rows.emplace_back();
+            for (size_t f = 0; f < options.features; ++f) {
+                sample_rows.back().push_back(DataFrame::double_cast(row[f]));
+            }
+            samples.insert(samples.end(), sample_rows.back().begin(), sample_rows.back().end());
+        }
+
+        // Ingestion and data preparation
+        string csv_path = "benchmark_suite_" + std::to_string(num_rows) + ".csv";
+        generator.write_csv(csv_path);
+        run("DataFrame::read_csv", num_rows, 0, [&]() { sink = DataFrame::read_csv(csv_path)->get_num_rows(); });
+        std::remove(csv_path.c_str());
+
+        run("DataFrame::filter", num_rows, 0, [&]() { sink = data->filter("n0", 0.0, "<=")->get_num_rows(); });
+        run("DataFrame::bootstrap_sample", num_rows, 0, [&]() {
+            sink = data->bootstrap_sample(options.features / 2 + 1, "label", 7)->get_num_rows();
+        });
+        run("DataFrame::selectBestAttribute", num_rows, 0, [&]() { sink = data->selectBestAttribute("label").size(); });
+
+        // Decision tree; like the forest below, fit is timed on a fresh tree every run
+        DecisionTree tree(6, 2);
+        tree.fit(data, "label");
+        run_fit("DecisionTree::fit", num_rows, [&]() {
+            DecisionTree fresh(6, 2);
+            stats = fresh.fit(data, "label");
+        });
+        run_fit("DecisionTree::fit/LevelWise", num_rows, [&]() {
+            DecisionTree fresh(6, 2);
+            fresh.set_growth_policy(GrowthPolicy::LevelWise);
+            stats = fresh.fit(data, "label");
+        });
+        run("DecisionTree::predict", num_rows, num_rows, [&]() {
+            for (const auto& sample : sample_rows) {
+                sink = sink + tree.predict(sample);
+            }
+        });
+        run("DecisionTree::predict_batch", num_rows, num_rows, [&]() { sink = tree.predict_batch(samples, options.features)[0]; });
+
+        // Random forest
+        RandomForest forest(16, 6, 2, -1, 42);
+        forest.fit(data, "label");
+        run_fit("RandomForest::fit", num_rows, [&]() {
+            RandomForest fresh(16, 6, 2, -1, 42);
+            stats = fresh.fit(data, "label");
+        });
+        run("RandomForest::predict", num_rows, num_rows, [&]() {
+            for (const auto& sample : sample_rows) {
+                sink = sink + forest.predict(sample);
+            }
+        });
+        run("RandomForest::predict_batch", num_rows, num_rows, [&]() { sink = forest.predict_batch(samples, options.features)[0]; });
+
+        // One-row batches, as forest_serve sends them under light load; they should cost about as much as predict
+        run("RandomForest::predict_batch/1 row", num_rows, num_rows, [&]() {
+            for (const auto& sample : sample_rows) {
+                sink = sink + forest.predict_batch(sample, options.features)[0];
+            }
+        });
+        {
+            MicroBatcher batcher([&forest](const vector<double>& batch, size_t num_columns) {
+                return forest.predict_batch(batch, num_columns);
+            }, options.features, 1, std::chrono::microseconds(0));
+            run("MicroBatcher::submit/1 row", num_rows, num_rows, [&]() {
+                for (const auto& sample : sample_rows) {
+                    sink = sink + batcher.submit(sample).get()[0];
+                }
+            });
+        }
+
+        // The same forest scored by its compiled inference engines
+        forest.set_inference_engine(InferenceEngine::QuickScorer);
+        run("RandomForest::predict_batch/QuickScorer", num_rows, num_rows, [&]() {
+            sink = forest.predict_batch(samples, options.features)[0];
+        });
+        forest.set_inference_engine(InferenceEngine::Compact);
+        run("RandomForest::predict_batch/Compact", num_rows, num_rows, [&]() {
+            sink = forest.predict_batch(samples, options.features)[0];
+        });
+        forest.set_inference_engine(InferenceEngine::Pointer);
+        run("RandomForest::hypertune", num_rows, 0, [&]() {
+            auto best = RandomForest::hypertune(data, "label", 2, 42, {4}, {3, 5}, {2}, {2});
+            sink = std::get<0>(best);
+        });
+
+        // Gradient boosting
+        run_fit("GradientBoostedTrees::fit", num_rows, [&]() {
+            GradientBoostedTrees boosted(10, 0.1, 3, 2);
+            stats = boosted.fit(data, "label");
+        });
+    }
+
+    string json = to_json(results, options);
+    if (options.output.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream(options.output) << json;
+    }
+    return 0;
+}
@@ -0,0 +1,113 @@
+/**
+ * @file layout_benchmark.cpp
+ * @brief Compares the NodeLayout options of FlatTree on forests trained on a sample data set
+ *
+ * For every layout the benchmark reports the average number of distinct 64-byte cache lines a prediction touches in
+ * a deep decision tree, and the time RandomForest::predict_batch takes per sample. The data set must be laid out like
+ * samples/seattle-weather.csv: a "date" column that is dropped and a "weather" label column.
+ *
+ * Usage: layout_benchmark [csv file] [number of trees] [maximum depth] [repetitions]
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../src/DataFrame.h"
+#include "../src/DecisionTree.h"
+#include "../src/FlatTree.h"
+#include "../src/RandomForest.h"
+
+using std::string;
+using std::vector;
+
+
+// Average number of distinct cache lines read while walking the tree for every sample
+static double cache_lines_per_sample(const FlatTree& tree, const vector<double>& samples, size_t num_columns) {
+    size_t num_rows = samples.size() / num_columns;
+    size_t total = 0;
+    for (size_t r = 0; r < num_rows; ++r) {
+        const double* sample = samples.data() + r * num_columns;
+        std::set<uintptr_t> lines;
+        const FlatNode* node = tree.data();
+        lines.insert(reinterpret_cast<uintptr_t>(node) / 64);
+        while (node->feature >= 0) {
+            node = tree.data() + (sample[node->feature] <= node->value ? node->left : node->right);
+            lines.insert(reinterpret_cast<uintptr_t>(node) / 64);
+        }
+        total += lines.size();
+    }
+    return static_cast<double>(total) / num_rows;
+}
+
+static const char* layout_name(NodeLayout layout) {
+    switch (layout) {
+        case NodeLayout::DepthFirst: return "depth-first";
+        case NodeLayout::BreadthFirst: return "breadth-first";
+        case NodeLayout::HotPath: return "hot-path";
+    }
+    return "unknown";
+}
+
+
+int main(int argc, char* argv[]) {
+    string path = argc > 1 ? argv[1] : "../../samples/seattle-weather.csv";
+    int num_trees = argc > 2 ? std::stoi(argv[2]) : 16;
+    int max_depth = argc > 3 ? std::stoi(argv[3]) : 8;
+    int repetitions = argc > 4 ? std::stoi(argv[4]) : 10;
+
+    std::shared_ptr<DataFrame> data;
+    try {
+        std::unique_ptr<DataFrame> df = DataFrame::read_csv(path);
+        df->drop_column("date");
+        df->one_hot_encode("weather");
+        data = std::move(df);
+    } catch (const std::exception& e) {
+        std::cerr << "Could not load " << path << ": " << e.what() << std::endl;
+        return 1;
+    }
+
+    // Row-major feature values of the training rows, in column order without the label
+    vector<double> samples;
+    size_t num_columns = data->columns.size() - 1;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                samples.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+    }
+
+    DecisionTree tree(max_depth, 2);
+    tree.fit(data, "weather");
+    RandomForest forest(num_trees, max_depth, 2, -1, 42);
+    forest.fit(data, "weather");
+
+    std::cout << data->get_num_rows() << " rows, " << tree.get_num_nodes() << " nodes in the decision tree, "
+              << num_trees << " trees of depth <= " << max_depth << " in the forest" << std::endl;
+    std::cout << std::left << std::setw(16) << "layout" << std::setw(24) << "cache lines/sample"
+              << "forest ns/sample" << std::endl;
+
+    for (NodeLayout layout : {NodeLayout::DepthFirst, NodeLayout::BreadthFirst, NodeLayout::HotPath}) {
+        tree.set_node_layout(layout);
+        forest.set_node_layout(layout);
+        double lines = cache_lines_per_sample(tree.flatten(), samples, num_columns);
+
+        forest.predict_batch(samples, num_columns);   // warm up
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repetitions; ++r) {
+            forest.predict_batch(samples, num_columns);
+        }
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        double ns = elapsed.count() / (static_cast<double>(repetitions) * data->get_num_rows());
+
+        std::cout << std::left << std::setw(16) << layout_name(layout) << std::setw(24) << std::fixed
+                  << std::setprecision(2) << lines << std::setprecision(1) << ns << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,168 @@
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "AllocationTracking.h"
+
+// Process-wide totals; relaxed, since they are only summed
+static std::atomic<uint64_t> process_allocations{0};
+static std::atomic<uint64_t> process_bytes{0};
+
+// Per-thread totals; plain integers with no constructor, so they are safe to use inside operator new
+static thread_local uint64_t thread_allocations = 0;
+static thread_local uint64_t thread_bytes = 0;
+
+
+static void count_allocation(std::size_t size) {
+    process_allocations.fetch_add(1, std::memory_order_relaxed);
+    process_bytes.fetch_add(size, std::memory_order_relaxed);
+    thread_allocations++;
+    thread_bytes += size;
+}
+
+// Both allocators only count the blocks they actually hand out, so a failed attempt that the new handler retries is
+// not counted twice
+static void* allocate(std::size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if (p) {
+        count_allocation(size);
+    }
+    return p;
+}
+
+static void* allocate_aligned(std::size_t size, std::align_val_t alignment) {
+    std::size_t align = static_cast<std::size_t>(alignment);
+    // aligned_alloc needs a size that is a multiple of the alignment
+    void* p = std::aligned_alloc(align, ((size ? size : 1) + align - 1) / align * align);
+    if (p) {
+        count_allocation(size);
+    }
+    return p;
+}
+
+// Give the installed new handler a chance to free memory after a failed attempt, as the standard operator new does;
+// without a handler the allocation fails with std::bad_alloc
+static void handle_failure() {
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) {
+        throw std::bad_alloc();
+    }
+    handler();
+}
+
+
+AllocationCounts thread_allocation_counts() {
+    return {thread_allocations, thread_bytes};
+}
+
+AllocationCounts process_allocation_counts() {
+    return {process_allocations.load(std::memory_order_relaxed), process_bytes.load(std::memory_order_relaxed)};
+}
+
+
+AllocationScope::AllocationScope(bool whole_process)
+        : whole_process(whole_process), start(whole_process ? process_allocation_counts() : thread_allocation_counts()) {}
+
+AllocationCounts AllocationScope::counts() const {
+    AllocationCounts now = whole_process ? process_allocation_counts() : thread_allocation_counts();
+    return {now.allocations - start.allocations, now.bytes - start.bytes};
+}
+
+
+// Replacements of the global allocation functions; every form of new is counted and retries through the new handler,
+// and every delete frees with free()
+void* operator new(std::size_t size) {
+    void* p;
+    while (!(p = allocate(size))) {
+        handle_failure();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment) {
+    void* p;
+    while (!(p = allocate_aligned(size, alignment))) {
+        handle_failure();
+    }
+    return p;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size, alignment);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t& tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::align_val_t, const std::nothrow_t&) noexcept {
+    std::free(p);
+}
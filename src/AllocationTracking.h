@@ -0,0 +1,69 @@
+#ifndef ALLOCATIONTRACKING_H
+#define ALLOCATIONTRACKING_H
+
+#include <cstdint>
+
+
+/**
+ * @struct AllocationCounts
+ * @brief Number and total size of the heap allocations made through operator new
+ */
+struct AllocationCounts {
+    uint64_t allocations = 0; ///< Successful calls to any form of operator new
+    uint64_t bytes = 0; ///< Bytes requested by those calls
+};
+
+
+/**
+ * @brief Get the allocations made so far by the calling thread
+ * @return Counts since the thread started
+ */
+AllocationCounts thread_allocation_counts();
+
+/**
+ * @brief Get the allocations made so far by all threads
+ * @return Counts since the process started
+ */
+AllocationCounts process_allocation_counts();
+
+
+/**
+ * @class AllocationScope
+ * @brief Counts the heap allocations made between its construction and a call to counts()
+ *
+ * Allocation tracking is opt-in: it is active in the programs that link AllocationTracking_lib (AllocationTracking.cpp),
+ * which replaces the global operator new and operator delete with versions that call malloc and free and count every
+ * block they hand out. Like the standard operator new, a failed allocation calls the installed new handler and
+ * retries, and throws std::bad_alloc once no handler is installed. The library is linked into tests and benchmarks
+ * only, never into Driver or forest_serve.
+ *
+ * A scope counts the calling thread by default, which is exact for single-threaded calls such as predict and is not
+ * disturbed by other threads. Calls that fan out to worker threads, like RandomForest::fit, need a process-wide scope,
+ * which also counts whatever else the process does meanwhile.
+ *
+ * @code
+ * AllocationScope scope;
+ * double prediction = tree.predict(sample);
+ * EXPECT_EQ(scope.counts().allocations, 0);   // allocation budget of predict
+ * @endcode
+ */
+class AllocationScope {
+    private:
+        bool whole_process; ///< Whether every thread is counted, rather than the calling thread only
+        AllocationCounts start; ///< Counts when the scope was created
+
+    public:
+        /**
+         * @brief Constructor for AllocationScope, which starts counting
+         * @param whole_process Count the allocations of every thread instead of the calling thread only
+         */
+        explicit AllocationScope(bool whole_process = false);
+
+        /**
+         * @brief Get the allocations made since the scope was created
+         * @return Counts of the calling thread, or of the whole process
+         */
+        AllocationCounts counts() const;
+};
+
+#endif // ALLOCATIONTRACKING_H
@@ -6,6 +6,7 @@
 #include <string>
 #include <memory>
 #include "DataFrame.h"
+#include "TrainingStats.h"
 
 
 /**
@@ -25,7 +26,7 @@ class Classifier {
         /**
          * @brief Destructor for the Classifier class
          */
-        ~Classifier() {};
+        virtual ~Classifier() {};
 
         /**
          * @brief Function to make a prediction
@@ -40,11 +41,37 @@ class Classifier {
          * @brief Function to fit the model to the data
          * @param data Data to fit the model to
          * @param label_column Name of the column containing the labels
+         * @return Statistics of the work done to fit the model
          * 
          * This function fits the model to the data by training the model on the data. The function takes a DataFrame
          * containing the data and the name of the column containing the labels.
          */
-        virtual void fit(std::shared_ptr<DataFrame> data, const std::string& label_column) = 0;
+        virtual TrainingStats fit(std::shared_ptr<DataFrame> data, const std::string& label_column) = 0;
+
+        /**
+         * @brief Function to report the memory footprint of the model
+         * @return Approximate number of bytes held by the model, including the object itself
+         * 
+         * This function returns the number of bytes a trained model keeps alive: its nodes, trees, feature names, and
+         * any other state needed by predict. Buffers that only exist while fitting are not counted, since they are
+         * released when fit returns. Containers are counted by capacity, so the result is an estimate rather than the
+         * exact amount reported by the allocator.
+         */
+        virtual size_t memory_usage() const = 0;
+
+    protected:
+        /**
+         * @brief Helper function to compute the heap bytes owned by a vector of strings
+         * @param strings Vector of strings
+         * @return Bytes allocated for the vector and the characters of its strings
+         */
+        static size_t strings_memory_usage(const std::vector<std::string>& strings) {
+            size_t bytes = strings.capacity() * sizeof(std::string);
+            for (const auto& str : strings) {
+                bytes += str.capacity();
+            }
+            return bytes;
+        }
 };
 
 #endif // CLASSIFIER_H
\ No newline at end of file
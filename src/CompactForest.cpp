@@ -0,0 +1,183 @@
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#include "FlatTree.h"
+#include "CompactForest.h"
+
+
+// Smallest float that is not below x, so every value <= x is still <= the stored threshold
+static float round_up_to_float(double x) {
+    float rounded = static_cast<float>(x);
+    if (static_cast<double>(rounded) < x) {
+        rounded = std::nextafter(rounded, INFINITY);
+    }
+    return rounded;
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// Position in the sample of the feature a decision node tests
+static size_t sample_position(const FlatNode& node, const std::vector<size_t>& features, size_t num_features) {
+    size_t position = node.feature;
+    if (!features.empty()) {
+        if (position >= features.size()) {
+            throw std::invalid_argument("Tree uses a feature without a sample position");
+        }
+        position = features[position];
+    }
+    if (position >= num_features) {
+        throw std::invalid_argument("Tree uses a feature outside of the sample");
+    }
+    return position;
+}
+
+
+CompactForest::CompactForest(const std::vector<FlatTree>& trees, const std::vector<std::vector<size_t>>& features, size_t num_features,
+                             ThresholdEncoding thresholds, LeafEncoding leaves)
+    : num_features(num_features), threshold_encoding(thresholds), leaf_encoding(leaves) {
+    if (features.size() != trees.size()) {
+        throw std::invalid_argument("CompactForest needs one feature mapping per tree");
+    }
+    if (num_features > CompactNode::LEAF) {
+        throw std::invalid_argument("CompactForest supports at most " + std::to_string(CompactNode::LEAF) + " features");
+    }
+
+    // Bin edges are the distinct thresholds of every feature, and the class table the distinct leaf values
+    std::vector<std::set<double>> feature_thresholds(num_features);
+    std::set<double> leaf_values;
+    for (size_t t = 0; t < trees.size(); ++t) {
+        if (trees[t].empty()) {
+            throw std::invalid_argument("CompactForest cannot hold an empty tree");
+        }
+        for (size_t i = 0; i < trees[t].size(); ++i) {
+            const FlatNode& node = trees[t].data()[i];
+            if (node.feature < 0) {
+                leaf_values.insert(node.value);
+            } else {
+                feature_thresholds[sample_position(node, features[t], num_features)].insert(node.value);
+            }
+        }
+    }
+
+    if (threshold_encoding == ThresholdEncoding::Bin16) {
+        edge_offsets.push_back(0);
+        for (const auto& edges : feature_thresholds) {
+            if (edges.size() > CompactNode::LEAF) {
+                throw std::invalid_argument("A feature has more thresholds than 16-bit bin indices can address");
+            }
+            bin_edges.insert(bin_edges.end(), edges.begin(), edges.end());
+            edge_offsets.push_back(bin_edges.size());
+        }
+    }
+    if (leaf_encoding == LeafEncoding::ClassId8) {
+        if (leaf_values.size() > 256) {
+            throw std::invalid_argument("The leaves hold more distinct values than 8-bit class ids can address");
+        }
+        classes.assign(leaf_values.begin(), leaf_values.end());
+    }
+
+    for (size_t t = 0; t < trees.size(); ++t) {
+        roots.push_back(add_subtree(trees[t], 0, features[t]));
+    }
+    nodes.shrink_to_fit();
+}
+
+uint32_t CompactForest::add_subtree(const FlatTree& tree, uint32_t index, const std::vector<size_t>& features) {
+    const FlatNode& node = tree.data()[index];
+    uint32_t position = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({0, CompactNode::LEAF, 0});
+
+    if (node.feature < 0) {
+        if (leaf_encoding == LeafEncoding::ClassId8) {
+            nodes[position].value = static_cast<uint32_t>(std::lower_bound(classes.begin(), classes.end(), node.value) - classes.begin());
+        } else {
+            nodes[position].value = float_bits(static_cast<float>(node.value));
+        }
+        return position;
+    }
+
+    size_t feature = sample_position(node, features, num_features);
+    add_subtree(tree, node.left, features);   // lands right after this node
+    uint32_t right = add_subtree(tree, node.right, features);
+    if (right - position > CompactNode::LEAF) {
+        throw std::invalid_argument("Subtree too large for a 16-bit child offset");
+    }
+
+    uint32_t value;
+    if (threshold_encoding == ThresholdEncoding::Bin16) {
+        const double* edges = bin_edges.data() + edge_offsets[feature];
+        const double* end = bin_edges.data() + edge_offsets[feature + 1];
+        value = static_cast<uint32_t>(std::lower_bound(edges, end, node.value) - edges);
+    } else {
+        value = float_bits(round_up_to_float(node.value));
+    }
+    nodes[position] = {value, static_cast<uint16_t>(feature), static_cast<uint16_t>(right - position)};
+    return position;
+}
+
+bool CompactForest::fits_class_ids(const std::vector<FlatTree>& trees) {
+    std::set<double> leaf_values;
+    for (const auto& tree : trees) {
+        for (size_t i = 0; i < tree.size(); ++i) {
+            if (tree.data()[i].feature < 0) {
+                leaf_values.insert(tree.data()[i].value);
+            }
+        }
+    }
+    return leaf_values.size() <= 256;
+}
+
+double CompactForest::leaf_value(const CompactNode& leaf) const {
+    return leaf_encoding == LeafEncoding::ClassId8 ? classes[leaf.value] : bits_float(leaf.value);
+}
+
+void CompactForest::score(const double* sample, double* tree_values) const {
+    if (threshold_encoding == ThresholdEncoding::Float32) {
+        for (size_t t = 0; t < roots.size(); ++t) {
+            const CompactNode* node = nodes.data() + roots[t];
+            while (node->feature != CompactNode::LEAF) {
+                node += sample[node->feature] <= bits_float(node->value) ? 1 : node->right;
+            }
+            tree_values[t] = leaf_value(*node);
+        }
+        return;
+    }
+
+    // Quantize the sample once: x <= edge k exactly when fewer than k + 1 edges are below x; NaN is above every bin.
+    // The bins live in per-thread scratch, so scoring allocates nothing once a thread has seen this many features.
+    static thread_local std::vector<uint16_t> bins;
+    bins.resize(num_features);
+    for (size_t f = 0; f < num_features; ++f) {
+        const double* edges = bin_edges.data() + edge_offsets[f];
+        const double* end = bin_edges.data() + edge_offsets[f + 1];
+        bins[f] = std::isnan(sample[f]) ? CompactNode::LEAF : static_cast<uint16_t>(std::lower_bound(edges, end, sample[f]) - edges);
+    }
+
+    for (size_t t = 0; t < roots.size(); ++t) {
+        const CompactNode* node = nodes.data() + roots[t];
+        while (node->feature != CompactNode::LEAF) {
+            node += bins[node->feature] <= node->value ? 1 : node->right;
+        }
+        tree_values[t] = leaf_value(*node);
+    }
+}
+
+size_t CompactForest::memory_usage() const {
+    return sizeof(*this) + nodes.capacity() * sizeof(CompactNode) + roots.capacity() * sizeof(uint32_t)
+           + edge_offsets.capacity() * sizeof(size_t) + bin_edges.capacity() * sizeof(double) + classes.capacity() * sizeof(double);
+}
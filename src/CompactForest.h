@@ -0,0 +1,138 @@
+#ifndef COMPACTFOREST_H
+#define COMPACTFOREST_H
+
+#include <cstdint>
+#include <vector>
+
+#include "FlatTree.h"
+
+
+/**
+ * @enum ThresholdEncoding
+ * @brief How CompactForest stores the thresholds of the decision nodes
+ */
+enum class ThresholdEncoding {
+    Float32, ///< The threshold rounded up to the next float; samples within that rounding step of a threshold may go left
+    Bin16 ///< Index of the threshold among the sorted thresholds of its feature; exact, at most 65535 per feature
+};
+
+/**
+ * @enum LeafEncoding
+ * @brief How CompactForest stores the values of the leaves
+ */
+enum class LeafEncoding {
+    Float32, ///< The value rounded to float; exact for integer class labels below 2^24
+    ClassId8 ///< Index into a table of the distinct leaf values of the forest; exact, at most 256 distinct values
+};
+
+
+/**
+ * @struct CompactNode
+ * @brief 8-byte record of a node in a CompactForest
+ *
+ * The nodes of every tree are stored in pre-order, so the left child of a decision node is always the next record and
+ * only the offset of the right child is kept.
+ */
+struct CompactNode {
+    uint32_t value; ///< Decision node: float32 threshold bits or bin index; leaf: float32 value bits or class id
+    uint16_t feature; ///< Position in the sample of the feature tested by a decision node, or LEAF for a leaf
+    uint16_t right; ///< Distance from a decision node to its right child; unused for leaves
+
+    static constexpr uint16_t LEAF = 0xFFFF; ///< Feature of a leaf record
+};
+
+static_assert(sizeof(CompactNode) == 8, "CompactNode must stay 8 bytes");
+
+
+/**
+ * @class CompactForest
+ * @brief Quantized, read-only copy of an ensemble of trees for low-memory serving
+ *
+ * A FlatNode takes 24 bytes and a DecisionNode object several times that; a CompactNode takes 8. Thresholds are kept
+ * either as float32 values or as uint16 bin indices against the sorted thresholds the model uses for each feature, and
+ * leaves as float32 values or uint8 ids into a shared table of leaf values. With bin indices a sample is quantized once
+ * per feature before the trees are walked, and every comparison is a 16-bit integer comparison. The default encodings,
+ * Bin16 and ClassId8, give exactly the predictions of the original trees, including for NaN feature values, which go
+ * right.
+ *
+ * @code
+ * CompactForest forest(trees, features, num_features);
+ * std::vector<double> tree_values(forest.get_num_trees());
+ * forest.score(sample.data(), tree_values.data());
+ * @endcode
+ */
+class CompactForest {
+    private:
+        size_t num_features; ///< Number of features in a sample
+        ThresholdEncoding threshold_encoding; ///< How the thresholds of the decision nodes are stored
+        LeafEncoding leaf_encoding; ///< How the values of the leaves are stored
+        std::vector<CompactNode> nodes; ///< Nodes of all trees, every tree in pre-order
+        std::vector<uint32_t> roots; ///< Index of the root of every tree in nodes
+        std::vector<size_t> edge_offsets; ///< Start of the bin edges of every feature in bin_edges; num_features + 1 entries
+        std::vector<double> bin_edges; ///< Sorted distinct thresholds of every feature (Bin16 only)
+        std::vector<double> classes; ///< Distinct leaf values, in increasing order (ClassId8 only)
+
+        /**
+         * @brief Helper method for the constructor; appends the subtree rooted at a node in pre-order
+         * @return Index of the appended subtree root in nodes
+         */
+        uint32_t add_subtree(const FlatTree& tree, uint32_t index, const std::vector<size_t>& features);
+
+        /**
+         * @brief Helper method which looks up the value of a leaf record
+         */
+        double leaf_value(const CompactNode& leaf) const;
+
+    public:
+        /**
+         * @brief Constructor for CompactForest
+         * @param trees Trees of the ensemble
+         * @param features For every tree, the position in the sample of every feature index the tree uses; an empty
+         *                 vector means the tree indexes the sample directly
+         * @param num_features Number of features in a sample; at most 65535
+         * @param thresholds How to store the thresholds
+         * @param leaves How to store the leaf values
+         * @throws std::invalid_argument if a tree is empty or uses a feature outside the sample, a feature has more than
+         *         65535 distinct thresholds (Bin16), the leaves have more than 256 distinct values (ClassId8), or a left
+         *         subtree has 65535 or more nodes
+         */
+        CompactForest(const std::vector<FlatTree>& trees, const std::vector<std::vector<size_t>>& features, size_t num_features,
+                      ThresholdEncoding thresholds = ThresholdEncoding::Bin16, LeafEncoding leaves = LeafEncoding::ClassId8);
+
+        /**
+         * @brief Check whether the leaves of the trees can be stored as class ids
+         * @param trees Trees of the ensemble
+         * @return True if the leaves hold at most 256 distinct values
+         */
+        static bool fits_class_ids(const std::vector<FlatTree>& trees);
+
+        /**
+         * @brief Evaluate every tree of the ensemble on a sample
+         * @param sample Pointer to the num_features feature values of the sample
+         * @param tree_values Receives the value of the exit leaf of every tree, in the order the trees were given
+         *
+         * The quantized sample is kept in per-thread scratch, so concurrent calls are safe and do not allocate once
+         * the calling thread has scored a sample.
+         */
+        void score(const double* sample, double* tree_values) const;
+
+        /**
+         * @brief Get the number of trees in the ensemble
+         * @return Number of trees
+         */
+        size_t get_num_trees() const { return roots.size(); }
+
+        /**
+         * @brief Get the number of node records
+         * @return Number of nodes over all trees
+         */
+        size_t get_num_nodes() const { return nodes.size(); }
+
+        /**
+         * @brief Get the memory held by the forest
+         * @return Approximate number of bytes held by the object, its node records, and its tables
+         */
+        size_t memory_usage() const;
+};
+
+#endif // COMPACTFOREST_H
@@ -10,8 +10,11 @@
 #include <unordered_set>
 #include <fstream>
 #include <random>
+#include <numeric>
 
 #include "DataFrame.h"
+#include "Impurity.h"
+#include "Trace.h"
 
 using std::vector;
 using std::string;
@@ -82,20 +85,13 @@ Cell Series::mode() const {
         throw std::runtime_error("Cannot compute mode on an empty column!");
     }
 
-    // Frequency map to count occurrences of each value
+    // Count every value in a single pass; ties go to the value whose count reaches the maximum first
     std::map<Cell, int> frequency_map;
-
-    for (const auto& cell : data) {
-        frequency_map[cell]++;
-    }
-
-    // Find the maximum frequency
     int max_frequency = 0;
     Cell mode_value = data[0];  // Default to first value
 
     for (const auto& cell : data) {
-        int& count = frequency_map[cell];  // Get reference to count (increments automatically)
-        count++;
+        int count = ++frequency_map[cell];
 
         if (count > max_frequency) {
             max_frequency = count;
@@ -106,6 +102,25 @@ Cell Series::mode() const {
     return mode_value;
 }
 
+Cell Series::mode(const Series& weights) const {
+    if (data.empty()) {
+        throw std::runtime_error("Cannot compute mode on an empty column!");
+    }
+    if (weights.size() != data.size()) {
+        throw std::runtime_error("Series sizes do not match");
+    }
+
+    // Total weight of each value
+    std::map<Cell, double> weight_map;
+    vector<double> numeric_weights = weights.convert_to_numeric();
+    for (size_t i = 0; i < data.size(); ++i) {
+        weight_map[data[i]] += numeric_weights[i];
+    }
+
+    return std::max_element(weight_map.begin(), weight_map.end(),
+                            [](const auto& a, const auto& b) { return a.second < b.second; })->first;
+}
+
 double Series::mean() const {
     if (data.empty()) {
         throw std::runtime_error("Cannot compute mode on an empty column!");
@@ -176,6 +191,22 @@ vector<double> Series::convert_to_numeric() const {
     return numeric_values;
 }
 
+void Series::convert_to_numeric(size_t begin, size_t end, double* values, size_t stride) const {
+    if (begin > end || end > data.size()) {
+        throw std::out_of_range("row range out of bounds");
+    }
+    for (size_t row = begin; row < end; ++row, values += stride) {
+        *values = std::visit([](auto&& value) -> double {
+            using T = std::decay_t<decltype(value)>;
+            if constexpr (std::is_same_v<T, int> || std::is_same_v<T, double>) {
+                return static_cast<double>(value);
+            } else {
+                throw std::runtime_error("The column does not entirely consist of numeric data");
+            }
+        }, data[row]);
+    }
+}
+
 vector<string> Series::convert_to_string() const {
     std::vector<string> string_values;
 
@@ -297,6 +328,36 @@ double Series::calculateEntropy() const {
 }
 
 
+double Series::calculateEntropy(const Series& weights) const {
+    if (weights.size() != data.size()) {
+        throw std::runtime_error("Series sizes do not match");
+    }
+
+    // Accumulate the weight of each unique value
+    std::map<Cell, double> weight_map;
+    vector<double> numeric_weights = weights.convert_to_numeric();
+    double total_weight = 0.0;
+    for (size_t i = 0; i < data.size(); ++i) {
+        weight_map[data[i]] += numeric_weights[i];
+        total_weight += numeric_weights[i];
+    }
+
+    double entropy = 0.0;
+    if (total_weight <= 0.0) {
+        return entropy;
+    }
+
+    for (const auto& [key, weight] : weight_map) {
+        if (weight > 0.0) {
+            double probability = weight / total_weight;
+            entropy -= probability * std::log2(probability);
+        }
+    }
+
+    return entropy;
+}
+
+
 
 
 
@@ -340,7 +401,7 @@ DataFrame::~DataFrame() {}
 
 
 // Function to calculate information gain of an attribute
-double DataFrame::calculateInformationGain(string attribute_name, string label_name) const {
+double DataFrame::calculateInformationGain(string attribute_name, string label_name, size_t* num_values) const {
     // Check if the attribute and label columns exist
     if (data.find(attribute_name) == data.end()) {
         throw std::runtime_error("attribute column not found");
@@ -349,50 +410,81 @@ double DataFrame::calculateInformationGain(string attribute_name, string label_n
         throw std::runtime_error("label column not found");
     }
 
-    // Get the label data
-    Series label_data = data.at(label_name);
-
-    // Compute the entropy of the entire dataset w.r.t. label column
-    double total_entropy = label_data.calculateEntropy();
+    return informationGain(attribute_name, label_name, "", num_values);
+}
 
-    // map to store subsets of data based on attribute values
-    std::map<Cell, vector<size_t>> partitions;
-    size_t total_count = label_data.size();
 
-    // Partition data based on attribute values
-    for (size_t row = 0; row < total_count; ++row) {
-        Series attribute_data = data.at(attribute_name);
-        partitions[attribute_data[row]].push_back(row);
+// Function to calculate the information gain of an attribute where every row counts with its weight
+double DataFrame::calculateInformationGain(string attribute_name, string label_name, string weight_name, size_t* num_values) const {
+    // Check if the attribute, label and weight columns exist
+    if (data.find(attribute_name) == data.end()) {
+        throw std::runtime_error("attribute column not found");
+    }
+    if (data.find(label_name) == data.end()) {
+        throw std::runtime_error("label column not found");
+    }
+    if (data.find(weight_name) == data.end()) {
+        throw std::runtime_error("weight column not found");
     }
 
-    // Compute weighted entropy after the split
-    double weighted_entropy = 0.0;
-
-    for (const auto& [attribute_value, row_indices] : partitions) {
-        // Create a temporary DataFrame for subset
-        DataFrame subset;
-        for (const auto& col : columns) {
-            subset.add_column(col);
-        }
+    return informationGain(attribute_name, label_name, weight_name, num_values);
+}
 
-        for (size_t row : row_indices) {
-            std::vector<Cell> new_row;
-            for (const auto& col : columns) {
-                Series col_data = data.at(col);
-                new_row.push_back(col_data[row]);
+// Shared implementation of both calculateInformationGain overloads; an empty weight name counts every row once
+double DataFrame::informationGain(const string& attribute_name, const string& label_name, const string& weight_name,
+                                  size_t* num_values) const {
+    const Series& attribute_data = data.at(attribute_name);
+    LabelEncoder labels(data.at(label_name));
+    const vector<ClassId>& ids = labels.get_ids();
+    bool weighted = !weight_name.empty();
+    vector<double> weights = weighted ? data.at(weight_name).convert_to_numeric() : vector<double>();
+
+    // Order the rows by attribute value, so that the rows of every value are adjacent; NaN, which compares false with
+    // everything, sorts last and forms one value of its own
+    vector<size_t> order(ids.size());
+    std::iota(order.begin(), order.end(), 0);
+    auto values = attribute_data.begin();
+    auto is_nan = [](const Cell& cell) { return std::holds_alternative<double>(cell) && std::isnan(std::get<double>(cell)); };
+    auto less = [&values, &is_nan](size_t a, size_t b) {
+        return !is_nan(values[a]) && (is_nan(values[b]) || values[a] < values[b]);
+    };
+    std::sort(order.begin(), order.end(), less);
+
+    // Class counts of the whole column, and of every attribute value in turn
+    ImpurityKernel kernel(SplitCriterion::Entropy, weighted ? 0 : ids.size());
+    ClassCounts total(labels.num_classes());
+    ClassCounts partition(labels.num_classes());
+    double total_weight = 0.0;
+    double weighted_entropy = 0.0;
+    size_t partitions = 0;
+    for (size_t begin = 0; begin < order.size();) {
+        size_t end = begin;
+        for (; end < order.size() && !less(order[begin], order[end]) && !less(order[end], order[begin]); ++end) {
+            size_t row = order[end];
+            if (weighted) {
+                partition.add(ids[row], weights[row]);
+                total.add(ids[row], weights[row]);
+                total_weight += weights[row];
+            } else {
+                partition.add(ids[row]);
+                total.add(ids[row]);
             }
-            subset.add_row(new_row);
         }
-
-        // Compute entropy of this subset
-        double subset_entropy = subset.data.at(label_name).calculateEntropy();
-        double subset_weight = static_cast<double>(row_indices.size()) / total_count;
-
-        weighted_entropy += subset_weight * subset_entropy;
+        weighted_entropy += partition.weighted_impurity(kernel, weighted);
+        partition.clear();
+        partitions++;
+        begin = end;
+    }
+    if (num_values) {
+        *num_values = partitions;
     }
 
     // Information Gain = Total Entropy - Weighted Entropy after split
-    return total_entropy - weighted_entropy;
+    double total_size = weighted ? total_weight : static_cast<double>(ids.size());
+    if (total_size <= 0.0) {
+        return 0.0;
+    }
+    return (total.weighted_impurity(kernel, weighted) - weighted_entropy) / total_size;
 }
 
 
@@ -711,6 +803,14 @@ Series DataFrame::get_column(string col_name) const {
     return this->data.at(col_name);
 }
 
+const Series& DataFrame::view_column(const string& col_name) const {
+    auto it = data.find(col_name);
+    if (it == data.end()) {
+        throw std::invalid_argument("Column not found");
+    }
+    return it->second;
+}
+
 void DataFrame::set_column(const std::string& name, const Series& column) {
     if (data.empty()) {
         add_column(name, column);
@@ -897,20 +997,38 @@ string DataFrame::print() const {
 
 // Function to find the best attribute (highest information gain)
 string DataFrame::selectBestAttribute(string label_name) {
+    return selectBestAttribute(label_name, columns);
+}
+
+// Function to find the best attribute among a subset of the columns
+string DataFrame::selectBestAttribute(string label_name, const vector<string>& candidates) {
+    return selectBestAttribute(label_name, candidates, "");
+}
+
+// Function to find the best attribute among a subset of the columns, weighting each row
+string DataFrame::selectBestAttribute(string label_name, const vector<string>& candidates, string weight_column, size_t* num_thresholds) {
 
     if (data.find(label_name) == data.end()) {
         throw std::invalid_argument("Label column not found");
     }
+    if (!weight_column.empty() && data.find(weight_column) == data.end()) {
+        throw std::invalid_argument("Weight column not found");
+    }
 
     string bestAttribute = "";
     double maxGain = -std::numeric_limits<double>::infinity();
 
-    for (const std::string& attribute_name : columns) {
-        if (attribute_name == label_name) {
+    for (const std::string& attribute_name : candidates) {
+        if (attribute_name == label_name || attribute_name == weight_column) {
             continue;
         }
 
-        double gain = calculateInformationGain(attribute_name, label_name);
+        size_t num_values = 0;
+        double gain = weight_column.empty() ? calculateInformationGain(attribute_name, label_name, &num_values)
+                                            : calculateInformationGain(attribute_name, label_name, weight_column, &num_values);
+        if (num_thresholds) {
+            *num_thresholds += num_values;
+        }
         if (gain > maxGain) {
             maxGain = gain;
             bestAttribute = attribute_name;
@@ -922,6 +1040,7 @@ string DataFrame::selectBestAttribute(string label_name) {
 
 
 void DataFrame::one_hot_encode(string col_name) {
+    RF_TRACE_SCOPE("DataFrame::one_hot_encode", "data");
     if (data.find(col_name) == data.end()) {
         throw std::invalid_argument("Column not found");
     }
@@ -998,19 +1117,10 @@ unique_ptr<DataFrame> DataFrame::bootstrap_sample(size_t num_features, string la
     return sample;
 }
 
-// Overloaded version that also allows controlling the random process through a seed
-unique_ptr<DataFrame> DataFrame::bootstrap_sample(size_t num_features, string label_column, size_t random_state) {
-    if (num_features > columns.size() - 1) {
-        num_features = columns.size() - 1;
-    }
-
-    std::unique_ptr<DataFrame> sample = std::make_unique<DataFrame>();
-
-    // Mersenne twister random number generator
-    std::mt19937 generator(random_state);
+// Helper which randomly selects num_features distinct columns (excluding the label column)
+std::unordered_set<std::string> DataFrame::select_random_features(size_t num_features, const string& label_column, std::mt19937& generator) const {
     std::uniform_int_distribution<int> distribution(0, columns.size() - 1);
 
-    // Randomly select num_features columns (excluding the label column)
     std::unordered_set<std::string> selected_features;
     
     while (selected_features.size() < static_cast<size_t>(num_features) && selected_features.size() < columns.size() - 1) {
@@ -1022,34 +1132,141 @@ unique_ptr<DataFrame> DataFrame::bootstrap_sample(size_t num_features, string la
         selected_features.insert(columns[random_index]);
     }
 
-    // Add selected columns to the new DataFrame
-    for (const auto& feature : selected_features) {
-        sample->add_column(feature);
+    return selected_features;
+}
+
+// Overloaded version that also allows controlling the random process through a seed
+unique_ptr<DataFrame> DataFrame::bootstrap_sample(size_t num_features, string label_column, size_t random_state) {
+    RF_TRACE_SCOPE("DataFrame::bootstrap_sample", "data");
+    return copy_draw(draw_bootstrap(num_features, label_column, random_state), label_column);
+}
+
+// Draws the features and rows of a seeded bootstrap sample
+SampleDraw DataFrame::draw_bootstrap(size_t num_features, const string& label_column, size_t random_state) const {
+    if (num_features > columns.size() - 1) {
+        num_features = columns.size() - 1;
     }
-    sample->add_column(label_column);
+
+    // Mersenne twister random number generator
+    std::mt19937 generator(random_state);
+
+    // Randomly select num_features columns (excluding the label column); they keep the order of the set
+    std::unordered_set<std::string> selected_features = select_random_features(num_features, label_column, generator);
+    SampleDraw draw;
+    draw.features.assign(selected_features.begin(), selected_features.end());
 
     // Bootstrap sampling (random rows with replacement)
     int num_rows = this->get_num_rows();
+    if (num_rows == 0) {
+        throw std::runtime_error("No rows to sample from.");
+    }
     std::uniform_int_distribution<int> row_distribution(0, num_rows - 1);
+    draw.rows.reserve(num_rows);
+    for (int i = 0; i < num_rows; ++i) {
+        draw.rows.push_back(row_distribution(generator));
+    }
 
+    return draw;
+}
 
+
+
+// Sampling without replacement, used for stochastic gradient boosting
+unique_ptr<DataFrame> DataFrame::subsample(double row_fraction, size_t num_features, string label_column, size_t random_state) {
+    return copy_draw(draw_subsample(row_fraction, num_features, label_column, random_state), label_column);
+}
+
+// Overloaded version where the caller decides which rows to keep
+unique_ptr<DataFrame> DataFrame::subsample(const vector<size_t>& rows, size_t num_features, string label_column, size_t random_state) {
+    return copy_draw(draw_subsample(rows, num_features, label_column, random_state), label_column);
+}
+
+// Draws the features and rows of a subsample
+SampleDraw DataFrame::draw_subsample(double row_fraction, size_t num_features, const string& label_column, size_t random_state) const {
+    if (row_fraction <= 0.0 || row_fraction > 1.0) {
+        throw std::invalid_argument("row_fraction must be in the interval (0, 1]");
+    }
+
+    size_t num_rows = this->get_num_rows();
     if (num_rows == 0) {
         throw std::runtime_error("No rows to sample from.");
     }
-    for (int i = 0; i < num_rows; ++i) {
-        int random_index = row_distribution(generator);
-        // Build a new row only with the selected columns
-        std::vector<Cell> new_row;
-        for (const auto& col : sample->columns) {
-            new_row.push_back(this->data.at(col).retrieve(random_index));
+
+    if (num_features > columns.size() - 1) {
+        num_features = columns.size() - 1;
+    }
+
+    std::mt19937 generator(random_state);
+
+    // Randomly select num_features columns (excluding the label column) with the same helper as bootstrap_sample
+    SampleDraw draw;
+    draw.features = in_column_order(select_random_features(num_features, label_column, generator));
+
+    // Draw the rows without replacement, then restore their original order
+    size_t rows_to_sample = std::max<size_t>(1, static_cast<size_t>(std::round(row_fraction * num_rows)));
+    draw.rows.resize(num_rows);
+    for (size_t i = 0; i < num_rows; ++i) {
+        draw.rows[i] = i;
+    }
+    if (rows_to_sample < num_rows) {
+        std::shuffle(draw.rows.begin(), draw.rows.end(), generator);
+        draw.rows.resize(rows_to_sample);
+        std::sort(draw.rows.begin(), draw.rows.end());
+    }
+
+    return draw;
+}
+
+// Overloaded version where the caller decides which rows to keep
+SampleDraw DataFrame::draw_subsample(const vector<size_t>& rows, size_t num_features, const string& label_column, size_t random_state) const {
+    size_t num_rows = this->get_num_rows();
+    for (size_t row : rows) {
+        if (row >= num_rows) {
+            throw std::out_of_range("row index out of bounds");
         }
+    }
 
-        sample->add_row(new_row);
+    if (num_features > columns.size() - 1) {
+        num_features = columns.size() - 1;
     }
 
-    return sample;
+    std::mt19937 generator(random_state);
+    SampleDraw draw;
+    draw.features = in_column_order(select_random_features(num_features, label_column, generator));
+    draw.rows = rows;
+    return draw;
+}
+
+// Keeps the selected features in their original order so the result does not depend on the hashing of the set
+vector<string> DataFrame::in_column_order(const std::unordered_set<string>& selected_features) const {
+    vector<string> features;
+    for (const auto& col : columns) {
+        if (selected_features.count(col)) {
+            features.push_back(col);
+        }
+    }
+    return features;
 }
 
+// Copies the drawn rows of the drawn features, followed by the label column
+unique_ptr<DataFrame> DataFrame::copy_draw(const SampleDraw& draw, const string& label_column) const {
+    std::unique_ptr<DataFrame> sample = std::make_unique<DataFrame>();
+    for (const auto& col : draw.features) {
+        sample->add_column(col);
+    }
+    sample->add_column(label_column);
+
+    // Copy the column data directly instead of building the frame row by row
+    for (const auto& col : sample->columns) {
+        const Series& source = this->data.at(col);
+        Series& target = sample->data[col];
+        for (size_t index : draw.rows) {
+            target.push_back(source.retrieve(index));
+        }
+    }
+
+    return sample;
+}
 
 
 // Filter method
@@ -1199,6 +1416,7 @@ string DataFrame::str_cast(Cell cell) {
 
 
 std::unique_ptr<DataFrame> DataFrame::read_csv(const std::string& file_path) {
+    RF_TRACE_SCOPE("DataFrame::read_csv", "data");
     std::ifstream file(file_path);
     if (!file.is_open()) {
         throw std::runtime_error("Failed to open file: " + file_path);
@@ -1270,6 +1488,7 @@ std::unique_ptr<DataFrame> DataFrame::read_csv(const std::string& file_path) {
 
 
 std::pair<std::shared_ptr<DataFrame>, std::shared_ptr<DataFrame>> DataFrame::split_train_test(double percent_training) {
+    RF_TRACE_SCOPE("DataFrame::split_train_test", "data");
     if (percent_training <= 0.0 || percent_training >= 100.0) {
         throw std::invalid_argument("percent_training must be between 0 and 100 (exclusive)");
     }
@@ -1311,6 +1530,7 @@ std::pair<std::shared_ptr<DataFrame>, std::shared_ptr<DataFrame>> DataFrame::spl
 
 
 std::pair<std::shared_ptr<DataFrame>, std::shared_ptr<DataFrame>> DataFrame::split_train_test(double percent_training, size_t seed) {
+    RF_TRACE_SCOPE("DataFrame::split_train_test", "data");
     if (percent_training <= 0.0 || percent_training >= 100.0) {
         throw std::invalid_argument("percent_training must be between 0 and 100 (exclusive)");
     }
@@ -1352,6 +1572,7 @@ std::pair<std::shared_ptr<DataFrame>, std::shared_ptr<DataFrame>> DataFrame::spl
 
 
 std::vector<std::unique_ptr<DataFrame>> DataFrame::split_k_fold(size_t n_folds) {
+    RF_TRACE_SCOPE("DataFrame::split_k_fold", "data");
     if (n_folds < 2) {
         throw std::invalid_argument("n_folds must be at least 2");
     }
@@ -1406,6 +1627,7 @@ std::vector<std::unique_ptr<DataFrame>> DataFrame::split_k_fold(size_t n_folds)
 
 
 std::vector<std::unique_ptr<DataFrame>> DataFrame::split_k_fold(size_t n_folds, size_t seed) {
+    RF_TRACE_SCOPE("DataFrame::split_k_fold", "data");
     if (n_folds < 2) {
         throw std::invalid_argument("n_folds must be at least 2");
     }
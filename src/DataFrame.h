@@ -3,6 +3,8 @@
 
 #include <variant>
 #include <unordered_map>
+#include <unordered_set>
+#include <random>
 
 using std::vector;
 using std::string;
@@ -96,10 +98,22 @@ class Series {
          * @return mode (i.e. most frequent entry) of the column as a Cell
          * @throws runtime_error if the column is empty
          * 
-         * This function calculates the mode of the specified column.
+         * This function calculates the mode of the specified column. Ties go to the value whose count reaches the
+         * highest count first when the column is read from the start, e.g. 3 for {1, 2, 3, 3, 0, 1}.
          */
         Cell mode() const;
 
+        /**
+         * @brief Calculates the weighted mode of the Series
+         * @param weights Series of numeric weights, one per entry
+         * @return entry of the Series with the greatest total weight, as a Cell
+         * @throws runtime_error if the column is empty or the sizes of the Series do not match
+         * 
+         * This function calculates the mode of the Series where every entry counts with its weight instead of once.
+         * Ties are broken in favour of the smallest value.
+         */
+        Cell mode(const Series& weights) const;
+
 
         /**
          * @brief Function to convert the Series to numeric classes
@@ -228,6 +242,19 @@ class Series {
          */
         vector<double> convert_to_numeric() const;
 
+        /**
+         * @brief Function to convert a range of rows to numeric values in place
+         * @param begin First row to convert
+         * @param end One past the last row to convert
+         * @param values Receives the value of row begin + k at values[k * stride]
+         * @param stride Distance between two consecutive values in the output, e.g. the row size of a row-major buffer
+         * @throws std::out_of_range if the range is outside of the Series
+         * @throws std::runtime_error if a row in the range is not numeric
+         *
+         * Unlike convert_to_numeric(), nothing is allocated, so several threads can each convert their own rows.
+         */
+        void convert_to_numeric(size_t begin, size_t end, double* values, size_t stride = 1) const;
+
 
         /**
          * @brief Helper function to convert a column to string values
@@ -256,6 +283,17 @@ class Series {
          */
         double calculateEntropy() const;
 
+        /**
+         * @brief Function to calculate the weighted entropy of a set of labels
+         * @param weights Series of numeric weights, one per label
+         * @return double entropy of the set of labels
+         * @throws runtime_error if the sizes of the Series do not match
+         * 
+         * This function calculates the entropy like calculateEntropy(), except that the probability of each label is the
+         * total weight of its entries divided by the total weight of the Series.
+         */
+        double calculateEntropy(const Series& weights) const;
+
 
 };
 
@@ -273,6 +311,19 @@ class Series {
 /* -------------------------------------------------- */
 
 
+/**
+ * @struct SampleDraw
+ * @brief Rows and features drawn by a sampling method of DataFrame, without copying any data
+ *
+ * Ensembles that train on a shared SortedIndex use the draws directly; bootstrap_sample and subsample copy them into a
+ * new DataFrame.
+ */
+struct SampleDraw {
+    vector<string> features; ///< Names of the drawn feature columns, in the order the copied sample stores them
+    vector<size_t> rows; ///< Indices of the drawn rows, in the order the copied sample stores them; may repeat
+};
+
+
 /**
  * @class DataFrame
  * @brief DataFrame class
@@ -290,6 +341,7 @@ class DataFrame {
          * @brief Function to calculate the information gain of an attribute
          * @param attributeIndex Index of the attribute for which to calculate information gain
          * @param label_column Name of the column containing the labels
+         * @param num_values If not null, receives the number of distinct values of the attribute (the partitions scored)
          * @return double information gain of the attribute
          * 
          * Information gain is a measure of the reduction in entropy that results from splitting a set of data on a particular attribute.
@@ -299,7 +351,35 @@ class DataFrame {
          * 3. Calculate the information gain as the entropy of the set of labels minus the weighted average entropy after splitting.
          * 4. Return the information gain.
          */
-        double calculateInformationGain(string attribute_column, string label_column) const;
+        double calculateInformationGain(string attribute_column, string label_column, size_t* num_values = nullptr) const;
+
+        /**
+         * @brief Function to calculate the weighted information gain of an attribute
+         * @param attribute_column Name of the attribute for which to calculate information gain
+         * @param label_column Name of the column containing the labels
+         * @param weight_column Name of the column containing the sample weights
+         * @param num_values If not null, receives the number of distinct values of the attribute (the partitions scored)
+         * @return double information gain of the attribute
+         * 
+         * This function calculates the information gain like calculateInformationGain(string attribute_column, string label_column),
+         * but every row contributes its weight to the entropies and to the size of the partitions.
+         */
+        double calculateInformationGain(string attribute_column, string label_column, string weight_column,
+                                        size_t* num_values = nullptr) const;
+
+        /**
+         * @brief Shared implementation of the calculateInformationGain functions
+         * @param attribute_name Name of the attribute for which to calculate information gain
+         * @param label_name Name of the column containing the labels
+         * @param weight_name Name of the column containing the sample weights; empty to count every row once
+         * @param num_values If not null, receives the number of distinct values of the attribute
+         * @return double information gain of the attribute
+         * 
+         * The labels are encoded as class ids and counted per attribute value in a ClassCounts, after ordering the
+         * rows by attribute value, so no row or subset is copied.
+         */
+        double informationGain(const string& attribute_name, const string& label_name, const string& weight_name,
+                               size_t* num_values) const;
 
         /**
          * @brief Helper function to filter all rows where the value of the attribute at the given index is less than the threshold
@@ -381,6 +461,36 @@ class DataFrame {
          */
         static bool is_double(const std::string& str);
 
+        /**
+         * @brief Helper function to randomly select a subset of the feature columns
+         * @param num_features Number of features to select
+         * @param label_column Name of the column containing the labels; this column is never selected
+         * @param generator Random number generator used for the selection
+         * @return Set of the selected column names
+         * 
+         * This function draws random column indices from the generator until num_features distinct, non-label
+         * columns have been selected. It is shared by the seeded bootstrap sampling and the subsampling used in
+         * gradient boosting, so that both consume the generator in the same way.
+         */
+        std::unordered_set<string> select_random_features(size_t num_features, const string& label_column, std::mt19937& generator) const;
+
+        /**
+         * @brief Helper function to copy the drawn rows of the drawn features (and the label) into a new DataFrame
+         * @param draw Rows and features to copy, in order
+         * @param label_column Name of the column containing the labels; it is always copied last
+         * @return DataFrame containing the copied rows and columns
+         *
+         * This is the shared implementation of bootstrap_sample and the subsample overloads.
+         */
+        unique_ptr<DataFrame> copy_draw(const SampleDraw& draw, const string& label_column) const;
+
+        /**
+         * @brief Helper function to list the selected features in their original column order
+         * @param selected_features Names of the selected feature columns
+         * @return The selected names, ordered like columns, so that the order does not depend on the hashing of the set
+         */
+        vector<string> in_column_order(const std::unordered_set<string>& selected_features) const;
+
     public:
 
         vector<string> columns; ///< Vector of column names
@@ -546,6 +656,15 @@ class DataFrame {
          */
         Series get_column(string col_name) const;
 
+        /**
+         * @brief Function to get a column of the DataFrame without copying it
+         * @param col_name Name of the column
+         * @return Reference to the column, valid until the DataFrame is modified
+         * @throws std::invalid_argument if the column name is not found
+         * @see DataFrame::get_column
+         */
+        const Series& view_column(const string& col_name) const;
+
         /**
         * @brief Adds a column to the DataFrame.
         * @param name Column name.
@@ -649,6 +768,36 @@ class DataFrame {
          */
         string selectBestAttribute(string label_name);
 
+        /**
+         * @brief Function which calculates the attribute with the greatest information gain among a set of candidates
+         * @param label_name Name of the column containing the labels
+         * @param candidates Names of the columns that may be selected
+         * @return Name of the candidate attribute with the greatest information gain
+         * @throws std::invalid_argument if the label column is not found
+         * @see selectBestAttribute(string label_name)
+         * 
+         * This function behaves like selectBestAttribute(string label_name), but only the specified candidate columns
+         * are considered. Ties are broken in favour of the candidate that appears first. This is used to restrict the
+         * split search to a random subset of the columns (e.g. per-level column sampling in gradient boosting).
+         */
+        string selectBestAttribute(string label_name, const vector<string>& candidates);
+
+        /**
+         * @brief Function which calculates the attribute with the greatest weighted information gain among a set of candidates
+         * @param label_name Name of the column containing the labels
+         * @param candidates Names of the columns that may be selected
+         * @param weight_column Name of the column containing the sample weights; an empty name means every row has weight 1
+         * @param num_thresholds If not null, the number of partitions scored over all candidates is added to it
+         * @return Name of the candidate attribute with the greatest information gain
+         * @throws std::invalid_argument if the label or weight column is not found
+         * @see selectBestAttribute(string label_name, const vector<string>& candidates)
+         * 
+         * This function is used to grow trees on weighted samples, such as the rows kept by gradient-based one-side sampling.
+         * The weight column itself is never selected.
+         */
+        string selectBestAttribute(string label_name, const vector<string>& candidates, string weight_column,
+                                   size_t* num_thresholds = nullptr);
+
         /**
          * @brief Function to create a bootstrap sample of the DataFrame
          * @return DataFrame containing a bootstrap sample of the data
@@ -725,6 +874,93 @@ class DataFrame {
          */
         unique_ptr<DataFrame> bootstrap_sample(size_t num_features, string label_column, size_t random_state);
 
+        /**
+         * @brief Function to create a random subsample of the rows and features of the DataFrame
+         * @param row_fraction Fraction of the rows to sample (without replacement) as a decimal in (0, 1]
+         * @param num_features Number of features to sample
+         * @param label_column Name of the column containing the labels
+         * @param random_state Random seed for sampling
+         * @return DataFrame containing the sampled rows and features, with the label column last
+         * @throws std::invalid_argument if row_fraction is not in (0, 1]
+         * @throws std::runtime_error if the DataFrame has no rows
+         * 
+         * This function is the sampling counterpart of bootstrap_sample used by stochastic gradient boosting. Rows are
+         * drawn without replacement and keep their original order; the selected features keep their original column
+         * order and are followed by the label column. At least one row is always sampled.
+         * 
+         * @code
+         * std::vector<std::vector<double>> sample = {
+         * {0,0,0,0},
+         * {1,0,1,0},
+         * {0,2,0,2},
+         * {3,3,3,3},
+         * {4,0,0,4}};
+         * DataFrame df(sample, {"a", "b", "c", "d"});
+         * 
+         * std::unique_ptr<DataFrame> subsample = df.subsample(0.6, 2, "d", 42);
+         * 
+         * printf("Subsample has 3 rows: %s", subsample->get_num_rows() == 3 ? "TRUE" : "FALSE");
+         * printf("Subsample has 2 features and the label: %s", subsample->get_num_columns() == 3 ? "TRUE" : "FALSE");
+         * @endcode
+         */
+        unique_ptr<DataFrame> subsample(double row_fraction, size_t num_features, string label_column, size_t random_state);
+
+        /**
+         * @brief Function to create a subsample of the given rows and a random subset of the features of the DataFrame
+         * @param rows Indices of the rows to keep, in the order they should appear
+         * @param num_features Number of features to sample
+         * @param label_column Name of the column containing the labels
+         * @param random_state Random seed for the feature sampling
+         * @return DataFrame containing the given rows and the sampled features, with the label column last
+         * @throws std::out_of_range if one of the row indices is out of bounds
+         * @see subsample(double row_fraction, size_t num_features, string label_column, size_t random_state)
+         * 
+         * This overload is used when the rows are chosen by the caller, e.g. by gradient-based one-side sampling.
+         */
+        unique_ptr<DataFrame> subsample(const vector<size_t>& rows, size_t num_features, string label_column, size_t random_state);
+
+        /**
+         * @brief Function to draw a seeded bootstrap sample without copying it
+         * @param num_features Number of features to sample
+         * @param label_column Name of the column containing the labels
+         * @param random_state Random seed for sampling
+         * @return Drawn features and rows; copying them gives bootstrap_sample(num_features, label_column, random_state)
+         * @throws std::runtime_error if the DataFrame has no rows
+         *
+         * The random numbers are consumed exactly as by bootstrap_sample, so a tree trained on the draw through a
+         * SortedIndex sees the same sample as a tree trained on the copy.
+         *
+         * @see bootstrap_sample(size_t num_features, string label_column, size_t random_state)
+         */
+        SampleDraw draw_bootstrap(size_t num_features, const string& label_column, size_t random_state) const;
+
+        /**
+         * @brief Function to draw a random subsample of the rows and features without copying it
+         * @param row_fraction Fraction of the rows to sample (without replacement) as a decimal in (0, 1]
+         * @param num_features Number of features to sample
+         * @param label_column Name of the column containing the labels
+         * @param random_state Random seed for sampling
+         * @return Drawn features and rows; copying them gives subsample(row_fraction, num_features, label_column, random_state)
+         * @throws std::invalid_argument if row_fraction is not in (0, 1]
+         * @throws std::runtime_error if the DataFrame has no rows
+         *
+         * @see subsample(double row_fraction, size_t num_features, string label_column, size_t random_state)
+         */
+        SampleDraw draw_subsample(double row_fraction, size_t num_features, const string& label_column, size_t random_state) const;
+
+        /**
+         * @brief Function to draw a random subset of the features for the given rows without copying them
+         * @param rows Indices of the rows to keep, in the order they should appear
+         * @param num_features Number of features to sample
+         * @param label_column Name of the column containing the labels
+         * @param random_state Random seed for the feature sampling
+         * @return Drawn features and the given rows; copying them gives subsample(rows, num_features, label_column, random_state)
+         * @throws std::out_of_range if one of the row indices is out of bounds
+         *
+         * @see subsample(const vector<size_t>& rows, size_t num_features, string label_column, size_t random_state)
+         */
+        SampleDraw draw_subsample(const vector<size_t>& rows, size_t num_features, const string& label_column, size_t random_state) const;
+
         /**
          * @brief Function to filter the DataFrame based on a condition
          * @param attributeIndex Index of the attribute to filter on
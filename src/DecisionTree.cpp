@@ -3,10 +3,21 @@
 #include <vector>
 #include <iomanip>
 #include <sstream>
+#include <random>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <limits>
 
 #include "DataFrame.h"
 #include "Node.h"
+#include "FlatTree.h"
+#include "Serialization.h"
+#include "ObliviousTree.h"
 #include "DecisionTree.h"
+#include "SortedIndex.h"
+#include "Trace.h"
 
 using std::string;
 using std::vector;
@@ -45,78 +56,590 @@ void DecisionTree::print_helper(const Node* node, const vector<string>& col_name
     }
 }
 
+// Training set of one fit: the presorted features, the labels encoded as class ids, and the rows of the sample sorted
+// by every split feature. A node owns the same range [begin, end) of every sorted array and of rows.
+struct DecisionTree::FitData {
+    const SortedIndex& index; ///< Values and sort order of the features of the whole data set
+    vector<size_t> index_features; ///< Number in the index of every split feature
+    vector<int> feature_columns; ///< Column index of every split feature in the samples
+    LabelEncoder labels; ///< Class id of every row of the index
+    const vector<double>& weights; ///< Weight of every row of the index; empty if unweighted
+    ImpurityKernel kernel; ///< Impurity of the class counts
+    ClassCounts counts; ///< Scratch class counts, cleared between uses
+    vector<vector<uint32_t>> sorted; ///< Rows of the sample sorted by every split feature, duplicates included
+    vector<uint32_t> rows; ///< Rows of the sample in the order they were given
+    vector<uint32_t> scratch; ///< Scratch right-hand rows of a partition
+
+    FitData(const SortedIndex& index, LabelEncoder encoded, const vector<double>& weights, SplitCriterion criterion,
+            size_t num_rows)
+        : index(index), labels(std::move(encoded)), weights(weights), kernel(criterion, num_rows), counts(labels.num_classes()) {}
+
+    void sort_sample(const vector<size_t>& sample_rows);
+    void count(size_t begin, size_t end);
+    double impurity(size_t begin, size_t end, double& total);
+
+    double information_gain(size_t begin, size_t end, size_t feature, double parent_impurity, double total,
+                            size_t& num_values);
+    double median(size_t begin, size_t end, size_t feature) const;
+    size_t partition(vector<uint32_t>& array, size_t begin, size_t end, size_t feature, double threshold);
+    size_t partition(size_t begin, size_t end, size_t feature, double threshold);
+};
+
+// Lays out the rows of the sample by every split feature; the order comes from the index, with every row repeated as
+// often as it was drawn, so nothing is sorted here
+void DecisionTree::FitData::sort_sample(const vector<size_t>& sample_rows) {
+    vector<uint32_t> multiplicity(index.get_num_rows(), 0);
+    rows.reserve(sample_rows.size());
+    for (size_t row : sample_rows) {
+        multiplicity[row]++;
+        rows.push_back(static_cast<uint32_t>(row));
+    }
+
+    sorted.resize(index_features.size());
+    for (size_t f = 0; f < index_features.size(); ++f) {
+        sorted[f].reserve(sample_rows.size());
+        for (uint32_t row : index.get_order(index_features[f])) {
+            sorted[f].insert(sorted[f].end(), multiplicity[row], row);
+        }
+    }
+    scratch.resize(sample_rows.size());
+}
+
+// Gain of partitioning the rows of a node by the distinct values of a feature (ID3's multiway split), from the class
+// counts of every value; the rows sorted by the feature have equal values next to each other, and the NaNs, which
+// compare false with everything, form one value
+double DecisionTree::FitData::information_gain(size_t begin, size_t end, size_t feature, double parent_impurity,
+                                               double total, size_t& num_values) {
+    const vector<double>& values = index.get_values(index_features[feature]);
+    const vector<uint32_t>& order = sorted[feature];
+    const ClassId* ids = labels.get_ids().data();
+    bool weighted = !weights.empty();
+
+    double children_impurity = 0.0;
+    num_values = 0;
+    for (size_t first = begin; first < end;) {
+        size_t last = first;
+        double value = values[order[first]];
+        bool nan = std::isnan(value);
+        for (; last < end && (nan ? std::isnan(values[order[last]]) : values[order[last]] == value); ++last) {
+            if (weighted) {
+                counts.add(ids[order[last]], weights[order[last]]);
+            } else {
+                counts.add(ids[order[last]]);
+            }
+        }
+        children_impurity += counts.weighted_impurity(kernel, weighted);
+        counts.clear();
+        num_values++;
+        first = last;
+    }
+    return total > 0.0 ? (parent_impurity - children_impurity) / total : 0.0;
+}
+
+// Counts the classes of the rows of a node, in their given order
+void DecisionTree::FitData::count(size_t begin, size_t end) {
+    const ClassId* ids = labels.get_ids().data();
+    counts.clear();
+    for (size_t i = begin; i < end; ++i) {
+        if (weights.empty()) {
+            counts.add(ids[rows[i]]);
+        } else {
+            counts.add(ids[rows[i]], weights[rows[i]]);
+        }
+    }
+}
+
+// Impurity of a node times its size, from its class counts; total receives the size (or total weight)
+double DecisionTree::FitData::impurity(size_t begin, size_t end, double& total) {
+    count(begin, end);
+    double node_impurity = counts.weighted_impurity(kernel, !weights.empty());
+    total = static_cast<double>(end - begin);
+    if (!weights.empty()) {
+        total = 0.0;
+        for (size_t i = begin; i < end; ++i) {
+            total += weights[rows[i]];
+        }
+    }
+    counts.clear();
+    return node_impurity;
+}
+
+// Median of a feature over the rows of a node, read off the rows sorted by the feature
+double DecisionTree::FitData::median(size_t begin, size_t end, size_t feature) const {
+    const vector<double>& values = index.get_values(index_features[feature]);
+    const vector<uint32_t>& order = sorted[feature];
+    size_t n = end - begin;
+    size_t middle = begin + n / 2;
+    return n % 2 == 0 ? (values[order[middle - 1]] + values[order[middle]]) / 2.0 : values[order[middle]];
+}
+
+// Stable partition of a node's range of one array: the rows with feature <= threshold move to the front, in their
+// order, and the others follow in theirs, so the children's rows stay sorted. Returns the number of rows on the left.
+size_t DecisionTree::FitData::partition(vector<uint32_t>& array, size_t begin, size_t end, size_t feature, double threshold) {
+    const vector<double>& values = index.get_values(index_features[feature]);
+    size_t left = begin, right = 0;
+    for (size_t i = begin; i < end; ++i) {
+        uint32_t row = array[i];
+        if (values[row] <= threshold) {
+            array[left++] = row;
+        } else {
+            scratch[right++] = row;
+        }
+    }
+    std::copy(scratch.begin(), scratch.begin() + right, array.begin() + left);
+    return left - begin;
+}
+
+// Stable partition of every array of a node
+size_t DecisionTree::FitData::partition(size_t begin, size_t end, size_t feature, double threshold) {
+    for (auto& array : sorted) {
+        partition(array, begin, end, feature, threshold);
+    }
+    return partition(rows, begin, end, feature, threshold);
+}
+
 // Helper function for fitting the decision tree recursively. 
 // This is the main implementation of the ID3 algorithm.
-unique_ptr<Node> DecisionTree::fit_helper(std::shared_ptr<DataFrame> df, string label_column, int max_depth, int min_samples_split) {
+unique_ptr<Node> DecisionTree::fit_helper(FitData& data, size_t begin, size_t end, int max_depth, int min_samples_split,
+                                          TrainingStats& stats) {
+    // Every node records how many training rows reached it; FlatTree can lay out the busiest paths first
+    size_t num_samples = end - begin;
+    int depth = this->max_depth - max_depth;
+    stats.depth = std::max(stats.depth, static_cast<size_t>(std::max(depth, 0)));
+
     // Base cases for recursion
-    if (df->get_num_rows() < min_samples_split || max_depth == 0) {
+    if (num_samples < static_cast<size_t>(std::max(min_samples_split, 0)) || max_depth == 0 || data.sorted.empty()) {
         // Compute the most common label in the dataset
-        return std::make_unique<LeafNode>(DataFrame::double_cast(df->get_column(label_column).mode()));
+        return make_leaf(data, begin, end, stats);
     }
 
-    // Find the best attribute to split on
-    string best_feature = df->selectBestAttribute(label_column);
-    Series best_feature_data = df->get_column(best_feature);
-    int best_feature_index = df->get_column_index(best_feature);
+    // Impurity of the node itself, from its class counts
+    auto search_start = std::chrono::steady_clock::now();
+    double total = 0.0;
+    double parent_impurity = data.impurity(begin, end, total);
 
+    // Find the best attribute to split on; restrict the search to this depth's features when sampling by level
+    size_t num_candidates = level_features.empty() ? split_features.size() : level_features[depth].size();
+    size_t best_feature = 0;
+    double best_gain = -std::numeric_limits<double>::infinity();
+    for (size_t c = 0; c < num_candidates; ++c) {
+        size_t feature = level_features.empty() ? c : level_features[depth][c];
+        size_t num_values = 0;
+        double gain = data.information_gain(begin, end, feature, parent_impurity, total, num_values);
+        stats.candidate_thresholds += num_values;
+        if (gain > best_gain) {
+            best_gain = gain;
+            best_feature = feature;
+        }
+    }
+    stats.rows_scanned += num_samples * num_candidates;
 
     // Determine threshold for splitting (using median for continuous data)
-    double threshold = df->get_column(best_feature).median();
-
-    // Split data into left and right subsets
-    unique_ptr<DataFrame> left_df = df->filter(best_feature, threshold, "<=");
-    unique_ptr<DataFrame> right_df = df->filter(best_feature, threshold, ">");
+    double threshold = data.median(begin, end, best_feature);
+    stats.split_search_seconds += TrainingStats::seconds_since(search_start);
 
-    // If splitting doesn't separate data, return a leaf node
-    if (left_df->get_num_rows() == 0 || right_df->get_num_rows() == 0) {
-        return std::make_unique<LeafNode>(DataFrame::double_cast(df->get_column(label_column).mode()));
+    // If splitting doesn't separate data, return a leaf node; the sorted rows show it from the extreme values (NaN
+    // sorts last and goes right, and a NaN threshold sends every row right)
+    const vector<double>& values = data.index.get_values(data.index_features[best_feature]);
+    const vector<uint32_t>& order = data.sorted[best_feature];
+    if (!(values[order[begin]] <= threshold) || values[order[end - 1]] <= threshold) {
+        return make_leaf(data, begin, end, stats);
     }
 
+    // Split the rows into left and right ranges in place, keeping their order
+    auto partition_start = std::chrono::steady_clock::now();
+    size_t mid = begin + data.partition(begin, end, best_feature, threshold);
+    stats.partition_seconds += TrainingStats::seconds_since(partition_start);
+
     // Recursively build left and right subtrees
-    unique_ptr<Node> left_child = fit_helper(std::move(left_df), label_column, max_depth - 1, min_samples_split);
-    unique_ptr<Node> right_child = fit_helper(std::move(right_df), label_column, max_depth - 1, min_samples_split);
+    unique_ptr<Node> left_child = fit_helper(data, begin, mid, max_depth - 1, min_samples_split, stats);
+    unique_ptr<Node> right_child = fit_helper(data, mid, end, max_depth - 1, min_samples_split, stats);
 
     // Return the constructed decision node
-    return std::make_unique<DecisionNode>(best_feature_index, threshold, std::move(left_child), std::move(right_child));
+    unique_ptr<Node> node = std::make_unique<DecisionNode>(data.feature_columns[best_feature], threshold,
+                                                           std::move(left_child), std::move(right_child));
+    node->set_num_samples(num_samples);
+    stats.nodes++;
+    return node;
 }
 
+// Node of the frontier of level-wise growth: its rows, where it goes in the tree, and the best split found for it
+struct FrontierNode {
+    size_t begin; ///< First position of the node's rows in the arrays of the training set
+    size_t end; ///< Position after the node's last row
+    unique_ptr<Node>* slot; ///< Owner of the node: the new root, or a child pointer of the node's parent
+    double parent_impurity = 0.0; ///< Impurity of the node times its size
+    double total = 0.0; ///< Size (or total weight) of the node
+    size_t best_feature = 0; ///< Feature of the best split found so far
+    double best_gain = -std::numeric_limits<double>::infinity(); ///< Gain of the best split found so far
+    double threshold = 0.0; ///< Threshold of the split
+    size_t mid = 0; ///< Position of the first row of the right child, once partitioned
+    DecisionNode* node = nullptr; ///< Decision node created for the split; null if the node became a leaf
+};
+
+// Level-wise implementation of the ID3 algorithm. Every level is one batch: the split search streams each candidate
+// feature's sorted array once, visiting the frontier nodes' ranges in order, and the partition then streams every
+// array once more. Each node's split is chosen exactly as by fit_helper, so both build the same tree.
+unique_ptr<Node> DecisionTree::grow_level_wise(FitData& data, int min_samples_split, TrainingStats& stats) {
+    unique_ptr<Node> new_root;
+    vector<FrontierNode> frontier(1);
+    frontier[0].begin = 0;
+    frontier[0].end = data.rows.size();
+    frontier[0].slot = &new_root;
+
+    vector<FrontierNode> splitting, next;
+    for (int depth = 0; !frontier.empty(); ++depth) {
+        stats.depth = std::max(stats.depth, static_cast<size_t>(depth));
+
+        // Nodes that cannot split become leaves; the others get their own impurity
+        auto search_start = std::chrono::steady_clock::now();
+        splitting.clear();
+        for (FrontierNode& node : frontier) {
+            size_t num_samples = node.end - node.begin;
+            if (num_samples < static_cast<size_t>(std::max(min_samples_split, 0)) || depth == max_depth || data.sorted.empty()) {
+                *node.slot = make_leaf(data, node.begin, node.end, stats);
+                continue;
+            }
+            node.parent_impurity = data.impurity(node.begin, node.end, node.total);
+            splitting.push_back(node);
+        }
+
+        // Batched split search: one pass per candidate feature over the ranges of all nodes of the level
+        size_t num_candidates = level_features.empty() ? split_features.size() : level_features[depth].size();
+        for (size_t c = 0; c < num_candidates && !splitting.empty(); ++c) {
+            size_t feature = level_features.empty() ? c : level_features[depth][c];
+            for (FrontierNode& node : splitting) {
+                size_t num_values = 0;
+                double gain = data.information_gain(node.begin, node.end, feature, node.parent_impurity, node.total, num_values);
+                stats.candidate_thresholds += num_values;
+                if (gain > node.best_gain) {
+                    node.best_gain = gain;
+                    node.best_feature = feature;
+                }
+            }
+        }
+
+        // Thresholds of all splits; nodes whose split does not separate their rows become leaves
+        for (FrontierNode& node : splitting) {
+            size_t num_samples = node.end - node.begin;
+            stats.rows_scanned += num_samples * num_candidates;
+            node.threshold = data.median(node.begin, node.end, node.best_feature);
+
+            const vector<double>& values = data.index.get_values(data.index_features[node.best_feature]);
+            const vector<uint32_t>& order = data.sorted[node.best_feature];
+            if (!(values[order[node.begin]] <= node.threshold) || values[order[node.end - 1]] <= node.threshold) {
+                continue;
+            }
+            unique_ptr<Node> decision = std::make_unique<DecisionNode>(data.feature_columns[node.best_feature], node.threshold,
+                                                                       nullptr, nullptr);
+            decision->set_num_samples(num_samples);
+            node.node = static_cast<DecisionNode*>(decision.get());
+            *node.slot = std::move(decision);
+            stats.nodes++;
+        }
+        stats.split_search_seconds += TrainingStats::seconds_since(search_start);
+
+        // Partition every array once for the whole level
+        auto partition_start = std::chrono::steady_clock::now();
+        auto partition_level = [&](vector<uint32_t>& array) {
+            for (FrontierNode& node : splitting) {
+                if (node.node) {
+                    node.mid = node.begin + data.partition(array, node.begin, node.end, node.best_feature, node.threshold);
+                }
+            }
+        };
+        for (auto& array : data.sorted) {
+            partition_level(array);
+        }
+        partition_level(data.rows);
+        stats.partition_seconds += TrainingStats::seconds_since(partition_start);
+
+        // The children of the splits, left to right, are the next level
+        next.clear();
+        for (FrontierNode& node : splitting) {
+            if (!node.node) {
+                *node.slot = make_leaf(data, node.begin, node.end, stats);
+                continue;
+            }
+            FrontierNode left, right;
+            left.begin = node.begin;
+            left.end = node.mid;
+            left.slot = &node.node->left;
+            right.begin = node.mid;
+            right.end = node.end;
+            right.slot = &node.node->right;
+            next.push_back(left);
+            next.push_back(right);
+        }
+        frontier.swap(next);
+    }
+    return new_root;
+}
+
+unique_ptr<Node> DecisionTree::make_leaf(FitData& data, size_t begin, size_t end, TrainingStats& stats) const {
+    auto leaf_start = std::chrono::steady_clock::now();
+    data.count(begin, end);
+    ClassId label = data.counts.majority(!data.weights.empty());
+    data.counts.clear();
+    unique_ptr<Node> leaf = std::make_unique<LeafNode>(DataFrame::double_cast(data.labels.decode(label)));
+    leaf->set_num_samples(end - begin);
+    stats.nodes++;
+    stats.leaves++;
+    stats.leaf_seconds += TrainingStats::seconds_since(leaf_start);
+    return leaf;
+}
         
 
 // Constructor
-DecisionTree::DecisionTree(int max_depth, int min_samples_split) : root(nullptr), max_depth(max_depth), min_samples_split(min_samples_split) {}
-// Destructor; the default destructor handles destruction of the root node and its children
-DecisionTree::~DecisionTree() = default;
+DecisionTree::DecisionTree(int max_depth, int min_samples_split) 
+    : root(nullptr), max_depth(max_depth), min_samples_split(min_samples_split), colsample_bylevel(1.0), random_state(0),
+      criterion(SplitCriterion::Entropy), growth(GrowthPolicy::DepthFirst), node_layout(NodeLayout::DepthFirst), oblivious(false) {}
+
+DecisionTree::DecisionTree(int max_depth, int min_samples_split, double colsample_bylevel, size_t random_state) 
+    : root(nullptr), max_depth(max_depth), min_samples_split(min_samples_split), colsample_bylevel(colsample_bylevel), random_state(random_state),
+      criterion(SplitCriterion::Entropy), growth(GrowthPolicy::DepthFirst), node_layout(NodeLayout::DepthFirst), oblivious(false) {
+    if (colsample_bylevel <= 0.0 || colsample_bylevel > 1.0) {
+        throw std::invalid_argument("colsample_bylevel must be in the interval (0, 1]");
+    }
+}
+DecisionTree::DecisionTree(int max_depth, int min_samples_split, FlatTree nodes, std::shared_ptr<const MappedFile> mapping) 
+    : root(nullptr), max_depth(max_depth), min_samples_split(min_samples_split), colsample_bylevel(1.0), random_state(0),
+      criterion(SplitCriterion::Entropy), growth(GrowthPolicy::DepthFirst), flat(std::move(nodes)), mapping(std::move(mapping)), node_layout(NodeLayout::DepthFirst),
+      oblivious(false) {}
+
+// Destructor; the arena frees the nodes grown by fit
+DecisionTree::~DecisionTree() {
+    release_nodes();
+}
+
+void DecisionTree::release_nodes() {
+    if (node_arena) {
+        root.release();   // arena nodes hold no other resources, so their destructors can be skipped
+    }
+    root.reset();
+    node_arena.reset();
+}
 
 // Predict method; simply utilize the functionality from the Node class
 double DecisionTree::predict(const vector<double>& sample) const {
-    if (!root) {
-        throw std::runtime_error("Decision tree is not trained.");
+    if (oblivious_tree) {
+        return oblivious_tree->predict(sample);   // branch-free leaf index
     }
-
-    return root->predict(sample);
+    if (root) {
+        return root->predict(sample);
+    }
+    if (!flat.empty()) {
+        return flat.predict(sample.data());   // loaded tree
+    }
+    throw std::runtime_error("Decision tree is not trained.");
 }
 
 
 // Fit method: Entry point for training the decision tree
-void DecisionTree::fit(std::shared_ptr<DataFrame> df, const string& label_column) {
-    root = fit_helper(df, label_column, max_depth, min_samples_split);
+TrainingStats DecisionTree::fit(std::shared_ptr<DataFrame> df, const string& label_column) {
+    return fit(df, label_column, "");
+}
+
+// Fit method on weighted samples; an empty weight column means every row has weight 1
+TrainingStats DecisionTree::fit(std::shared_ptr<DataFrame> df, const string& label_column, const string& weight_column) {
+    RF_TRACE_SCOPE("DecisionTree::fit", "train");
+    auto fit_start = std::chrono::steady_clock::now();
+    if (!weight_column.empty() && std::find(df->columns.begin(), df->columns.end(), weight_column) == df->columns.end()) {
+        throw std::invalid_argument("Weight column not found");
+    }
+
+    vector<string> features;
+    for (const auto& col : df->columns) {
+        if (col != label_column && col != weight_column) {
+            features.push_back(col);
+        }
+    }
+
+    TrainingStats stats;
+    if (oblivious) {
+        // Grow the nodes in an arena of their own, so they are contiguous in creation order and freed in one go
+        auto arena = std::make_unique<NodeArena>();
+        unique_ptr<Node> new_root;
+        {
+            NodeArena::Scope arena_scope(*arena);
+            oblivious_tree = std::make_unique<ObliviousTree>(max_depth, min_samples_split, colsample_bylevel, random_state);
+            stats = oblivious_tree->fit(df, label_column, weight_column);
+            new_root = oblivious_tree->to_node_tree();
+        }
+        set_nodes(std::move(arena), std::move(new_root));
+    } else {
+        if (df->get_num_rows() == 0) {
+            throw std::runtime_error("Cannot fit a decision tree on an empty DataFrame");
+        }
+
+        // Sort every feature once; the nodes are split in the index's order from then on
+        SortedIndex index(*df, features);
+        vector<size_t> index_features(features.size());
+        std::iota(index_features.begin(), index_features.end(), 0);
+        vector<int> feature_columns;
+        for (const auto& feature : features) {
+            feature_columns.push_back(df->get_column_index(feature));
+        }
+        vector<double> weights;
+        if (!weight_column.empty()) {
+            weights = df->get_column(weight_column).convert_to_numeric();
+        }
+        vector<size_t> rows(df->get_num_rows());
+        std::iota(rows.begin(), rows.end(), 0);
+        stats = fit_presorted(index, index_features, feature_columns, LabelEncoder(df->get_column(label_column)), rows, weights);
+    }
+
+    stats.fit_seconds = TrainingStats::seconds_since(fit_start);
+    return stats;
+}
+
+// Fit method on a sample of a presorted data set
+TrainingStats DecisionTree::fit(const SortedIndex& index, const vector<string>& features, const Series& labels,
+                                const vector<size_t>& rows, const vector<double>& weights) {
+    return fit_encoded(index, features, LabelEncoder(labels), rows, weights);
+}
+
+TrainingStats DecisionTree::fit(const SortedIndex& index, const vector<string>& features, const vector<double>& labels,
+                                const vector<size_t>& rows, const vector<double>& weights) {
+    return fit_encoded(index, features, LabelEncoder(labels), rows, weights);
+}
+
+TrainingStats DecisionTree::fit_encoded(const SortedIndex& index, const vector<string>& features, LabelEncoder labels,
+                                        const vector<size_t>& rows, const vector<double>& weights) {
+    RF_TRACE_SCOPE("DecisionTree::fit", "train");
+    auto fit_start = std::chrono::steady_clock::now();
+    if (rows.empty()) {
+        throw std::runtime_error("Cannot fit a decision tree on an empty sample");
+    }
+    if (labels.get_ids().size() != index.get_num_rows() || (!weights.empty() && weights.size() != index.get_num_rows())) {
+        throw std::invalid_argument("Labels and weights must hold one value per row of the index");
+    }
+    for (size_t row : rows) {
+        if (row >= index.get_num_rows()) {
+            throw std::out_of_range("row index out of bounds");
+        }
+    }
+    vector<size_t> index_features;
+    for (const auto& feature : features) {
+        index_features.push_back(index.find(feature));
+    }
+
+    if (oblivious) {
+        // ObliviousTree works on a DataFrame, so the sample is copied into one
+        const string label_column = "__label__";
+        const string weight_column = weights.empty() ? "" : "__weight__";
+        auto sample = std::make_shared<DataFrame>();
+        for (size_t f = 0; f < features.size(); ++f) {
+            const vector<double>& values = index.get_values(index_features[f]);
+            vector<Cell> cells;
+            for (size_t row : rows) {
+                cells.push_back(values[row]);
+            }
+            sample->add_column(features[f], Series(cells));
+        }
+        vector<Cell> label_cells;
+        for (size_t row : rows) {
+            label_cells.push_back(labels.decode(labels.get_ids()[row]));
+        }
+        sample->add_column(label_column, Series(label_cells));
+        if (!weights.empty()) {
+            vector<Cell> weight_cells;
+            for (size_t row : rows) {
+                weight_cells.push_back(weights[row]);
+            }
+            sample->add_column(weight_column, Series(weight_cells));
+        }
+        return fit(sample, label_column, weight_column);
+    }
+
+    vector<int> feature_columns(features.size());
+    std::iota(feature_columns.begin(), feature_columns.end(), 0);
+    TrainingStats stats = fit_presorted(index, index_features, feature_columns, std::move(labels), rows, weights);
+    stats.fit_seconds = TrainingStats::seconds_since(fit_start);
+    return stats;
+}
+
+TrainingStats DecisionTree::fit_presorted(const SortedIndex& index, const vector<size_t>& index_features,
+                                          const vector<int>& feature_columns, LabelEncoder labels,
+                                          const vector<size_t>& rows, const vector<double>& weights) {
+    split_features.clear();
+    for (size_t feature : index_features) {
+        split_features.push_back(index.get_features()[feature]);
+    }
+
+    // Draw the candidate features of every depth up front so that all nodes of a level share them
+    level_features.clear();
+    if (colsample_bylevel < 1.0) {
+        size_t num_level_features = std::max<size_t>(1, static_cast<size_t>(std::round(colsample_bylevel * split_features.size())));
+        std::mt19937 generator(random_state);
+
+        for (int depth = 0; depth < std::max(max_depth, 0); ++depth) {
+            vector<size_t> order(split_features.size());
+            std::iota(order.begin(), order.end(), 0);
+            std::shuffle(order.begin(), order.end(), generator);
+            order.resize(std::min(num_level_features, order.size()));
+            std::sort(order.begin(), order.end());   // keep the column order for deterministic tie-breaking
+
+            level_features.push_back(std::move(order));
+        }
+    }
+
+    // Encode the labels once and lay out the sample by every feature; every node then owns a range of these arrays
+    FitData data(index, std::move(labels), weights, criterion, rows.size());
+    data.index_features = index_features;
+    data.feature_columns = feature_columns;
+    data.sort_sample(rows);
+
+    TrainingStats stats;
+    stats.bytes_allocated += (data.sorted.size() + 2) * rows.size() * sizeof(uint32_t);
+
+    // Grow the nodes in an arena of their own, so they are contiguous in creation order and freed in one go
+    auto arena = std::make_unique<NodeArena>();
+    unique_ptr<Node> new_root;
+    {
+        NodeArena::Scope arena_scope(*arena);
+        if (growth == GrowthPolicy::LevelWise) {
+            new_root = grow_level_wise(data, min_samples_split, stats);
+        } else {
+            new_root = fit_helper(data, 0, rows.size(), max_depth, min_samples_split, stats);
+        }
+    }
+    stats.num_trees = 1;
+    oblivious_tree.reset();
+    set_nodes(std::move(arena), std::move(new_root));
+    return stats;
+}
+
+void DecisionTree::set_nodes(unique_ptr<NodeArena> arena, unique_ptr<Node> new_root) {
+    release_nodes();
+    node_arena = std::move(arena);
+    root = std::move(new_root);
+    mapping.reset();
+    flat = FlatTree(*root, node_layout);   // compiled form used by predict_batch
+
+    // Free the feature lists of the fit rather than only emptying them; clear() would keep their capacity
+    vector<vector<size_t>>().swap(level_features);
+    vector<string>().swap(split_features);
 }
 
 // Print method: Entry point for printing the decision tree
 string DecisionTree::print(vector<string> col_names) {
-    if (!root) {
+    // A loaded tree is printed from a temporary copy of its nodes
+    unique_ptr<Node> loaded_root = root ? nullptr : flat.to_node();
+    const Node* print_root = root ? root.get() : loaded_root.get();
+    if (!print_root) {
         return "Empty Decision Tree";
     }
 
     std::ostringstream oss;
-    print_helper(root.get(), col_names, "", true, oss);
+    print_helper(print_root, col_names, "", true, oss);
     return oss.str();
 }
 
 // Get number of nodes; simply utilize the functionality from the Node class
 int DecisionTree::get_num_nodes() {
     if (!root) {
-        return 0;
+        return static_cast<int>(flat.size());
     }
 
     return root->get_num_nodes();
@@ -125,8 +648,144 @@ int DecisionTree::get_num_nodes() {
 // Get height of decision tree; simply utilize the functionality from the Node class
 int DecisionTree::get_height() {
     if (!root) {
-        return 0;
+        return flat.get_height();
     }
 
     return root->get_height();
-}
\ No newline at end of file
+}
+
+// Memory footprint; the node memory is computed recursively by the Node class
+size_t DecisionTree::memory_usage() const {
+    size_t bytes = sizeof(*this);
+    for (const auto& features : level_features) {
+        bytes += features.capacity() * sizeof(size_t);
+    }
+    bytes += level_features.capacity() * sizeof(vector<size_t>);
+    bytes += strings_memory_usage(split_features);
+    if (node_arena) {
+        bytes += node_arena->memory_usage();
+    } else if (root) {
+        bytes += root->memory_usage();
+    }
+    if (oblivious_tree) {
+        bytes += oblivious_tree->memory_usage();
+    }
+    return bytes + flat.memory_usage();   // mapped nodes belong to the page cache and are not counted
+}
+
+FlatTree DecisionTree::flatten() const {
+    if (!flat.empty()) {
+        return FlatTree(flat.data(), flat.size());
+    }
+    if (root) {
+        return FlatTree(*root, node_layout);
+    }
+    throw std::runtime_error("Decision tree is not trained.");
+}
+
+void DecisionTree::set_node_layout(NodeLayout layout) {
+    node_layout = layout;
+    if (root) {
+        flat = FlatTree(*root, layout);
+    } else if (!flat.empty()) {
+        // A loaded tree is rebuilt from its flat nodes, which keep the sample counts, and no longer needs its file
+        unique_ptr<Node> loaded_root = flat.to_node();
+        flat = FlatTree(*loaded_root, layout);
+        mapping.reset();
+    }
+}
+
+NodeLayout DecisionTree::get_node_layout() const {
+    return node_layout;
+}
+
+void DecisionTree::set_criterion(SplitCriterion criterion) {
+    this->criterion = criterion;
+}
+
+SplitCriterion DecisionTree::get_criterion() const {
+    return criterion;
+}
+
+void DecisionTree::set_growth_policy(GrowthPolicy growth) {
+    this->growth = growth;
+}
+
+GrowthPolicy DecisionTree::get_growth_policy() const {
+    return growth;
+}
+
+void DecisionTree::set_oblivious(bool oblivious) {
+    this->oblivious = oblivious;
+}
+
+bool DecisionTree::is_oblivious() const {
+    return oblivious;
+}
+
+vector<double> DecisionTree::predict_batch(const vector<double>& samples, size_t num_columns) const {
+    if (flat.empty()) {
+        throw std::runtime_error("Decision tree is not trained.");
+    }
+    if (num_columns == 0 || samples.size() % num_columns != 0) {
+        throw std::invalid_argument("Sample buffer size is not a multiple of the number of columns");
+    }
+    if (flat.max_feature() >= static_cast<int32_t>(num_columns)) {
+        throw std::invalid_argument("Samples have fewer columns than the features used by the tree");
+    }
+
+    if (oblivious_tree) {
+        return oblivious_tree->predict_batch(samples, num_columns);
+    }
+
+    vector<double> predictions(samples.size() / num_columns);
+    flat.predict_batch(samples.data(), predictions.size(), num_columns, nullptr, predictions.data());
+    return predictions;
+}
+
+string DecisionTree::to_cpp(const string& function_name, const vector<size_t>& features) const {
+    // A loaded tree is generated from a temporary copy of its nodes
+    unique_ptr<Node> loaded_root = root ? nullptr : flat.to_node();
+    const Node* code_root = root ? root.get() : loaded_root.get();
+    if (!code_root) {
+        throw std::runtime_error("Decision tree is not trained.");
+    }
+
+    std::ostringstream oss;
+    oss << "static double " << function_name << "(const double* x) {\n";
+    code_root->to_cpp(oss, features, "    ");
+    oss << "}\n";
+    return oss.str();
+}
+
+void DecisionTree::save(const string& path) const {
+    FlatTree nodes = flatten();
+
+    ModelHeader header{};
+    header.model_type = static_cast<uint32_t>(ModelType::DecisionTree);
+    header.num_trees = 1;
+    header.max_depth = max_depth;
+    header.min_samples_split = min_samples_split;
+    header.num_features = -1;
+    header.random_state = random_state;
+
+    ModelWriter writer(header);
+    writer.write_names({});
+    writer.write_tree(nodes, {});
+    writer.save(path);
+}
+
+unique_ptr<DecisionTree> DecisionTree::load(const string& path) {
+    ModelReader reader(path, ModelType::DecisionTree);
+    if (reader.header().num_trees != 1) {
+        throw std::runtime_error("Decision tree model file must hold exactly one tree: " + path);
+    }
+
+    vector<size_t> features;
+    FlatTree nodes = reader.read_tree(features);
+    if (nodes.empty()) {
+        throw std::runtime_error("Decision tree model file holds an empty tree: " + path);
+    }
+    return std::make_unique<DecisionTree>(reader.header().max_depth, reader.header().min_samples_split,
+                                          std::move(nodes), reader.mapping());
+}
@@ -3,14 +3,30 @@
 
 #include <vector>
 #include "Node.h"
+#include "FlatTree.h"
 #include "DataFrame.h"
 #include "Classifier.h"
+#include "Impurity.h"
+
+class MappedFile;
+class ObliviousTree;
+class SortedIndex;
 
 using std::string;
 using std::vector;
 using std::unique_ptr;
 
 
+/**
+ * @enum GrowthPolicy
+ * @brief Order in which fit grows the nodes of a tree; both orders grow the same tree
+ */
+enum class GrowthPolicy {
+    DepthFirst, ///< One node at a time, recursing into the left child first
+    LevelWise ///< One level at a time: the splits of all nodes at a depth are searched together in one pass over the data
+};
+
+
 
 /**
  * @class DecisionTree
@@ -28,9 +44,21 @@ using std::unique_ptr;
  */
 class DecisionTree : public Classifier {
     private:
+        unique_ptr<NodeArena> node_arena; ///< Memory of the nodes grown by fit; declared before root so it outlives them
         unique_ptr<Node> root; ///< Pointer to the root node of the decision tree
         int max_depth; ///< Maximum depth of the decision tree
         int min_samples_split; ///< Minimum number of samples required to split a node
+        double colsample_bylevel; ///< Fraction of the features considered at each depth of the tree
+        size_t random_state; ///< Random seed used to sample the features of each depth
+        vector<vector<size_t>> level_features; ///< Candidate features (positions in split_features) for each depth; only used during fit when colsample_bylevel < 1
+        vector<string> split_features; ///< Features that may be split on; only used during fit
+        SplitCriterion criterion; ///< Impurity measure minimized by the split search
+        GrowthPolicy growth; ///< Order in which fit grows the nodes
+        FlatTree flat; ///< Nodes of the tree in flat form; compiled at the end of fit, or a view of a loaded model file
+        std::shared_ptr<const MappedFile> mapping; ///< Model file the nodes of a loaded tree live in; keeps them mapped
+        NodeLayout node_layout; ///< Order of the nodes in the flat form of the tree
+        bool oblivious; ///< Whether fit grows an oblivious tree, in which all nodes of a depth share their decision rule
+        unique_ptr<ObliviousTree> oblivious_tree; ///< Level tables of the tree grown by fit when oblivious; used by predict
         
         /**
          * @brief Helper method for the print function
@@ -52,20 +80,105 @@ class DecisionTree : public Classifier {
         void print_helper(const Node* node, const vector<string>& col_names,
                                         const string& prefix, bool isLeft, std::ostringstream& oss); 
 
+        /**
+         * @struct FitData
+         * @brief Training set in the form the split search reads it: the SortedIndex of the features, the labels as
+         *        dense class ids, the sample weights, the impurity kernel, and the rows of the sample sorted by every
+         *        split feature; only alive during fit
+         */
+        struct FitData;
+
         /**
          * @brief Helper method for the fit function. Main implementation of ID3 algorithm.
-         * @param df Pointer to the DataFrame object containing the training data
-         * @param label_column Name of the column in the DataFrame that contains the class labels
+         * @param data Training set of the tree
+         * @param begin First position of the node's rows in the arrays of data
+         * @param end Position after the node's last row in the arrays of data
          * @param max_depth Maximum depth of the decision tree
          * @param min_samples_split Minimum number of samples required to split a node
+         * @param stats Receives the nodes created and the work done for them
          * @return Pointer to the root node of the decision tree
          * 
          * This is a recursive helper function that builds the decision tree by selecting the best attribute. 
          * For the most part, the ID3 algorithm is implemented in this function and not in the fit() function.
+         * The rows of a node are kept sorted by every split feature, so the split search and the median threshold
+         * read them in order. A stable partition of the node's range hands each child its rows, still sorted and in
+         * place, so no node sorts or copies data.
+         * 
+         * @see fit(std::shared_ptr<DataFrame> df, const std::string& label_column)
+         */
+        unique_ptr<Node> fit_helper(FitData& data, size_t begin, size_t end, int max_depth, int min_samples_split,
+                                    TrainingStats& stats);
+
+        /**
+         * @brief Helper method which creates a leaf predicting the majority label of a node
+         * @param data Training set of the tree
+         * @param begin First position of the leaf's rows in the arrays of data
+         * @param end Position after the leaf's last row in the arrays of data
+         * @param stats Receives the leaf and the time spent on it
+         * @return The leaf, with the number of rows that reach it
+         * 
+         * The leaf predicts the most common label, weighted by the sample weights when the tree is fit on weighted
+         * samples, with the ties of Series::mode.
+         */
+        unique_ptr<Node> make_leaf(FitData& data, size_t begin, size_t end, TrainingStats& stats) const;
+
+        /**
+         * @brief Helper method for the fit function which grows the tree level by level
+         * @param data Training set of the tree
+         * @param min_samples_split Minimum number of samples required to split a node
+         * @param stats Receives the nodes created and the work done for them
+         * @return Pointer to the root node of the decision tree
+         *
+         * The breadth-first counterpart of fit_helper(). The nodes of a depth form the frontier, whose row ranges lie in
+         * order in the arrays of data; the split search walks every candidate feature's array once across all of them,
+         * and one more pass per array partitions the rows of all the splits. Memory is therefore read sequentially,
+         * column by column, however many small nodes a level has.
+         *
+         * @see GrowthPolicy
+         */
+        unique_ptr<Node> grow_level_wise(FitData& data, int min_samples_split, TrainingStats& stats);
+
+        /**
+         * @brief Helper method which grows the tree on a sample of a presorted data set
+         * @param index Values and sort order of the features
+         * @param index_features Number in the index of every feature that may be split on
+         * @param feature_columns Feature index the decision nodes store for every feature that may be split on
+         * @param labels Class id of every row of the index
+         * @param rows Rows of the sample, in order; rows may repeat
+         * @param weights Weight of every row of the index; empty if unweighted
+         * @return Statistics of the tree grown, without fit_seconds
+         *
+         * This is the shared implementation of the fit methods that grow an ID3 tree.
+         */
+        TrainingStats fit_presorted(const SortedIndex& index, const vector<size_t>& index_features,
+                                    const vector<int>& feature_columns, LabelEncoder labels, const vector<size_t>& rows,
+                                    const vector<double>& weights);
+
+        /**
+         * @brief Helper method which grows the tree on a sample of a SortedIndex, with the labels already encoded
+         * @return Statistics of the tree grown
+         *
+         * This is the shared implementation of the fit methods that take a SortedIndex.
+         *
+         * @see fit(const SortedIndex& index, const vector<string>& features, const Series& labels, const vector<size_t>& rows, const vector<double>& weights)
+         */
+        TrainingStats fit_encoded(const SortedIndex& index, const vector<string>& features, LabelEncoder labels,
+                                  const vector<size_t>& rows, const vector<double>& weights);
+
+        /**
+         * @brief Helper method which replaces the nodes of the tree with newly grown ones and compiles their flat form
+         * @param arena Arena the new nodes live in
+         * @param new_root Root of the new nodes
+         */
+        void set_nodes(unique_ptr<NodeArena> arena, unique_ptr<Node> new_root);
+
+        /**
+         * @brief Helper method which destroys the nodes of the tree
          * 
-         * @see fit(unique_ptr<DataFrame> df, string label_column, int max_depth, int min_samples_split)
+         * Nodes grown by fit live in node_arena and own nothing else, so their destructors are skipped and the arena
+         * frees them all at once instead of walking the tree; other nodes are destroyed through root as usual.
          */
-        unique_ptr<Node> fit_helper(std::shared_ptr<DataFrame> df, string label_column, int max_depth, int min_samples_split);
+        void release_nodes();
 
         
     public:
@@ -75,10 +188,37 @@ class DecisionTree : public Classifier {
          * The default constructor is used here to initialize the root node to nullptr.
          */
         DecisionTree(int max_depth, int min_samples_split);
+
+        /**
+         * @brief Constructor for the DecisionTree class with per-level feature sampling
+         * @param max_depth Maximum depth of the decision tree
+         * @param min_samples_split Minimum number of samples required to split a node
+         * @param colsample_bylevel Fraction of the features, as a decimal in (0, 1], considered at each depth
+         * @param random_state Random seed used to sample the features of each depth
+         * @throws std::invalid_argument if colsample_bylevel is not in (0, 1]
+         * 
+         * Every node at a given depth of the tree searches for its split among the same random subset of the
+         * features. A fraction of 1 considers every feature, which is equivalent to DecisionTree(max_depth, min_samples_split).
+         */
+        DecisionTree(int max_depth, int min_samples_split, double colsample_bylevel, size_t random_state);
+
+        /**
+         * @brief Constructor for a trained DecisionTree whose nodes live in a model file
+         * @param max_depth Maximum depth the tree was grown with
+         * @param min_samples_split Minimum number of samples required to split a node
+         * @param nodes View of the tree's nodes inside the mapping
+         * @param mapping Memory mapping of the model file holding the nodes
+         * 
+         * The tree predicts directly from the mapped nodes; fitting the tree again replaces them with an in-memory tree.
+         * This constructor is used by the load() methods of the models.
+         * 
+         * @see load(const std::string& path)
+         */
+        DecisionTree(int max_depth, int min_samples_split, FlatTree nodes, std::shared_ptr<const MappedFile> mapping);
         /**
          * @brief Destructor for the DecisionTree class
          * 
-         * The default destructor is used here to handle the destruction of the root node and its children.
+         * The nodes grown by fit are freed together with the NodeArena that holds them.
          */
         ~DecisionTree();
 
@@ -135,17 +275,34 @@ class DecisionTree : public Classifier {
          */
         int get_height();
 
+        /**
+         * @brief Get the memory footprint of the decision tree
+         * @return Approximate number of bytes held by the tree object and its nodes
+         * 
+         * This function returns the size of the DecisionTree object plus the memory of its nodes, which is the size
+         * of the NodeArena they were grown in, or is computed recursively by the memory_usage() method of the root
+         * node otherwise. The feature lists used while fitting are released at the end of fit and are therefore not
+         * counted.
+         * 
+         * @see Node::memory_usage()
+         * @see Classifier::memory_usage()
+         */
+        size_t memory_usage() const override;
+
         
         /**
          * @brief The fit method trains the decision tree using the ID3 algorithm
          * @param df unique_ptr to the DataFrame object containing the training data
          * @param label_column Name of the column in the DataFrame that contains the class labels
+         * @return Statistics of the tree grown
          * 
          * This is the entry point for training the decision tree. The function takes a unique_ptr to
          * a DataFrame and the name of the column containing the class labels. The function then calls
-         * the fit_helper() method to build the decision tree using the ID3 algorithm.
+         * the fit_helper() method to build the decision tree using the ID3 algorithm. The labels are encoded once as
+         * dense class ids, so the split search and the leaves count classes in small arrays, and every feature is
+         * sorted once into a SortedIndex.
          * 
-         * @see fit_helper(unique_ptr<DataFrame> df, string label_column, int max_depth, int min_samples_split)
+         * @see fit_helper(FitData& data, size_t begin, size_t end, int max_depth, int min_samples_split, TrainingStats& stats)
          * @see Classifier::fit(unique_ptr<DataFrame> df, string label_column)
          * 
          * @code
@@ -156,7 +313,73 @@ class DecisionTree : public Classifier {
          * dt1.fit(std::move(df1), "C");
          * @endcode
          */
-        void fit(std::shared_ptr<DataFrame> df, const std::string& label_column) override;
+        TrainingStats fit(std::shared_ptr<DataFrame> df, const std::string& label_column) override;
+
+        /**
+         * @brief The fit method trains the decision tree on weighted samples
+         * @param df shared_ptr to the DataFrame object containing the training data
+         * @param label_column Name of the column in the DataFrame that contains the class labels
+         * @param weight_column Name of the column in the DataFrame that contains the (non-negative) sample weights
+         * @return Statistics of the tree grown
+         * @throws std::invalid_argument if the weight column is not found
+         * 
+         * Every row contributes its weight to the information gain of the splits and to the (weighted) mode
+         * predicted by the leaves. The weight column is never split on and must come after all feature columns,
+         * so that the feature indices of the tree still match the samples passed to predict.
+         * 
+         * @see fit(std::shared_ptr<DataFrame> df, const std::string& label_column)
+         */
+        TrainingStats fit(std::shared_ptr<DataFrame> df, const std::string& label_column, const std::string& weight_column);
+
+        /**
+         * @brief The fit method trains the decision tree on a sample of a presorted data set
+         * @param index Values and sort order of the features of the whole data set; only read
+         * @param features Names of the indexed features the tree may split on; the decision nodes store a feature's
+         *                 position in this list, so samples passed to predict hold these features in this order
+         * @param labels Label of every row of the index
+         * @param rows Rows of the sample, in order; rows may repeat, as in a bootstrap sample
+         * @param weights (Non-negative) weight of every row of the index; empty if every row has weight 1
+         * @return Statistics of the tree grown
+         * @throws std::runtime_error if rows is empty
+         * @throws std::invalid_argument if a feature is not indexed, or labels or weights do not match the index
+         * @throws std::out_of_range if a row is out of bounds
+         *
+         * Ensembles build one SortedIndex per data set and share it between all their trees, which then never sort:
+         * the tree is the one fit(DataFrame) grows on the sample copied into a DataFrame, with the given features
+         * followed by the label. An oblivious tree is grown on such a copy.
+         *
+         * @see SortedIndex
+         * @see DataFrame::draw_bootstrap(size_t num_features, const string& label_column, size_t random_state)
+         *
+         * @code
+         * SortedIndex index(*df, features);
+         * SampleDraw draw = df->draw_bootstrap(2, "label", 42);
+         * DecisionTree dt(3, 2);
+         * dt.fit(index, draw.features, df->get_column("label"), draw.rows);
+         * @endcode
+         */
+        TrainingStats fit(const SortedIndex& index, const vector<string>& features, const Series& labels,
+                          const vector<size_t>& rows, const vector<double>& weights = {});
+
+        /**
+         * @brief The fit method trains the decision tree on a sample of a presorted data set with numeric labels
+         * @param index Values and sort order of the features of the whole data set; only read
+         * @param features Names of the indexed features the tree may split on
+         * @param labels Numeric label of every row of the index, such as the residuals of a boosting round
+         * @param rows Rows of the sample, in order; rows may repeat
+         * @param weights (Non-negative) weight of every row of the index; empty if every row has weight 1
+         * @return Statistics of the tree grown
+         * @throws std::runtime_error if rows is empty
+         * @throws std::invalid_argument if a feature is not indexed, or labels or weights do not match the index
+         * @throws std::out_of_range if a row is out of bounds
+         *
+         * Grows the same tree as the Series overload on a column of these labels, but encodes the doubles directly,
+         * so the caller does not build a column of Cell for every tree.
+         *
+         * @see fit(const SortedIndex& index, const vector<string>& features, const Series& labels, const vector<size_t>& rows, const vector<double>& weights)
+         */
+        TrainingStats fit(const SortedIndex& index, const vector<string>& features, const vector<double>& labels,
+                          const vector<size_t>& rows, const vector<double>& weights = {});
 
         /**
          * @brief Print method for the decision tree
@@ -181,6 +404,151 @@ class DecisionTree : public Classifier {
          * 
          */
         string print(vector<string> col_names);
+
+        /**
+         * @brief Set the order in which the flat form of the tree stores its nodes
+         * @param layout NodeLayout to use from now on
+         * 
+         * A trained or loaded tree is compiled again right away; a loaded tree then owns its nodes instead of reading
+         * them from the model file. The layout does not change any prediction, only which nodes share cache lines:
+         * NodeLayout::HotPath stores the path taken by most training samples contiguously, so common predictions touch
+         * fewer cache lines. The sample counts are recorded by fit and kept in model files.
+         * 
+         * @see NodeLayout
+         */
+        void set_node_layout(NodeLayout layout);
+
+        /**
+         * @brief Get the order in which the flat form of the tree stores its nodes
+         * @return The selected NodeLayout
+         */
+        NodeLayout get_node_layout() const;
+
+        /**
+         * @brief Choose whether fit grows an oblivious tree
+         * @param oblivious True to grow an ObliviousTree, false (the default) to grow a tree with the ID3 algorithm
+         * 
+         * An oblivious tree uses one feature and threshold per depth, so predict and predict_batch take the same number
+         * of comparisons for every sample and index the leaf without branching. The tree is also expanded into regular
+         * nodes, so print, flatten, save, and to_cpp work as usual; a loaded tree is evaluated like any other tree. The
+         * setting takes effect at the next fit.
+         * 
+         * @see ObliviousTree
+         */
+        void set_oblivious(bool oblivious);
+
+        /**
+         * @brief Check whether fit grows an oblivious tree
+         * @return True if fit grows an ObliviousTree
+         */
+        bool is_oblivious() const;
+
+        /**
+         * @brief Choose the impurity measure of the split search
+         * @param criterion SplitCriterion::Entropy (the default, ID3's information gain) or SplitCriterion::Gini
+         * 
+         * The setting takes effect at the next fit; oblivious trees always use the entropy.
+         */
+        void set_criterion(SplitCriterion criterion);
+
+        /**
+         * @brief Get the impurity measure of the split search
+         * @return The selected SplitCriterion
+         */
+        SplitCriterion get_criterion() const;
+
+        /**
+         * @brief Choose the order in which fit grows the nodes
+         * @param growth GrowthPolicy::DepthFirst (the default) or GrowthPolicy::LevelWise
+         *
+         * Every node's split only depends on its own rows, so both policies grow the same tree; they differ in how the
+         * training data is read. Level-wise growth handles all nodes of a depth in one batch, which streams each
+         * feature once per level instead of once per node, and suits deep trees with many small nodes. The setting
+         * takes effect at the next fit; oblivious trees are always grown level by level.
+         */
+        void set_growth_policy(GrowthPolicy growth);
+
+        /**
+         * @brief Get the order in which fit grows the nodes
+         * @return The selected GrowthPolicy
+         */
+        GrowthPolicy get_growth_policy() const;
+
+        /**
+         * @brief Get the flat form of the decision tree
+         * @return FlatTree holding the nodes of the tree in its node layout
+         * @throws runtime_error if the decision tree is not trained
+         * 
+         * The result is a view of the flat nodes the tree compiles at the end of fit (or of the mapped nodes of a loaded
+         * tree), and is only valid as long as the tree is alive and not fit again.
+         */
+        FlatTree flatten() const;
+
+        /**
+         * @brief Predict method for a batch of samples
+         * @param samples Feature values of the samples, one row of num_columns values after the other
+         * @param num_columns Number of feature values per sample
+         * @return Predicted class label for every sample, in order
+         * @throws runtime_error if the decision tree is not trained
+         * @throws invalid_argument if the buffer does not hold whole rows, or the rows are too short for the tree
+         * 
+         * The samples are pushed through the flat form of the tree in blocks of rows that advance in lockstep, with
+         * the next node of every row prefetched, so the cache misses of the rows overlap instead of adding up. The
+         * predictions are the same as calling predict() on every row.
+         * 
+         * @see FlatTree::predict_batch()
+         * 
+         * @code
+         * std::vector<double> samples = {2.5, 1.5,
+         *                                1.0, 3.0};
+         * std::vector<double> predictions = dt1.predict_batch(samples, 2);
+         * @endcode
+         */
+        vector<double> predict_batch(const vector<double>& samples, size_t num_columns) const;
+
+        /**
+         * @brief Generate C++ source code for the decision tree
+         * @param function_name Name of the generated function
+         * @param features Position in the sample array of every feature the tree was trained on; empty if the samples
+         *                 hold exactly the tree's features
+         * @return Definition of a function "static double function_name(const double* x)" that predicts like the tree
+         * @throws runtime_error if the decision tree is not trained
+         * 
+         * Every decision node becomes a nested if/else statement and every leaf a return statement, with the thresholds
+         * and values written as exact literals, so the compiled function needs no node data at run time. The code is
+         * generated by Node::to_cpp(), which mirrors Node::predict().
+         * 
+         * @see Node::to_cpp()
+         */
+        string to_cpp(const string& function_name, const vector<size_t>& features) const;
+
+        /**
+         * @brief Save the decision tree to a binary model file
+         * @param path Path of the model file
+         * @throws runtime_error if the decision tree is not trained or the file cannot be written
+         * 
+         * The file uses the layout described by ModelHeader, with a single tree section.
+         * 
+         * @see load(const std::string& path)
+         */
+        void save(const std::string& path) const;
+
+        /**
+         * @brief Load a decision tree from a binary model file
+         * @param path Path of the model file written by save()
+         * @return Pointer to the loaded decision tree
+         * @throws runtime_error if the file cannot be mapped or does not hold a valid decision tree
+         * 
+         * The file is memory mapped and the tree predicts from the mapped nodes in place, so loading does not depend on
+         * the size of the tree and processes loading the same file share its pages.
+         * 
+         * @code
+         * dt.save("tree.bin");
+         * unique_ptr<DecisionTree> loaded = DecisionTree::load("tree.bin");
+         * std::cout << loaded->predict({2.5, 1.5}) << std::endl;
+         * @endcode
+         */
+        static unique_ptr<DecisionTree> load(const std::string& path);
 };
 
 #endif // DECISIONTREE_H
\ No newline at end of file
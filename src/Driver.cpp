@@ -7,11 +7,13 @@
 #include <map>
 #include <random>
 #include <climits>
+#include <stdexcept>
 
 
 #include "DataFrame.h"
 #include "DecisionTree.h"
 #include "RandomForest.h"
+#include "Trace.h"
 
 // Helper function to trim whitespace from the beginning and end of a string
 std::string trim(const std::string& str) {
@@ -158,12 +160,20 @@ std::string get_label_column() {
  * The function performs hyperparameter tuning for a RandomForest model using the RandomForest::hypertune function, which takes
  * the input data, label column name, number of folds for cross-validation, random seed, and vectors of hyperparameter values.
  * The function prints the best hyperparameters found during hyperparameter tuning.
+ * 
+ * A model saved with the -o option can be passed back with the -m option, in which case tuning and training are skipped
+ * and the saved forest is loaded and scored on the test data. The -g option writes the forest as a C++ translation unit with
+ * an extern "C" double predict(const double* x) entry point, which can be compiled into a shared object.
  */
 int main(int argc, char* argv[]) {
     int opt;
     std::string input_file;
     std::string config_file = "config.txt";
     std:string cleaning_file = "clean.txt";
+    std::string model_file;
+    std::string save_file;
+    std::string code_file;
+    std::string trace_file;
     bool verbose = false;
     
     
@@ -179,17 +189,21 @@ int main(int argc, char* argv[]) {
     /*-----------------------------------------------------------*/
 
     // Define short options: h (no argument), f (requires argument), o (requires argument), v (no argument)
-    while ((opt = getopt(argc, argv, "hf:c:vl:s:")) != -1) {
+    while ((opt = getopt(argc, argv, "hf:c:vl:s:m:o:g:t:")) != -1) {
         switch (opt) {
             case 'h':
-                std::cout << "Usage: ./program [-h] [-v] [-f filename] [-c config] [-l cleaning file] [-s seed]\n"
+                std::cout << "Usage: ./program [-h] [-v] [-f filename] [-c config] [-l cleaning file] [-s seed] [-m model] [-o model] [-g source] [-t trace]\n"
                           << "Options:\n"
                           << "  -h                Show help\n"
                           << "  -v                Enable verbose mode\n"
                           << "  -f filename       Specify input file\n"
                           << "  -c config         Specify config file\n"
                           << "  -l cleaning file  Specify cleaning file\n"
-                          << "  -s seed           Specify a random seed\n";
+                          << "  -s seed           Specify a random seed\n"
+                          << "  -m model          Load a saved model instead of tuning and training one\n"
+                          << "  -o model          Save the trained model to a file\n"
+                          << "  -g source         Generate C++ source code for the trained model\n"
+                          << "  -t trace          Write a Chrome trace of the run (needs a build with RF_ENABLE_TRACING)\n";
                 return 0;
             case 'f':
                 input_file = optarg;
@@ -207,6 +221,18 @@ int main(int argc, char* argv[]) {
             case 's':
                 seed = std::stoi(optarg);
                 break;
+            case 'm':
+                model_file = optarg;
+                break;
+            case 'o':
+                save_file = optarg;
+                break;
+            case 'g':
+                code_file = optarg;
+                break;
+            case 't':
+                trace_file = optarg;
+                break;
             case '?':
                 std::cerr << "Unknown option: " << char(optopt) << "\n";
                 return 1;
@@ -229,6 +255,9 @@ int main(int argc, char* argv[]) {
     if (cleaning_file != "clean.txt" && verbose) {
         std::cout << "Config file: " << cleaning_file << "\n";
     }
+    if (!model_file.empty() && verbose) {
+        std::cout << "Model file: " << model_file << "\n";
+    }
 
     // Handle remaining command-line arguments (non-option arguments)
     if (optind < argc) {
@@ -374,27 +403,65 @@ int main(int argc, char* argv[]) {
     /*-----------------------------------------------------------*/
     /*-------- STEP 6: Perform Hyperparameter Tuning ------------*/
     /*-----------------------------------------------------------*/
-    std::unique_ptr<DataFrame> train_df_copy = train_df->copy();
+    unique_ptr<RandomForest> rf;
+
+    if (!model_file.empty()) {
+        // A saved model replaces tuning and training; it is memory mapped and used in place
+        try {
+            rf = RandomForest::load(model_file);
+        } catch (const std::runtime_error& e) {
+            std::cerr << "Error loading model " << model_file << ": " << e.what() << "\n";
+            return 1;
+        }
+        if (verbose) {
+            std::cout << "Loaded model from " << model_file << "\n";
+        }
+    } else {
+        std::unique_ptr<DataFrame> train_df_copy = train_df->copy();
 
-    auto [best_num_trees, best_max_depth, best_min_samples_split, best_num_features] = RandomForest::hypertune(std::move(train_df),
-                                                                                     label_col, 3, seed,
-                                                                                     num_trees_values,
-                                                                                     max_depth_values,
-                                                                                     min_samples_split_values,
-                                                                                     num_features_values,
-                                                                                     verbose);
+        auto [best_num_trees, best_max_depth, best_min_samples_split, best_num_features] = RandomForest::hypertune(std::move(train_df),
+                                                                                         label_col, 3, seed,
+                                                                                         num_trees_values,
+                                                                                         max_depth_values,
+                                                                                         min_samples_split_values,
+                                                                                         num_features_values,
+                                                                                         verbose);
 
-    if (verbose) {
-        std::cout << "\n\n";
-        std::cout << "Best hyperparameters:\n";
-        std::cout << "  num_trees: " << best_num_trees << "\n";
-        std::cout << "  max_depth: " << best_max_depth << "\n";
-        std::cout << "  min_samples_split: " << best_min_samples_split << "\n";
-        std::cout << "  num_features: " << best_num_features << "\n";
+        if (verbose) {
+            std::cout << "\n\n";
+            std::cout << "Best hyperparameters:\n";
+            std::cout << "  num_trees: " << best_num_trees << "\n";
+            std::cout << "  max_depth: " << best_max_depth << "\n";
+            std::cout << "  min_samples_split: " << best_min_samples_split << "\n";
+            std::cout << "  num_features: " << best_num_features << "\n";
+        }
+
+        rf = std::make_unique<RandomForest>(best_num_trees, best_max_depth, best_min_samples_split, best_num_features, seed);
+        TrainingStats stats = rf->fit(std::move(train_df_copy), label_col);
+        if (verbose) {
+            std::cout << "\nTraining statistics:\n" << stats.print();
+        }
+    }
+
+    if (!save_file.empty()) {
+        rf->save(save_file);
+        if (verbose) {
+            std::cout << "Saved model to " << save_file << "\n";
+        }
+    }
+
+    if (!code_file.empty()) {
+        std::ofstream code(code_file);
+        if (!code) {
+            std::cerr << "Error opening file " << code_file << ".\n";
+            return 1;
+        }
+        code << rf->to_cpp();
+        if (verbose) {
+            std::cout << "Generated C++ source code in " << code_file << "\n";
+        }
     }
 
-    unique_ptr<RandomForest> rf = std::make_unique<RandomForest>(best_num_trees, best_max_depth, best_min_samples_split, best_num_features, seed);
-    rf->fit(std::move(train_df_copy), label_col);
     double accuracy = rf->score(std::move(test_df), label_col);
 
     if (verbose) {
@@ -402,5 +469,15 @@ int main(int argc, char* argv[]) {
         std::cout << "\033[32mModel accuracy on test data: " << accuracy << "\n\033[0m";
     }
 
+    if (!trace_file.empty()) {
+#ifndef RF_ENABLE_TRACING
+        std::cerr << "Warning: built without RF_ENABLE_TRACING, so the trace in " << trace_file << " is empty.\n";
+#endif
+        TraceRecorder::instance().write_json(trace_file);
+        if (verbose) {
+            std::cout << "Wrote trace to " << trace_file << "\n";
+        }
+    }
+
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include <vector>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <unordered_map>
+
+#include "Node.h"
+#include "FlatTree.h"
+
+
+// Children of a decision node, or nothing for a leaf
+static std::vector<const Node*> children(const Node* node) {
+    const DecisionNode* decision_node = dynamic_cast<const DecisionNode*>(node);
+    if (!decision_node) {
+        return {};
+    }
+    if (!decision_node->left || !decision_node->right) {
+        throw std::runtime_error("Cannot flatten a decision node with a missing child");
+    }
+    return {decision_node->left.get(), decision_node->right.get()};
+}
+
+// Order of the nodes in the given layout; every node comes before its children
+static std::vector<const Node*> node_order(const Node& root, NodeLayout layout) {
+    std::vector<const Node*> order;
+
+    if (layout == NodeLayout::BreadthFirst) {
+        order.push_back(&root);
+        for (size_t i = 0; i < order.size(); ++i) {
+            for (const Node* child : children(order[i])) {
+                order.push_back(child);
+            }
+        }
+        return order;
+    }
+
+    // Pre-order; the hot-path layout descends into the child reached by more samples first, so the most frequent
+    // path from every node continues in the next records
+    std::vector<const Node*> stack = {&root};
+    while (!stack.empty()) {
+        const Node* node = stack.back();
+        stack.pop_back();
+        order.push_back(node);
+
+        std::vector<const Node*> next = children(node);
+        if (next.empty()) {
+            continue;
+        }
+        if (layout == NodeLayout::HotPath && next[1]->get_num_samples() > next[0]->get_num_samples()) {
+            std::swap(next[0], next[1]);
+        }
+        stack.push_back(next[1]);
+        stack.push_back(next[0]);
+    }
+    return order;
+}
+
+
+// Constructors
+FlatTree::FlatTree() : nodes(nullptr), num_nodes(0) {}
+
+FlatTree::FlatTree(const Node& root, NodeLayout layout) : nodes(nullptr), num_nodes(0) {
+    std::vector<const Node*> order = node_order(root, layout);
+
+    std::unordered_map<const Node*, uint32_t> index;
+    for (size_t i = 0; i < order.size(); ++i) {
+        index[order[i]] = static_cast<uint32_t>(i);
+    }
+
+    storage.resize(order.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        const Node* node = order[i];
+        uint32_t num_samples = static_cast<uint32_t>(node->get_num_samples());
+        const DecisionNode* decision_node = dynamic_cast<const DecisionNode*>(node);
+        if (decision_node) {
+            storage[i] = {decision_node->get_threshold(), decision_node->get_feature_index(), index.at(decision_node->left.get()),
+                          index.at(decision_node->right.get()), num_samples};
+        } else {
+            storage[i] = {node->predict({}), -1, 0, 0, num_samples};
+        }
+    }
+    nodes = storage.data();
+    num_nodes = storage.size();
+}
+
+FlatTree::FlatTree(const FlatNode* nodes, size_t num_nodes) : nodes(nodes), num_nodes(num_nodes) {
+    // Every child must come after its parent; this rules out cycles and out-of-range indices
+    for (size_t i = 0; i < num_nodes; ++i) {
+        if (nodes[i].feature < 0) {
+            continue;
+        }
+        if (nodes[i].left <= i || nodes[i].left >= num_nodes || nodes[i].right <= i || nodes[i].right >= num_nodes) {
+            throw std::runtime_error("Invalid child index in flat tree node " + std::to_string(i));
+        }
+    }
+}
+
+// Moving keeps the owned node buffer in place, so the node pointer stays valid
+FlatTree::FlatTree(FlatTree&& other) noexcept
+    : storage(std::move(other.storage)), nodes(other.nodes), num_nodes(other.num_nodes) {
+    other.nodes = nullptr;
+    other.num_nodes = 0;
+}
+
+FlatTree& FlatTree::operator=(FlatTree&& other) noexcept {
+    if (this != &other) {
+        storage = std::move(other.storage);
+        nodes = other.nodes;
+        num_nodes = other.num_nodes;
+        other.nodes = nullptr;
+        other.num_nodes = 0;
+    }
+    return *this;
+}
+
+// Predict method; walk from the root following the same <= rule as DecisionNode::predict
+double FlatTree::predict(const double* sample) const {
+    if (num_nodes == 0) {
+        throw std::runtime_error("Flat tree is empty.");
+    }
+
+    const FlatNode* node = nodes;
+    while (node->feature >= 0) {
+        node = nodes + (sample[node->feature] <= node->value ? node->left : node->right);
+    }
+    return node->value;
+}
+
+// Batch predict; a block of rows walks the tree in lockstep so that their node fetches overlap
+void FlatTree::predict_batch(const double* samples, size_t num_rows, size_t num_columns, const size_t* features,
+                             double* predictions) const {
+    if (num_nodes == 0) {
+        throw std::runtime_error("Flat tree is empty.");
+    }
+
+    for (size_t start = 0; start < num_rows; start += BATCH_BLOCK) {
+        size_t block = std::min(BATCH_BLOCK, num_rows - start);
+        const double* rows = samples + start * num_columns;
+        uint32_t current[BATCH_BLOCK] = {};
+
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (size_t r = 0; r < block; ++r) {
+                const FlatNode& node = nodes[current[r]];
+                if (node.feature < 0) {
+                    continue;
+                }
+                size_t column = features ? features[node.feature] : static_cast<size_t>(node.feature);
+                current[r] = rows[r * num_columns + column] <= node.value ? node.left : node.right;
+                __builtin_prefetch(nodes + current[r]);
+                moved = true;
+            }
+        }
+
+        for (size_t r = 0; r < block; ++r) {
+            predictions[start + r] = nodes[current[r]].value;
+        }
+    }
+}
+
+std::unique_ptr<Node> FlatTree::to_node() const {
+    if (num_nodes == 0) {
+        return nullptr;
+    }
+    return to_node(0);
+}
+
+std::unique_ptr<Node> FlatTree::to_node(uint32_t index) const {
+    const FlatNode& node = nodes[index];
+    std::unique_ptr<Node> rebuilt;
+    if (node.feature < 0) {
+        rebuilt = std::make_unique<LeafNode>(node.value);
+    } else {
+        rebuilt = std::make_unique<DecisionNode>(node.feature, node.value, to_node(node.left), to_node(node.right));
+    }
+    rebuilt->set_num_samples(node.num_samples);
+    return rebuilt;
+}
+
+// Since children always come after their parents, one forward pass computes the depth of every node
+int FlatTree::get_height() const {
+    std::vector<int> depth(num_nodes, 0);
+    int height = 0;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        height = std::max(height, depth[i]);
+        if (nodes[i].feature >= 0) {
+            depth[nodes[i].left] = depth[i] + 1;
+            depth[nodes[i].right] = depth[i] + 1;
+        }
+    }
+    return height;
+}
+
+int32_t FlatTree::max_feature() const {
+    int32_t largest = -1;
+    for (size_t i = 0; i < num_nodes; ++i) {
+        largest = std::max(largest, nodes[i].feature);
+    }
+    return largest;
+}
+
+size_t FlatTree::memory_usage() const {
+    return storage.capacity() * sizeof(FlatNode);
+}
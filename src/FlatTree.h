@@ -0,0 +1,169 @@
+#ifndef FLATTREE_H
+#define FLATTREE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Node.h"
+
+
+/**
+ * @struct FlatNode
+ * @brief A node of a decision tree stored as a plain record
+ *
+ * A FlatNode is the array form of a DecisionNode or a LeafNode. Children are referenced by their index in the node
+ * array instead of by pointer, so an array of FlatNodes can be written to disk as-is and used in place after it has
+ * been memory mapped.
+ */
+struct FlatNode {
+    double value; ///< Threshold of a decision node, or the predicted value of a leaf
+    int32_t feature; ///< Index of the feature used by a decision node, or -1 for a leaf
+    uint32_t left; ///< Index of the left child (samples with feature value <= threshold)
+    uint32_t right; ///< Index of the right child (samples with feature value > threshold)
+    uint32_t num_samples; ///< Number of training samples that reached the node (0 if unknown)
+};
+
+static_assert(sizeof(FlatNode) == 24, "FlatNode is part of the model file format and must stay 24 bytes");
+
+
+/**
+ * @enum NodeLayout
+ * @brief Order in which the nodes of a tree are stored in a FlatTree
+ *
+ * Every layout stores a node before its children, so the root is always node 0.
+ */
+enum class NodeLayout {
+    DepthFirst, ///< Pre-order: every left path is contiguous in memory
+    BreadthFirst, ///< Level by level: the top levels of the tree share a few cache lines
+    HotPath ///< Pre-order through the child reached by more training samples first: the most frequent paths are contiguous
+};
+
+
+/**
+ * @class FlatTree
+ * @brief A decision tree stored as a contiguous array of FlatNodes
+ *
+ * This class represents a trained decision tree as an array of FlatNodes, ordered according to a NodeLayout, so the
+ * root is node 0 and every child comes after its parent. A FlatTree either owns its nodes, when it is built from a
+ * tree of Node objects, or is a read-only view of nodes owned by someone else, e.g. a memory-mapped model file.
+ *
+ * @see Node
+ * @see DecisionTree
+ */
+class FlatTree {
+    private:
+        std::vector<FlatNode> storage; ///< Owned nodes; empty when the tree is a view
+        const FlatNode* nodes; ///< Pointer to the first node (into storage, or into external memory for a view)
+        size_t num_nodes; ///< Number of nodes in the tree
+
+        /**
+         * @brief Helper method for to_node; rebuilds the subtree rooted at the given index
+         * @param index Index of the subtree root
+         * @return Pointer to the rebuilt subtree
+         */
+        std::unique_ptr<Node> to_node(uint32_t index) const;
+
+    public:
+        /**
+         * @brief Constructor for an empty FlatTree
+         */
+        FlatTree();
+
+        /**
+         * @brief Constructor which flattens a tree of Node objects
+         * @param root Root node of the tree to flatten
+         * @param layout Order in which the nodes are stored
+         * @throws std::runtime_error if a decision node is missing one of its children
+         *
+         * NodeLayout::HotPath ranks the children of every node by the number of training samples that reached them, as
+         * recorded by DecisionTree::fit; a tree without sample counts is laid out depth-first.
+         */
+        explicit FlatTree(const Node& root, NodeLayout layout = NodeLayout::DepthFirst);
+
+        /**
+         * @brief Constructor for a view of nodes owned elsewhere
+         * @param nodes Pointer to the first node; must outlive the FlatTree
+         * @param num_nodes Number of nodes
+         * @throws std::runtime_error if a child index does not point to a later node of the tree
+         *
+         * The nodes are checked once here so that predict can follow child indices without bounds checks.
+         */
+        FlatTree(const FlatNode* nodes, size_t num_nodes);
+
+        FlatTree(FlatTree&& other) noexcept;
+        FlatTree& operator=(FlatTree&& other) noexcept;
+        FlatTree(const FlatTree&) = delete;
+        FlatTree& operator=(const FlatTree&) = delete;
+
+        /**
+         * @brief Predict method
+         * @param sample Pointer to the feature values of a single sample
+         * @return Value of the leaf the sample falls into
+         * @throws std::runtime_error if the tree is empty
+         */
+        double predict(const double* sample) const;
+
+        /**
+         * @brief Predict method for a batch of samples
+         * @param samples Pointer to the feature values of the samples, one row of num_columns values after the other
+         * @param num_rows Number of samples
+         * @param num_columns Number of feature values per sample
+         * @param features Column of every feature index used by the tree, or nullptr to use the feature indices as columns
+         * @param predictions Receives the value of the leaf every sample falls into
+         *
+         * Rows are processed in blocks of BATCH_BLOCK rows that descend the tree in lockstep: every pass moves each row
+         * that has not reached a leaf one level down and prefetches its next node. While one row waits for a node to
+         * arrive from memory, the other rows of the block keep the core busy.
+         */
+        void predict_batch(const double* samples, size_t num_rows, size_t num_columns, const size_t* features,
+                           double* predictions) const;
+
+        /// Number of rows that descend a tree together in predict_batch
+        static constexpr size_t BATCH_BLOCK = 16;
+
+        /**
+         * @brief Rebuild the tree of Node objects
+         * @return Pointer to the root node, or nullptr for an empty tree
+         */
+        std::unique_ptr<Node> to_node() const;
+
+        /**
+         * @brief Get the height of the tree
+         * @return Height of the tree; 0 for an empty tree or a single leaf
+         */
+        int get_height() const;
+
+        /**
+         * @brief Get the largest feature index used by a decision node
+         * @return Largest feature index, or -1 if the tree has no decision nodes
+         */
+        int32_t max_feature() const;
+
+        /**
+         * @brief Get the nodes of the tree
+         * @return Pointer to the first node
+         */
+        const FlatNode* data() const { return nodes; }
+
+        /**
+         * @brief Get the number of nodes in the tree
+         * @return Number of nodes
+         */
+        size_t size() const { return num_nodes; }
+
+        /**
+         * @brief Check whether the tree has no nodes
+         * @return True if the tree is empty
+         */
+        bool empty() const { return num_nodes == 0; }
+
+        /**
+         * @brief Get the memory owned by the tree
+         * @return Bytes allocated for owned nodes; views report 0 since their nodes belong to someone else
+         */
+        size_t memory_usage() const;
+};
+
+#endif // FLATTREE_H
@@ -0,0 +1,313 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <list>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "RandomForest.h"
+#include "MicroBatcher.h"
+
+// Largest number of feature values accepted in one request frame
+static const uint64_t MAX_FRAME_VALUES = uint64_t(1) << 24;
+
+// Number of requests of one connection that may wait for their predictions before reading pauses
+static const size_t MAX_IN_FLIGHT = 64;
+
+
+// Reads exactly count bytes; false on end of stream or error
+static bool read_exact(int fd, void* buffer, size_t count) {
+    char* out = static_cast<char*>(buffer);
+    while (count > 0) {
+        ssize_t n = read(fd, out, count);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        out += n;
+        count -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Writes exactly count bytes; false if the peer went away
+static bool write_exact(int fd, const void* buffer, size_t count) {
+    const char* in = static_cast<const char*>(buffer);
+    while (count > 0) {
+        ssize_t n = write(fd, in, count);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        in += n;
+        count -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// Response frame: status 0 and one double per row, or status 1 and an error message
+static bool write_response(int fd, const std::vector<double>& predictions) {
+    uint32_t head[2] = {0, static_cast<uint32_t>(predictions.size())};
+    return write_exact(fd, head, sizeof(head)) && write_exact(fd, predictions.data(), predictions.size() * sizeof(double));
+}
+
+static bool write_error(int fd, const std::string& message) {
+    uint32_t head[2] = {1, static_cast<uint32_t>(message.size())};
+    return write_exact(fd, head, sizeof(head)) && write_exact(fd, message.data(), message.size());
+}
+
+
+// A client connection of the socket server and the thread serving it
+struct Connection {
+    int fd; ///< Socket of the client; closed by the accepting thread once the serving thread is joined
+    std::shared_ptr<std::atomic<bool>> done; ///< Set by the serving thread when the stream has ended
+    std::thread thread; ///< Thread serving the connection
+};
+
+
+/**
+ * @brief Function to answer the request frames of one stream
+ * @param in_fd Descriptor the request frames are read from
+ * @param out_fd Descriptor the response frames are written to
+ * @param batcher MicroBatcher that predicts the rows
+ *
+ * The frames are read on the calling thread and queued with the batcher without waiting for earlier answers, so the
+ * requests a client pipelines can share a batch. A second thread writes the responses in request order. The function
+ * returns when the input ends or the output is closed.
+ */
+static void serve_stream(int in_fd, int out_fd, MicroBatcher& batcher) {
+    std::deque<std::future<std::vector<double>>> in_flight;
+    std::mutex mutex;
+    std::condition_variable changed;
+    bool input_done = false;
+    bool output_failed = false;
+
+    std::thread writer([&]() {
+        while (true) {
+            std::future<std::vector<double>> result;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return input_done || !in_flight.empty(); });
+                if (in_flight.empty()) {
+                    return;
+                }
+                result = std::move(in_flight.front());
+                in_flight.pop_front();
+            }
+            changed.notify_all();
+
+            bool written;
+            try {
+                written = write_response(out_fd, result.get());
+            } catch (const std::exception& e) {
+                written = write_error(out_fd, e.what());
+            }
+            if (!written) {
+                std::lock_guard<std::mutex> lock(mutex);
+                output_failed = true;
+                in_flight.clear();
+                changed.notify_all();
+                return;
+            }
+        }
+    });
+
+    while (true) {
+        uint32_t head[2];
+        if (!read_exact(in_fd, head, sizeof(head))) {
+            break;
+        }
+        uint64_t num_values = uint64_t(head[0]) * head[1];
+        if (num_values > MAX_FRAME_VALUES) {
+            break;   // the payload cannot be skipped safely, so the connection is dropped
+        }
+        std::vector<double> rows(num_values);
+        if (!read_exact(in_fd, rows.data(), num_values * sizeof(double))) {
+            break;
+        }
+
+        std::string rejection;
+        if (head[1] != batcher.get_num_columns()) {
+            rejection = "Expected rows of " + std::to_string(batcher.get_num_columns()) + " features";
+        } else if (head[0] == 0) {
+            rejection = "Expected at least one row";
+        }
+
+        std::future<std::vector<double>> result;
+        if (!rejection.empty()) {
+            std::promise<std::vector<double>> rejected;
+            rejected.set_exception(std::make_exception_ptr(std::invalid_argument(rejection)));
+            result = rejected.get_future();
+        } else {
+            result = batcher.submit(std::move(rows));
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return output_failed || in_flight.size() < MAX_IN_FLIGHT; });
+        if (output_failed) {
+            break;
+        }
+        in_flight.push_back(std::move(result));
+        changed.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        input_done = true;
+    }
+    changed.notify_all();
+    writer.join();
+}
+
+
+/**
+ * @brief Main function of the batch-scoring daemon
+ * @param argc The number of command-line arguments
+ * @param argv The array of command-line arguments
+ *
+ * forest_serve loads a RandomForest saved with RandomForest::save (or Driver -o) and predicts feature rows sent to it
+ * over stdin/stdout, or over a Unix domain socket with the -u option, where every connection is served on its own
+ * thread. All integers and doubles are in the byte order of the host.
+ *
+ * Request frame:  uint32 num_rows, uint32 num_columns, num_rows * num_columns doubles (row after row)
+ * Response frame: uint32 status 0, uint32 num_rows, num_rows doubles (the predictions); or
+ *                 uint32 status 1, uint32 length, length bytes of error message
+ *
+ * Responses come back in request order on every stream. The rows of concurrent and pipelined requests are coalesced
+ * into batches of up to -b rows, waiting at most -t microseconds for a batch to fill, and every batch is predicted with
+ * RandomForest::predict_batch. A request without rows, or with rows of the wrong width, gets an error response. If the
+ * socket stops accepting connections, the open connections are shut down and their threads joined before exiting.
+ */
+int main(int argc, char* argv[]) {
+    int opt;
+    std::string model_file;
+    std::string socket_path;
+    size_t max_rows = 256;
+    long max_delay_us = 200;
+
+    while ((opt = getopt(argc, argv, "hm:u:b:t:")) != -1) {
+        switch (opt) {
+            case 'h':
+                std::cout << "Usage: ./forest_serve -m model [-u socket] [-b rows] [-t microseconds]\n"
+                          << "Options:\n"
+                          << "  -h                Show help\n"
+                          << "  -m model          Saved RandomForest to serve\n"
+                          << "  -u socket         Listen on a Unix domain socket instead of stdin/stdout\n"
+                          << "  -b rows           Largest number of rows in a batch (default 256)\n"
+                          << "  -t microseconds   Longest time a request waits for a batch to fill (default 200)\n";
+                return 0;
+            case 'm':
+                model_file = optarg;
+                break;
+            case 'u':
+                socket_path = optarg;
+                break;
+            case 'b':
+                max_rows = std::stoul(optarg);
+                break;
+            case 't':
+                max_delay_us = std::stol(optarg);
+                break;
+            default:
+                std::cerr << "Error parsing options.\n";
+                return 1;
+        }
+    }
+    if (model_file.empty()) {
+        std::cerr << "A model file is required (-m).\n";
+        return 1;
+    }
+
+    std::unique_ptr<RandomForest> forest;
+    try {
+        forest = RandomForest::load(model_file);
+    } catch (const std::exception& e) {
+        std::cerr << "Could not load the model: " << e.what() << "\n";
+        return 1;
+    }
+
+    size_t num_columns = forest->get_num_columns();
+
+    MicroBatcher batcher([&forest](const std::vector<double>& samples, size_t columns) {
+        return forest->predict_batch(samples, columns);
+    }, num_columns, max_rows, std::chrono::microseconds(max_delay_us));
+
+    // A client that disconnects early must not kill the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (socket_path.empty()) {
+        serve_stream(STDIN_FILENO, STDOUT_FILENO, batcher);
+        return 0;
+    }
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (server < 0 || socket_path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "Could not create the socket " << socket_path << "\n";
+        return 1;
+    }
+    std::strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+    unlink(socket_path.c_str());
+    if (bind(server, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(server, 128) < 0) {
+        std::cerr << "Could not listen on " << socket_path << ": " << std::strerror(errno) << "\n";
+        return 1;
+    }
+    std::cerr << "Serving " << model_file << " (" << num_columns << " features) on " << socket_path << "\n";
+
+    // Every connection thread is joined before the batcher it uses goes away; the descriptor is closed by this thread
+    // after the join, so it cannot be reused while its connection is still being served
+    std::list<Connection> connections;
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            std::cerr << "accept failed: " << std::strerror(errno) << "\n";
+            break;
+        }
+
+        for (auto it = connections.begin(); it != connections.end();) {
+            if (it->done->load()) {
+                it->thread.join();
+                close(it->fd);
+                it = connections.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        auto done = std::make_shared<std::atomic<bool>>(false);
+        connections.push_back({client, done, std::thread([client, done, &batcher]() {
+            serve_stream(client, client, batcher);
+            done->store(true);
+        })});
+    }
+
+    // End the connections still open, so their threads stop reading, and wait for them
+    for (auto& connection : connections) {
+        shutdown(connection.fd, SHUT_RDWR);
+        connection.thread.join();
+        close(connection.fd);
+    }
+    close(server);
+    return 0;
+}
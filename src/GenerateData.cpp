@@ -0,0 +1,85 @@
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+#include "SyntheticData.h"
+
+
+/**
+ * @brief Main function of the synthetic data generator
+ * @param argc The number of command-line arguments
+ * @param argv The array of command-line arguments
+ *
+ * generate_data writes a synthetic classification data set (see SyntheticData) to the file given with -o: a CSV file
+ * that DataFrame::read_csv and Driver can read, or the binary format of SyntheticData::write_binary if the name ends in
+ * ".bin". The rows are streamed to the file, so any number of rows fits in memory.
+ */
+int main(int argc, char* argv[]) {
+    int opt;
+    SyntheticSpec spec;
+    std::string output_file;
+
+    try {
+        while ((opt = getopt(argc, argv, "hn:f:c:k:l:e:s:o:")) != -1) {
+            switch (opt) {
+                case 'h':
+                    std::cout << "Usage: ./generate_data -o file [-n rows] [-f numeric] [-c categorical] [-k cardinality]"
+                              << " [-l classes] [-e noise] [-s seed]\n"
+                              << "Options:\n"
+                              << "  -h                Show help\n"
+                              << "  -o file           Output file; binary if the name ends in .bin, CSV otherwise\n"
+                              << "  -n rows           Number of rows (default 1000)\n"
+                              << "  -f numeric        Number of numeric features (default 8)\n"
+                              << "  -c categorical    Number of categorical features (default 0)\n"
+                              << "  -k cardinality    Distinct values of every categorical feature (default 8)\n"
+                              << "  -l classes        Number of classes (default 2)\n"
+                              << "  -e noise          Fraction of rows with a random label (default 0)\n"
+                              << "  -s seed           Random seed (default 42)\n";
+                    return 0;
+                case 'o':
+                    output_file = optarg;
+                    break;
+                case 'n':
+                    spec.num_rows = std::stoull(optarg);
+                    break;
+                case 'f':
+                    spec.num_numeric = std::stoull(optarg);
+                    break;
+                case 'c':
+                    spec.num_categorical = std::stoull(optarg);
+                    break;
+                case 'k':
+                    spec.cardinality = std::stoull(optarg);
+                    break;
+                case 'l':
+                    spec.num_classes = std::stoull(optarg);
+                    break;
+                case 'e':
+                    spec.label_noise = std::stod(optarg);
+                    break;
+                case 's':
+                    spec.seed = std::stoull(optarg);
+                    break;
+                default:
+                    std::cerr << "Error parsing options.\n";
+                    return 1;
+            }
+        }
+        if (output_file.empty()) {
+            std::cerr << "An output file is required (-o).\n";
+            return 1;
+        }
+
+        SyntheticData data(spec);
+        bool binary = output_file.size() >= 4 && output_file.compare(output_file.size() - 4, 4, ".bin") == 0;
+        if (binary) {
+            data.write_binary(output_file);
+        } else {
+            data.write_csv(output_file);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -1,67 +1,225 @@
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <sstream>
 #include <cmath>  // for pow()
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <tuple>
+#include <chrono>
 #include "DecisionTree.h"
 #include "DataFrame.h"
+#include "Serialization.h"
 #include "GradientBoostedTrees.h"
+#include "SortedIndex.h"
+#include "Trace.h"
 
 using Cell = std::variant<int, double, std::string>;
 using std::vector;
 using std::string;
 
-
-
 GradientBoostedTrees::GradientBoostedTrees(int num_trees, double learning_rate, int max_depth, int min_samples_split)
-    : num_trees(num_trees), learning_rate(learning_rate), max_depth(max_depth), min_samples_split(min_samples_split) {}
+    : max_depth(max_depth), min_samples_split(min_samples_split), num_trees(num_trees), learning_rate(learning_rate), base_prediction(0.0),
+      subsample(1.0), colsample_bytree(1.0), colsample_bylevel(1.0), random_state(0),
+      use_goss(false), goss_top_rate(0.0), goss_other_rate(1.0), engine(InferenceEngine::Pointer), oblivious(false) {}
+
+GradientBoostedTrees::GradientBoostedTrees(int num_trees, double learning_rate, int max_depth, int min_samples_split,
+                                           double subsample, double colsample_bytree, double colsample_bylevel, size_t random_state)
+    : max_depth(max_depth), min_samples_split(min_samples_split), num_trees(num_trees), learning_rate(learning_rate), base_prediction(0.0),
+      subsample(subsample), colsample_bytree(colsample_bytree), colsample_bylevel(colsample_bylevel), random_state(random_state),
+      use_goss(false), goss_top_rate(0.0), goss_other_rate(1.0), engine(InferenceEngine::Pointer), oblivious(false) {
+    if (subsample <= 0.0 || subsample > 1.0) {
+        throw std::invalid_argument("subsample must be in the interval (0, 1]");
+    }
+    if (colsample_bytree <= 0.0 || colsample_bytree > 1.0) {
+        throw std::invalid_argument("colsample_bytree must be in the interval (0, 1]");
+    }
+    if (colsample_bylevel <= 0.0 || colsample_bylevel > 1.0) {
+        throw std::invalid_argument("colsample_bylevel must be in the interval (0, 1]");
+    }
+}
 
 GradientBoostedTrees::~GradientBoostedTrees() {}
 
-void GradientBoostedTrees::fit(std::shared_ptr<DataFrame> data, const std::string& label_column) {
+void GradientBoostedTrees::set_goss(double top_rate, double other_rate) {
+    if (top_rate < 0.0 || top_rate >= 1.0) {
+        throw std::invalid_argument("top_rate must be in the interval [0, 1)");
+    }
+    if (other_rate <= 0.0 || other_rate > 1.0) {
+        throw std::invalid_argument("other_rate must be in the interval (0, 1]");
+    }
+    if (top_rate + other_rate > 1.0) {
+        throw std::invalid_argument("top_rate + other_rate must not exceed 1");
+    }
+
+    use_goss = true;
+    goss_top_rate = top_rate;
+    goss_other_rate = other_rate;
+}
+
+// Gradient-based one-side sampling: keep the rows with the largest absolute gradients and a weighted random
+// sample of the others. Returns the selected rows (in their original order) and the weight of each of them.
+std::pair<std::vector<size_t>, std::vector<double>> GradientBoostedTrees::goss_sample(const std::vector<double>& gradients,
+                                                                                      double top_rate, double other_rate,
+                                                                                      size_t seed) {
+    size_t n_samples = gradients.size();
+    size_t num_top = static_cast<size_t>(std::round(top_rate * n_samples));
+    size_t num_other = std::max<size_t>(1, static_cast<size_t>(std::round(other_rate * n_samples)));
+    num_other = std::min(num_other, n_samples - num_top);
+
+    // Partition the rows so that the num_top largest absolute gradients come first
+    std::vector<size_t> order(n_samples);
+    std::iota(order.begin(), order.end(), 0);
+    std::nth_element(order.begin(), order.begin() + num_top, order.end(), [&gradients](size_t a, size_t b) {
+        double abs_a = std::abs(gradients[a]);
+        double abs_b = std::abs(gradients[b]);
+        return abs_a > abs_b || (abs_a == abs_b && a < b);
+    });
+
+    // Randomly sample the small-gradient rows without replacement
+    std::mt19937 generator(seed);
+    std::shuffle(order.begin() + num_top, order.end(), generator);
+    order.resize(num_top + num_other);
+
+    // Amplify the sampled rows so their total weight matches the rows they stand in for
+    double amplification = (1.0 - top_rate) / other_rate;
+    std::vector<double> row_weights(n_samples, 0.0);
+    for (size_t i = 0; i < order.size(); ++i) {
+        row_weights[order[i]] = i < num_top ? 1.0 : amplification;
+    }
+
+    std::sort(order.begin(), order.end());
+    std::vector<double> weights;
+    for (size_t row : order) {
+        weights.push_back(row_weights[row]);
+    }
+    return {order, weights};
+}
+
+// Training-time state of a single call to fit; it is released when fit returns so the model only keeps its trees
+struct BoostingWorkspace {
+    std::unique_ptr<SortedIndex> index; ///< Numeric value and sort order of every feature, shared by all rounds
+    std::vector<double> true_values; ///< Numeric value of the label of every row
+    std::vector<double> predictions; ///< Running prediction of every row
+    std::vector<double> gradients; ///< Residuals (negative gradients of the squared loss) of the current round; the tree's targets
+    std::vector<double> sample; ///< Features of one row for the tree of the current round
+    std::vector<double> row_weights; ///< GOSS weight of every row sampled by the current round
+};
+
+TrainingStats GradientBoostedTrees::fit(std::shared_ptr<DataFrame> data, const std::string& label_column) {
+    // Keep the current model aside until the new trees and their engine are complete, so that a failed fit (for
+    // example with trees the QuickScorer cannot hold) leaves the model as it was
+    std::vector<std::unique_ptr<DecisionTree>> saved_trees = std::move(trees);
+    std::vector<std::vector<size_t>> saved_tree_features = std::move(tree_features);
+    std::vector<std::string> saved_feature_names = std::move(feature_names);
+    std::unique_ptr<QuickScorer> saved_quick_scorer = std::move(quick_scorer);
+    std::unique_ptr<CompactForest> saved_compact_forest = std::move(compact_forest);
+    double saved_base_prediction = base_prediction;
+    try {
+        return fit_rounds(data, label_column);
+    } catch (...) {
+        trees = std::move(saved_trees);
+        tree_features = std::move(saved_tree_features);
+        feature_names = std::move(saved_feature_names);
+        quick_scorer = std::move(saved_quick_scorer);
+        compact_forest = std::move(saved_compact_forest);
+        base_prediction = saved_base_prediction;
+        throw;
+    }
+}
+
+TrainingStats GradientBoostedTrees::fit_rounds(std::shared_ptr<DataFrame> data, const std::string& label_column) {
+    RF_TRACE_SCOPE("GradientBoostedTrees::fit", "train");
+    auto fit_start = std::chrono::steady_clock::now();
+    TrainingStats stats;
     int n_samples = data->get_num_rows();
 
+    trees.clear();
+    tree_features.clear();
+    feature_names.clear();
+    quick_scorer.reset();
+    compact_forest.reset();
+    for (const auto& col : data->columns) {
+        if (col != label_column) {
+            feature_names.push_back(col);
+        }
+    }
+
+    // Convert and sort the features once; every round grows its tree on the index, and the running predictions of
+    // every row are updated from its values
+    BoostingWorkspace workspace;
+    workspace.index = std::make_unique<SortedIndex>(*data, feature_names);
+    workspace.true_values = data->get_column(label_column).convert_to_numeric();
+
+    size_t features_per_tree = std::max<size_t>(1, static_cast<size_t>(std::round(colsample_bytree * feature_names.size())));
+
     // Step 1: Initialize base prediction (mean of target values)
-    base_predictions.resize(n_samples);
-    double initial_prediction = data->get_column(label_column).mean();
-    std::fill(base_predictions.begin(), base_predictions.end(), initial_prediction);
+    base_prediction = data->get_column(label_column).mean();
+    workspace.predictions.assign(n_samples, base_prediction);
+    workspace.gradients.resize(n_samples);
 
     for (int i = 0; i < num_trees; ++i) {
-        // Step 2: Compute residuals
-        std::vector<Cell> residuals(n_samples);
+        RF_TRACE_SCOPE_ARG("boosting round", "train", "round", i);
+
+        // Step 2: Compute residuals (the negative gradients of the squared loss)
         for (int j = 0; j < n_samples; ++j) {
-            double true_value = DataFrame::double_cast(data->retrieve(j, label_column));
-            residuals[j] = true_value - base_predictions[j];
+            workspace.gradients[j] = workspace.true_values[j] - workspace.predictions[j];
         }
 
-        // Step 3: Train a decision tree to predict residuals
-        std::shared_ptr<DataFrame> residual_data = data->copy();
-
-        // printf("Residuals:\n");
-        // printf("%s\n", residual_data->print().c_str());
-        // printf("\n\n");
+        // Step 3: Train a decision tree to predict residuals on a random subset of the rows and features
+        SampleDraw draw;
+        if (use_goss) {
+            std::vector<size_t> rows;
+            std::vector<double> goss_weights;
+            std::tie(rows, goss_weights) = goss_sample(workspace.gradients, goss_top_rate, goss_other_rate, random_state + i);
+            draw = data->draw_subsample(rows, features_per_tree, label_column, random_state + i);
 
-        Series residual_series(residuals); // Cast to Series object
-        residual_data->set_column(label_column, residual_series);
+            // The tree reads the weights by row, like the labels
+            workspace.row_weights.assign(n_samples, 0.0);
+            for (size_t k = 0; k < rows.size(); ++k) {
+                workspace.row_weights[rows[k]] = goss_weights[k];
+            }
+        } else {
+            draw = data->draw_subsample(subsample, features_per_tree, label_column, random_state + i);
+        }
 
-        auto tree = std::make_unique<DecisionTree>(max_depth, min_samples_split);  // Smaller trees for boosting
-        tree->fit(residual_data, label_column);
+        // Record which of the model's features this tree was trained on
+        std::vector<size_t> selected_features;
+        for (const auto& col : draw.features) {
+            selected_features.push_back(std::find(feature_names.begin(), feature_names.end(), col) - feature_names.begin());
+        }
 
-        // Step 4: Update predictions with a fraction of the tree's predictions (controlled by learning_rate)
+        auto tree = std::make_unique<DecisionTree>(max_depth, min_samples_split, colsample_bylevel, random_state + i);  // Smaller trees for boosting
+        tree->set_oblivious(oblivious);
+        stats.add(tree->fit(*workspace.index, draw.features, workspace.gradients, draw.rows, workspace.row_weights));
 
-        residual_data->drop_column(label_column);  // Drop the residuals column
+        // Step 4: Update predictions of every row with a fraction of the tree's predictions (controlled by learning_rate)
+        workspace.sample.resize(selected_features.size());
         for (int j = 0; j < n_samples; ++j) {
-            vector<Cell> sample = residual_data->get_row(j);
-            // convert to vector<double>
-            vector<double> sample_doubles;
-            for (const auto& cell : sample) {
-                sample_doubles.push_back(DataFrame::double_cast(cell));
+            for (size_t k = 0; k < selected_features.size(); ++k) {
+                workspace.sample[k] = workspace.index->get_values(selected_features[k])[j];
             }
 
-            base_predictions[j] += learning_rate * tree->predict(sample_doubles);
+            workspace.predictions[j] += learning_rate * tree->predict(workspace.sample);
         }
 
         trees.push_back(std::move(tree));
+        tree_features.push_back(std::move(selected_features));
+    }
+
+    // Release the spare capacity left over from growing the ensemble
+    trees.shrink_to_fit();
+    tree_features.shrink_to_fit();
+
+    if (engine == InferenceEngine::QuickScorer) {
+        build_quick_scorer();
+    } else if (engine == InferenceEngine::Compact) {
+        build_compact_forest();
     }
+
+    stats.fit_seconds = TrainingStats::seconds_since(fit_start);
+    return stats;
 }
 
 double GradientBoostedTrees::predict(const std::vector<double>& sample) const {
@@ -69,11 +227,173 @@ double GradientBoostedTrees::predict(const std::vector<double>& sample) const {
         throw std::runtime_error("Model has not been trained yet.");
     }
 
-    double prediction = base_predictions[0];  // Start with the initial prediction
-    for (const auto& tree : trees) {
-        prediction += learning_rate * tree->predict(sample);
+    if (sample.size() != feature_names.size()) {
+        throw std::runtime_error("Sample size does not match the number of non-label features");
+    }
+
+    double prediction = base_prediction;  // Start with the initial prediction
+    if (quick_scorer || compact_forest) {
+        static thread_local std::vector<double> tree_predictions;   // reused, so predict does not allocate once warm
+        tree_predictions.resize(trees.size());
+        if (quick_scorer) {
+            quick_scorer->score(sample.data(), tree_predictions.data());
+        } else {
+            compact_forest->score(sample.data(), tree_predictions.data());
+        }
+        for (double tree_prediction : tree_predictions) {
+            prediction += learning_rate * tree_prediction;
+        }
+        return prediction;
+    }
+
+    static thread_local std::vector<double> filtered_sample;
+    for (size_t i = 0; i < trees.size(); ++i) {
+        // Map the full sample to the features this tree was trained on
+        filtered_sample.clear();
+        for (size_t index : tree_features[i]) {
+            filtered_sample.push_back(sample[index]);
+        }
+        prediction += learning_rate * trees[i]->predict(filtered_sample);
     }
     return prediction;
 }
 
+void GradientBoostedTrees::build_quick_scorer() {
+    std::vector<FlatTree> flat_trees;
+    for (const auto& tree : trees) {
+        flat_trees.push_back(tree->flatten());
+    }
+    quick_scorer = std::make_unique<QuickScorer>(flat_trees, tree_features, feature_names.size());
+}
+
+void GradientBoostedTrees::build_compact_forest() {
+    std::vector<FlatTree> flat_trees;
+    for (const auto& tree : trees) {
+        flat_trees.push_back(tree->flatten());
+    }
+    LeafEncoding leaves = CompactForest::fits_class_ids(flat_trees) ? LeafEncoding::ClassId8 : LeafEncoding::Float32;
+    compact_forest = std::make_unique<CompactForest>(flat_trees, tree_features, feature_names.size(), ThresholdEncoding::Bin16, leaves);
+}
+
+void GradientBoostedTrees::set_inference_engine(InferenceEngine engine) {
+    // Build the new engine first, so a failure leaves the current one in place
+    if (engine == InferenceEngine::QuickScorer && !trees.empty()) {
+        build_quick_scorer();
+    } else if (engine == InferenceEngine::Compact && !trees.empty()) {
+        build_compact_forest();
+    }
+    if (engine != InferenceEngine::QuickScorer) {
+        quick_scorer.reset();
+    }
+    if (engine != InferenceEngine::Compact) {
+        compact_forest.reset();
+    }
+    this->engine = engine;
+}
+
+InferenceEngine GradientBoostedTrees::get_inference_engine() const {
+    return engine;
+}
+
+void GradientBoostedTrees::set_oblivious(bool oblivious) {
+    this->oblivious = oblivious;
+}
+
+bool GradientBoostedTrees::is_oblivious() const {
+    return oblivious;
+}
+
+size_t GradientBoostedTrees::memory_usage() const {
+    size_t bytes = sizeof(*this) + strings_memory_usage(feature_names);
+
+    bytes += trees.capacity() * sizeof(std::unique_ptr<DecisionTree>);
+    for (const auto& tree : trees) {
+        bytes += tree->memory_usage();
+    }
+
+    if (quick_scorer) {
+        bytes += quick_scorer->memory_usage();
+    }
+    if (compact_forest) {
+        bytes += compact_forest->memory_usage();
+    }
+
+    bytes += tree_features.capacity() * sizeof(std::vector<size_t>);
+    for (const auto& features : tree_features) {
+        bytes += features.capacity() * sizeof(size_t);
+    }
+    return bytes;
+}
+
+void GradientBoostedTrees::save(const std::string& path) const {
+    if (trees.empty()) {
+        throw std::runtime_error("Model has not been trained yet.");
+    }
 
+    ModelHeader header{};
+    header.model_type = static_cast<uint32_t>(ModelType::GradientBoostedTrees);
+    header.num_trees = static_cast<uint32_t>(trees.size());
+    header.num_names = static_cast<uint32_t>(feature_names.size());
+    header.max_depth = max_depth;
+    header.min_samples_split = min_samples_split;
+    header.num_features = -1;
+    header.random_state = random_state;
+    header.base_score = base_prediction;
+    header.learning_rate = learning_rate;
+
+    ModelWriter writer(header);
+    writer.write_names(feature_names);
+    for (size_t i = 0; i < trees.size(); ++i) {
+        writer.write_tree(trees[i]->flatten(), tree_features[i]);
+    }
+    writer.save(path);
+}
+
+std::unique_ptr<GradientBoostedTrees> GradientBoostedTrees::load(const std::string& path) {
+    ModelReader reader(path, ModelType::GradientBoostedTrees);
+    const ModelHeader& header = reader.header();
+
+    auto model = std::make_unique<GradientBoostedTrees>(header.num_trees, header.learning_rate, header.max_depth, header.min_samples_split);
+    model->random_state = header.random_state;
+    model->base_prediction = header.base_score;
+    model->feature_names = reader.names();
+
+    for (uint32_t i = 0; i < header.num_trees; ++i) {
+        std::vector<size_t> features;
+        FlatTree nodes = reader.read_tree(features);
+        if (nodes.empty() || nodes.max_feature() >= static_cast<int32_t>(features.size())) {
+            throw std::runtime_error("Model file holds an invalid tree: " + path);
+        }
+        for (size_t index : features) {
+            if (index >= model->feature_names.size()) {
+                throw std::runtime_error("Tree feature index out of range in model file: " + path);
+            }
+        }
+
+        model->trees.push_back(std::make_unique<DecisionTree>(header.max_depth, header.min_samples_split, std::move(nodes), reader.mapping()));
+        model->tree_features.push_back(std::move(features));
+    }
+    return model;
+}
+
+std::string GradientBoostedTrees::to_cpp(const std::string& function_name) const {
+    if (trees.empty()) {
+        throw std::runtime_error("Model has not been trained yet.");
+    }
+
+    std::ostringstream oss;
+    oss << "// Generated by GradientBoostedTrees::to_cpp from a model of " << trees.size() << " trees; do not edit.\n\n";
+    for (size_t i = 0; i < trees.size(); ++i) {
+        oss << trees[i]->to_cpp("tree_" + std::to_string(i), tree_features[i]) << "\n";
+    }
+
+    oss << std::hexfloat;
+    oss << "extern \"C\" double " << function_name << "(const double* x) {\n"
+        << "    double prediction = " << base_prediction << ";\n";
+    for (size_t i = 0; i < trees.size(); ++i) {
+        oss << "    prediction += " << learning_rate << " * tree_" << i << "(x);\n";
+    }
+    oss << "    return prediction;\n"
+        << "}\n";
+    return oss.str();
+}
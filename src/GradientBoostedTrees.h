@@ -1,9 +1,12 @@
 #include <vector>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "DecisionTree.h"
 #include "DataFrame.h"
+#include "QuickScorer.h"
+#include "CompactForest.h"
 #include "Classifier.h"
 
 
@@ -25,7 +28,44 @@ private:
     int num_trees; ///< Number of trees that should sequentially be built
     double learning_rate; ///< Learning rate for the gradient boosting algorithm
     std::vector<std::unique_ptr<DecisionTree>> trees; ///< Vector of decision trees in the ensemble
-    std::vector<double> base_predictions; ///< Vector of base predictions for the gradient boosting algorithm
+    double base_prediction; ///< Initial score of every prediction (the mean of the training labels)
+
+    double subsample; ///< Fraction of the rows sampled (without replacement) for each boosting round
+    double colsample_bytree; ///< Fraction of the features sampled for each tree
+    double colsample_bylevel; ///< Fraction of a tree's features sampled for each depth of the tree
+    size_t random_state; ///< Random seed for the row and feature sampling
+
+    bool use_goss; ///< Whether the rows of each round are chosen by gradient-based one-side sampling
+    double goss_top_rate; ///< Fraction of the rows with the largest absolute gradients that GOSS always keeps
+    double goss_other_rate; ///< Fraction of the rows GOSS samples at random from the remaining rows
+
+    std::vector<std::string> feature_names; ///< Names of the (non-label) features the model was trained on, in order
+    std::vector<std::vector<size_t>> tree_features; ///< For each tree, the indices into feature_names of the features it was trained on
+
+    InferenceEngine engine; ///< Algorithm used by predict to evaluate the trees
+    std::unique_ptr<QuickScorer> quick_scorer; ///< Bitvector evaluation of the trees; only built for InferenceEngine::QuickScorer
+    std::unique_ptr<CompactForest> compact_forest; ///< Quantized copy of the trees; only built for InferenceEngine::Compact
+    bool oblivious; ///< Whether every round grows an oblivious tree (see DecisionTree::set_oblivious)
+
+    /**
+     * @brief Function to train the trees of a fit and build the selected engine from them
+     * @param data Data to fit the GradientBoostedTrees to
+     * @param label_column Name of the column containing the labels
+     * @return Statistics of all trees added up
+     * @see fit()
+     */
+    TrainingStats fit_rounds(std::shared_ptr<DataFrame> data, const std::string& label_column);
+
+    /**
+     * @brief Function to build the QuickScorer from the trees of the ensemble
+     * @throws std::invalid_argument if a tree has more than 64 leaves
+     */
+    void build_quick_scorer();
+
+    /**
+     * @brief Function to build the CompactForest from the trees of the ensemble
+     */
+    void build_compact_forest();
 public:
     /**
      * @brief Constructor for the GradientBoostedTrees class
@@ -39,6 +79,63 @@ public:
      */
     GradientBoostedTrees(int num_trees, double learning_rate, int max_depth, int min_samples_split);
 
+    /**
+     * @brief Constructor for the GradientBoostedTrees class with stochastic row and column subsampling
+     * @param num_trees Number of trees to build
+     * @param learning_rate Learning rate for the gradient boosting algorithm
+     * @param max_depth Maximum depth of the trees
+     * @param min_samples_split Minimum number of samples required to split a node
+     * @param subsample Fraction of the rows, as a decimal in (0, 1], used to grow each tree
+     * @param colsample_bytree Fraction of the features, as a decimal in (0, 1], used to grow each tree
+     * @param colsample_bylevel Fraction of a tree's features, as a decimal in (0, 1], considered at each depth of the tree
+     * @param random_state Random seed for the row and feature sampling
+     * @throws std::invalid_argument if one of the fractions is not in (0, 1]
+     * 
+     * Each boosting round grows its tree on a DataFrame::draw_subsample of the residuals, so a round only touches a
+     * fraction of the rows and columns; the features are sorted once per fit into a SortedIndex that all rounds share.
+     * The running predictions are still updated for every row. Setting all three fractions to 1 reproduces the
+     * deterministic behaviour of GradientBoostedTrees(num_trees, learning_rate, max_depth, min_samples_split).
+     * 
+     * @see DataFrame::draw_subsample(double row_fraction, size_t num_features, const string& label_column, size_t random_state)
+     */
+    GradientBoostedTrees(int num_trees, double learning_rate, int max_depth, int min_samples_split,
+                         double subsample, double colsample_bytree, double colsample_bylevel, size_t random_state);
+
+    /**
+     * @brief Function to enable gradient-based one-side sampling (GOSS)
+     * @param top_rate Fraction of the rows, as a decimal in [0, 1), with the largest absolute gradients kept in every round
+     * @param other_rate Fraction of the rows, as a decimal in (0, 1], sampled at random from the remaining rows
+     * @throws std::invalid_argument if the rates are out of range or top_rate + other_rate exceeds 1
+     * 
+     * With GOSS each boosting round grows its tree on the top_rate * n rows with the largest absolute residuals (the
+     * gradients of the squared loss) plus other_rate * n rows sampled from the rest. The sampled rows are weighted by
+     * (1 - top_rate) / other_rate so that the tree still sees an unbiased estimate of the small gradients. GOSS replaces
+     * the uniform row subsampling; the feature sampling still applies.
+     * 
+     * @code
+     * GradientBoostedTrees gb(100, 0.1, 4, 2);
+     * gb.set_goss(0.2, 0.1);   // keep the top 20% of the gradients and 10% of the rest
+     * gb.fit(data, "label");
+     * @endcode
+     */
+    void set_goss(double top_rate, double other_rate);
+
+    /**
+     * @brief Function to draw the rows of one GOSS round
+     * @param gradients Gradient of every row
+     * @param top_rate Fraction of the rows with the largest absolute gradients to keep
+     * @param other_rate Fraction of the rows to sample at random from the remaining rows
+     * @param seed Random seed of the sample
+     * @return The selected rows in increasing order, and the weight of each of them: 1 for the rows kept for their
+     *         gradients and (1 - top_rate) / other_rate for the sampled ones
+     * 
+     * The round(top_rate * n) rows with the largest absolute gradients are always kept, ties going to the lower row,
+     * and round(other_rate * n) (at least 1) of the others are drawn without replacement. The rates are not checked;
+     * set_goss() validates them before fit draws any rows.
+     */
+    static std::pair<std::vector<size_t>, std::vector<double>> goss_sample(const std::vector<double>& gradients, double top_rate,
+                                                                          double other_rate, size_t seed);
+
     /**
      * @brief Destructor for the GradientBoostedTrees class
      * 
@@ -50,12 +147,17 @@ public:
      * @brief Function to fit the GradientBoostedTrees to the data
      * @param data Data to fit the GradientBoostedTrees to
      * @param label_column Name of the column containing the labels
+     * @return Statistics of all trees added up
      * 
      * This function fits the GradientBoostedTrees to the data by training the individual decision trees in the ensemble.
      * The function takes a DataFrame containing the data and the name of the column containing the labels.
      * For each decision tree, the base predictions are calculated, and the tree is trained to correct the errors of the previous tree.
+     * The running predictions and residuals of the training rows live in a workspace that is released when fit returns, so
+     * the trained model only holds the initial score and the trees. If the fit fails, including when the selected
+     * inference engine cannot hold the new trees (QuickScorer with a tree of more than 64 leaves), the model is left as
+     * it was and the exception is passed on.
      */
-    void fit(std::shared_ptr<DataFrame> data, const std::string& label_column) override;
+    TrainingStats fit(std::shared_ptr<DataFrame> data, const std::string& label_column) override;
 
     /**
      * @brief Function to make predictions using the GradientBoostedTrees
@@ -64,6 +166,102 @@ public:
      * 
      * This function makes predictions using the GradientBoostedTrees on the specified sample.
      * The function returns the prediction from the GradientBoostedTrees.
+     * 
+     * @throws std::runtime_error if the model has not been trained or the sample size does not match the number of features
      */
     double predict(const std::vector<double>& sample) const override;
+
+    /**
+     * @brief Function to select the algorithm predict uses to evaluate the trees
+     * @param engine InferenceEngine::Pointer to walk each tree from its root, InferenceEngine::QuickScorer to
+     *               evaluate all trees feature by feature with bitvectors, or InferenceEngine::Compact to walk
+     *               quantized 8-byte node records
+     * @throws std::invalid_argument if QuickScorer is selected and a tree has more than 64 leaves
+     * 
+     * Pointer and QuickScorer give the same predictions. Compact keeps the thresholds as exact 16-bit bin indices and
+     * the leaves as 8-bit ids into a table of leaf values when the trees have at most 256 distinct leaf values, which
+     * is exact too; otherwise the leaves are rounded to float32. The selected engine is built right away if the model
+     * has been trained, and rebuilt at the end of every later fit. QuickScorer uses AVX2 when the CPU supports it and
+     * falls back to scalar code otherwise.
+     * 
+     * @see QuickScorer
+     * @see CompactForest
+     */
+    void set_inference_engine(InferenceEngine engine);
+
+    /**
+     * @brief Function to get the algorithm predict uses to evaluate the trees
+     * @return The selected InferenceEngine
+     */
+    InferenceEngine get_inference_engine() const;
+
+    /**
+     * @brief Function to choose whether every boosting round grows an oblivious tree
+     * @param oblivious True to grow ObliviousTree learners, false (the default) to grow ID3 trees
+     * 
+     * Oblivious trees test one feature and threshold per depth, so every tree costs exactly max_depth comparisons per
+     * sample and predicts without data-dependent branches. With a max_depth of at most 6 every tree also fits the
+     * QuickScorer. The setting takes effect at the next fit.
+     * 
+     * @see ObliviousTree
+     */
+    void set_oblivious(bool oblivious);
+
+    /**
+     * @brief Function to check whether every boosting round grows an oblivious tree
+     * @return True if the rounds grow ObliviousTree learners
+     */
+    bool is_oblivious() const;
+
+    /**
+     * @brief Function to report the memory footprint of the GradientBoostedTrees
+     * @return Approximate number of bytes held by the model, its trees, and their feature indices
+     * 
+     * The footprint does not depend on the number of training rows: only the initial score, the trees, and the
+     * feature indices of each tree outlive fit.
+     * 
+     * @see DecisionTree::memory_usage()
+     */
+    size_t memory_usage() const override;
+
+    /**
+     * @brief Function to save the GradientBoostedTrees to a binary model file
+     * @param path Path of the model file
+     * @throws std::runtime_error if the model has not been trained or the file cannot be written
+     * 
+     * The file uses the layout described by ModelHeader: the header holds the initial score and the learning rate, the
+     * names section holds the feature names, and every tree section stores the tree's nodes together with the position
+     * of each of its features in the samples passed to predict.
+     * 
+     * @see load(const std::string& path)
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * @brief Function to load a GradientBoostedTrees from a binary model file
+     * @param path Path of the model file written by save()
+     * @return Pointer to the loaded GradientBoostedTrees
+     * @throws std::runtime_error if the file cannot be mapped or does not hold a valid GradientBoostedTrees
+     * 
+     * The file is memory mapped and every tree predicts from its mapped nodes in place.
+     */
+    static std::unique_ptr<GradientBoostedTrees> load(const std::string& path);
+
+    /**
+     * @brief Function to generate a C++ translation unit that evaluates the GradientBoostedTrees
+     * @param function_name Name of the generated entry point
+     * @return Source code of the translation unit
+     * @throws std::runtime_error if the model has not been trained
+     * 
+     * Every tree becomes a function of nested if/else statements with its thresholds baked in as literals (see
+     * DecisionTree::to_cpp), and the entry point extern "C" double function_name(const double* x) adds the scaled tree
+     * predictions to the initial score in the same order as predict. The sample array holds the features in the order
+     * predict expects.
+     * 
+     * @code
+     * std::ofstream("model.cpp") << gb.to_cpp();
+     * // c++ -O2 -shared -fPIC model.cpp -o model.so
+     * @endcode
+     */
+    std::string to_cpp(const std::string& function_name = "predict") const;
 };
\ No newline at end of file
@@ -0,0 +1,344 @@
+#ifndef IMPURITY_H
+#define IMPURITY_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <vector>
+
+#include "DataFrame.h"
+
+
+/**
+ * @enum SplitCriterion
+ * @brief Impurity measure that the split search of a tree minimizes
+ */
+enum class SplitCriterion {
+    Entropy, ///< Shannon entropy in bits; the split search maximizes the information gain (ID3)
+    Gini ///< Gini impurity, 1 - sum of the squared class probabilities
+};
+
+
+using ClassId = uint32_t; ///< Dense id of a class label; 32 bits since regression trees (boosting) see a class per value
+
+
+/**
+ * @class LabelEncoder
+ * @brief Dense class ids for a column of labels
+ *
+ * The distinct labels are numbered 0, 1, ... in the order of Cell, so that the smallest label has the smallest id and
+ * ties between classes resolve the way they do on a std::map<Cell, ...>. Trees encode their label column once per fit
+ * and then count classes in small arrays indexed by id instead of maps keyed by Cell. Numeric targets, such as the
+ * residuals of a boosting round, are encoded straight from their doubles, in the same order.
+ *
+ * @code
+ * LabelEncoder labels(df->get_column("label"));
+ * vector<uint32_t> counts(labels.num_classes(), 0);
+ * for (ClassId id : labels.get_ids()) counts[id]++;
+ * @endcode
+ */
+class LabelEncoder {
+    private:
+        std::vector<Cell> classes; ///< Label of every class id, in ascending order; empty for numeric labels
+        std::vector<double> values; ///< Label of every class id of numeric labels, in ascending order
+        std::vector<ClassId> ids; ///< Class id of every row
+
+    public:
+        /**
+         * @brief Constructor for an empty LabelEncoder
+         */
+        LabelEncoder() = default;
+
+        /**
+         * @brief Constructor for LabelEncoder, which encodes every label of a column
+         * @param labels Column of labels
+         */
+        explicit LabelEncoder(const Series& labels) {
+            std::map<Cell, ClassId> class_ids;
+            for (const Cell& label : labels) {
+                class_ids.emplace(label, 0);
+            }
+            for (auto& [label, id] : class_ids) {
+                id = static_cast<ClassId>(classes.size());
+                classes.push_back(label);
+            }
+            ids.reserve(labels.size());
+            for (const Cell& label : labels) {
+                ids.push_back(class_ids.at(label));
+            }
+        }
+
+        /**
+         * @brief Constructor for LabelEncoder, which encodes numeric labels without converting them to Cell
+         * @param labels Label of every row
+         */
+        explicit LabelEncoder(const std::vector<double>& labels) : values(labels) {
+            std::sort(values.begin(), values.end());
+            values.erase(std::unique(values.begin(), values.end()), values.end());
+            ids.reserve(labels.size());
+            for (double label : labels) {
+                ids.push_back(static_cast<ClassId>(std::lower_bound(values.begin(), values.end(), label) - values.begin()));
+            }
+        }
+
+        /**
+         * @brief Get the number of distinct labels
+         * @return Number of class ids
+         */
+        size_t num_classes() const {
+            return classes.empty() ? values.size() : classes.size();
+        }
+
+        /**
+         * @brief Get the class id of every row
+         * @return One id per label of the encoded column
+         */
+        const std::vector<ClassId>& get_ids() const {
+            return ids;
+        }
+
+        /**
+         * @brief Get the label of a class id
+         * @param id Class id
+         * @return Label that was encoded as id
+         */
+        Cell decode(ClassId id) const {
+            return classes.empty() ? Cell(values[id]) : classes[id];
+        }
+};
+
+
+/**
+ * @class ImpurityKernel
+ * @brief Impurity of class counts, with a table of n * log2(n) for the entropy of integer counts
+ *
+ * The kernels return the impurity of a node multiplied by its size (its number of rows, or total weight), which is
+ * what a split search adds up over the children; dividing the difference between a parent and its children by the
+ * parent's size gives the information gain. For integer counts the entropy needs no logarithm at all:
+ * n * H = n log2 n - sum of c log2 c over the class counts c, and both terms come from the table.
+ *
+ * Counts live in caller-owned arrays of num_classes entries, so evaluating a candidate split allocates nothing.
+ *
+ * @code
+ * ImpurityKernel kernel(SplitCriterion::Entropy, num_rows);
+ * double gain = (kernel.weighted_impurity(parent.data(), k) - kernel.weighted_impurity(left.data(), k)
+ *                - kernel.weighted_impurity(right.data(), k)) / num_rows;
+ * @endcode
+ */
+class ImpurityKernel {
+    private:
+        SplitCriterion criterion; ///< Impurity measure
+        std::vector<double> nlog2n; ///< n * log2(n) for n = 0 .. the largest count; 0 for n = 0
+
+    public:
+        /**
+         * @brief Constructor for ImpurityKernel
+         * @param criterion Impurity measure
+         * @param max_count Largest integer count the kernel will see, normally the number of rows of the data set
+         */
+        ImpurityKernel(SplitCriterion criterion, size_t max_count) : criterion(criterion), nlog2n(max_count + 1, 0.0) {
+            if (criterion == SplitCriterion::Entropy) {
+                for (size_t n = 2; n <= max_count; ++n) {
+                    nlog2n[n] = n * std::log2(static_cast<double>(n));
+                }
+            }
+        }
+
+        /**
+         * @brief Get the impurity measure
+         * @return Criterion the kernel computes
+         */
+        SplitCriterion get_criterion() const {
+            return criterion;
+        }
+
+        /**
+         * @brief Impurity of integer class counts times their total
+         * @param counts Rows of every class
+         * @param num_classes Number of entries of counts
+         * @return n * impurity, where n is the sum of the counts; 0 for no rows
+         */
+        double weighted_impurity(const uint32_t* counts, size_t num_classes) const {
+            uint32_t total = 0;
+            double sum = 0.0;
+            if (criterion == SplitCriterion::Entropy) {
+                for (size_t c = 0; c < num_classes; ++c) {
+                    total += counts[c];
+                    sum += nlog2n[counts[c]];
+                }
+                return nlog2n[total] - sum;
+            }
+            for (size_t c = 0; c < num_classes; ++c) {
+                total += counts[c];
+                sum += static_cast<double>(counts[c]) * counts[c];
+            }
+            return total == 0 ? 0.0 : total - sum / total;
+        }
+
+        /**
+         * @brief Impurity of class weights times their total
+         * @param weights Total weight of every class
+         * @param num_classes Number of entries of weights
+         * @return w * impurity, where w is the sum of the weights; classes of weight 0 or less are ignored
+         */
+        double weighted_impurity(const double* weights, size_t num_classes) const {
+            double total = 0.0;
+            double sum = 0.0;
+            for (size_t c = 0; c < num_classes; ++c) {
+                if (weights[c] > 0.0) {
+                    total += weights[c];
+                    sum += criterion == SplitCriterion::Entropy ? weights[c] * std::log2(weights[c]) : weights[c] * weights[c];
+                }
+            }
+            if (total <= 0.0) {
+                return 0.0;
+            }
+            return criterion == SplitCriterion::Entropy ? total * std::log2(total) - sum : total - sum / total;
+        }
+};
+
+
+/**
+ * @class ClassCounts
+ * @brief Rows (and total weight) of every class among a set of rows, in arrays indexed by class id
+ *
+ * The counts are kept dense for fast, allocation-free updates, together with the list of classes that occur, so that
+ * clearing the counts and evaluating a data set with many classes (the residuals a boosting round regresses on, where
+ * nearly every row is its own class) only touches the classes present. A set of rows with few classes is evaluated
+ * with the dense kernels.
+ *
+ * @code
+ * ClassCounts counts(labels.num_classes());
+ * for (size_t row : rows) counts.add(ids[row]);
+ * double impurity = counts.weighted_impurity(kernel, false);
+ * ClassId label = counts.majority(false);
+ * counts.clear();
+ * @endcode
+ */
+class ClassCounts {
+    private:
+        std::vector<uint32_t> counts; ///< Rows of every class
+        std::vector<double> weights; ///< Total weight of every class; only updated by add(id, weight)
+        std::vector<ClassId> present; ///< Classes with at least one row, in the order they first occurred
+        mutable std::vector<uint32_t> gathered_counts; ///< Counts of the present classes; scratch of weighted_impurity
+        mutable std::vector<double> gathered_weights; ///< Weights of the present classes; scratch of weighted_impurity
+        size_t num_rows; ///< Rows added since the last clear()
+        ClassId best; ///< Class whose count first reached the highest count
+        uint32_t best_count; ///< Count of best
+
+        static const size_t DENSE_CLASSES = 64; ///< Classes up to which the dense kernels are used
+
+    public:
+        /**
+         * @brief Constructor for ClassCounts, with every count 0
+         * @param num_classes Number of class ids
+         */
+        explicit ClassCounts(size_t num_classes) : counts(num_classes, 0), weights(num_classes, 0.0), num_rows(0),
+                                                    best(0), best_count(0) {
+            present.reserve(num_classes);
+            if (num_classes > DENSE_CLASSES) {
+                gathered_counts.reserve(num_classes);
+                gathered_weights.reserve(num_classes);
+            }
+        }
+
+        /**
+         * @brief Count a row
+         * @param id Class of the row
+         */
+        void add(ClassId id) {
+            if (counts[id]++ == 0) {
+                present.push_back(id);
+            }
+            if (counts[id] > best_count) {
+                best_count = counts[id];
+                best = id;
+            }
+            num_rows++;
+        }
+
+        /**
+         * @brief Count a weighted row
+         * @param id Class of the row
+         * @param weight Weight of the row
+         */
+        void add(ClassId id, double weight) {
+            add(id);
+            weights[id] += weight;
+        }
+
+        /**
+         * @brief Reset every count to 0, touching only the classes that occurred
+         */
+        void clear() {
+            for (ClassId id : present) {
+                counts[id] = 0;
+                weights[id] = 0.0;
+            }
+            present.clear();
+            num_rows = 0;
+            best_count = 0;
+        }
+
+        /**
+         * @brief Get the number of rows counted
+         * @return Rows added since the last clear()
+         */
+        size_t size() const {
+            return num_rows;
+        }
+
+        /**
+         * @brief Impurity of the counted rows times their number (or total weight)
+         * @param kernel Impurity measure
+         * @param weighted Whether to use the weights given to add() instead of the row counts
+         * @return Result of ImpurityKernel::weighted_impurity for the counts or weights
+         */
+        double weighted_impurity(const ImpurityKernel& kernel, bool weighted) const {
+            if (counts.size() <= DENSE_CLASSES) {
+                return weighted ? kernel.weighted_impurity(weights.data(), weights.size())
+                                : kernel.weighted_impurity(counts.data(), counts.size());
+            }
+            // Gather the classes that occur; the other classes do not change the impurity
+            if (weighted) {
+                gathered_weights.clear();
+                for (ClassId id : present) {
+                    gathered_weights.push_back(weights[id]);
+                }
+                return kernel.weighted_impurity(gathered_weights.data(), gathered_weights.size());
+            }
+            gathered_counts.clear();
+            for (ClassId id : present) {
+                gathered_counts.push_back(counts[id]);
+            }
+            return kernel.weighted_impurity(gathered_counts.data(), gathered_counts.size());
+        }
+
+        /**
+         * @brief Most common class of the counted rows
+         * @param weighted Whether the class with the greatest total weight wins instead of the most rows
+         * @return Class whose count first reached the highest count in the order the rows were added, like
+         *         Series::mode(); when weighted, the heaviest class, ties going to the smallest class id like
+         *         Series::mode(const Series&)
+         * @throws runtime_error if no rows were counted
+         */
+        ClassId majority(bool weighted) const {
+            if (present.empty()) {
+                throw std::runtime_error("Cannot compute the majority of no rows");
+            }
+            if (!weighted) {
+                return best;
+            }
+            ClassId heaviest = present[0];
+            for (ClassId id : present) {
+                if (weights[id] > weights[heaviest] || (weights[id] == weights[heaviest] && id < heaviest)) {
+                    heaviest = id;
+                }
+            }
+            return heaviest;
+        }
+};
+
+#endif // IMPURITY_H
@@ -0,0 +1,109 @@
+#include <chrono>
+#include <exception>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "MicroBatcher.h"
+
+
+MicroBatcher::MicroBatcher(BatchFunction predict, size_t num_columns, size_t max_rows, std::chrono::microseconds max_delay)
+    : predict(std::move(predict)), num_columns(num_columns), max_rows(max_rows), max_delay(max_delay),
+      pending_rows(0), num_batches(0), stopping(false) {
+    if (num_columns == 0 || max_rows == 0) {
+        throw std::invalid_argument("MicroBatcher needs at least one column and one row per batch");
+    }
+    worker = std::thread(&MicroBatcher::run, this);
+}
+
+MicroBatcher::~MicroBatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+}
+
+std::future<std::vector<double>> MicroBatcher::submit(std::vector<double> rows) {
+    if (rows.empty() || rows.size() % num_columns != 0) {
+        throw std::invalid_argument("Request buffer size is not a positive multiple of the number of columns");
+    }
+
+    Request request{std::move(rows), {}, std::chrono::steady_clock::now()};
+    std::future<std::vector<double>> result = request.result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending_rows += request.rows.size() / num_columns;
+        pending.push_back(std::move(request));
+    }
+    wake.notify_one();
+    return result;
+}
+
+size_t MicroBatcher::get_num_batches() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return num_batches;
+}
+
+void MicroBatcher::run() {
+    std::vector<Request> batch;
+    std::vector<double> samples;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this]() { return stopping || !pending.empty(); });
+            if (pending.empty()) {
+                return;
+            }
+
+            // Give other requests until the oldest one's deadline to fill the batch
+            auto deadline = pending.front().arrival + max_delay;
+            wake.wait_until(lock, deadline, [this]() { return stopping || pending_rows >= max_rows; });
+
+            // Take whole requests, oldest first; the first one is always taken, even if it alone exceeds max_rows
+            size_t batch_rows = 0;
+            while (!pending.empty()) {
+                size_t rows = pending.front().rows.size() / num_columns;
+                if (!batch.empty() && batch_rows + rows > max_rows) {
+                    break;
+                }
+                batch_rows += rows;
+                pending_rows -= rows;
+                batch.push_back(std::move(pending.front()));
+                pending.pop_front();
+            }
+            ++num_batches;
+        }
+
+        samples.clear();
+        for (const auto& request : batch) {
+            samples.insert(samples.end(), request.rows.begin(), request.rows.end());
+        }
+
+        std::vector<double> predictions;
+        std::exception_ptr error;
+        try {
+            predictions = predict(samples, num_columns);
+            if (predictions.size() != samples.size() / num_columns) {
+                throw std::runtime_error("Batched predict function returned the wrong number of predictions");
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        size_t offset = 0;
+        for (auto& request : batch) {
+            size_t rows = request.rows.size() / num_columns;
+            if (error) {
+                request.result.set_exception(error);
+            } else {
+                request.result.set_value(std::vector<double>(predictions.begin() + offset, predictions.begin() + offset + rows));
+            }
+            offset += rows;
+        }
+        batch.clear();
+    }
+}
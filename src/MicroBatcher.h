@@ -0,0 +1,105 @@
+#ifndef MICROBATCHER_H
+#define MICROBATCHER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+/**
+ * @class MicroBatcher
+ * @brief Coalesces concurrent prediction requests into batches for a batched predict function
+ *
+ * Every request is a block of rows. A worker thread waits until the pending requests hold max_rows rows or the oldest
+ * of them has waited max_delay, then concatenates whole requests into one sample buffer of at most max_rows rows (a
+ * larger request forms a batch of its own), calls the predict function once, and hands every request its slice of the
+ * predictions. The per-call overhead of the predict function, such as the pass over every tree of
+ * RandomForest::predict_batch, is then paid once per batch rather than once per request. RandomForest collects its
+ * flat trees once per fit or load, so a batch of one row, the common case under light load, costs about as much as
+ * RandomForest::predict.
+ *
+ * @code
+ * MicroBatcher batcher([&forest](const std::vector<double>& samples, size_t num_columns) {
+ *     return forest.predict_batch(samples, num_columns);
+ * }, num_columns, 256, std::chrono::microseconds(200));
+ * std::vector<double> predictions = batcher.submit(rows).get();
+ * @endcode
+ */
+class MicroBatcher {
+    public:
+        /// Function that predicts a buffer of rows; it must return one prediction per row
+        using BatchFunction = std::function<std::vector<double>(const std::vector<double>& samples, size_t num_columns)>;
+
+    private:
+        /// Rows of one request and the promise of their predictions
+        struct Request {
+            std::vector<double> rows;
+            std::promise<std::vector<double>> result;
+            std::chrono::steady_clock::time_point arrival;
+        };
+
+        BatchFunction predict; ///< Batched predict function
+        size_t num_columns; ///< Number of feature values per row
+        size_t max_rows; ///< Number of pending rows that starts a batch right away
+        std::chrono::microseconds max_delay; ///< Longest time a request waits for other requests to join its batch
+
+        std::deque<Request> pending; ///< Requests not yet in a batch, oldest first
+        size_t pending_rows; ///< Number of rows in pending
+        size_t num_batches; ///< Number of calls of the predict function so far
+        bool stopping; ///< Set by the destructor; the worker exits once pending is empty
+        mutable std::mutex mutex; ///< Protects pending, pending_rows, num_batches and stopping
+        std::condition_variable wake; ///< Signals new requests and stopping to the worker
+        std::thread worker; ///< Thread that forms and predicts the batches
+
+        /**
+         * @brief Helper method run by the worker thread
+         */
+        void run();
+
+    public:
+        /**
+         * @brief Constructor for MicroBatcher; starts the worker thread
+         * @param predict Batched predict function
+         * @param num_columns Number of feature values per row
+         * @param max_rows Number of rows that starts a batch without waiting
+         * @param max_delay Longest time a request waits for other requests to join its batch
+         * @throws std::invalid_argument if num_columns or max_rows is 0
+         */
+        MicroBatcher(BatchFunction predict, size_t num_columns, size_t max_rows, std::chrono::microseconds max_delay);
+
+        /**
+         * @brief Destructor; predicts the pending requests and stops the worker thread
+         */
+        ~MicroBatcher();
+
+        MicroBatcher(const MicroBatcher&) = delete;
+        MicroBatcher& operator=(const MicroBatcher&) = delete;
+
+        /**
+         * @brief Queue a request
+         * @param rows Feature values of the rows, one row of num_columns values after the other
+         * @return Future of the predictions of the rows, in order; it holds the exception if the predict function throws
+         * @throws std::invalid_argument if the buffer is empty or does not hold whole rows
+         */
+        std::future<std::vector<double>> submit(std::vector<double> rows);
+
+        /**
+         * @brief Get the number of feature values per row
+         * @return Number of columns of every request
+         */
+        size_t get_num_columns() const { return num_columns; }
+
+        /**
+         * @brief Get the number of batches predicted so far
+         * @return Number of calls of the predict function
+         */
+        size_t get_num_batches() const;
+};
+
+#endif // MICROBATCHER_H
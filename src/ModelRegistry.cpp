@@ -0,0 +1,88 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include "Classifier.h"
+#include "ModelRegistry.h"
+
+
+// Source of the registries' ids
+static std::atomic<uint64_t> next_registry_id(0);
+
+// A thread's reference to the model of one registry, and the version it was published as
+struct CachedModel {
+    uint64_t registry; ///< Id of the registry
+    std::weak_ptr<const uint64_t> lifetime; ///< Lifetime token of the registry; expired once it is destroyed
+    uint64_t version; ///< Version of the registry when model was read
+    std::shared_ptr<const Classifier> model; ///< Model of the registry at that version
+};
+
+// References of the calling thread, one per registry it has read
+static thread_local std::vector<CachedModel> cached_models;
+
+
+ModelRegistry::ModelRegistry()
+    : version(0), id(next_registry_id.fetch_add(1, std::memory_order_relaxed)), lifetime(std::make_shared<uint64_t>(id)) {}
+
+ModelRegistry::ModelRegistry(std::shared_ptr<const Classifier> model) : ModelRegistry() {
+    publish(std::move(model));
+}
+
+const std::shared_ptr<const Classifier>& ModelRegistry::cached_model() const {
+    uint64_t current = version.load(std::memory_order_acquire);
+    CachedModel* entry = nullptr;
+    for (size_t i = 0; i < cached_models.size();) {
+        if (cached_models[i].registry == id) {
+            entry = &cached_models[i];
+            ++i;
+        } else if (cached_models[i].lifetime.expired()) {
+            // Drop the reference kept for a destroyed registry
+            cached_models[i] = std::move(cached_models.back());
+            cached_models.pop_back();
+        } else {
+            ++i;
+        }
+    }
+    if (entry && entry->version == current) {
+        return entry->model;   // nothing was published since this thread last read the registry
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!entry) {
+        cached_models.push_back({id, lifetime, 0, nullptr});
+        entry = &cached_models.back();
+    }
+    entry->version = version.load(std::memory_order_relaxed);
+    entry->model = model;
+    return entry->model;
+}
+
+std::shared_ptr<const Classifier> ModelRegistry::acquire() const {
+    return cached_model();
+}
+
+std::shared_ptr<const Classifier> ModelRegistry::publish(std::shared_ptr<const Classifier> model) {
+    if (!model) {
+        throw std::invalid_argument("Cannot publish an empty model");
+    }
+    // The previous model is returned, so it is released by the caller rather than under the mutex
+    std::lock_guard<std::mutex> lock(mutex);
+    std::shared_ptr<const Classifier> previous = std::move(this->model);
+    this->model = std::move(model);
+    version.fetch_add(1, std::memory_order_release);
+    return previous;
+}
+
+double ModelRegistry::predict(const std::vector<double>& sample) const {
+    const std::shared_ptr<const Classifier>& current = cached_model();
+    if (!current) {
+        throw std::runtime_error("No model has been published");
+    }
+    return current->predict(sample);
+}
+
+uint64_t ModelRegistry::get_version() const {
+    return version.load(std::memory_order_relaxed);
+}
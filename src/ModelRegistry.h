@@ -0,0 +1,109 @@
+#ifndef MODELREGISTRY_H
+#define MODELREGISTRY_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Classifier.h"
+
+
+/**
+ * @class ModelRegistry
+ * @brief Holder of the model a service predicts with, which can be replaced while predictions are running
+ *
+ * Reads are lock-free in the style of RCU. Every thread caches a reference to the current model together with the
+ * version it was published as; a read loads the atomic version, and while it matches the cached one (every read
+ * between two publications) uses the cached reference without touching any shared state. Only the first read after a
+ * publication takes the mutex that publish() holds, to refresh the thread's reference. std::atomic_load on a
+ * shared_ptr is no alternative, since libstdc++ implements it with a pool of mutexes.
+ *
+ * A retrained model can be published at any time. Every request keeps the model it started with alive through its
+ * reference, so an old model is destroyed once the last request using it has finished and every thread that cached it
+ * has read the registry again (or exited); references cached for a destroyed registry are dropped at the thread's next
+ * read of any registry. The models must be safe to use from several threads through a const reference, as
+ * RandomForest, DecisionTree and GradientBoostedTrees are.
+ *
+ * @code
+ * ModelRegistry registry(RandomForest::load("forest.bin"));
+ *
+ * // Request threads
+ * double prediction = registry.predict(sample);
+ *
+ * // Training thread
+ * auto forest = std::make_shared<RandomForest>(100, 8, 2, 3);
+ * forest->fit(data, "label");
+ * registry.publish(std::move(forest));
+ * @endcode
+ */
+class ModelRegistry {
+    private:
+        std::shared_ptr<const Classifier> model; ///< Current model; guarded by mutex
+        std::atomic<uint64_t> version; ///< Number of models published so far; written under mutex
+        mutable std::mutex mutex; ///< Serializes publications and the refreshes of the threads' cached references
+        const uint64_t id; ///< Number that identifies the registry in the threads' caches; never reused
+        std::shared_ptr<const uint64_t> lifetime; ///< Expires with the registry, so the threads can drop its cached references
+
+        /**
+         * @brief Get the calling thread's reference to the current model
+         * @return Cached reference, refreshed under the mutex if a model was published since the thread last read it
+         */
+        const std::shared_ptr<const Classifier>& cached_model() const;
+
+    public:
+        /**
+         * @brief Constructor for an empty ModelRegistry
+         */
+        ModelRegistry();
+
+        /**
+         * @brief Constructor for ModelRegistry
+         * @param model Trained model to start with
+         * @throws std::invalid_argument if model is null
+         */
+        explicit ModelRegistry(std::shared_ptr<const Classifier> model);
+
+        ModelRegistry(const ModelRegistry&) = delete;
+        ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+        /**
+         * @brief Get the current model
+         * @return Reference to the current model, which stays valid as long as it is held; null if none was published
+         *
+         * Take the model once per request and use it for all predictions of that request, so they come from the same
+         * model even if another one is published in the meantime. No lock is taken unless a model was published since
+         * the calling thread last read the registry.
+         */
+        std::shared_ptr<const Classifier> acquire() const;
+
+        /**
+         * @brief Replace the current model
+         * @param model Trained model to predict with from now on
+         * @return The previous model, or null if there was none
+         * @throws std::invalid_argument if model is null
+         *
+         * Requests that already acquired the previous model finish with it; every later acquire() returns the new one.
+         */
+        std::shared_ptr<const Classifier> publish(std::shared_ptr<const Classifier> model);
+
+        /**
+         * @brief Make a prediction with the current model
+         * @param sample Vector of feature values for a single sample
+         * @return Prediction of the current model
+         * @throws std::runtime_error if no model was published
+         *
+         * Predicts through the calling thread's cached reference, so it neither locks nor changes a reference count
+         * unless a model was published since the thread last read the registry.
+         */
+        double predict(const std::vector<double>& sample) const;
+
+        /**
+         * @brief Get the number of models published so far
+         * @return Number of models passed to the constructor or to publish()
+         */
+        uint64_t get_version() const;
+};
+
+#endif // MODELREGISTRY_H
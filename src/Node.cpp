@@ -1,6 +1,11 @@
 #include <iostream>
+#include <new>
 #include <vector>
 #include <string>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 
 #include "Node.h"
 
@@ -9,11 +14,100 @@ using std::unique_ptr;
 using std::string;
 
 
+// --------------- NodeArena Class ---------------
+
+thread_local NodeArena* NodeArena::active_arena = nullptr;
+
+static const size_t ARENA_FIRST_BLOCK = 4096;
+static const size_t ARENA_MAX_BLOCK = 65536;
+
+NodeArena::NodeArena() : block_size(0), used(0), bytes_allocated(0) {}
+
+void* NodeArena::allocate(size_t size) {
+    const size_t align = alignof(std::max_align_t);
+    size = (size + align - 1) / align * align;
+    if (blocks.empty() || used + size > block_size) {
+        // Each block doubles the previous one up to ARENA_MAX_BLOCK, so small trees stay small
+        block_size = std::max(blocks.empty() ? ARENA_FIRST_BLOCK : std::min(2 * block_size, ARENA_MAX_BLOCK), size);
+        blocks.emplace_back(new char[block_size]);
+        bytes_allocated += block_size;
+        used = 0;
+    }
+    void* ptr = blocks.back().get() + used;
+    used += size;
+    return ptr;
+}
+
+size_t NodeArena::memory_usage() const {
+    return bytes_allocated;
+}
+
+size_t NodeArena::get_num_blocks() const {
+    return blocks.size();
+}
+
+NodeArena* NodeArena::active() {
+    return active_arena;
+}
+
+NodeArena::Scope::Scope(NodeArena& arena) : previous(active_arena) {
+    active_arena = &arena;
+}
+
+NodeArena::Scope::~Scope() {
+    active_arena = previous;
+}
+
+
 // --------------- Node Class ---------------
 
-Node::Node(): left(nullptr), right(nullptr) {}
+// Every node is preceded by a word that records whether it lives in an arena (1) or on the heap (0)
+static const size_t NODE_HEADER = sizeof(uintptr_t);
+static_assert(alignof(DecisionNode) <= NODE_HEADER && alignof(LeafNode) <= NODE_HEADER,
+              "nodes must be aligned by the header that precedes them");
+
+void* Node::operator new(size_t size) {
+    NodeArena* arena = NodeArena::active();
+    char* block = static_cast<char*>(arena ? arena->allocate(size + NODE_HEADER) : ::operator new(size + NODE_HEADER));
+    *reinterpret_cast<uintptr_t*>(block) = arena ? 1 : 0;
+    return block + NODE_HEADER;
+}
+
+void Node::operator delete(void* ptr) {
+    if (!ptr) {
+        return;
+    }
+    char* block = static_cast<char*>(ptr) - NODE_HEADER;
+    if (*reinterpret_cast<uintptr_t*>(block) == 0) {
+        ::operator delete(block);
+    }
+}
+
+
+Node::Node(): num_samples(0) {}
 Node::~Node() = default;
 
+void Node::set_num_samples(size_t count) {
+    num_samples = count;
+}
+
+size_t Node::get_num_samples() const {
+    return num_samples;
+}
+
+// Exact C++ literal for a double; hexadecimal floating point round-trips every value
+static std::string cpp_literal(double value) {
+    if (std::isnan(value)) {
+        return "__builtin_nan(\"\")";
+    }
+    if (std::isinf(value)) {
+        return value > 0 ? "__builtin_inf()" : "(-__builtin_inf())";
+    }
+    std::ostringstream oss;
+    oss << std::hexfloat << value;
+    return oss.str();
+}
+
 // Default implementation of predict method
 double Node::predict(const vector<double>& sample) const {
     return 0.0;
@@ -68,6 +162,15 @@ int LeafNode::get_height() {
     return 0;
 }
 
+size_t LeafNode::memory_usage() const {
+    return sizeof(*this);
+}
+
+// Code generation --- a leaf simply returns the value it predicts
+void LeafNode::to_cpp(std::ostringstream& oss, const vector<size_t>& /* features */, const std::string& indent) const {
+    oss << indent << "return " << cpp_literal(value) << ";\n";
+}
+
 // --------------- DecisionNode Class ---------------
 
 // Constructor
@@ -134,6 +237,30 @@ int DecisionNode::get_height() {
 }
 
 
+// Recursively calculate the memory held by the subtree rooted at this node
+size_t DecisionNode::memory_usage() const {
+    size_t bytes = sizeof(*this);
+    if (left) {
+        bytes += left->memory_usage();
+    }
+    if (right) {
+        bytes += right->memory_usage();
+    }
+    return bytes;
+}
+
+
+// Code generation; mirrors predict(): the left branch is taken when the feature value is less than or equal to the threshold
+void DecisionNode::to_cpp(std::ostringstream& oss, const vector<size_t>& features, const std::string& indent) const {
+    size_t index = features.empty() ? feature_index : features.at(feature_index);
+    oss << indent << "if (x[" << index << "] <= " << cpp_literal(threshold) << ") {\n";
+    left->to_cpp(oss, features, indent + "    ");
+    oss << indent << "} else {\n";
+    right->to_cpp(oss, features, indent + "    ");
+    oss << indent << "}\n";
+}
+
+
 // Setters
 void DecisionNode::set_feature_index(int idx) {
     feature_index = idx;
@@ -1,22 +1,116 @@
 #ifndef NODE_H
 #define NODE_H
 
+#include <cstddef>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
 using std::unique_ptr;
 using std::vector;
 
+/**
+ * @class NodeArena
+ * @brief Block allocator that holds the nodes of one tree
+ *
+ * While a NodeArena::Scope is active on a thread, every LeafNode and DecisionNode created on that thread is placed in
+ * the arena instead of getting its own heap allocation. The nodes are laid out one after another in creation order
+ * (the depth-first order of DecisionTree::fit), in blocks that grow from 4 KiB to 64 KiB, and all of them are freed
+ * together when the arena is destroyed.
+ *
+ * The nodes stay owned by their unique_ptr, so trees built in an arena look the same as any other tree; deleting an
+ * arena node runs its destructor and leaves the memory to the arena. Nodes created without an active scope (FlatTree,
+ * the tests) come from the heap as before. The arena must outlive every node placed in it.
+ *
+ * @code
+ * NodeArena arena;
+ * {
+ *     NodeArena::Scope scope(arena);
+ *     root = std::make_unique<LeafNode>(1.0);   // placed in arena
+ * }
+ * @endcode
+ *
+ * @see DecisionTree::fit()
+ */
+class NodeArena {
+    private:
+        vector<unique_ptr<char[]>> blocks; ///< Blocks of memory, in the order they were allocated
+        size_t block_size; ///< Size of the last block
+        size_t used; ///< Bytes of the last block handed out
+        size_t bytes_allocated; ///< Total size of all blocks
+
+        static thread_local NodeArena* active_arena; ///< Arena of the innermost Scope on this thread, or nullptr
+
+    public:
+        /**
+         * @class Scope
+         * @brief Places the nodes created on the calling thread in an arena for as long as it is alive
+         *
+         * Scopes nest; destroying one restores the arena that was active before it.
+         */
+        class Scope {
+            private:
+                NodeArena* previous; ///< Arena that was active when the scope was created
+            public:
+                /**
+                 * @brief Constructor for Scope, which makes an arena the active one of the calling thread
+                 * @param arena Arena that receives the nodes
+                 */
+                explicit Scope(NodeArena& arena);
+                ~Scope();
+                Scope(const Scope&) = delete;
+                Scope& operator=(const Scope&) = delete;
+        };
+
+        /**
+         * @brief Constructor for NodeArena; no memory is allocated until the first node
+         */
+        NodeArena();
+        NodeArena(const NodeArena&) = delete;
+        NodeArena& operator=(const NodeArena&) = delete;
+
+        /**
+         * @brief Allocate memory for a node
+         * @param size Number of bytes, rounded up to a multiple of the alignment of std::max_align_t
+         * @return Pointer to the memory, which directly follows the previous allocation unless a new block was needed
+         */
+        void* allocate(size_t size);
+
+        /**
+         * @brief Get the memory held by the arena
+         * @return Total size of all blocks in bytes
+         */
+        size_t memory_usage() const;
+
+        /**
+         * @brief Get the number of blocks allocated so far
+         * @return Number of blocks
+         */
+        size_t get_num_blocks() const;
+
+        /**
+         * @brief Get the arena of the innermost active Scope on the calling thread
+         * @return Active arena, or nullptr if nodes come from the heap
+         */
+        static NodeArena* active();
+};
+
 /**
  * @class Node
  * @brief A class that represents a node in a decision tree
  * 
  * This class represents a node in a decision tree. The node can be either a decision node or a leaf node. 
  * A decision node contains a decision rule based on an attribute and a value, and pointers to its left and right
- * child nodes. A leaf node contains a predicted value for the target variable. The node class is an abstract class
+ * child nodes, which only DecisionNode declares so that leaves do not carry them. A leaf node contains a predicted
+ * value for the target variable. The node class is an abstract class
  * that is inherited by the DecisionNode and LeafNode classes.
  */
 class Node {
+    protected:
+        size_t num_samples; ///< Number of training samples that reached the node; 0 if unknown
+
     public:
-        unique_ptr<Node> left; ///< Pointer to the left child node
-        unique_ptr<Node> right; ///< Pointer to the right child node
         /**
          * @brief Constructor for the Node class
          */
@@ -25,6 +119,19 @@ class Node {
          * @brief Destructor for the Node class
          */
         virtual  ~Node();
+
+        /**
+         * @brief Allocate a node, from the active NodeArena if there is one and from the heap otherwise
+         * @param size Size of the node object
+         * @return Memory for the node
+         * @see NodeArena
+         */
+        static void* operator new(size_t size);
+        /**
+         * @brief Free a node; memory that belongs to a NodeArena is left for the arena to free
+         * @param ptr Memory returned by operator new
+         */
+        static void operator delete(void* ptr);
         /**
          * @brief Predict method
          * @param sample Vector of feature values for a single sample
@@ -81,6 +188,48 @@ class Node {
          * @see LeafNode::get_height()
          */
         virtual int get_height() = 0;
+
+        /**
+         * @brief Get the memory footprint of the subtree rooted at this node
+         * @return Number of bytes held by this node and all of its descendants
+         * 
+         * This function returns the size of the node object plus, for decision nodes, the memory of the left and right
+         * subtrees. It is called by the memory_usage() method of the DecisionTree class.
+         * 
+         * @see DecisionTree::memory_usage()
+         */
+        virtual size_t memory_usage() const = 0;
+
+        /**
+         * @brief Emit C++ source code that evaluates the subtree rooted at this node
+         * @param oss Output string stream the code is appended to
+         * @param features Position in the sample array x of every feature index used by the tree; empty to use the
+         *                 feature indices directly
+         * @param indent Indentation of the emitted statements
+         * 
+         * This function generates the statements that predict() would execute, with the thresholds and predicted values
+         * baked in as exact (hexadecimal floating point) literals. The generated code reads the features from an array
+         * named x and returns the predicted value. The function is implemented in the derived classes LeafNode and
+         * DecisionNode, and is called by the to_cpp() method of the DecisionTree class.
+         * 
+         * @see DecisionTree::to_cpp()
+         */
+        virtual void to_cpp(std::ostringstream& oss, const vector<size_t>& features, const std::string& indent) const = 0;
+
+        /**
+         * @brief Set the number of training samples that reached the node
+         * @param count Number of samples; recorded by DecisionTree::fit for every node it creates
+         */
+        void set_num_samples(size_t count);
+
+        /**
+         * @brief Get the number of training samples that reached the node
+         * @return Number of samples, or 0 if the node was not created by DecisionTree::fit
+         * 
+         * The counts tell how often each branch is taken, which FlatTree uses to place frequently visited nodes together
+         * (see NodeLayout::HotPath).
+         */
+        size_t get_num_samples() const;
 };
 
 /**
@@ -173,6 +322,22 @@ class LeafNode : public Node {
          * @see DecisionNode::get_height()
          */
         int get_height() override;
+
+        /**
+         * @brief Get the memory footprint of the leaf node
+         * @return Size of the leaf node object in bytes
+         */
+        size_t memory_usage() const override;
+
+        /**
+         * @brief Emit C++ source code for the leaf node
+         * @param oss Output string stream the code is appended to
+         * @param features Unused, since a leaf does not read any feature
+         * @param indent Indentation of the emitted statement
+         * 
+         * The leaf emits a single return statement with its value, e.g. "return 0x1p+0;".
+         */
+        void to_cpp(std::ostringstream& oss, const vector<size_t>& features, const std::string& indent) const override;
         
 };
 
@@ -292,6 +457,24 @@ class DecisionNode : public Node{
          * @see LeafNode::get_height()
          */
         int get_height() override;
+
+        /**
+         * @brief Get the memory footprint of the subtree rooted at this node
+         * @return Size of this node object plus the memory of its left and right subtrees
+         */
+        size_t memory_usage() const override;
+
+        /**
+         * @brief Emit C++ source code for the subtree rooted at this node
+         * @param oss Output string stream the code is appended to
+         * @param features Position in the sample array x of every feature index used by the tree; empty to use the
+         *                 feature indices directly
+         * @param indent Indentation of the emitted statements
+         * 
+         * The decision rule of predict() becomes an if/else statement that compares x[feature] with the threshold
+         * using <=, with the code of the left and right subtrees as its branches.
+         */
+        void to_cpp(std::ostringstream& oss, const vector<size_t>& features, const std::string& indent) const override;
 };
 
 #endif // NODE_H
\ No newline at end of file
@@ -0,0 +1,287 @@
+#include <vector>
+#include <memory>
+#include <string>
+#include <set>
+#include <cmath>
+#include <random>
+#include <numeric>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+#include <chrono>
+
+#include "Node.h"
+#include "DataFrame.h"
+#include "Impurity.h"
+#include "ObliviousTree.h"
+
+// The leaf table has 2^max_depth entries
+static const int MAX_OBLIVIOUS_DEPTH = 24;
+
+
+// Most common label of the given rows, with the same tie-breaking as DecisionTree
+static double majority_label(const LabelEncoder& labels, const vector<double>& weights, const vector<size_t>& rows,
+                             bool weighted, ClassCounts& counts) {
+    const ClassId* ids = labels.get_ids().data();
+    for (size_t row : rows) {
+        counts.add(ids[row], weights[row]);
+    }
+    ClassId label = counts.majority(weighted);
+    counts.clear();
+    return DataFrame::double_cast(labels.decode(label));
+}
+
+// Median of the given values, like Series::median but without copying them into a Series; NaN values are skipped,
+// since they go right of every threshold. Returns false if no value is left. Reorders values.
+static bool median(vector<double>& values, double& result) {
+    values.erase(std::remove_if(values.begin(), values.end(), [](double value) { return std::isnan(value); }), values.end());
+    if (values.empty()) {
+        return false;
+    }
+    size_t n = values.size();
+    auto middle = values.begin() + n / 2;
+    std::nth_element(values.begin(), middle, values.end());
+    result = n % 2 == 0 ? (*std::max_element(values.begin(), middle) + *middle) / 2.0 : *middle;
+    return true;
+}
+
+// Builds the complete subtree of the given level whose leaves are first_leaf, first_leaf + 1, ...
+static unique_ptr<Node> expand(const vector<int32_t>& features, const vector<double>& thresholds, const vector<double>& leaf_values,
+                               const vector<size_t>& leaf_samples, size_t level, size_t first_leaf) {
+    size_t depth = features.size();
+    size_t num_leaves = size_t(1) << (depth - level);
+    size_t num_samples = std::accumulate(leaf_samples.begin() + first_leaf, leaf_samples.begin() + first_leaf + num_leaves, size_t(0));
+
+    unique_ptr<Node> node;
+    if (level == depth) {
+        node = std::make_unique<LeafNode>(leaf_values[first_leaf]);
+    } else {
+        node = std::make_unique<DecisionNode>(features[level], thresholds[level],
+                                              expand(features, thresholds, leaf_values, leaf_samples, level + 1, first_leaf),
+                                              expand(features, thresholds, leaf_values, leaf_samples, level + 1, first_leaf + num_leaves / 2));
+    }
+    node->set_num_samples(num_samples);
+    return node;
+}
+
+
+// Constructors
+ObliviousTree::ObliviousTree(int max_depth, int min_samples_split) : ObliviousTree(max_depth, min_samples_split, 1.0, 0) {}
+
+ObliviousTree::ObliviousTree(int max_depth, int min_samples_split, double colsample_bylevel, size_t random_state)
+    : max_depth(max_depth), min_samples_split(min_samples_split), colsample_bylevel(colsample_bylevel), random_state(random_state) {
+    if (colsample_bylevel <= 0.0 || colsample_bylevel > 1.0) {
+        throw std::invalid_argument("colsample_bylevel must be in the interval (0, 1]");
+    }
+    if (max_depth > MAX_OBLIVIOUS_DEPTH) {
+        throw std::invalid_argument("Oblivious trees support a maximum depth of at most " + std::to_string(MAX_OBLIVIOUS_DEPTH));
+    }
+}
+
+// Predict method; every level contributes one bit of the leaf index
+double ObliviousTree::predict(const vector<double>& sample) const {
+    if (leaf_values.empty()) {
+        throw std::runtime_error("Oblivious tree is not trained.");
+    }
+
+    size_t index = 0;
+    for (size_t level = 0; level < level_features.size(); ++level) {
+        size_t feature = static_cast<size_t>(level_features[level]);
+        if (feature >= sample.size()) {
+            throw std::invalid_argument("Sample has fewer values than the features used by the tree");
+        }
+        index = (index << 1) | static_cast<size_t>(!(sample[feature] <= level_thresholds[level]));
+    }
+    return leaf_values[index];
+}
+
+vector<double> ObliviousTree::predict_batch(const vector<double>& samples, size_t num_columns) const {
+    if (leaf_values.empty()) {
+        throw std::runtime_error("Oblivious tree is not trained.");
+    }
+    if (num_columns == 0 || samples.size() % num_columns != 0) {
+        throw std::invalid_argument("Sample buffer size is not a multiple of the number of columns");
+    }
+    for (int32_t feature : level_features) {
+        if (static_cast<size_t>(feature) >= num_columns) {
+            throw std::invalid_argument("Samples have fewer columns than the features used by the tree");
+        }
+    }
+
+    // One level for all rows at a time; the comparison result is the next bit of every row's leaf index
+    size_t num_rows = samples.size() / num_columns;
+    vector<uint32_t> indices(num_rows, 0);
+    for (size_t level = 0; level < level_features.size(); ++level) {
+        const double* column = samples.data() + level_features[level];
+        double threshold = level_thresholds[level];
+        for (size_t r = 0; r < num_rows; ++r) {
+            indices[r] = (indices[r] << 1) | static_cast<uint32_t>(!(column[r * num_columns] <= threshold));
+        }
+    }
+
+    vector<double> predictions(num_rows);
+    for (size_t r = 0; r < num_rows; ++r) {
+        predictions[r] = leaf_values[indices[r]];
+    }
+    return predictions;
+}
+
+// Fit method: Entry point for training the tree
+TrainingStats ObliviousTree::fit(std::shared_ptr<DataFrame> df, const string& label_column) {
+    return fit(df, label_column, "");
+}
+
+// Fit method on weighted samples; grows the tree one level at a time
+TrainingStats ObliviousTree::fit(std::shared_ptr<DataFrame> df, const string& label_column, const string& weight_column) {
+    auto fit_start = std::chrono::steady_clock::now();
+    TrainingStats stats;
+    if (!weight_column.empty() && std::find(df->columns.begin(), df->columns.end(), weight_column) == df->columns.end()) {
+        throw std::invalid_argument("Weight column not found");
+    }
+
+    size_t num_rows = df->get_num_rows();
+    if (num_rows == 0) {
+        throw std::runtime_error("Cannot fit an oblivious tree on an empty DataFrame");
+    }
+
+    // Column-wise feature values, with the column index every feature has in the samples
+    vector<int32_t> feature_columns;
+    vector<vector<double>> feature_values;
+    for (const auto& col : df->columns) {
+        if (col != label_column && col != weight_column) {
+            feature_columns.push_back(static_cast<int32_t>(df->get_column_index(col)));
+            feature_values.push_back(df->get_column(col).convert_to_numeric());
+        }
+    }
+
+    // Labels as dense class ids, counted in arrays of one entry per class
+    LabelEncoder labels(df->get_column(label_column));
+    const ClassId* ids = labels.get_ids().data();
+    bool weighted = !weight_column.empty();
+    vector<double> weights = weighted ? df->get_column(weight_column).convert_to_numeric() : vector<double>(num_rows, 1.0);
+    ImpurityKernel kernel(SplitCriterion::Entropy, num_rows);
+    ClassCounts left(labels.num_classes());
+    ClassCounts right(labels.num_classes());
+
+    // Every level draws its candidate features with the same generator sequence as DecisionTree
+    std::mt19937 generator(random_state);
+    size_t num_level_features = std::max<size_t>(1, static_cast<size_t>(std::round(colsample_bylevel * feature_columns.size())));
+
+    level_features.clear();
+    level_thresholds.clear();
+    vector<uint32_t> leaf_of_row(num_rows, 0);
+    vector<vector<size_t>> leaf_rows = {vector<size_t>(num_rows)};
+    std::iota(leaf_rows[0].begin(), leaf_rows[0].end(), 0);
+    vector<double> values = {majority_label(labels, weights, leaf_rows[0], weighted, left)};
+
+    for (int level = 0; level < max_depth; ++level) {
+        vector<size_t> candidates(feature_columns.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+        if (colsample_bylevel < 1.0) {
+            std::shuffle(candidates.begin(), candidates.end(), generator);
+            candidates.resize(std::min(num_level_features, candidates.size()));
+            std::sort(candidates.begin(), candidates.end());   // keep the column order for deterministic tie-breaking
+        }
+
+        // Every leaf that is large enough proposes the median of each candidate feature
+        auto search_start = std::chrono::steady_clock::now();
+        double best_score = std::numeric_limits<double>::infinity();
+        size_t best_feature = 0;
+        double best_threshold = 0.0;
+        vector<double> leaf_feature_values;   // reused for every leaf's median
+        for (size_t f : candidates) {
+            std::set<double> thresholds;
+            for (const auto& rows : leaf_rows) {
+                if (!rows.empty() && rows.size() >= static_cast<size_t>(min_samples_split)) {
+                    leaf_feature_values.clear();
+                    for (size_t row : rows) {
+                        leaf_feature_values.push_back(feature_values[f][row]);
+                    }
+                    double threshold = 0.0;
+                    if (median(leaf_feature_values, threshold)) {
+                        thresholds.insert(threshold);
+                    }
+                }
+            }
+
+            stats.candidate_thresholds += thresholds.size();
+            stats.rows_scanned += num_rows * (thresholds.size() + 1);   // the medians, then one pass per threshold
+            for (double threshold : thresholds) {
+                double score = 0.0;
+                bool separates = false;
+                for (const auto& rows : leaf_rows) {
+                    for (size_t row : rows) {
+                        (feature_values[f][row] <= threshold ? left : right).add(ids[row], weights[row]);
+                    }
+                    score += left.weighted_impurity(kernel, weighted) + right.weighted_impurity(kernel, weighted);
+                    separates = separates || (left.size() > 0 && right.size() > 0);
+                    left.clear();
+                    right.clear();
+                }
+                if (separates && score < best_score) {
+                    best_score = score;
+                    best_feature = f;
+                    best_threshold = threshold;
+                }
+            }
+        }
+
+        stats.split_search_seconds += TrainingStats::seconds_since(search_start);
+
+        // Stop once no threshold splits any leaf
+        if (best_score == std::numeric_limits<double>::infinity()) {
+            break;
+        }
+
+        level_features.push_back(feature_columns[best_feature]);
+        level_thresholds.push_back(best_threshold);
+
+        auto partition_start = std::chrono::steady_clock::now();
+        vector<vector<size_t>> next_rows(leaf_rows.size() * 2);
+        for (size_t row = 0; row < num_rows; ++row) {
+            leaf_of_row[row] = (leaf_of_row[row] << 1) | static_cast<uint32_t>(!(feature_values[best_feature][row] <= best_threshold));
+            next_rows[leaf_of_row[row]].push_back(row);
+        }
+        stats.bytes_allocated += num_rows * sizeof(size_t) + next_rows.size() * sizeof(vector<size_t>);
+        stats.partition_seconds += TrainingStats::seconds_since(partition_start);
+
+        // An empty leaf predicts like its parent
+        auto leaf_start = std::chrono::steady_clock::now();
+        vector<double> next_values(next_rows.size());
+        for (size_t leaf = 0; leaf < next_rows.size(); ++leaf) {
+            next_values[leaf] = next_rows[leaf].empty() ? values[leaf / 2] : majority_label(labels, weights, next_rows[leaf], weighted, left);
+        }
+        leaf_rows = std::move(next_rows);
+        values = std::move(next_values);
+        stats.leaf_seconds += TrainingStats::seconds_since(leaf_start);
+    }
+
+    leaf_values = std::move(values);
+    leaf_samples.clear();
+    for (const auto& rows : leaf_rows) {
+        leaf_samples.push_back(rows.size());
+    }
+
+    stats.num_trees = 1;
+    stats.depth = level_features.size();
+    stats.leaves = leaf_values.size();
+    stats.nodes = 2 * leaf_values.size() - 1;
+    stats.fit_seconds = TrainingStats::seconds_since(fit_start);
+    return stats;
+}
+
+unique_ptr<Node> ObliviousTree::to_node_tree() const {
+    if (leaf_values.empty()) {
+        throw std::runtime_error("Oblivious tree is not trained.");
+    }
+    return expand(level_features, level_thresholds, leaf_values, leaf_samples, 0, 0);
+}
+
+int ObliviousTree::get_depth() const {
+    return static_cast<int>(level_features.size());
+}
+
+size_t ObliviousTree::memory_usage() const {
+    return sizeof(*this) + level_features.capacity() * sizeof(int32_t) + level_thresholds.capacity() * sizeof(double)
+           + leaf_values.capacity() * sizeof(double) + leaf_samples.capacity() * sizeof(size_t);
+}
@@ -0,0 +1,132 @@
+#ifndef OBLIVIOUSTREE_H
+#define OBLIVIOUSTREE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Node.h"
+#include "DataFrame.h"
+#include "Classifier.h"
+
+using std::string;
+using std::vector;
+using std::unique_ptr;
+
+
+/**
+ * @class ObliviousTree
+ * @brief A decision tree in which all nodes of a depth share the same decision rule
+ *
+ * An oblivious (symmetric) tree of depth d is described by d (feature, threshold) pairs, one per level, and a table of
+ * 2^d leaf values. Predicting a sample takes exactly d comparisons: the outcome of level k becomes bit d - 1 - k of the
+ * leaf index, so there are no data-dependent branches and the cost is the same for every sample. The batch predict
+ * evaluates one level for all rows at a time, which the compiler can vectorize.
+ *
+ * The tree is grown level by level. At each level, every leaf with at least min_samples_split rows proposes the median
+ * of each candidate feature over its rows as a threshold, and the (feature, threshold) pair with the lowest entropy of
+ * the labels summed over all resulting leaves is applied to the whole level. Growth stops early once no split separates
+ * any leaf. A leaf predicts the most common label of its training rows, or the value of its parent if no row reached it.
+ *
+ * Like DecisionNode::predict, a sample goes right when its feature value is not <= the threshold, so NaN goes right.
+ */
+class ObliviousTree : public Classifier {
+    private:
+        int max_depth; ///< Maximum number of levels of the tree
+        int min_samples_split; ///< Minimum number of samples a leaf needs to propose a threshold
+        double colsample_bylevel; ///< Fraction of the features considered at each level of the tree
+        size_t random_state; ///< Random seed used to sample the features of each level
+        vector<int32_t> level_features; ///< Column index tested at every level
+        vector<double> level_thresholds; ///< Threshold tested at every level
+        vector<double> leaf_values; ///< Predicted value of every leaf, indexed by the bits of the level outcomes
+        vector<size_t> leaf_samples; ///< Number of training samples that reached every leaf
+
+    public:
+        /**
+         * @brief Constructor for ObliviousTree
+         * @param max_depth Maximum number of levels of the tree
+         * @param min_samples_split Minimum number of samples a leaf needs to propose a threshold
+         * @throws std::invalid_argument if max_depth is larger than 24, since the leaf table has 2^max_depth entries
+         */
+        ObliviousTree(int max_depth, int min_samples_split);
+
+        /**
+         * @brief Constructor for ObliviousTree with per-level feature sampling
+         * @param max_depth Maximum number of levels of the tree
+         * @param min_samples_split Minimum number of samples a leaf needs to propose a threshold
+         * @param colsample_bylevel Fraction of the features, as a decimal in (0, 1], considered at each level
+         * @param random_state Random seed used to sample the features of each level
+         * @throws std::invalid_argument if colsample_bylevel is not in (0, 1] or max_depth is larger than 24
+         */
+        ObliviousTree(int max_depth, int min_samples_split, double colsample_bylevel, size_t random_state);
+
+        /**
+         * @brief Predict method
+         * @param sample Vector of feature values for a single sample, indexed like the columns of the training data
+         * @return Predicted value of the leaf the sample falls into
+         * @throws std::runtime_error if the tree is not trained
+         * @throws std::invalid_argument if the sample has fewer values than the features used by the tree
+         */
+        double predict(const vector<double>& sample) const override;
+
+        /**
+         * @brief Predict method for a batch of samples
+         * @param samples Feature values of the samples, one row of num_columns values after the other
+         * @param num_columns Number of feature values per sample
+         * @return Predicted value for every sample, in order
+         * @throws std::runtime_error if the tree is not trained
+         * @throws std::invalid_argument if the buffer does not hold whole rows, or the rows are too short for the tree
+         *
+         * The leaf indices of all rows are built one level at a time, so the inner loop is a branch-free comparison
+         * over the rows. The predictions are the same as calling predict() on every row.
+         */
+        vector<double> predict_batch(const vector<double>& samples, size_t num_columns) const;
+
+        /**
+         * @brief Fit method
+         * @param df DataFrame holding the training data
+         * @param label_column Name of the column holding the labels
+         * @return Statistics of the tree grown
+         */
+        TrainingStats fit(std::shared_ptr<DataFrame> df, const string& label_column) override;
+
+        /**
+         * @brief Fit method on weighted samples
+         * @param df DataFrame holding the training data
+         * @param label_column Name of the column holding the labels
+         * @param weight_column Name of the column holding the sample weights; empty if every row has weight 1
+         * @return Statistics of the tree grown, counting the complete binary tree that to_node_tree() expands it into
+         * @throws std::invalid_argument if the weight column is not in the DataFrame
+         *
+         * The weights scale the label counts of the entropy and of the majority vote in every leaf. The weight column
+         * is not used as a feature.
+         */
+        TrainingStats fit(std::shared_ptr<DataFrame> df, const string& label_column, const string& weight_column);
+
+        /**
+         * @brief Expand the tree into linked nodes
+         * @return Root of an equivalent tree of DecisionNode and LeafNode objects, with the sample counts of fit
+         * @throws std::runtime_error if the tree is not trained
+         *
+         * The result is a complete binary tree whose depth-k nodes all test the rule of level k. It lets an oblivious
+         * tree be flattened, saved, scored with QuickScorer, and turned into C++ code like any other tree.
+         *
+         * @see DecisionTree::set_oblivious()
+         */
+        unique_ptr<Node> to_node_tree() const;
+
+        /**
+         * @brief Get the number of levels of the trained tree
+         * @return Number of levels, which can be smaller than max_depth if growth stopped early
+         */
+        int get_depth() const;
+
+        /**
+         * @brief Get the memory footprint of the tree
+         * @return Size of the object plus its level and leaf tables
+         */
+        size_t memory_usage() const override;
+};
+
+#endif // OBLIVIOUSTREE_H
@@ -0,0 +1,160 @@
+#include <vector>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define QUICKSCORER_X86 1
+#endif
+
+#include "FlatTree.h"
+#include "QuickScorer.h"
+
+
+// Number of leading thresholds (sorted ascending) that are strictly below x
+static size_t count_below_scalar(const double* thresholds, size_t n, double x) {
+    size_t i = 0;
+    while (i < n && thresholds[i] < x) {
+        ++i;
+    }
+    return i;
+}
+
+#ifdef QUICKSCORER_X86
+// AVX2 version of count_below_scalar; compares four thresholds at a time and stops at the first one that is not below x
+__attribute__((target("avx2")))
+static size_t count_below_avx2(const double* thresholds, size_t n, double x) {
+    const __m256d value = _mm256_set1_pd(x);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256d block = _mm256_loadu_pd(thresholds + i);
+        int below = _mm256_movemask_pd(_mm256_cmp_pd(block, value, _CMP_LT_OQ));
+        if (below != 0xF) {
+            return i + __builtin_ctz(~below & 0xF);
+        }
+    }
+    return i + count_below_scalar(thresholds + i, n - i, x);
+}
+#endif
+
+// Bitvector with the bits first_leaf, ..., first_leaf + num_leaves - 1 set
+static uint64_t leaf_range(uint32_t first_leaf, uint32_t num_leaves) {
+    uint64_t bits = num_leaves >= 64 ? ~uint64_t(0) : (uint64_t(1) << num_leaves) - 1;
+    return bits << first_leaf;
+}
+
+
+QuickScorer::QuickScorer(const std::vector<FlatTree>& trees, const std::vector<std::vector<size_t>>& features, size_t num_features,
+                         bool use_simd)
+    : num_trees(trees.size()), num_features(num_features), avx2(false) {
+    if (features.size() != trees.size()) {
+        throw std::invalid_argument("QuickScorer needs one feature mapping per tree");
+    }
+
+    // Decision nodes of every feature as (threshold, node) pairs, with the tree and mask of every node alongside
+    std::vector<std::vector<std::pair<double, size_t>>> feature_nodes(num_features);
+    std::vector<uint32_t> trees_of_nodes;
+    std::vector<uint64_t> masks_of_nodes;
+
+    for (size_t t = 0; t < trees.size(); ++t) {
+        if (trees[t].empty()) {
+            throw std::invalid_argument("QuickScorer cannot evaluate an empty tree");
+        }
+        leaf_offsets.push_back(leaf_values.size());
+        uint32_t num_leaves = add_subtree(trees[t], 0, static_cast<uint32_t>(t), 0, features[t], feature_nodes, trees_of_nodes, masks_of_nodes);
+        initial_leaves.push_back(leaf_range(0, num_leaves));
+    }
+
+    // Lay out the nodes feature by feature in increasing threshold order
+    feature_offsets.push_back(0);
+    for (auto& nodes : feature_nodes) {
+        std::sort(nodes.begin(), nodes.end());
+        for (const auto& [threshold, node] : nodes) {
+            thresholds.push_back(threshold);
+            node_trees.push_back(trees_of_nodes[node]);
+            node_masks.push_back(masks_of_nodes[node]);
+        }
+        feature_offsets.push_back(thresholds.size());
+    }
+
+#ifdef QUICKSCORER_X86
+    avx2 = use_simd && __builtin_cpu_supports("avx2");
+#endif
+}
+
+// Number the leaves of the subtree from left to right; a decision node masks out the leaves of its left subtree
+uint32_t QuickScorer::add_subtree(const FlatTree& tree, uint32_t index, uint32_t tree_id, uint32_t first_leaf,
+                                  const std::vector<size_t>& features, std::vector<std::vector<std::pair<double, size_t>>>& feature_nodes,
+                                  std::vector<uint32_t>& trees_of_nodes, std::vector<uint64_t>& masks_of_nodes) {
+    const FlatNode& node = tree.data()[index];
+    if (node.feature < 0) {
+        if (first_leaf >= 64) {
+            throw std::invalid_argument("QuickScorer supports at most 64 leaves per tree; tree " + std::to_string(tree_id) + " has more");
+        }
+        leaf_values.push_back(node.value);
+        return 1;
+    }
+
+    size_t position = node.feature;
+    if (!features.empty()) {
+        if (position >= features.size()) {
+            throw std::invalid_argument("Tree " + std::to_string(tree_id) + " uses a feature without a sample position");
+        }
+        position = features[position];
+    }
+    if (position >= num_features) {
+        throw std::invalid_argument("Tree " + std::to_string(tree_id) + " uses a feature outside of the sample");
+    }
+
+    uint32_t left_leaves = add_subtree(tree, node.left, tree_id, first_leaf, features, feature_nodes, trees_of_nodes, masks_of_nodes);
+    feature_nodes[position].emplace_back(node.value, trees_of_nodes.size());
+    trees_of_nodes.push_back(tree_id);
+    masks_of_nodes.push_back(~leaf_range(first_leaf, left_leaves));
+
+    uint32_t right_leaves = add_subtree(tree, node.right, tree_id, first_leaf + left_leaves, features, feature_nodes, trees_of_nodes, masks_of_nodes);
+    return left_leaves + right_leaves;
+}
+
+void QuickScorer::score(const double* sample, double* tree_values) const {
+    // The leaf bitvectors live in per-thread scratch, so scoring allocates nothing once a thread has seen this many trees
+    static thread_local std::vector<uint64_t> leaves;
+    leaves.assign(initial_leaves.begin(), initial_leaves.end());
+
+    for (size_t f = 0; f < num_features; ++f) {
+        size_t begin = feature_offsets[f];
+        size_t n = feature_offsets[f + 1] - begin;
+        double x = sample[f];
+
+        // Every node whose test x <= threshold fails sends the sample right; NaN fails every test
+        size_t num_false;
+        if (std::isnan(x)) {
+            num_false = n;
+        }
+#ifdef QUICKSCORER_X86
+        else if (avx2) {
+            num_false = count_below_avx2(thresholds.data() + begin, n, x);
+        }
+#endif
+        else {
+            num_false = count_below_scalar(thresholds.data() + begin, n, x);
+        }
+
+        for (size_t k = begin; k < begin + num_false; ++k) {
+            leaves[node_trees[k]] &= node_masks[k];
+        }
+    }
+
+    // The exit leaf of a tree is its leftmost remaining leaf
+    for (size_t t = 0; t < num_trees; ++t) {
+        tree_values[t] = leaf_values[leaf_offsets[t] + __builtin_ctzll(leaves[t])];
+    }
+}
+
+size_t QuickScorer::memory_usage() const {
+    return sizeof(*this) + feature_offsets.capacity() * sizeof(size_t) + thresholds.capacity() * sizeof(double)
+           + node_trees.capacity() * sizeof(uint32_t) + node_masks.capacity() * sizeof(uint64_t)
+           + initial_leaves.capacity() * sizeof(uint64_t) + leaf_offsets.capacity() * sizeof(size_t)
+           + leaf_values.capacity() * sizeof(double);
+}
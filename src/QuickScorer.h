@@ -0,0 +1,103 @@
+#ifndef QUICKSCORER_H
+#define QUICKSCORER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "FlatTree.h"
+
+
+/**
+ * @enum InferenceEngine
+ * @brief Algorithm an ensemble uses to evaluate its trees in predict
+ */
+enum class InferenceEngine {
+    Pointer, ///< Walk every tree from its root, one node at a time (the default)
+    QuickScorer, ///< Evaluate all trees feature by feature with bitvectors (see QuickScorer)
+    Compact ///< Walk quantized 8-byte node records (see CompactForest)
+};
+
+
+/**
+ * @class QuickScorer
+ * @brief Bitvector-based evaluation of an ensemble of small trees
+ *
+ * This class implements the QuickScorer algorithm. Instead of walking each tree from its root, every feature of a
+ * sample is compared against the sorted thresholds of all decision nodes that test it, across the whole ensemble.
+ * Every node whose test fails (the sample goes right) clears the leaves of its left subtree from its tree's leaf
+ * bitvector. Once all features are processed, the exit leaf of each tree is the lowest set bit of its bitvector.
+ *
+ * Leaves are numbered from left to right, so every tree can have at most 64 leaves. The threshold comparisons use
+ * AVX2 when the CPU supports it and scalar code otherwise; both give the same results as FlatTree::predict, including
+ * for NaN feature values, which always go right.
+ *
+ * @code
+ * QuickScorer scorer(trees, features, num_features);
+ * std::vector<double> tree_values(scorer.get_num_trees());
+ * scorer.score(sample.data(), tree_values.data());
+ * @endcode
+ */
+class QuickScorer {
+    private:
+        size_t num_trees; ///< Number of trees in the ensemble
+        size_t num_features; ///< Number of features in a sample
+        std::vector<size_t> feature_offsets; ///< Start of the nodes of every feature in the arrays below; num_features + 1 entries
+        std::vector<double> thresholds; ///< Thresholds of the decision nodes, grouped by feature and sorted within a feature
+        std::vector<uint32_t> node_trees; ///< Tree of every decision node
+        std::vector<uint64_t> node_masks; ///< Bitvector of every decision node; zero bits mark the leaves of its left subtree
+        std::vector<uint64_t> initial_leaves; ///< Bitvector with one set bit per leaf, for every tree
+        std::vector<size_t> leaf_offsets; ///< Start of the leaf values of every tree in leaf_values
+        std::vector<double> leaf_values; ///< Values of the leaves, from left to right, for every tree
+        bool avx2; ///< Whether the threshold comparisons use AVX2
+
+        /**
+         * @brief Helper method for the constructor; numbers the leaves of a subtree and records its decision nodes
+         * @return Number of leaves in the subtree
+         */
+        uint32_t add_subtree(const FlatTree& tree, uint32_t index, uint32_t tree_id, uint32_t first_leaf,
+                             const std::vector<size_t>& features, std::vector<std::vector<std::pair<double, size_t>>>& feature_nodes,
+                             std::vector<uint32_t>& trees_of_nodes, std::vector<uint64_t>& masks_of_nodes);
+
+    public:
+        /**
+         * @brief Constructor for QuickScorer
+         * @param trees Trees of the ensemble
+         * @param features For every tree, the position in the sample of every feature index the tree uses; an empty
+         *                 vector means the tree indexes the sample directly
+         * @param num_features Number of features in a sample
+         * @param use_simd Whether AVX2 may be used when the CPU supports it; false forces the scalar code
+         * @throws std::invalid_argument if a tree is empty, has more than 64 leaves, or uses a feature outside the sample
+         */
+        QuickScorer(const std::vector<FlatTree>& trees, const std::vector<std::vector<size_t>>& features, size_t num_features,
+                    bool use_simd = true);
+
+        /**
+         * @brief Evaluate every tree of the ensemble on a sample
+         * @param sample Pointer to the num_features feature values of the sample
+         * @param tree_values Receives the value of the exit leaf of every tree, in the order the trees were given
+         *
+         * The leaf bitvectors are kept in per-thread scratch, so concurrent calls are safe and do not allocate once
+         * the calling thread has scored a sample.
+         */
+        void score(const double* sample, double* tree_values) const;
+
+        /**
+         * @brief Get the number of trees in the ensemble
+         * @return Number of trees
+         */
+        size_t get_num_trees() const { return num_trees; }
+
+        /**
+         * @brief Check whether the threshold comparisons use AVX2
+         * @return True if AVX2 is used, false if the scalar code is used
+         */
+        bool uses_avx2() const { return avx2; }
+
+        /**
+         * @brief Get the memory held by the scorer
+         * @return Approximate number of bytes held by the scorer object and its arrays
+         */
+        size_t memory_usage() const;
+};
+
+#endif // QUICKSCORER_H
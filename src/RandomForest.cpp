@@ -1,13 +1,23 @@
 #include <vector>
 #include <memory>
 #include <future>
+#include <thread>
 #include <string>
 #include <map>
 #include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <numeric>
+#include <chrono>
+#include <functional>
+#include <tuple>
 
 #include "DecisionTree.h"
 #include "DataFrame.h"
+#include "Serialization.h"
 #include "RandomForest.h"
+#include "SortedIndex.h"
+#include "Trace.h"
 
 using std::vector;
 
@@ -15,80 +25,306 @@ using std::vector;
 
 // Constructors
 RandomForest::RandomForest(int num_trees, int max_depth, int min_samples_split, int num_features)
-        : num_trees(num_trees), max_depth(max_depth), min_samples_split(min_samples_split), num_features(num_features) {}
+        : num_trees(num_trees), max_depth(max_depth), min_samples_split(min_samples_split), num_features(num_features),
+          engine(InferenceEngine::Pointer), node_layout(NodeLayout::DepthFirst), oblivious(false),
+          criterion(SplitCriterion::Entropy), growth(GrowthPolicy::DepthFirst), early_exit(false), early_exit_margin(0.0),
+          early_exit_stats(false) {}
 
 RandomForest::RandomForest(int num_trees, int max_depth, int min_samples_split, int num_features, size_t random_state)
-        : num_trees(num_trees), max_depth(max_depth), min_samples_split(min_samples_split), num_features(num_features), random_state(random_state) {}
+        : num_trees(num_trees), max_depth(max_depth), min_samples_split(min_samples_split), num_features(num_features), random_state(random_state),
+          engine(InferenceEngine::Pointer), node_layout(NodeLayout::DepthFirst), oblivious(false),
+          criterion(SplitCriterion::Entropy), growth(GrowthPolicy::DepthFirst), early_exit(false), early_exit_margin(0.0),
+          early_exit_stats(false) {}
+
+
+
+TrainingStats RandomForest::fit(std::shared_ptr<DataFrame> data, const std::string& label_column) {
+    // Set the fitted forest aside until the new trees and their engine are complete, so that a failed fit (for
+    // example with trees the QuickScorer cannot hold) leaves the forest as it was
+    std::vector<std::string> saved_names = std::move(full_feature_names);
+    std::vector<std::shared_ptr<DecisionTree>> saved_trees = std::move(trees);
+    std::vector<std::vector<std::string>> saved_features = std::move(tree_features);
+    std::vector<std::vector<size_t>> saved_indices = std::move(tree_indices);
+    std::vector<FlatTree> saved_flat_trees = std::move(flat_trees);
+    std::vector<double> saved_classes = std::move(classes);
+    std::unique_ptr<QuickScorer> saved_quick_scorer = std::move(quick_scorer);
+    std::unique_ptr<CompactForest> saved_compact_forest = std::move(compact_forest);
+    try {
+        return grow_forest(data, label_column);
+    } catch (...) {
+        full_feature_names = std::move(saved_names);
+        trees = std::move(saved_trees);
+        tree_features = std::move(saved_features);
+        tree_indices = std::move(saved_indices);
+        flat_trees = std::move(saved_flat_trees);
+        classes = std::move(saved_classes);
+        quick_scorer = std::move(saved_quick_scorer);
+        compact_forest = std::move(saved_compact_forest);
+        throw;
+    }
+}
 
+TrainingStats RandomForest::grow_forest(std::shared_ptr<DataFrame> data, const std::string& label_column) {
+    RF_TRACE_SCOPE("RandomForest::fit", "train");
+    auto fit_start = std::chrono::steady_clock::now();
+
+    // A fit replaces the trees of any earlier fit, whose labels may not be in the new class table
+    trees.clear();
+    tree_features.clear();
+    tree_indices.clear();
+    flat_trees.clear();
+    quick_scorer.reset();
+    compact_forest.reset();
+    full_feature_names = data->columns;
 
+    // Sort every feature once; all trees read the same index and only draw the rows and features of their sample
+    std::vector<std::string> feature_names;
+    for (const auto& col : data->columns) {
+        if (col != label_column) {
+            feature_names.push_back(col);
+        }
+    }
+    const SortedIndex index(*data, feature_names);
+    const Series labels = data->get_column(label_column);
 
-void RandomForest::fit(std::shared_ptr<DataFrame> data, const std::string& label_column) {
-    std::vector<std::future<std::shared_ptr<DecisionTree>>> futures;
-    full_feature_names = data->columns;
+    // Declared after the index and the labels, so a failed fit waits for the tasks before they go away
+    std::vector<std::future<std::tuple<std::shared_ptr<DecisionTree>, std::vector<std::string>, TrainingStats>>> futures;
 
     for (int i = 0; i < num_trees; ++i) {
-        futures.push_back(std::async(std::launch::async, [this, &data, label_column, i]() {
+        futures.push_back(std::async(std::launch::async, [this, &data, &index, &labels, label_column, i]() {
+            RF_TRACE_SCOPE_ARG("tree task", "train", "tree", i);
             if (num_features == -1) {
                 num_features = static_cast<int>(std::sqrt(data->get_num_columns()));
             }
-            std::unique_ptr<DataFrame> bootstrap_sample = data->bootstrap_sample(num_features, label_column, random_state + i);
+            SampleDraw bootstrap = data->draw_bootstrap(num_features, label_column, random_state + i);
 
-            // Save the feature names used in the bootstrap sample
-            std::vector<std::string> selected_features = bootstrap_sample->columns;
+            // Save the feature names used in the bootstrap sample; the tree's feature indices are positions in it
+            std::vector<std::string> selected_features = bootstrap.features;
             auto tree = std::make_shared<DecisionTree>(max_depth, min_samples_split);
-            tree->fit(std::move(bootstrap_sample), label_column);
-
-            // Associate the tree with its selected features; lock with a mutex to ensure there are no race conditions
-            {
-                std::lock_guard<std::mutex> lock(map_mutex);
-                tree_feature_map[tree] = selected_features;
-            }
-
-            return tree;
+            tree->set_node_layout(node_layout);
+            tree->set_oblivious(oblivious);
+            tree->set_criterion(criterion);
+            tree->set_growth_policy(growth);
+            TrainingStats tree_stats = tree->fit(index, bootstrap.features, labels, bootstrap.rows);
+            return std::make_tuple(tree, selected_features, tree_stats);
         }));
     }
 
-    for (auto& future : futures) {
-        trees.push_back(std::move(future.get()));  // Add the tree to the forest in the same order
+    TrainingStats stats;
+    {
+        RF_TRACE_SCOPE("RandomForest::fit join", "train");   // only the wait for the trees
+        for (auto& future : futures) {
+            auto [tree, selected_features, tree_stats] = future.get();
+            add_tree(std::move(tree), std::move(selected_features));  // Add the tree to the forest in the same order
+            stats.add(tree_stats);
+        }
+    }
+    build_class_table(labels);
+
+    // Put the trees that usually agree with the forest first, so the early exit can stop sooner
+    if (early_exit) {
+        std::vector<const Series*> columns = feature_columns(*data, label_column);
+        std::vector<double> samples(data->get_num_rows() * columns.size());
+        feature_rows(columns, 0, data->get_num_rows(), samples.data());
+        rank_trees(samples, columns.size());
+    } else {
+        build_flat_trees();
+    }
+
+    if (engine == InferenceEngine::QuickScorer) {
+        build_quick_scorer();
+    } else if (engine == InferenceEngine::Compact) {
+        build_compact_forest();
     }
+
+    stats.fit_seconds = TrainingStats::seconds_since(fit_start);
+    return stats;
 }
 
 
 
 
 
+// Per-thread scratch of predict and predict_batch, which is reused so that a prediction allocates nothing once the
+// thread has warmed up
+static thread_local std::vector<double> tree_values_scratch;
+static thread_local std::vector<double> filtered_sample_scratch;
+static thread_local std::vector<double> chunk_predictions_scratch;
+
 double RandomForest::predict(const std::vector<double>& sample) const {
-    std::vector<double> predictions;
+    if (early_exit && !quick_scorer && !compact_forest) {
+        return predict_early_exit(sample);
+    }
+    std::vector<double>& tree_values = tree_values_scratch;
+    tree_values.resize(trees.size());
+    score_trees(sample, tree_values);
+    return majorityVote(tree_values);
+}
+
+std::vector<size_t> RandomForest::predict_votes(const std::vector<double>& sample) const {
+    std::vector<double>& tree_values = tree_values_scratch;
+    tree_values.resize(trees.size());
+    score_trees(sample, tree_values);
+
+    std::vector<size_t> counts(classes.size());
+    count_votes(tree_values, counts.data());
+    return counts;
+}
+
+std::vector<double> RandomForest::predict_proba(const std::vector<double>& sample) const {
+    std::vector<size_t> counts = predict_votes(sample);
+    std::vector<double> probabilities(counts.size());
+    for (size_t k = 0; k < counts.size(); ++k) {
+        probabilities[k] = static_cast<double>(counts[k]) / trees.size();
+    }
+    return probabilities;
+}
+
+size_t RandomForest::get_num_columns() const {
+    return full_feature_names.empty() ? 0 : full_feature_names.size() - 1;
+}
+
+std::vector<double> RandomForest::get_classes() const {
+    return classes;
+}
+
+void RandomForest::score_trees(const std::vector<double>& sample, std::vector<double>& tree_values) const {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
 
     // ensure sample size is same as feature size - 1 (i.e. removing label column)
     if (sample.size() != full_feature_names.size() - 1) {
         throw std::runtime_error("Sample size does not match the number of non-label features");
     }
 
-    for (const std::shared_ptr<DecisionTree>& tree : trees) {
-        std::vector<double> filtered_sample;
+    if (quick_scorer) {
+        quick_scorer->score(sample.data(), tree_values.data());
+        return;
+    }
+    if (compact_forest) {
+        compact_forest->score(sample.data(), tree_values.data());
+        return;
+    }
 
-        // Get the feature set for this tree
-        std::vector<std::string> feature_subset;
-        std::lock_guard<std::mutex> lock(map_mutex);
-        auto it = tree_feature_map.find(tree);
-        if (it != tree_feature_map.end()) {
-            feature_subset = it->second;
-        } else {
-            throw std::runtime_error("Tree not found in tree_feature_map");
-        }
+    for (size_t t = 0; t < trees.size(); ++t) {
+        tree_values[t] = tree_predict(t, sample, filtered_sample_scratch);
+    }
+}
 
+double RandomForest::tree_predict(size_t t, const std::vector<double>& sample, std::vector<double>& filtered_sample) const {
+    // Map the full sample to the features of the tree
+    filtered_sample.clear();
+    for (size_t index : tree_indices[t]) {
+        filtered_sample.push_back(sample[index]);
+    }
+    return trees[t]->predict(filtered_sample);
+}
 
-        // Map the full sample to the feature subset
-        for (const auto& feature : feature_subset) {
-            size_t index = original_feature_index(feature);  // Use original_feature_index to find the index of each feature
-            filtered_sample.push_back(sample[index]);
+double RandomForest::predict_early_exit(const std::vector<double>& sample) const {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+    if (sample.size() != full_feature_names.size() - 1) {
+        throw std::runtime_error("Sample size does not match the number of non-label features");
+    }
+
+    size_t stack_counts[MAX_STACK_CLASSES];
+    std::vector<size_t> heap_counts;
+    size_t* counts = stack_counts;
+    if (classes.size() > MAX_STACK_CLASSES) {
+        heap_counts.resize(classes.size());
+        counts = heap_counts.data();
+    }
+    std::fill(counts, counts + classes.size(), 0);
+
+    size_t evaluated = 0;
+    while (evaluated < trees.size()) {
+        ++counts[class_id(tree_predict(evaluated, sample, filtered_sample_scratch))];
+        ++evaluated;
+
+        // Stop once the runner-up could not catch up even if the remaining trees all voted for it
+        size_t leader = 0, runner_up = 0;
+        for (size_t k = 0; k < classes.size(); ++k) {
+            if (counts[k] > leader) {
+                runner_up = leader;
+                leader = counts[k];
+            } else if (counts[k] > runner_up) {
+                runner_up = counts[k];
+            }
+        }
+        double remaining = static_cast<double>(trees.size() - evaluated);
+        if (static_cast<double>(leader - runner_up) > (1.0 - early_exit_margin) * remaining) {
+            break;
         }
+    }
 
-        predictions.push_back(tree->predict(filtered_sample));
+    if (early_exit_stats) {
+        early_exit_samples.fetch_add(1, std::memory_order_relaxed);
+        early_exit_trees.fetch_add(evaluated, std::memory_order_relaxed);
     }
+    return classes[std::max_element(counts, counts + classes.size()) - counts];
+}
+
 
-    return majorityVote(predictions);
+std::vector<double> RandomForest::predict_batch(const std::vector<double>& samples, size_t num_columns) const {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+    if (num_columns != full_feature_names.size() - 1) {
+        throw std::runtime_error("Sample size does not match the number of non-label features");
+    }
+    if (samples.size() % num_columns != 0) {
+        throw std::invalid_argument("Sample buffer size is not a multiple of the number of columns");
+    }
+
+    std::vector<double> predictions(samples.size() / num_columns);
+    predict_batch(samples.data(), predictions.size(), num_columns, predictions.data());
+    return predictions;
+}
+
+void RandomForest::predict_batch(const double* samples, size_t num_rows, size_t num_columns, double* predictions) const {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+    if (num_columns != full_feature_names.size() - 1) {
+        throw std::runtime_error("Sample size does not match the number of non-label features");
+    }
+
+    std::vector<double>& votes = tree_values_scratch;
+    votes.resize(trees.size());
+    if (quick_scorer || compact_forest) {
+        for (size_t row = 0; row < num_rows; ++row) {
+            const double* sample = samples + row * num_columns;
+            if (quick_scorer) {
+                quick_scorer->score(sample, votes.data());
+            } else {
+                compact_forest->score(sample, votes.data());
+            }
+            predictions[row] = majorityVote(votes);
+        }
+        return;
+    }
+
+    // Score a chunk of rows tree by tree, so each tree's nodes stay in cache for the whole chunk; the scratch holds
+    // one chunk of every tree, and a chunk is never larger than the batch
+    const size_t chunk_rows = std::min<size_t>(1024, num_rows);
+    std::vector<double>& tree_predictions = chunk_predictions_scratch;
+    tree_predictions.resize(trees.size() * chunk_rows);
+    for (size_t start = 0; start < num_rows; start += chunk_rows) {
+        size_t chunk = std::min(chunk_rows, num_rows - start);
+        for (size_t t = 0; t < trees.size(); ++t) {
+            flat_trees[t].predict_batch(samples + start * num_columns, chunk, num_columns, tree_indices[t].data(),
+                                        tree_predictions.data() + t * chunk);
+        }
+
+        for (size_t r = 0; r < chunk; ++r) {
+            for (size_t t = 0; t < trees.size(); ++t) {
+                votes[t] = tree_predictions[t * chunk + r];
+            }
+            predictions[start + r] = majorityVote(votes);
+        }
+    }
 }
 
 
@@ -100,9 +336,8 @@ std::string RandomForest::print() {
     string output_string = "Random forest of length " + std::to_string(num_trees) + " with trees:\n";
 
     // Print each tree in the forest
-    for (const auto& tree : trees) {
-        std::vector<std::string> feature_subset = tree_feature_map.at(tree);
-        output_string += tree->print(feature_subset) + "\n";
+    for (size_t t = 0; t < trees.size(); ++t) {
+        output_string += trees[t]->print(tree_features[t]) + "\n";
     }
     return output_string;
 }
@@ -124,13 +359,39 @@ size_t RandomForest::original_feature_index(const std::string& feature_name) con
 
 
 double RandomForest::majorityVote(const std::vector<double>& predictions) const {
-    std::map<double, int> frequency_map;
-    for (double pred : predictions) {
-        frequency_map[pred]++;
+    size_t stack_counts[MAX_STACK_CLASSES];
+    std::vector<size_t> heap_counts;
+    size_t* counts = stack_counts;
+    if (classes.size() > MAX_STACK_CLASSES) {
+        heap_counts.resize(classes.size());
+        counts = heap_counts.data();
     }
+    count_votes(predictions, counts);
 
-    return std::max_element(frequency_map.begin(), frequency_map.end(),
-                            [](const auto& a, const auto& b) { return a.second < b.second; })->first;
+    // The first class with the most votes wins, so ties go to the smallest label
+    return classes[std::max_element(counts, counts + classes.size()) - counts];
+}
+
+void RandomForest::count_votes(const std::vector<double>& tree_values, size_t* counts) const {
+    std::fill(counts, counts + classes.size(), 0);
+    for (double value : tree_values) {
+        ++counts[class_id(value)];
+    }
+}
+
+size_t RandomForest::class_id(double label) const {
+    auto it = std::lower_bound(classes.begin(), classes.end(), label);
+    if (it == classes.end() || *it != label) {
+        throw std::runtime_error("Tree predicted a label outside of the class table");
+    }
+    return it - classes.begin();
+}
+
+void RandomForest::build_class_table(const Series& labels) {
+    classes = labels.convert_to_numeric();
+    std::sort(classes.begin(), classes.end());
+    classes.erase(std::unique(classes.begin(), classes.end()), classes.end());
+    classes.shrink_to_fit();
 }
 
 
@@ -158,29 +419,32 @@ std::tuple<int,int,int,int> RandomForest::hypertune(std::shared_ptr<DataFrame> d
                     double all_folds_accuracy = 0.0;
                     // Perform k-fold cross-validation
                     for (size_t i = 0; i < num_folds; ++i) {
+                        RF_TRACE_SCOPE_ARG("hypertune fold", "tune", "fold", i);
                         double single_fold_accuracy = 0.0;
                         // Create a new DataFrame for training data consisting 
                         // of all folds except the current fold
                         std::shared_ptr<DataFrame> train_data = std::make_shared<DataFrame>();
-                        
-                        for (const auto& col : data->columns) {
-                            train_data->add_column(col);
-                        }
-
-                        for (size_t j = 0; j < num_folds; ++j) {
-                            if (j == i) {
-                                continue; // Skip the current fold
+                        {
+                            RF_TRACE_SCOPE_ARG("hypertune fold rebuild", "tune", "fold", i);
+                            for (const auto& col : data->columns) {
+                                train_data->add_column(col);
                             }
-                            size_t num_rows = k_folds[j]->get_num_rows();
-                            for (size_t k = 0; k < num_rows; ++k) {
-                                train_data->add_row(k_folds[j]->get_row(k));
+
+                            for (size_t j = 0; j < num_folds; ++j) {
+                                if (j == i) {
+                                    continue; // Skip the current fold
+                                }
+                                size_t num_rows = k_folds[j]->get_num_rows();
+                                for (size_t k = 0; k < num_rows; ++k) {
+                                    train_data->add_row(k_folds[j]->get_row(k));
+                                }
                             }
                         }
 
                         RandomForest rf(num_trees, max_depth, min_samples_split, num_features, seed);
                         rf.fit(train_data, label_column); 
 
-
+                        RF_TRACE_SCOPE_ARG("hypertune fold score", "tune", "fold", i);
                         Series label_column_data = k_folds[i]->get_column(label_column);
                         k_folds[i]->drop_column(label_column);
                         size_t testing_rows = k_folds[i]->get_num_rows();
@@ -233,35 +497,389 @@ std::tuple<int,int,int,int> RandomForest::hypertune(std::shared_ptr<DataFrame> d
 }
 
 
-double RandomForest::score(std::shared_ptr<DataFrame> data, const std::string& label_column) {
+double RandomForest::score(std::shared_ptr<const DataFrame> data, const std::string& label_column, size_t num_threads) const {
+    RF_TRACE_SCOPE("RandomForest::score", "score");
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+    size_t num_rows = data->get_num_rows();
+    if (num_rows == 0) {
+        throw std::runtime_error("Cannot score a RandomForest on an empty DataFrame");
+    }
+
+    std::vector<double> labels = data->view_column(label_column).convert_to_numeric();
+    std::vector<double> predictions(num_rows);
+    size_t correct_predictions = predict_shards(feature_columns(*data, label_column), num_rows, num_threads,
+                                                predictions.data(), labels.data());
+    return static_cast<double>(correct_predictions) / num_rows;
+}
 
+std::vector<double> RandomForest::predict_all(const DataFrame& data, const std::string& label_column, size_t num_threads) const {
+    RF_TRACE_SCOPE("RandomForest::predict_all", "score");
     if (trees.empty()) {
         throw std::runtime_error("RandomForest has not been fit");
     }
+    std::vector<double> predictions(data.get_num_rows());
+    predict_shards(feature_columns(data, label_column), predictions.size(), num_threads, predictions.data(), nullptr);
+    return predictions;
+}
 
-    double correct_predictions = 0.0;
-    size_t num_rows = data->get_num_rows();
+size_t RandomForest::predict_shards(const std::vector<const Series*>& columns, size_t num_rows, size_t num_threads,
+                                    double* predictions, const double* labels) const {
+    if (num_threads == 0) {
+        num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    size_t num_shards = std::max<size_t>(1, std::min(num_threads, num_rows));
+    size_t shard_rows = (num_rows + num_shards - 1) / num_shards;
+
+    // Every shard converts and predicts a contiguous block of rows into its part of the output and counts its own hits
+    std::vector<std::future<size_t>> futures;
+    for (size_t begin = 0; begin < num_rows; begin += shard_rows) {
+        size_t end = std::min(num_rows, begin + shard_rows);
+        futures.push_back(std::async(std::launch::async, [this, &columns, predictions, labels, begin, end]() {
+            RF_TRACE_SCOPE_ARG("score shard", "score", "first_row", begin);
+            std::vector<double> shard((end - begin) * columns.size());
+            feature_rows(columns, begin, end, shard.data());
+            predict_batch(shard.data(), end - begin, columns.size(), predictions + begin);
+
+            size_t correct = 0;
+            if (labels) {
+                for (size_t row = begin; row < end; ++row) {
+                    correct += predictions[row] == labels[row];
+                }
+            }
+            return correct;
+        }));
+    }
 
-    Series label_column_data = data->get_column(label_column);
-    data->drop_column(label_column);
+    size_t correct = 0;
+    for (auto& future : futures) {
+        correct += future.get();
+    }
+    return correct;
+}
 
-    for (size_t i = 0; i < num_rows; ++i) {
-        vector<Cell> sample = data->get_row(i);
+std::vector<const Series*> RandomForest::feature_columns(const DataFrame& data, const std::string& label_column) const {
+    std::vector<const Series*> columns;
+    for (const auto& col : data.columns) {
+        if (col != label_column) {
+            columns.push_back(&data.view_column(col));
+        }
+    }
+    if (columns.size() != full_feature_names.size() - 1) {
+        throw std::runtime_error("Sample size does not match the number of non-label features");
+    }
+    return columns;
+}
+
+void RandomForest::feature_rows(const std::vector<const Series*>& columns, size_t begin, size_t end, double* samples) {
+    for (size_t c = 0; c < columns.size(); ++c) {
+        columns[c]->convert_to_numeric(begin, end, samples + c, columns.size());
+    }
+}
+
+size_t RandomForest::memory_usage() const {
+    size_t bytes = sizeof(*this) + trees.capacity() * sizeof(std::shared_ptr<DecisionTree>);
+    bytes += strings_memory_usage(full_feature_names);
+
+    for (const auto& tree : trees) {
+        bytes += tree->memory_usage();
+    }
+    if (quick_scorer) {
+        bytes += quick_scorer->memory_usage();
+    }
+    if (compact_forest) {
+        bytes += compact_forest->memory_usage();
+    }
+    bytes += classes.capacity() * sizeof(double);
+
+    bytes += tree_features.capacity() * sizeof(std::vector<std::string>) + tree_indices.capacity() * sizeof(std::vector<size_t>);
+    bytes += flat_trees.capacity() * sizeof(FlatTree);
+    for (size_t t = 0; t < tree_features.size(); ++t) {
+        bytes += strings_memory_usage(tree_features[t]) + tree_indices[t].capacity() * sizeof(size_t);
+    }
+    return bytes;
+}
+
+
+void RandomForest::add_tree(std::shared_ptr<DecisionTree> tree, std::vector<std::string> features) {
+    // Resolve the feature names to sample positions once, so predict never looks them up
+    std::vector<size_t> indices;
+    for (const auto& feature : features) {
+        indices.push_back(original_feature_index(feature));
+    }
+    trees.push_back(std::move(tree));
+    tree_features.push_back(std::move(features));
+    tree_indices.push_back(std::move(indices));
+}
+
+void RandomForest::build_quick_scorer() {
+    std::vector<FlatTree> flat_trees;
+    for (const auto& tree : trees) {
+        flat_trees.push_back(tree->flatten());
+    }
+    quick_scorer = std::make_unique<QuickScorer>(flat_trees, tree_indices, full_feature_names.size() - 1);
+}
+
+void RandomForest::build_flat_trees() {
+    // Views of the nodes the trees compiled, checked once so predict_batch can trust the feature positions
+    flat_trees.clear();
+    flat_trees.reserve(trees.size());
+    for (size_t t = 0; t < trees.size(); ++t) {
+        for (size_t index : tree_indices[t]) {
+            if (index >= full_feature_names.size() - 1) {
+                throw std::runtime_error("Tree feature index is outside of the samples");
+            }
+        }
+        flat_trees.push_back(trees[t]->flatten());
+    }
+}
+
+void RandomForest::build_compact_forest() {
+    std::vector<FlatTree> flat_trees;
+    for (const auto& tree : trees) {
+        flat_trees.push_back(tree->flatten());
+    }
+    LeafEncoding leaves = CompactForest::fits_class_ids(flat_trees) ? LeafEncoding::ClassId8 : LeafEncoding::Float32;
+    compact_forest = std::make_unique<CompactForest>(flat_trees, tree_indices, full_feature_names.size() - 1,
+                                                     ThresholdEncoding::Bin16, leaves);
+}
+
+void RandomForest::set_inference_engine(InferenceEngine engine) {
+    // Build the new engine first, so a failure leaves the current one in place
+    if (engine == InferenceEngine::QuickScorer && !trees.empty()) {
+        build_quick_scorer();
+    } else if (engine == InferenceEngine::Compact && !trees.empty()) {
+        build_compact_forest();
+    }
+    if (engine != InferenceEngine::QuickScorer) {
+        quick_scorer.reset();
+    }
+    if (engine != InferenceEngine::Compact) {
+        compact_forest.reset();
+    }
+    this->engine = engine;
+}
+
+InferenceEngine RandomForest::get_inference_engine() const {
+    return engine;
+}
+
+void RandomForest::set_node_layout(NodeLayout layout) {
+    node_layout = layout;
+    for (const auto& tree : trees) {
+        tree->set_node_layout(layout);
+    }
+    build_flat_trees();   // the trees compiled new flat forms
+}
+
+NodeLayout RandomForest::get_node_layout() const {
+    return node_layout;
+}
+
+void RandomForest::set_oblivious(bool oblivious) {
+    this->oblivious = oblivious;
+}
+
+bool RandomForest::is_oblivious() const {
+    return oblivious;
+}
+
+void RandomForest::set_criterion(SplitCriterion criterion) {
+    this->criterion = criterion;
+}
 
-        vector<double> sample_doubles;
+SplitCriterion RandomForest::get_criterion() const {
+    return criterion;
+}
+
+void RandomForest::set_growth_policy(GrowthPolicy growth) {
+    this->growth = growth;
+}
+
+GrowthPolicy RandomForest::get_growth_policy() const {
+    return growth;
+}
+
+void RandomForest::set_early_exit(bool enabled, double margin) {
+    if (!(margin >= 0.0 && margin < 1.0)) {
+        throw std::invalid_argument("Early exit margin must be in the interval [0, 1)");
+    }
+    early_exit = enabled;
+    early_exit_margin = margin;
+}
+
+bool RandomForest::is_early_exit() const {
+    return early_exit;
+}
 
-        for (const auto& cell : sample) {
-            sample_doubles.push_back( DataFrame::double_cast(cell) );
+void RandomForest::set_early_exit_stats(bool enabled) {
+    early_exit_stats = enabled;
+}
+
+void RandomForest::rank_trees(const std::vector<double>& samples, size_t num_columns) {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+    if (num_columns != full_feature_names.size() - 1) {
+        throw std::runtime_error("Sample size does not match the number of non-label features");
+    }
+    if (samples.size() % num_columns != 0) {
+        throw std::invalid_argument("Sample buffer size is not a multiple of the number of columns");
+    }
+
+    // Count for every tree the samples on which it votes with the whole forest
+    std::vector<size_t> agreement(trees.size(), 0);
+    std::vector<double> tree_values(trees.size());
+    std::vector<double> filtered_sample;
+    for (size_t start = 0; start < samples.size(); start += num_columns) {
+        std::vector<double> sample(samples.begin() + start, samples.begin() + start + num_columns);
+        for (size_t t = 0; t < trees.size(); ++t) {
+            tree_values[t] = tree_predict(t, sample, filtered_sample);
+        }
+        double prediction = majorityVote(tree_values);
+        for (size_t t = 0; t < trees.size(); ++t) {
+            agreement[t] += tree_values[t] == prediction;
         }
+    }
 
-        double prediction = predict(sample_doubles);
-        if (prediction == DataFrame::double_cast(label_column_data.retrieve(i))) {
-            correct_predictions += 1.0;
+    std::vector<size_t> order(trees.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&agreement](size_t a, size_t b) { return agreement[a] > agreement[b]; });
+
+    std::vector<std::shared_ptr<DecisionTree>> ranked;
+    std::vector<std::vector<std::string>> ranked_features;
+    std::vector<std::vector<size_t>> ranked_indices;
+    for (size_t t : order) {
+        ranked.push_back(trees[t]);
+        ranked_features.push_back(std::move(tree_features[t]));
+        ranked_indices.push_back(std::move(tree_indices[t]));
+    }
+    trees = std::move(ranked);
+    tree_features = std::move(ranked_features);
+    tree_indices = std::move(ranked_indices);
+
+    // Keep the flat trees and the engines in the order of the trees
+    build_flat_trees();
+    if (quick_scorer) {
+        build_quick_scorer();
+    }
+    if (compact_forest) {
+        build_compact_forest();
+    }
+}
+
+double RandomForest::get_mean_trees_evaluated() const {
+    size_t samples = early_exit_samples.load(std::memory_order_relaxed);
+    return samples == 0 ? 0.0 : static_cast<double>(early_exit_trees.load(std::memory_order_relaxed)) / samples;
+}
+
+void RandomForest::reset_early_exit_stats() {
+    early_exit_samples.store(0, std::memory_order_relaxed);
+    early_exit_trees.store(0, std::memory_order_relaxed);
+}
+
+void RandomForest::save(const std::string& path) const {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+
+    ModelHeader header{};
+    header.model_type = static_cast<uint32_t>(ModelType::RandomForest);
+    header.num_trees = static_cast<uint32_t>(trees.size());
+    header.num_names = static_cast<uint32_t>(full_feature_names.size());
+    header.max_depth = static_cast<int32_t>(max_depth);
+    header.min_samples_split = static_cast<int32_t>(min_samples_split);
+    header.num_features = static_cast<int32_t>(num_features);
+    header.random_state = random_state;
+    header.num_classes = static_cast<uint32_t>(classes.size());
+
+    ModelWriter writer(header);
+    writer.write_names(full_feature_names);
+    writer.write_classes(classes);
+
+    for (size_t t = 0; t < trees.size(); ++t) {
+        writer.write_tree(trees[t]->flatten(), tree_indices[t]);
+    }
+    writer.save(path);
+}
+
+std::unique_ptr<RandomForest> RandomForest::load(const std::string& path) {
+    ModelReader reader(path, ModelType::RandomForest);
+    const ModelHeader& header = reader.header();
+
+    auto forest = std::make_unique<RandomForest>(header.num_trees, header.max_depth, header.min_samples_split,
+                                                 header.num_features, header.random_state);
+    forest->full_feature_names = reader.names();
+    forest->classes = reader.classes();
+    if (forest->classes.empty() || std::adjacent_find(forest->classes.begin(), forest->classes.end(),
+                                                      std::greater_equal<double>()) != forest->classes.end()) {
+        throw std::runtime_error("RandomForest model file holds an invalid class table: " + path);
+    }
+
+    for (uint32_t i = 0; i < header.num_trees; ++i) {
+        std::vector<size_t> features;
+        FlatTree nodes = reader.read_tree(features);
+        if (nodes.empty() || nodes.max_feature() >= static_cast<int32_t>(features.size())) {
+            throw std::runtime_error("RandomForest model file holds an invalid tree: " + path);
+        }
+        for (size_t n = 0; n < nodes.size(); ++n) {
+            if (nodes.data()[n].feature < 0
+                && !std::binary_search(forest->classes.begin(), forest->classes.end(), nodes.data()[n].value)) {
+                throw std::runtime_error("RandomForest model file holds a leaf outside of its classes: " + path);
+            }
         }
 
+        std::vector<std::string> feature_subset;
+        for (size_t index : features) {
+            if (index >= forest->full_feature_names.size()) {
+                throw std::runtime_error("Tree feature index out of range in model file: " + path);
+            }
+            feature_subset.push_back(forest->full_feature_names[index]);
+        }
+
+        auto tree = std::make_shared<DecisionTree>(header.max_depth, header.min_samples_split, std::move(nodes), reader.mapping());
+        forest->add_tree(std::move(tree), std::move(feature_subset));
     }
+    forest->build_flat_trees();
+    return forest;
+}
 
-    data->add_column(label_column, label_column_data);
+std::string RandomForest::to_cpp(const std::string& function_name) const {
+    if (trees.empty()) {
+        throw std::runtime_error("RandomForest has not been fit");
+    }
+
+    std::ostringstream oss;
+    oss << "// Generated by RandomForest::to_cpp from a forest of " << trees.size() << " trees; do not edit.\n"
+        << "#include <algorithm>\n\n";
+    for (size_t i = 0; i < trees.size(); ++i) {
+        oss << trees[i]->to_cpp("tree_" + std::to_string(i), tree_indices[i]) << "\n";
+    }
 
-    return correct_predictions / num_rows;
-}
\ No newline at end of file
+    // Majority vote over the sorted votes; the first (smallest) class wins ties, like majorityVote
+    size_t n = trees.size();
+    oss << "extern \"C\" double " << function_name << "(const double* x) {\n"
+        << "    double votes[" << n << "] = {";
+    for (size_t i = 0; i < n; ++i) {
+        oss << (i ? ", " : "") << "tree_" << i << "(x)";
+    }
+    oss << "};\n"
+        << "    std::sort(votes, votes + " << n << ");\n"
+        << "    double best = votes[0];\n"
+        << "    int best_count = 0;\n"
+        << "    for (int i = 0; i < " << n << ";) {\n"
+        << "        int j = i;\n"
+        << "        while (j < " << n << " && votes[j] == votes[i]) {\n"
+        << "            ++j;\n"
+        << "        }\n"
+        << "        if (j - i > best_count) {\n"
+        << "            best = votes[i];\n"
+        << "            best_count = j - i;\n"
+        << "        }\n"
+        << "        i = j;\n"
+        << "    }\n"
+        << "    return best;\n"
+        << "}\n";
+    return oss.str();
+}
@@ -1,11 +1,14 @@
 #include <vector>
 #include <memory>
 #include <future>
+#include <atomic>
 #include <string>
 
 
 #include "DecisionTree.h"
 #include "DataFrame.h"
+#include "QuickScorer.h"
+#include "CompactForest.h"
 #include "Classifier.h"
 
 using std::vector;
@@ -32,8 +35,25 @@ class RandomForest : public Classifier {
         size_t random_state; ///< Random seed for the random number generator
         
         std::vector<std::string> full_feature_names; ///< Original feature names; used when mapping the features back to the original dataset
-        std::map<std::shared_ptr<DecisionTree>, std::vector<std::string>> tree_feature_map; ///< Map of decision trees to the features they were trained on
-        mutable std::mutex map_mutex; ///< Mutex to protect the tree_feature_map
+        std::vector<std::vector<std::string>> tree_features; ///< Names of the features every tree was trained on, parallel to trees
+        std::vector<std::vector<size_t>> tree_indices; ///< Position in the samples passed to predict of every feature of every tree, parallel to trees
+        std::vector<FlatTree> flat_trees; ///< View of the flat nodes of every tree, parallel to trees; built once for predict_batch
+
+        InferenceEngine engine; ///< Algorithm used by predict to evaluate the trees
+        std::unique_ptr<QuickScorer> quick_scorer; ///< Bitvector evaluation of the trees; only built for InferenceEngine::QuickScorer
+        std::unique_ptr<CompactForest> compact_forest; ///< Quantized copy of the trees; only built for InferenceEngine::Compact
+        NodeLayout node_layout; ///< Order of the nodes in the flat form of every tree
+        bool oblivious; ///< Whether fit grows oblivious trees (see DecisionTree::set_oblivious)
+        SplitCriterion criterion; ///< Impurity measure of the split search of every tree (see DecisionTree::set_criterion)
+        GrowthPolicy growth; ///< Order in which every tree grows its nodes (see DecisionTree::set_growth_policy)
+        std::vector<double> classes; ///< Sorted distinct training labels; a vote for classes[k] has class id k
+        bool early_exit; ///< Whether predict stops evaluating trees once the vote is decided
+        double early_exit_margin; ///< Fraction of the remaining trees the early exit assumes will not vote against the leader
+        bool early_exit_stats; ///< Whether predict counts the trees the early exit evaluates; off, it touches no shared state
+        mutable std::atomic<size_t> early_exit_samples{0}; ///< Number of samples predicted with the early exit and counted
+        mutable std::atomic<size_t> early_exit_trees{0}; ///< Number of trees evaluated for those samples
+
+        static constexpr size_t MAX_STACK_CLASSES = 64; ///< Votes of up to this many classes are counted in a stack array
 
         /**
          * @brief Function to get the index of a column in the DataFrame
@@ -49,10 +69,123 @@ class RandomForest : public Classifier {
          * @return the majority vote prediction
          * 
          * This function performs a majority vote on the predictions from the individual trees in the forest.
-         * The function returns the majority vote prediction.
+         * The function returns the majority vote prediction; ties go to the smallest label. The votes are counted per
+         * class id in a fixed-size array, so no memory is allocated for forests with up to MAX_STACK_CLASSES classes.
          */
         double majorityVote(const std::vector<double>& predictions) const;
 
+        /**
+         * @brief Function to count the votes of the trees per class
+         * @param tree_values Prediction of every tree
+         * @param counts Receives the number of votes of every class id; must hold classes.size() entries
+         * @throws std::runtime_error if a tree predicts a label that is not in the class table
+         */
+        void count_votes(const std::vector<double>& tree_values, size_t* counts) const;
+
+        /**
+         * @brief Function to look up the class id of a label
+         * @throws std::runtime_error if the label is not in the class table
+         */
+        size_t class_id(double label) const;
+
+        /**
+         * @brief Function to evaluate one tree of the forest by walking its nodes
+         * @param t Position of the tree in the forest
+         * @param sample Sample with one value per non-label feature
+         * @param filtered_sample Scratch buffer for the features of the tree
+         * @return Prediction of the tree
+         */
+        double tree_predict(size_t t, const std::vector<double>& sample, std::vector<double>& filtered_sample) const;
+
+        /**
+         * @brief Function to predict a sample with the early exit; the trees are evaluated in forest order
+         * @return The majority vote of the trees evaluated before the vote was decided
+         */
+        double predict_early_exit(const std::vector<double>& sample) const;
+
+        /**
+         * @brief Function to predict the rows of a DataFrame in parallel shards
+         * @param columns Non-label columns of the data, in the order of the forest's features
+         * @param num_rows Number of rows of the data
+         * @param num_threads Number of shards; 0 uses one per hardware thread
+         * @param predictions Receives the prediction of every row
+         * @param labels Label of every row, or nullptr
+         * @return Number of rows whose prediction equals their label; 0 without labels
+         *
+         * Every shard converts only its own rows into a row-major buffer, so no thread copies the whole data set.
+         */
+        size_t predict_shards(const std::vector<const Series*>& columns, size_t num_rows, size_t num_threads,
+                              double* predictions, const double* labels) const;
+
+        /**
+         * @brief Function to collect the non-label columns of a DataFrame without copying them
+         * @return Column of every feature, in the column order of the DataFrame
+         * @throws std::runtime_error if the number of non-label columns does not match the features of the forest
+         */
+        std::vector<const Series*> feature_columns(const DataFrame& data, const std::string& label_column) const;
+
+        /**
+         * @brief Function to convert a range of rows of the given columns into a row-major sample buffer
+         * @param columns Columns to read, one value per sample each
+         * @param begin First row to convert
+         * @param end One past the last row to convert
+         * @param samples Receives (end - begin) rows of columns.size() values
+         * @throws std::runtime_error if a value is not numeric
+         */
+        static void feature_rows(const std::vector<const Series*>& columns, size_t begin, size_t end, double* samples);
+
+        /**
+         * @brief Function to evaluate every tree on a sample with the selected inference engine
+         * @param sample Sample with one value per non-label feature
+         * @param tree_values Receives the prediction of every tree
+         * @throws std::runtime_error if the RandomForest has not been fit or the sample size does not match
+         */
+        void score_trees(const std::vector<double>& sample, std::vector<double>& tree_values) const;
+
+        /**
+         * @brief Function to encode the distinct training labels as the class table
+         * @param labels Label column of the training data
+         * @throws std::runtime_error if a label is not numeric
+         */
+        void build_class_table(const Series& labels);
+
+        /**
+         * @brief Function to add a trained tree to the forest
+         * @param tree Trained tree
+         * @param features Names of the features the tree was trained on, in the tree's order
+         * @throws std::runtime_error if a feature is not one of the columns the forest was trained on
+         */
+        void add_tree(std::shared_ptr<DecisionTree> tree, std::vector<std::string> features);
+
+        /**
+         * @brief Function to grow the trees of a fit, replace the trees of the forest with them, and build the selected engine
+         * @param data Data to fit the RandomForest to
+         * @param label_column Name of the column containing the labels
+         * @return Statistics of all trees added up
+         * @see fit()
+         */
+        TrainingStats grow_forest(std::shared_ptr<DataFrame> data, const std::string& label_column);
+
+        /**
+         * @brief Function to build the QuickScorer from the trees of the forest
+         * @throws std::invalid_argument if a tree has more than 64 leaves
+         */
+        void build_quick_scorer();
+
+        /**
+         * @brief Function to build the CompactForest from the trees of the forest
+         */
+        void build_compact_forest();
+
+        /**
+         * @brief Function to collect the flat form of every tree for predict_batch
+         * @throws std::runtime_error if a tree reads a feature outside of the samples
+         *
+         * Called whenever the trees or their flat forms change: at the end of fit and load, after rank_trees, and
+         * after set_node_layout.
+         */
+        void build_flat_trees();
+
 
     public:
 
@@ -88,12 +221,15 @@ class RandomForest : public Classifier {
          * @brief Function to fit the RandomForest to the data
          * @param data Data to fit the RandomForest to
          * @param label_column Name of the column containing the labels
+         * @return Statistics of all trees added up; the phase times are summed over the threads that grew the trees
          * 
          * This function fits the RandomForest to the data by training the individual decision trees in the forest.
          * The function takes a DataFrame containing the data and the name of the column containing the labels.
          * For each decision tree, bootstrap samples are created from the data, and the tree is trained on the samples.
+         * A later fit replaces the trees, classes and engine of the earlier one. If the fit fails, including when the selected inference engine cannot hold the new trees (QuickScorer with a
+         * tree of more than 64 leaves), the forest is left as it was and the exception is passed on.
          */
-        void fit(std::shared_ptr<DataFrame> data, const std::string& label_column) override;
+        TrainingStats fit(std::shared_ptr<DataFrame> data, const std::string& label_column) override;
 
         /**
          * @brief Function to make predictions using the RandomForest
@@ -102,9 +238,234 @@ class RandomForest : public Classifier {
          * 
          * This function makes predictions using the RandomForest on the specified sample.
          * The function returns the prediction from the RandomForest.
+         * The tree values are kept in per-thread scratch, so after its first prediction a thread allocates no memory.
          */
         double predict(const std::vector<double>& sample) const override;
 
+        /**
+         * @brief Function to make predictions for a batch of samples
+         * @param samples Feature values of the samples, one row of num_columns values after the other
+         * @param num_columns Number of feature values per sample; must match the number of non-label features
+         * @return Prediction for every sample, in order
+         * @throws std::runtime_error if the RandomForest has not been fit or num_columns does not match the features
+         * @throws std::invalid_argument if the buffer does not hold whole rows
+         * 
+         * The rows are scored one chunk at a time: every tree pushes the whole chunk through its flat form with
+         * DecisionTree's interleaved, prefetching batch traversal, and then every row takes the majority vote of the
+         * trees. The predictions are the same as calling predict() on every row. The flat trees are collected once
+         * per fit or load, and the per-tree predictions of a chunk are kept in per-thread scratch no larger than the
+         * batch, so a batch of one row costs about as much as predict().
+         * 
+         * @see FlatTree::predict_batch()
+         */
+        std::vector<double> predict_batch(const std::vector<double>& samples, size_t num_columns) const;
+
+        /**
+         * @brief Function to make predictions for a batch of samples held in a caller's buffer
+         * @param samples Feature values of the samples, num_rows rows of num_columns values one after the other
+         * @param num_rows Number of samples
+         * @param num_columns Number of feature values per sample; must match the number of non-label features
+         * @param predictions Receives the prediction of every sample, in order
+         * @throws std::runtime_error if the RandomForest has not been fit or num_columns does not match the features
+         *
+         * Like predict_batch() above, but reads and writes the caller's memory, so a slice of a larger buffer can be
+         * predicted in place.
+         */
+        void predict_batch(const double* samples, size_t num_rows, size_t num_columns, double* predictions) const;
+
+        /**
+         * @brief Function to get the number of feature values in a sample
+         * @return Number of non-label columns the RandomForest was trained on; 0 before fit
+         */
+        size_t get_num_columns() const;
+
+        /**
+         * @brief Function to get the class labels of the RandomForest
+         * @return Sorted distinct labels of the training data; the order of the entries of predict_votes and predict_proba
+         * 
+         * The labels of the training data are encoded to dense class ids during fit and saved with the model, so every
+         * training label has a class id, including one that no leaf predicts (it then never gets a vote).
+         */
+        std::vector<double> get_classes() const;
+
+        /**
+         * @brief Function to count the votes of the trees for every class
+         * @param sample Sample to make predictions on
+         * @return Number of trees voting for every class, in the order of get_classes()
+         * @throws std::runtime_error if the RandomForest has not been fit or the sample size does not match the features
+         * 
+         * @code
+         * std::vector<size_t> votes = rf.predict_votes({0.0, 12.8, 5.0, 4.7});
+         * // votes[k] trees predict rf.get_classes()[k]
+         * @endcode
+         */
+        std::vector<size_t> predict_votes(const std::vector<double>& sample) const;
+
+        /**
+         * @brief Function to get the fraction of trees voting for every class
+         * @param sample Sample to make predictions on
+         * @return Fraction of the trees voting for every class, in the order of get_classes(); the fractions sum to 1
+         * @throws std::runtime_error if the RandomForest has not been fit or the sample size does not match the features
+         * 
+         * The class with the largest fraction is the prediction of predict(), with ties going to the smallest label.
+         */
+        std::vector<double> predict_proba(const std::vector<double>& sample) const;
+
+        /**
+         * @brief Function to select the algorithm predict uses to evaluate the trees
+         * @param engine InferenceEngine::Pointer to walk each tree from its root, InferenceEngine::QuickScorer to
+         *               evaluate all trees feature by feature with bitvectors, or InferenceEngine::Compact to walk
+         *               quantized 8-byte node records
+         * @throws std::invalid_argument if QuickScorer is selected and a tree has more than 64 leaves
+         * 
+         * All engines give the same predictions. QuickScorer is meant for forests of many shallow trees. Compact keeps
+         * the thresholds as 16-bit bin indices and the leaves as 8-bit class ids, so a large forest takes a fraction of
+         * the memory of its nodes and stays in cache; a forest whose trees predict more than 256 distinct classes keeps
+         * its leaves as float32 instead, which is exact for integer labels below 2^24. The selected engine is built right away if the forest has been
+         * fit, and rebuilt at the end of every later fit. QuickScorer uses AVX2 when the CPU supports it and falls back
+         * to scalar code otherwise.
+         * 
+         * @see QuickScorer
+         * @see CompactForest
+         */
+        void set_inference_engine(InferenceEngine engine);
+
+        /**
+         * @brief Function to get the algorithm predict uses to evaluate the trees
+         * @return The selected InferenceEngine
+         */
+        InferenceEngine get_inference_engine() const;
+
+        /**
+         * @brief Function to set the order in which the flat form of every tree stores its nodes
+         * @param layout NodeLayout to use for the trees of the forest
+         * 
+         * The trees of a fit or loaded forest are compiled again right away, and trees grown by later fits use the
+         * same layout. The layout only changes the memory order of the nodes, never the predictions.
+         * 
+         * @see DecisionTree::set_node_layout()
+         */
+        void set_node_layout(NodeLayout layout);
+
+        /**
+         * @brief Function to get the order in which the flat form of every tree stores its nodes
+         * @return The selected NodeLayout
+         */
+        NodeLayout get_node_layout() const;
+
+        /**
+         * @brief Function to choose whether fit grows oblivious trees
+         * @param oblivious True to grow ObliviousTree learners, false (the default) to grow ID3 trees
+         * 
+         * Oblivious trees test one feature and threshold per depth, so every tree costs exactly max_depth comparisons
+         * per sample and predicts without data-dependent branches, which keeps the prediction latency predictable. The
+         * setting takes effect at the next fit.
+         * 
+         * @see ObliviousTree
+         */
+        void set_oblivious(bool oblivious);
+
+        /**
+         * @brief Function to check whether fit grows oblivious trees
+         * @return True if fit grows ObliviousTree learners
+         */
+        bool is_oblivious() const;
+
+        /**
+         * @brief Function to choose the impurity measure of the split search of every tree
+         * @param criterion SplitCriterion::Entropy (the default) or SplitCriterion::Gini; takes effect at the next fit
+         * 
+         * @see DecisionTree::set_criterion()
+         */
+        void set_criterion(SplitCriterion criterion);
+
+        /**
+         * @brief Function to get the impurity measure of the split search of every tree
+         * @return The selected SplitCriterion
+         */
+        SplitCriterion get_criterion() const;
+
+        /**
+         * @brief Function to choose the order in which every tree grows its nodes
+         * @param growth GrowthPolicy::DepthFirst (the default) or GrowthPolicy::LevelWise; takes effect at the next fit
+         * 
+         * The trees are the same either way; see DecisionTree::set_growth_policy().
+         */
+        void set_growth_policy(GrowthPolicy growth);
+
+        /**
+         * @brief Function to get the order in which every tree grows its nodes
+         * @return The selected GrowthPolicy
+         */
+        GrowthPolicy get_growth_policy() const;
+
+        /**
+         * @brief Function to let predict stop evaluating trees once the majority vote is decided
+         * @param enabled True to enable the early exit, false (the default) to always evaluate every tree
+         * @param margin Fraction in [0, 1) of the remaining trees that are assumed not to vote against the leading
+         *               class; 0 gives exactly the predictions of the full vote
+         * @throws std::invalid_argument if margin is outside [0, 1)
+         * 
+         * After every tree, predict stops once the lead of the leading class over the runner-up is larger than
+         * (1 - margin) times the number of trees left. With margin 0 no remaining tree can change the result; a larger
+         * margin stops sooner on close votes and may then differ from the full vote. The early exit applies to
+         * InferenceEngine::Pointer, which evaluates the trees one at a time; the other engines and predict_batch
+         * always evaluate the whole forest.
+         * 
+         * A clear vote is decided sooner when the trees that usually agree with the forest come first, so fit ranks
+         * the trees on the training data while the early exit is enabled; call rank_trees() to rank them on other data,
+         * such as recent traffic.
+         * 
+         * @code
+         * rf.set_early_exit(true);
+         * rf.set_early_exit_stats(true);
+         * rf.fit(data, "label");
+         * double prediction = rf.predict(sample);
+         * double trees_per_sample = rf.get_mean_trees_evaluated();
+         * @endcode
+         */
+        void set_early_exit(bool enabled, double margin = 0.0);
+
+        /**
+         * @brief Function to check whether predict stops evaluating trees once the vote is decided
+         * @return True if the early exit is enabled
+         */
+        bool is_early_exit() const;
+
+        /**
+         * @brief Function to order the trees by how often they agree with the forest
+         * @param samples Feature values of the samples, one row of num_columns values after the other
+         * @param num_columns Number of feature values per sample; must match the number of non-label features
+         * @throws std::runtime_error if the RandomForest has not been fit or num_columns does not match the features
+         * @throws std::invalid_argument if the buffer does not hold whole rows
+         * 
+         * Every tree is scored by the number of samples on which it votes for the prediction of the whole forest, and
+         * the trees are stably sorted by decreasing score. The order is kept by save() and does not change any
+         * prediction of the full vote.
+         */
+        void rank_trees(const std::vector<double>& samples, size_t num_columns);
+
+        /**
+         * @brief Function to set whether predict counts the trees evaluated with the early exit
+         * @param enabled True to count them for get_mean_trees_evaluated(); false (the default) to count nothing
+         * 
+         * The counters are shared by every thread that predicts with the forest, so counting costs two atomic updates
+         * per prediction; leave it off on the serving path unless the statistics are read.
+         */
+        void set_early_exit_stats(bool enabled);
+
+        /**
+         * @brief Function to get the average number of trees predict evaluated with the early exit
+         * @return Trees evaluated per sample since the last reset, or 0 if no sample was counted
+         * @see RandomForest::set_early_exit_stats
+         */
+        double get_mean_trees_evaluated() const;
+
+        /**
+         * @brief Function to reset the counters behind get_mean_trees_evaluated()
+         */
+        void reset_early_exit_stats();
+
 
         /**
          * @brief Function to print the RandomForest
@@ -171,6 +532,97 @@ class RandomForest : public Classifier {
                              const std::vector<int>& num_features_values,
                              bool verbose = false);
 
-        double score(std::shared_ptr<DataFrame> data, const std::string& label_column);
+        /**
+         * @brief Function to compute the accuracy of the RandomForest on labelled data
+         * @param data Data with the columns the forest was trained on, including the label column
+         * @param label_column Name of the column containing the labels
+         * @param num_threads Number of worker threads; 0 uses one per hardware thread
+         * @return Fraction of the rows whose prediction equals their label
+         * @throws std::runtime_error if the RandomForest has not been fit or the data is empty or not numeric
+         * 
+         * The data is not modified, so several threads can score the same DataFrame. The rows are split into one
+         * contiguous shard per thread; every shard converts only its own rows, is predicted with predict_batch() and
+         * counts its own correct predictions, and the counts are summed at the end.
+         * 
+         * @see predict_all()
+         */
+        double score(std::shared_ptr<const DataFrame> data, const std::string& label_column, size_t num_threads = 0) const;
+
+        /**
+         * @brief Function to make predictions for every row of a DataFrame
+         * @param data Data with the columns the forest was trained on; the label column is skipped if present
+         * @param label_column Name of the column containing the labels
+         * @param num_threads Number of worker threads; 0 uses one per hardware thread
+         * @return Prediction for every row, in order
+         * @throws std::runtime_error if the RandomForest has not been fit or the data is not numeric
+         * 
+         * Like score(), the rows are predicted in contiguous shards on parallel threads, and every shard writes its
+         * predictions straight into its part of the returned vector. Any metric can then be computed from the
+         * predictions and the labels.
+         * 
+         * @code
+         * std::vector<double> predictions = rf.predict_all(*holdout, "label");
+         * @endcode
+         */
+        std::vector<double> predict_all(const DataFrame& data, const std::string& label_column, size_t num_threads = 0) const;
+
+        /**
+         * @brief Function to report the memory footprint of the RandomForest
+         * @return Approximate number of bytes held by the forest, its trees, and their feature lists
+         * 
+         * This function returns the size of the RandomForest object plus the memory of every decision tree and of the
+         * feature names used to map a sample onto the features of each tree.
+         * 
+         * @see DecisionTree::memory_usage()
+         */
+        size_t memory_usage() const override;
+
+        /**
+         * @brief Function to save the RandomForest to a binary model file
+         * @param path Path of the model file
+         * @throws std::runtime_error if the RandomForest has not been fit or the file cannot be written
+         * 
+         * The file uses the layout described by ModelHeader: the names section holds the columns the forest was trained
+         * on, and every tree section stores the tree's nodes together with the position of each of its features in the
+         * samples passed to predict.
+         * 
+         * @see load(const std::string& path)
+         */
+        void save(const std::string& path) const;
+
+        /**
+         * @brief Function to load a RandomForest from a binary model file
+         * @param path Path of the model file written by save()
+         * @return Pointer to the loaded RandomForest
+         * @throws std::runtime_error if the file cannot be mapped or does not hold a valid RandomForest
+         * 
+         * The file is memory mapped once and every tree predicts from its mapped nodes in place, so loading a forest
+         * does not rebuild any nodes and scoring processes that load the same file share one physical copy of it.
+         * 
+         * @code
+         * rf.save("forest.bin");
+         * std::unique_ptr<RandomForest> loaded = RandomForest::load("forest.bin");
+         * double accuracy = loaded->score(test_data, "label");
+         * @endcode
+         */
+        static std::unique_ptr<RandomForest> load(const std::string& path);
+
+        /**
+         * @brief Function to generate a C++ translation unit that evaluates the RandomForest
+         * @param function_name Name of the generated entry point
+         * @return Source code of the translation unit
+         * @throws std::runtime_error if the RandomForest has not been fit
+         * 
+         * Every tree becomes a function of nested if/else statements with its thresholds baked in as literals (see
+         * DecisionTree::to_cpp), and the entry point extern "C" double function_name(const double* x) takes the majority
+         * vote of the trees like predict does. The sample array holds the non-label features in the order predict expects.
+         * Compiling the code into a shared object removes every data-dependent load of the tree structure.
+         * 
+         * @code
+         * std::ofstream("forest.cpp") << rf.to_cpp();
+         * // c++ -O2 -shared -fPIC forest.cpp -o forest.so
+         * @endcode
+         */
+        std::string to_cpp(const std::string& function_name = "predict") const;
 
 };
\ No newline at end of file
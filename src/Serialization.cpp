@@ -0,0 +1,230 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "FlatTree.h"
+#include "Serialization.h"
+
+using std::string;
+using std::vector;
+
+// Every model file starts with these four bytes
+static const char MODEL_MAGIC[4] = {'R', 'F', 'I', 'M'};
+
+
+// --------------- MappedFile Class ---------------
+
+MappedFile::MappedFile(const string& path) : address(nullptr), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Could not map empty or unreadable file: " + path);
+    }
+    length = static_cast<size_t>(info.st_size);
+
+    // The mapping stays valid after the descriptor is closed
+    void* mapped = mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Could not map file: " + path);
+    }
+    address = static_cast<const char*>(mapped);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(address), length);
+}
+
+
+// --------------- ModelWriter Class ---------------
+
+ModelWriter::ModelWriter(ModelHeader header) : header(header), names_written(false), classes_written(false), trees_written(0) {
+    std::memcpy(this->header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    this->header.version = MODEL_FORMAT_VERSION;
+    append(&this->header, sizeof(ModelHeader));
+}
+
+void ModelWriter::append(const void* bytes, size_t count) {
+    buffer.append(static_cast<const char*>(bytes), count);
+}
+
+void ModelWriter::align() {
+    buffer.append((8 - buffer.size() % 8) % 8, '\0');
+}
+
+void ModelWriter::write_names(const vector<string>& names) {
+    if (names_written) {
+        throw std::runtime_error("The names section has already been written");
+    }
+    if (names.size() != header.num_names) {
+        throw std::runtime_error("Number of names does not match the model header");
+    }
+
+    for (const auto& name : names) {
+        uint32_t name_length = static_cast<uint32_t>(name.size());
+        append(&name_length, sizeof(name_length));
+        append(name.data(), name.size());
+    }
+    align();
+    names_written = true;
+}
+
+void ModelWriter::write_classes(const vector<double>& classes) {
+    if (!names_written || trees_written > 0) {
+        throw std::runtime_error("The classes section must be written after the names and before the trees");
+    }
+    if (classes_written) {
+        throw std::runtime_error("The classes section has already been written");
+    }
+    if (classes.size() != header.num_classes) {
+        throw std::runtime_error("Number of classes does not match the model header");
+    }
+
+    append(classes.data(), classes.size() * sizeof(double));
+    classes_written = true;
+}
+
+void ModelWriter::write_tree(const FlatTree& tree, const vector<size_t>& features) {
+    if (!names_written) {
+        throw std::runtime_error("The names section must be written before the trees");
+    }
+    if (!classes_written && header.num_classes != 0) {
+        throw std::runtime_error("The classes section must be written before the trees");
+    }
+    if (trees_written == header.num_trees) {
+        throw std::runtime_error("More trees written than announced in the model header");
+    }
+
+    uint32_t counts[2] = {static_cast<uint32_t>(tree.size()), static_cast<uint32_t>(features.size())};
+    append(counts, sizeof(counts));
+    for (size_t feature : features) {
+        uint32_t index = static_cast<uint32_t>(feature);
+        append(&index, sizeof(index));
+    }
+    align();
+    append(tree.data(), tree.size() * sizeof(FlatNode));
+    ++trees_written;
+}
+
+void ModelWriter::save(const string& path) const {
+    if (!names_written || (!classes_written && header.num_classes != 0) || trees_written != header.num_trees) {
+        throw std::runtime_error("Model file is incomplete; not all sections announced in the header were written");
+    }
+
+    // Write a temporary file next to the target and rename it over the target once it is on disk. Models loaded from
+    // the old file keep their mapping of the old inode, which the rename does not touch; truncating the file in place
+    // would change the bytes under them.
+    string temp_path = path + ".tmpXXXXXX";
+    int fd = mkstemp(&temp_path[0]);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+    fchmod(fd, 0644);   // mkstemp creates the file readable by its owner only
+
+    const char* bytes = buffer.data();
+    size_t remaining = buffer.size();
+    bool written = true;
+    while (remaining > 0) {
+        ssize_t count = write(fd, bytes, remaining);
+        if (count < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            written = false;
+            break;
+        }
+        bytes += count;
+        remaining -= static_cast<size_t>(count);
+    }
+    written = written && fsync(fd) == 0;
+    written = close(fd) == 0 && written;
+    if (!written || rename(temp_path.c_str(), path.c_str()) != 0) {
+        unlink(temp_path.c_str());
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+
+// --------------- ModelReader Class ---------------
+
+ModelReader::ModelReader(const string& path, ModelType expected_type)
+    : file(std::make_shared<MappedFile>(path)), offset(0), trees_read(0) {
+    std::memcpy(&model_header, take(sizeof(ModelHeader)), sizeof(ModelHeader));
+
+    if (std::memcmp(model_header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0) {
+        throw std::runtime_error("Not a model file: " + path);
+    }
+    if (model_header.version != MODEL_FORMAT_VERSION) {
+        throw std::runtime_error("Unsupported model file version " + std::to_string(model_header.version) + ": " + path);
+    }
+    if (model_header.model_type != static_cast<uint32_t>(expected_type)) {
+        throw std::runtime_error("Model file holds a different kind of model: " + path);
+    }
+
+    for (uint32_t i = 0; i < model_header.num_names; ++i) {
+        uint32_t name_length;
+        std::memcpy(&name_length, take(sizeof(name_length)), sizeof(name_length));
+        model_names.emplace_back(take(name_length), name_length);
+    }
+    align();
+
+    const char* classes = take(model_header.num_classes * sizeof(double));
+    model_classes.resize(model_header.num_classes);
+    std::memcpy(model_classes.data(), classes, model_classes.size() * sizeof(double));
+}
+
+const char* ModelReader::take(size_t count) {
+    if (count > file->size() - offset) {
+        throw std::runtime_error("Model file is truncated");
+    }
+    const char* bytes = file->data() + offset;
+    offset += count;
+    return bytes;
+}
+
+void ModelReader::align() {
+    take((8 - offset % 8) % 8);
+}
+
+FlatTree ModelReader::read_tree(vector<size_t>& features) {
+    if (trees_read == model_header.num_trees) {
+        throw std::runtime_error("All trees of the model file have been read");
+    }
+
+    uint32_t counts[2];
+    std::memcpy(counts, take(sizeof(counts)), sizeof(counts));
+
+    features.clear();
+    const char* indices = take(counts[1] * sizeof(uint32_t));
+    for (uint32_t i = 0; i < counts[1]; ++i) {
+        uint32_t index;
+        std::memcpy(&index, indices + i * sizeof(uint32_t), sizeof(index));
+        features.push_back(index);
+    }
+    align();
+
+    // The section is 8-byte aligned within a page-aligned mapping, so the nodes can be used in place
+    const FlatNode* nodes = reinterpret_cast<const FlatNode*>(take(counts[0] * sizeof(FlatNode)));
+    FlatTree tree(nodes, counts[0]);
+    if (!features.empty() && tree.max_feature() >= static_cast<int32_t>(features.size())) {
+        throw std::runtime_error("Tree uses a feature outside of its feature list");
+    }
+
+    ++trees_read;
+    return tree;
+}
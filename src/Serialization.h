@@ -0,0 +1,257 @@
+#ifndef SERIALIZATION_H
+#define SERIALIZATION_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FlatTree.h"
+
+
+/**
+ * @class MappedFile
+ * @brief Read-only memory mapping of a file
+ *
+ * This class maps a whole file into memory for reading and unmaps it when destroyed. The mapping is shared, so every
+ * process that maps the same model file reads the same physical pages from the page cache.
+ */
+class MappedFile {
+    private:
+        const char* address; ///< Start of the mapping
+        size_t length; ///< Length of the file in bytes
+
+    public:
+        /**
+         * @brief Constructor which maps a file
+         * @param path Path of the file to map
+         * @throws std::runtime_error if the file cannot be opened, is empty, or cannot be mapped
+         */
+        explicit MappedFile(const std::string& path);
+
+        /**
+         * @brief Destructor which unmaps the file
+         */
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /**
+         * @brief Get the mapped bytes
+         * @return Pointer to the first byte of the file
+         */
+        const char* data() const { return address; }
+
+        /**
+         * @brief Get the size of the mapping
+         * @return Length of the file in bytes
+         */
+        size_t size() const { return length; }
+};
+
+
+/**
+ * @enum ModelType
+ * @brief Kind of model stored in a model file
+ */
+enum class ModelType : uint32_t {
+    DecisionTree = 1,
+    RandomForest = 2,
+    GradientBoostedTrees = 3
+};
+
+
+/**
+ * @struct ModelHeader
+ * @brief Fixed-size header at the start of every model file
+ *
+ * A model file is laid out as follows; every section starts at a multiple of 8 bytes so that the node arrays can be
+ * used in place once the file is mapped:
+ *
+ *     ModelHeader
+ *     names section:  num_names x (uint32 length, characters), padded to 8 bytes
+ *     classes section: double x num_classes
+ *     num_trees x tree section:
+ *         uint32 num_nodes, uint32 num_features
+ *         uint32 feature index x num_features, padded to 8 bytes
+ *         FlatNode x num_nodes
+ *
+ * The feature indices of a tree map the features the tree was trained on (in the order the tree indexes them) to
+ * positions in the sample passed to the model's predict method; a tree without feature indices indexes the sample
+ * directly. Values are stored in the byte order of the machine that wrote the file.
+ */
+struct ModelHeader {
+    char magic[4]; ///< Always "RFIM"
+    uint32_t version; ///< Format version; readers reject versions they do not know
+    uint32_t model_type; ///< One of the ModelType values
+    uint32_t num_trees; ///< Number of tree sections
+    uint32_t num_names; ///< Number of strings in the names section
+    int32_t max_depth; ///< Maximum depth the trees were grown with
+    int32_t min_samples_split; ///< Minimum number of samples required to split a node
+    int32_t num_features; ///< Number of features per tree (RandomForest), or -1 if not applicable
+    uint64_t random_state; ///< Random seed the model was trained with
+    double base_score; ///< Initial score added to every prediction (GradientBoostedTrees), otherwise 0
+    double learning_rate; ///< Learning rate (GradientBoostedTrees), otherwise 0
+    uint32_t num_classes; ///< Number of labels in the classes section (RandomForest), otherwise 0
+    uint32_t reserved; ///< Always 0; pads the header to a multiple of 8 bytes
+};
+
+static_assert(sizeof(ModelHeader) == 64, "ModelHeader is part of the model file format and must stay 64 bytes");
+
+/// Current version of the model file format
+constexpr uint32_t MODEL_FORMAT_VERSION = 2;
+
+
+/**
+ * @class ModelWriter
+ * @brief Builds a model file section by section
+ *
+ * @code
+ * ModelWriter writer(header);
+ * writer.write_names(feature_names);
+ * writer.write_classes({0, 1, 2});   // only if header.num_classes is not 0
+ * writer.write_tree(FlatTree(*root), {0, 2, 3});
+ * writer.save("model.bin");
+ * @endcode
+ */
+class ModelWriter {
+    private:
+        std::string buffer; ///< Bytes written so far
+        ModelHeader header; ///< Header of the file, used to check the sections against their announced counts
+        bool names_written; ///< Whether the names section has been written
+        bool classes_written; ///< Whether the classes section has been written
+        size_t trees_written; ///< Number of tree sections written so far
+
+        /**
+         * @brief Helper method which appends raw bytes to the buffer
+         */
+        void append(const void* bytes, size_t count);
+
+        /**
+         * @brief Helper method which pads the buffer with zeros up to a multiple of 8 bytes
+         */
+        void align();
+
+    public:
+        /**
+         * @brief Constructor for ModelWriter
+         * @param header Header of the file; the magic and version fields are filled in by the writer
+         */
+        explicit ModelWriter(ModelHeader header);
+
+        /**
+         * @brief Write the names section; must be called once, before the first tree is written
+         * @param names Strings of the names section
+         * @throws std::runtime_error if the section is written twice or does not hold header.num_names strings
+         */
+        void write_names(const std::vector<std::string>& names);
+
+        /**
+         * @brief Write the classes section; must be called once, after the names and before the first tree, unless the
+         *        header announces no classes
+         * @param classes Labels of the classes section
+         * @throws std::runtime_error if the section is out of order, written twice, or does not hold header.num_classes
+         *         labels
+         */
+        void write_classes(const std::vector<double>& classes);
+
+        /**
+         * @brief Write a tree section
+         * @param tree Nodes of the tree
+         * @param features Position in the model's samples of every feature the tree indexes; empty if the tree indexes
+         *                 the samples directly
+         * @throws std::runtime_error if the names or classes section has not been written or all announced trees were
+         *         written
+         */
+        void write_tree(const FlatTree& tree, const std::vector<size_t>& features);
+
+        /**
+         * @brief Write the file to disk
+         * @param path Path of the file
+         * @throws std::runtime_error if a section announced in the header is missing, or the file cannot be written
+         *
+         * The file is written to a temporary file in the same directory, flushed to disk, and renamed over path, so
+         * the target is replaced in one step. Models still mapping an earlier version of the file keep reading it
+         * unchanged, which makes it safe to overwrite a model that is being served.
+         */
+        void save(const std::string& path) const;
+};
+
+
+/**
+ * @class ModelReader
+ * @brief Reads a model file in place from a memory mapping
+ *
+ * The reader validates the header when it is constructed and then hands out the sections in file order. Trees are
+ * returned as FlatTree views into the mapping, so nothing is copied; the mapping must be kept alive (see mapping())
+ * for as long as the trees are used.
+ */
+class ModelReader {
+    private:
+        std::shared_ptr<const MappedFile> file; ///< Mapping of the model file
+        ModelHeader model_header; ///< Copy of the validated header
+        std::vector<std::string> model_names; ///< Strings of the names section
+        std::vector<double> model_classes; ///< Labels of the classes section
+        size_t offset; ///< Offset of the next unread byte
+        size_t trees_read; ///< Number of tree sections read so far
+
+        /**
+         * @brief Helper method which consumes bytes from the mapping
+         * @param count Number of bytes to consume
+         * @return Pointer to the first consumed byte
+         * @throws std::runtime_error if the file ends too early
+         */
+        const char* take(size_t count);
+
+        /**
+         * @brief Helper method which skips the padding up to the next multiple of 8 bytes
+         */
+        void align();
+
+    public:
+        /**
+         * @brief Constructor which maps a model file, validates its header, and reads the names and classes sections
+         * @param path Path of the model file
+         * @param expected_type Kind of model the caller wants to load
+         * @throws std::runtime_error if the file cannot be mapped, is not a model file, has an unsupported version,
+         *         or holds a different kind of model
+         */
+        ModelReader(const std::string& path, ModelType expected_type);
+
+        /**
+         * @brief Get the header of the file
+         * @return Reference to the header
+         */
+        const ModelHeader& header() const { return model_header; }
+
+        /**
+         * @brief Get the strings of the names section
+         * @return Reference to the names, which are read together with the header
+         */
+        const std::vector<std::string>& names() const { return model_names; }
+
+        /**
+         * @brief Get the labels of the classes section
+         * @return Reference to the labels, which are read together with the header; empty if the model has no classes
+         */
+        const std::vector<double>& classes() const { return model_classes; }
+
+        /**
+         * @brief Read the next tree section
+         * @param features Receives the position in the model's samples of every feature the tree indexes; empty if the
+         *                 tree indexes the samples directly
+         * @return View of the tree's nodes inside the mapping
+         * @throws std::runtime_error if the file is truncated, all trees have been read, or a node uses a feature
+         *         outside of the feature list
+         */
+        FlatTree read_tree(std::vector<size_t>& features);
+
+        /**
+         * @brief Get the mapping that backs the trees returned by read_tree
+         * @return Shared pointer to the mapping
+         */
+        std::shared_ptr<const MappedFile> mapping() const { return file; }
+};
+
+#endif // SERIALIZATION_H
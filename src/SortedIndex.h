@@ -0,0 +1,144 @@
+#ifndef SORTEDINDEX_H
+#define SORTEDINDEX_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DataFrame.h"
+
+
+/**
+ * @class SortedIndex
+ * @brief Numeric values of the features of a data set, with the row ids of every feature sorted by value
+ *
+ * The index is built once per data set, which sorts every feature once, and is then only read: all trees of a
+ * RandomForest and all rounds of GradientBoostedTrees share it, whatever rows they sample. A tree walks the sorted rows
+ * of a node to evaluate a feature's splits and to find the median threshold, and hands its children the rows on either
+ * side with a stable partition, which keeps them sorted; no node ever sorts again.
+ *
+ * Rows with equal values keep their original order (the sort is stable), so the index does not depend on the sort
+ * implementation. NaN values sort after all others, as if they were the largest value. Row ids are 32 bits wide, half the size of size_t, since the sorted rows are what the split search
+ * streams through.
+ *
+ * @code
+ * SortedIndex index(*df, {"a", "b"});
+ * const vector<double>& values = index.get_values(index.find("b"));
+ * for (uint32_t row : index.get_order(index.find("b"))) { ... }   // rows by ascending value of b
+ * @endcode
+ */
+class SortedIndex {
+    private:
+        std::vector<std::string> features; ///< Name of every indexed feature
+        std::vector<std::vector<double>> values; ///< Value of every row, one array per feature
+        std::vector<std::vector<uint32_t>> order; ///< Row ids sorted (stably) by value, one array per feature
+        size_t num_rows; ///< Rows of the data set
+
+    public:
+        /**
+         * @brief Constructor for SortedIndex, which converts and sorts the given columns
+         * @param df Data set to index
+         * @param features Names of the columns to index, in the order they are numbered by the index
+         * @throws std::invalid_argument if a column is not found
+         * @throws std::length_error if the data set has more rows than a 32-bit row id can address
+         */
+        SortedIndex(const DataFrame& df, const std::vector<std::string>& features)
+            : features(features), num_rows(df.get_num_rows()) {
+            if (num_rows > std::numeric_limits<uint32_t>::max()) {
+                throw std::length_error("Too many rows for a SortedIndex");
+            }
+            values.reserve(features.size());
+            order.reserve(features.size());
+            for (const auto& feature : features) {
+                if (std::find(df.columns.begin(), df.columns.end(), feature) == df.columns.end()) {
+                    throw std::invalid_argument("Column not found: " + feature);
+                }
+                values.push_back(df.get_column(feature).convert_to_numeric());
+
+                const std::vector<double>& column = values.back();
+                std::vector<uint32_t> rows(num_rows);
+                std::iota(rows.begin(), rows.end(), 0);
+                std::stable_sort(rows.begin(), rows.end(), [&column](uint32_t a, uint32_t b) {
+                    return !std::isnan(column[a]) && (std::isnan(column[b]) || column[a] < column[b]);
+                });
+                order.push_back(std::move(rows));
+            }
+        }
+
+        /**
+         * @brief Get the number of rows of the indexed data set
+         * @return Number of rows
+         */
+        size_t get_num_rows() const {
+            return num_rows;
+        }
+
+        /**
+         * @brief Get the number of indexed features
+         * @return Number of features
+         */
+        size_t get_num_features() const {
+            return features.size();
+        }
+
+        /**
+         * @brief Get the names of the indexed features
+         * @return Names, in the order the index numbers them
+         */
+        const std::vector<std::string>& get_features() const {
+            return features;
+        }
+
+        /**
+         * @brief Find a feature by name
+         * @param feature Name of the feature
+         * @return Number of the feature in the index
+         * @throws std::invalid_argument if the feature is not indexed
+         */
+        size_t find(const std::string& feature) const {
+            auto it = std::find(features.begin(), features.end(), feature);
+            if (it == features.end()) {
+                throw std::invalid_argument("Feature not indexed: " + feature);
+            }
+            return static_cast<size_t>(it - features.begin());
+        }
+
+        /**
+         * @brief Get the values of a feature
+         * @param feature Number of the feature
+         * @return Value of every row, by row id
+         */
+        const std::vector<double>& get_values(size_t feature) const {
+            return values[feature];
+        }
+
+        /**
+         * @brief Get the rows of a feature sorted by value
+         * @param feature Number of the feature
+         * @return Every row id once, by ascending value and with the NaNs last; rows with equal values (or both NaN) in
+         *         their original order
+         */
+        const std::vector<uint32_t>& get_order(size_t feature) const {
+            return order[feature];
+        }
+
+        /**
+         * @brief Get the memory footprint of the index
+         * @return Approximate number of bytes held by the index
+         */
+        size_t memory_usage() const {
+            size_t bytes = sizeof(*this);
+            for (size_t f = 0; f < features.size(); ++f) {
+                bytes += features[f].capacity() + values[f].capacity() * sizeof(double) + order[f].capacity() * sizeof(uint32_t);
+            }
+            return bytes + features.capacity() * sizeof(std::string) + values.capacity() * sizeof(std::vector<double>)
+                   + order.capacity() * sizeof(std::vector<uint32_t>);
+        }
+};
+
+#endif // SORTEDINDEX_H
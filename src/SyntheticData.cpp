@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "DataFrame.h"
+#include "SyntheticData.h"
+
+static const char BINARY_MAGIC[4] = {'R', 'F', 'S', 'D'};
+static const uint32_t BINARY_VERSION = 1;
+
+
+// splitmix64 stream; cheap to seed, so every row can have its own
+struct RowRandom {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // Uniform in (0, 1]
+    double uniform() {
+        return static_cast<double>((next() >> 11) + 1) * 0x1.0p-53;
+    }
+
+    double normal() {
+        const double two_pi = 6.283185307179586;
+        return std::sqrt(-2.0 * std::log(uniform())) * std::cos(two_pi * uniform());
+    }
+};
+
+
+void SyntheticSpec::validate() const {
+    if (num_rows == 0) {
+        throw std::invalid_argument("A synthetic data set needs at least one row");
+    }
+    if (num_numeric + num_categorical == 0) {
+        throw std::invalid_argument("A synthetic data set needs at least one feature column");
+    }
+    if (num_classes < 2) {
+        throw std::invalid_argument("A synthetic data set needs at least two classes");
+    }
+    if (num_categorical > 0 && cardinality == 0) {
+        throw std::invalid_argument("Categorical columns need a cardinality of at least 1");
+    }
+    if (!(label_noise >= 0.0 && label_noise <= 1.0)) {
+        throw std::invalid_argument("Label noise must be in the interval [0, 1]");
+    }
+}
+
+
+SyntheticData::SyntheticData(const SyntheticSpec& spec) : spec(spec) {
+    spec.validate();
+
+    // The hidden score is normalized by its standard deviation, so its quantiles split the rows evenly
+    std::mt19937_64 generator(spec.seed);
+    std::normal_distribution<double> weight(0.0, 1.0);
+    double variance = 0.0;
+    for (size_t f = 0; f < spec.num_numeric; ++f) {
+        numeric_weights.push_back(weight(generator));
+        variance += numeric_weights.back() * numeric_weights.back();
+    }
+    for (size_t c = 0; c < spec.num_categorical; ++c) {
+        double sum = 0.0, sum_squares = 0.0;
+        for (size_t k = 0; k < spec.cardinality; ++k) {
+            category_effects.push_back(weight(generator));
+            sum += category_effects.back();
+            sum_squares += category_effects.back() * category_effects.back();
+        }
+        double mean = sum / spec.cardinality;
+        variance += sum_squares / spec.cardinality - mean * mean;
+    }
+    score_scale = variance > 0.0 ? std::sqrt(variance) : 1.0;
+}
+
+int SyntheticData::draw_row(size_t row, std::vector<double>& numeric, std::vector<size_t>& categories) const {
+    RowRandom random{spec.seed ^ (static_cast<uint64_t>(row) * 0xD1B54A32D192ED03ULL)};
+    random.next();
+
+    double score = 0.0;
+    numeric.resize(spec.num_numeric);
+    for (size_t f = 0; f < spec.num_numeric; ++f) {
+        numeric[f] = std::round(random.normal() * 1000.0) / 1000.0;
+        score += numeric_weights[f] * numeric[f];
+    }
+    categories.resize(spec.num_categorical);
+    for (size_t c = 0; c < spec.num_categorical; ++c) {
+        categories[c] = random.next() % spec.cardinality;
+        score += category_effects[c * spec.cardinality + categories[c]];
+    }
+
+    // Class = quantile of the standardized score
+    double quantile = 0.5 * std::erfc(-score / score_scale / std::sqrt(2.0));
+    int label = static_cast<int>(std::min(quantile * spec.num_classes, static_cast<double>(spec.num_classes - 1)));
+    if (random.uniform() <= spec.label_noise) {
+        label = static_cast<int>(random.next() % spec.num_classes);
+    }
+    return label;
+}
+
+std::vector<std::string> SyntheticData::columns() const {
+    std::vector<std::string> names;
+    for (size_t f = 0; f < spec.num_numeric; ++f) {
+        names.push_back("n" + std::to_string(f));
+    }
+    for (size_t c = 0; c < spec.num_categorical; ++c) {
+        names.push_back("c" + std::to_string(c));
+    }
+    names.push_back("label");
+    return names;
+}
+
+std::unique_ptr<DataFrame> SyntheticData::to_dataframe() const {
+    size_t num_columns = spec.num_numeric + spec.num_categorical + 1;
+    std::vector<std::vector<Cell>> cells(num_columns);
+    for (auto& column : cells) {
+        column.reserve(spec.num_rows);
+    }
+
+    std::vector<double> numeric;
+    std::vector<size_t> categories;
+    for (size_t row = 0; row < spec.num_rows; ++row) {
+        int label = draw_row(row, numeric, categories);
+        for (size_t f = 0; f < spec.num_numeric; ++f) {
+            cells[f].push_back(numeric[f]);
+        }
+        for (size_t c = 0; c < spec.num_categorical; ++c) {
+            cells[spec.num_numeric + c].push_back("v" + std::to_string(categories[c]));
+        }
+        cells.back().push_back(label);
+    }
+
+    auto df = std::make_unique<DataFrame>();
+    std::vector<std::string> names = columns();
+    for (size_t i = 0; i < num_columns; ++i) {
+        df->add_column(names[i], Series(std::move(cells[i])));
+    }
+    return df;
+}
+
+void SyntheticData::write_csv(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open file for writing: " + path);
+    }
+
+    std::vector<std::string> names = columns();
+    for (size_t i = 0; i < names.size(); ++i) {
+        file << (i ? "," : "") << names[i];
+    }
+    file << "\n";
+
+    std::vector<double> numeric;
+    std::vector<size_t> categories;
+    std::string line;
+    char value[32];
+    for (size_t row = 0; row < spec.num_rows; ++row) {
+        int label = draw_row(row, numeric, categories);
+        line.clear();
+        for (double x : numeric) {
+            std::snprintf(value, sizeof(value), "%.3f,", x);
+            line += value;
+        }
+        for (size_t k : categories) {
+            line += "v" + std::to_string(k) + ",";
+        }
+        line += std::to_string(label);
+        line += '\n';
+        file.write(line.data(), static_cast<std::streamsize>(line.size()));
+    }
+    if (!file) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+void SyntheticData::write_binary(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open file for writing: " + path);
+    }
+
+    std::vector<std::string> names = columns();
+    uint64_t num_rows = spec.num_rows;
+    uint32_t num_columns = static_cast<uint32_t>(names.size());
+    file.write(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    file.write(reinterpret_cast<const char*>(&BINARY_VERSION), sizeof(BINARY_VERSION));
+    file.write(reinterpret_cast<const char*>(&num_rows), sizeof(num_rows));
+    file.write(reinterpret_cast<const char*>(&num_columns), sizeof(num_columns));
+    for (const auto& name : names) {
+        uint32_t length = static_cast<uint32_t>(name.size());
+        file.write(reinterpret_cast<const char*>(&length), sizeof(length));
+        file.write(name.data(), length);
+    }
+
+    std::vector<double> numeric;
+    std::vector<size_t> categories;
+    std::vector<double> values(num_columns);
+    for (size_t row = 0; row < spec.num_rows; ++row) {
+        int label = draw_row(row, numeric, categories);
+        std::copy(numeric.begin(), numeric.end(), values.begin());
+        for (size_t c = 0; c < categories.size(); ++c) {
+            values[spec.num_numeric + c] = static_cast<double>(categories[c]);
+        }
+        values.back() = label;
+        file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(double)));
+    }
+    if (!file) {
+        throw std::runtime_error("Could not write file: " + path);
+    }
+}
+
+std::unique_ptr<DataFrame> SyntheticData::read_binary(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        throw std::runtime_error("Could not open file: " + path);
+    }
+
+    char magic[4];
+    uint32_t version = 0;
+    uint64_t num_rows = 0;
+    uint32_t num_columns = 0;
+    file.read(magic, sizeof(magic));
+    file.read(reinterpret_cast<char*>(&version), sizeof(version));
+    file.read(reinterpret_cast<char*>(&num_rows), sizeof(num_rows));
+    file.read(reinterpret_cast<char*>(&num_columns), sizeof(num_columns));
+    if (!file || std::memcmp(magic, BINARY_MAGIC, sizeof(magic)) != 0 || version != BINARY_VERSION || num_columns == 0) {
+        throw std::runtime_error("Not a synthetic data file: " + path);
+    }
+
+    std::vector<std::string> names(num_columns);
+    for (auto& name : names) {
+        uint32_t length = 0;
+        file.read(reinterpret_cast<char*>(&length), sizeof(length));
+        if (!file || length > 4096) {
+            throw std::runtime_error("Synthetic data file has an invalid column name: " + path);
+        }
+        name.resize(length);
+        file.read(&name[0], length);
+    }
+
+    std::vector<std::vector<Cell>> cells(num_columns);
+    std::vector<double> values(num_columns);
+    for (uint64_t row = 0; row < num_rows; ++row) {
+        file.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(double)));
+        if (!file) {
+            throw std::runtime_error("Synthetic data file is truncated: " + path);
+        }
+        for (uint32_t i = 0; i + 1 < num_columns; ++i) {
+            cells[i].push_back(values[i]);
+        }
+        cells.back().push_back(static_cast<int>(values.back()));
+    }
+
+    auto df = std::make_unique<DataFrame>();
+    for (uint32_t i = 0; i < num_columns; ++i) {
+        df->add_column(names[i], Series(std::move(cells[i])));
+    }
+    return df;
+}
@@ -0,0 +1,123 @@
+#ifndef SYNTHETICDATA_H
+#define SYNTHETICDATA_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "DataFrame.h"
+
+
+/**
+ * @struct SyntheticSpec
+ * @brief Shape and seed of a synthetic classification data set
+ */
+struct SyntheticSpec {
+    size_t num_rows = 1000; ///< Number of rows
+    size_t num_numeric = 8; ///< Number of numeric feature columns, named n0, n1, ...
+    size_t num_categorical = 0; ///< Number of categorical feature columns, named c0, c1, ...
+    size_t cardinality = 8; ///< Number of distinct values of every categorical column
+    size_t num_classes = 2; ///< Number of classes of the label column, named label
+    double label_noise = 0.0; ///< Fraction of the rows, in [0, 1], whose label is replaced by a uniformly random class
+    uint64_t seed = 42; ///< Seed of every random draw
+
+    /**
+     * @brief Check that the spec describes a data set
+     * @throws std::invalid_argument if there are no rows, no feature columns, fewer than two classes, categorical
+     *         columns with a cardinality of 0, or a label noise outside [0, 1]
+     */
+    void validate() const;
+};
+
+
+/**
+ * @class SyntheticData
+ * @brief Generator of synthetic classification data sets of any size
+ *
+ * Numeric features are standard normal values rounded to three decimals, and categorical features take the values
+ * v0 ... v(cardinality - 1) uniformly. The label is the class whose quantile of a hidden score the row falls in: the
+ * score is a random linear function of the numeric features plus a random effect of every categorical value, so the
+ * classes are about equally frequent and can be learned from the features. The given fraction of labels is then
+ * replaced by random classes.
+ *
+ * Every row is drawn from its own random stream, derived from the seed and the row number, so a row does not depend on
+ * the rows before it: the same spec always yields the same data, and writing a file of 100M rows streams it row by row
+ * in constant memory.
+ *
+ * @code
+ * SyntheticSpec spec;
+ * spec.num_rows = 10000000;
+ * spec.num_categorical = 2;
+ * spec.num_classes = 3;
+ * spec.label_noise = 0.05;
+ * SyntheticData(spec).write_csv("synthetic.csv");
+ * @endcode
+ */
+class SyntheticData {
+    private:
+        SyntheticSpec spec; ///< Shape of the data set
+        std::vector<double> numeric_weights; ///< Weight of every numeric feature in the hidden score
+        std::vector<double> category_effects; ///< Effect of value k of categorical column j, at j * cardinality + k
+        double score_scale; ///< Standard deviation of the hidden score
+
+        /**
+         * @brief Helper method which draws one row
+         * @param row Row number
+         * @param numeric Receives the numeric feature values
+         * @param categories Receives the value index of every categorical feature
+         * @return Class of the row
+         */
+        int draw_row(size_t row, std::vector<double>& numeric, std::vector<size_t>& categories) const;
+
+    public:
+        /**
+         * @brief Constructor for SyntheticData
+         * @param spec Shape and seed of the data set
+         * @throws std::invalid_argument if the spec is invalid
+         */
+        explicit SyntheticData(const SyntheticSpec& spec);
+
+        /**
+         * @brief Get the column names
+         * @return The numeric columns, the categorical columns, and the label column, in file order
+         */
+        std::vector<std::string> columns() const;
+
+        /**
+         * @brief Build the data set as a DataFrame
+         * @return DataFrame with double numeric columns, string categorical columns, and an int label column
+         */
+        std::unique_ptr<DataFrame> to_dataframe() const;
+
+        /**
+         * @brief Write the data set as a CSV file that DataFrame::read_csv can read
+         * @param path Path of the file
+         * @throws std::runtime_error if the file cannot be written
+         */
+        void write_csv(const std::string& path) const;
+
+        /**
+         * @brief Write the data set as a binary file
+         * @param path Path of the file
+         * @throws std::runtime_error if the file cannot be written
+         *
+         * The file holds the magic "RFSD", uint32 version 1, uint64 number of rows, uint32 number of columns, every
+         * column name as a uint32 length and its characters, and then the rows, every value as a double in host byte
+         * order: categorical values as their value index and the label as its class.
+         *
+         * @see read_binary()
+         */
+        void write_binary(const std::string& path) const;
+
+        /**
+         * @brief Read a binary file written by write_binary
+         * @param path Path of the file
+         * @return DataFrame with a double column per feature, categorical columns holding the value index, and an int
+         *         label column
+         * @throws std::runtime_error if the file cannot be read or is not a synthetic data file
+         */
+        static std::unique_ptr<DataFrame> read_binary(const std::string& path);
+};
+
+#endif // SYNTHETICDATA_H
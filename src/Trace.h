@@ -0,0 +1,217 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+
+/**
+ * @struct TraceEvent
+ * @brief One finished span, in microseconds since the recorder started
+ */
+struct TraceEvent {
+    const char* name; ///< Name of the span; a string literal
+    const char* category; ///< Category of the span, e.g. "data", "train" or "score"; a string literal
+    uint64_t start_us; ///< Start of the span
+    uint64_t duration_us; ///< Length of the span
+    uint32_t thread_id; ///< Small id of the thread that ran the span, see TraceRecorder::thread_id()
+    const char* arg_name; ///< Name of the optional integer argument, or null
+    int64_t arg_value; ///< Value of the optional integer argument
+};
+
+
+/**
+ * @class TraceRecorder
+ * @brief Process-wide collector of trace spans, written as Chrome trace-event JSON
+ *
+ * Spans are recorded by TraceSpan, normally through the RF_TRACE_SCOPE macros, which compile to nothing unless the
+ * program is built with RF_ENABLE_TRACING defined (cmake -DRF_ENABLE_TRACING=ON, or make TRACING=1). The recorder
+ * itself is always available, so a program can write the trace unconditionally; it is empty in a build without
+ * tracing.
+ *
+ * The spans are the coarse phases of loading, training and scoring (one per data set operation, tree or fold, never
+ * one per node or row), so a mutex around the event list costs nothing measurable. The written file opens in
+ * chrome://tracing or https://ui.perfetto.dev, with one track per thread, which shows how well the tree tasks of
+ * RandomForest::fit overlap and which of them straggle.
+ *
+ * @code
+ * {
+ *     RF_TRACE_SCOPE("load", "data");
+ *     df = DataFrame::read_csv("data.csv");
+ * }
+ * TraceRecorder::instance().write_json("trace.json");
+ * @endcode
+ */
+class TraceRecorder {
+    private:
+        mutable std::mutex mutex; ///< Guards events
+        std::vector<TraceEvent> events; ///< Finished spans, in the order they ended
+        std::chrono::steady_clock::time_point epoch; ///< Time 0 of the trace
+
+        TraceRecorder() : epoch(std::chrono::steady_clock::now()) {}
+
+        static void write_escaped(std::ostream& out, const char* text) {
+            for (; *text; ++text) {
+                if (*text == '"' || *text == '\\') {
+                    out << '\\';
+                }
+                out << *text;
+            }
+        }
+
+    public:
+        TraceRecorder(const TraceRecorder&) = delete;
+        TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+        /**
+         * @brief Get the recorder of the process
+         * @return The recorder every TraceSpan reports to
+         */
+        static TraceRecorder& instance() {
+            static TraceRecorder recorder;
+            return recorder;
+        }
+
+        /**
+         * @brief Get the id of the calling thread
+         * @return Small number, 1 for the first thread that asks, 2 for the next, ...; stable for the life of the thread
+         */
+        static uint32_t thread_id() {
+            static std::atomic<uint32_t> next_id{1};
+            thread_local uint32_t id = next_id.fetch_add(1);
+            return id;
+        }
+
+        /**
+         * @brief Get the current time of the trace
+         * @return Microseconds since the recorder was created
+         */
+        uint64_t now_us() const {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::steady_clock::now() - epoch).count());
+        }
+
+        /**
+         * @brief Add a finished span
+         * @param event The span
+         */
+        void record(const TraceEvent& event) {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.push_back(event);
+        }
+
+        /**
+         * @brief Get the finished spans
+         * @return Copy of the spans recorded so far, in the order they ended
+         */
+        std::vector<TraceEvent> get_events() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return events;
+        }
+
+        /**
+         * @brief Drop all recorded spans
+         */
+        void clear() {
+            std::lock_guard<std::mutex> lock(mutex);
+            events.clear();
+        }
+
+        /**
+         * @brief Format the recorded spans as Chrome trace-event JSON
+         * @return JSON object whose traceEvents array holds one complete ("X") event per span
+         */
+        std::string to_json() const {
+            std::vector<TraceEvent> snapshot = get_events();
+            std::ostringstream out;
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+            for (size_t i = 0; i < snapshot.size(); ++i) {
+                const TraceEvent& e = snapshot[i];
+                out << (i ? "," : "") << "\n  {\"name\": \"";
+                write_escaped(out, e.name);
+                out << "\", \"cat\": \"";
+                write_escaped(out, e.category);
+                out << "\", \"ph\": \"X\", \"ts\": " << e.start_us << ", \"dur\": " << e.duration_us
+                    << ", \"pid\": 1, \"tid\": " << e.thread_id;
+                if (e.arg_name) {
+                    out << ", \"args\": {\"";
+                    write_escaped(out, e.arg_name);
+                    out << "\": " << e.arg_value << "}";
+                }
+                out << "}";
+            }
+            out << "\n]}\n";
+            return out.str();
+        }
+
+        /**
+         * @brief Write the recorded spans to a file
+         * @param path Path of the JSON file
+         * @throws std::runtime_error if the file cannot be written
+         * @see to_json()
+         */
+        void write_json(const std::string& path) const {
+            std::ofstream file(path);
+            if (!file) {
+                throw std::runtime_error("Could not open file for writing: " + path);
+            }
+            file << to_json();
+            if (!file) {
+                throw std::runtime_error("Could not write file: " + path);
+            }
+        }
+};
+
+
+/**
+ * @class TraceSpan
+ * @brief Scoped span: records the time from its construction to its destruction on the calling thread
+ */
+class TraceSpan {
+    private:
+        TraceEvent event; ///< The span; its duration is filled in by the destructor
+
+    public:
+        /**
+         * @brief Constructor for TraceSpan, which starts the span
+         * @param name Name of the span; must be a string literal or otherwise outlive the recorder
+         * @param category Category of the span; same lifetime requirement as name
+         * @param arg_name Name of an integer shown with the span, e.g. "tree"; null for none
+         * @param arg_value Value of that integer
+         */
+        TraceSpan(const char* name, const char* category, const char* arg_name = nullptr, int64_t arg_value = 0)
+                : event{name, category, TraceRecorder::instance().now_us(), 0, TraceRecorder::thread_id(), arg_name, arg_value} {}
+
+        TraceSpan(const TraceSpan&) = delete;
+        TraceSpan& operator=(const TraceSpan&) = delete;
+
+        ~TraceSpan() {
+            TraceRecorder& recorder = TraceRecorder::instance();
+            event.duration_us = recorder.now_us() - event.start_us;
+            recorder.record(event);
+        }
+};
+
+
+#define RF_TRACE_CONCAT_INNER(a, b) a##b
+#define RF_TRACE_CONCAT(a, b) RF_TRACE_CONCAT_INNER(a, b)
+
+#ifdef RF_ENABLE_TRACING
+/// Records a span named name in category from here to the end of the enclosing scope
+#define RF_TRACE_SCOPE(name, category) TraceSpan RF_TRACE_CONCAT(rf_trace_span_, __LINE__)(name, category)
+/// Like RF_TRACE_SCOPE, with an integer argument shown with the span
+#define RF_TRACE_SCOPE_ARG(name, category, arg_name, arg_value) \
+    TraceSpan RF_TRACE_CONCAT(rf_trace_span_, __LINE__)(name, category, arg_name, static_cast<int64_t>(arg_value))
+#else
+#define RF_TRACE_SCOPE(name, category) ((void)0)
+#define RF_TRACE_SCOPE_ARG(name, category, arg_name, arg_value) ((void)0)
+#endif
+
+#endif // TRACE_H
@@ -0,0 +1,88 @@
+#ifndef TRAININGSTATS_H
+#define TRAININGSTATS_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <sstream>
+#include <string>
+
+
+/**
+ * @struct TrainingStats
+ * @brief Work done and time spent by one call to fit
+ *
+ * Every Classifier::fit returns one. For a single tree the counters describe that tree; an ensemble adds up the
+ * statistics of its trees with add(), keeping the deepest depth, so the phase times of a RandomForest are the time
+ * spent on all threads together, while fit_seconds is the wall time of the fit call itself.
+ *
+ * The split search of DecisionTree scores one partition per distinct value of every candidate feature, so
+ * candidate_thresholds counts those values; ObliviousTree counts the median thresholds it proposes per level.
+ *
+ * @code
+ * RandomForest rf(100, 8, 2, 3);
+ * TrainingStats stats = rf.fit(data, "label");
+ * std::cout << stats.print();
+ * @endcode
+ */
+struct TrainingStats {
+    size_t num_trees = 0; ///< Number of trees grown
+    size_t nodes = 0; ///< Nodes created, leaves included
+    size_t leaves = 0; ///< Leaves created
+    size_t depth = 0; ///< Deepest level reached; the root is at depth 0
+    size_t rows_scanned = 0; ///< Rows read by the split search, once per candidate feature (or threshold) of every node
+    size_t candidate_thresholds = 0; ///< Split points whose impurity was computed
+    size_t bytes_allocated = 0; ///< Estimated bytes of the data sets built for the child nodes
+    double split_search_seconds = 0.0; ///< Time spent choosing the splits
+    double partition_seconds = 0.0; ///< Time spent dividing the rows of a node between its children
+    double leaf_seconds = 0.0; ///< Time spent computing the values of the leaves
+    double fit_seconds = 0.0; ///< Wall time of the whole fit call
+
+    /**
+     * @brief Add the statistics of another tree or ensemble
+     * @param other Statistics to add; its fit_seconds is not added, since an ensemble times its own fit
+     */
+    void add(const TrainingStats& other) {
+        num_trees += other.num_trees;
+        nodes += other.nodes;
+        leaves += other.leaves;
+        depth = std::max(depth, other.depth);
+        rows_scanned += other.rows_scanned;
+        candidate_thresholds += other.candidate_thresholds;
+        bytes_allocated += other.bytes_allocated;
+        split_search_seconds += other.split_search_seconds;
+        partition_seconds += other.partition_seconds;
+        leaf_seconds += other.leaf_seconds;
+    }
+
+    /**
+     * @brief Get the seconds elapsed since a point in time
+     * @param start Start of the interval
+     * @return Seconds from start until now
+     */
+    static double seconds_since(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    /**
+     * @brief Format the statistics as a human readable report
+     * @return One "name: value" line per statistic
+     */
+    std::string print() const {
+        std::ostringstream oss;
+        oss << "trees: " << num_trees << "\n"
+            << "nodes: " << nodes << "\n"
+            << "leaves: " << leaves << "\n"
+            << "depth: " << depth << "\n"
+            << "rows scanned: " << rows_scanned << "\n"
+            << "candidate thresholds: " << candidate_thresholds << "\n"
+            << "bytes allocated: " << bytes_allocated << "\n"
+            << "split search: " << split_search_seconds << " s\n"
+            << "partition: " << partition_seconds << " s\n"
+            << "leaf creation: " << leaf_seconds << " s\n"
+            << "fit: " << fit_seconds << " s\n";
+        return oss.str();
+    }
+};
+
+#endif // TRAININGSTATS_H
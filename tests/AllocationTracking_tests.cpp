@@ -0,0 +1,161 @@
+#include <gtest/gtest.h>
+#include "../src/AllocationTracking.h"
+#include "../src/DataFrame.h"
+#include "../src/DecisionTree.h"
+#include "../src/RandomForest.h"
+#include <limits>
+#include <memory>
+#include <new>
+#include <thread>
+#include <vector>
+
+using std::vector;
+
+
+/**
+ * @brief Unit Test for the AllocationScope class
+ *
+ * @test Test that every form of operator new is counted, on the calling thread or across the whole process
+ */
+TEST(AllocationTrackingTest, CountingTest) {
+    // The counts are read before any assertion, since gtest allocates too
+    AllocationScope thread_scope;
+    auto value = std::make_unique<double>(1.0);
+    auto values = std::make_unique<int[]>(10);
+    vector<char> buffer;
+    buffer.reserve(100);
+    AllocationCounts counts = thread_scope.counts();
+
+    // Freeing memory does not change the counts
+    value.reset();
+    values.reset();
+    AllocationCounts after_free = thread_scope.counts();
+
+    EXPECT_EQ(counts.allocations, 3);
+    EXPECT_EQ(counts.bytes, sizeof(double) + 10 * sizeof(int) + 100);
+    EXPECT_EQ(after_free.allocations, 3);
+
+    // Another thread's allocations only show up in the process-wide scope
+    AllocationScope process_scope(true);
+    std::thread worker([]() { vector<double> other(1000); });
+    AllocationScope joined_scope;
+    worker.join();
+    AllocationCounts joined = joined_scope.counts();
+    AllocationCounts process = process_scope.counts();
+
+    EXPECT_EQ(joined.allocations, 0);
+    EXPECT_GE(process.allocations, 1);
+    EXPECT_GE(process.bytes, 1000 * sizeof(double));
+}
+
+// Number of times new_handler_calls_twice has been called; it uninstalls itself on the second call
+static int new_handler_calls = 0;
+
+static void new_handler_calls_twice() {
+    if (++new_handler_calls == 2) {
+        std::set_new_handler(nullptr);
+    }
+}
+
+/**
+ * @brief Unit Test for the replaced operator new
+ *
+ * @test Test that a failed allocation calls the new handler until it is uninstalled, and then throws std::bad_alloc,
+ *       or returns nullptr for the nothrow forms
+ */
+TEST(AllocationTrackingTest, NewHandlerTest) {
+    volatile std::size_t huge = std::numeric_limits<std::size_t>::max() / 2;
+
+    std::set_new_handler(new_handler_calls_twice);
+    EXPECT_THROW(::operator delete(::operator new(huge)), std::bad_alloc);
+    EXPECT_EQ(new_handler_calls, 2);
+
+    new_handler_calls = 0;
+    std::set_new_handler(new_handler_calls_twice);
+    EXPECT_EQ(::operator new(huge, std::align_val_t(64), std::nothrow), nullptr);
+    EXPECT_EQ(new_handler_calls, 2);
+    EXPECT_EQ(std::get_new_handler(), nullptr);
+}
+
+/**
+ * @brief Unit Test for the AllocationScope class
+ *
+ * @test Test the allocation budgets of inference: none per DecisionTree::predict or (once warm) RandomForest::predict,
+ *       and a number per batch that does not grow with the rows of the batch
+ */
+TEST(AllocationTrackingTest, PredictBudgetTest) {
+    std::shared_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(60);
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+
+    DecisionTree dt(4, 2);
+    dt.fit(df, "weather");
+    RandomForest rf(4, 4, 2, 2, 123456);
+    rf.fit(df, "weather");
+
+    vector<double> sample = {0.0, 12.8, 5.0, 4.7};
+    vector<double> small_batch, large_batch;
+    for (int i = 0; i < 50; ++i) {
+        vector<double>& batch = i < 5 ? small_batch : large_batch;
+        batch.insert(batch.end(), sample.begin(), sample.end());
+    }
+
+    AllocationScope tree_scope;
+    dt.predict(sample);
+    AllocationCounts tree = tree_scope.counts();
+    EXPECT_EQ(tree.allocations, 0);
+
+    // The batch only allocates its result
+    AllocationScope tree_batch_scope;
+    vector<double> predictions = dt.predict_batch(large_batch, 4);
+    AllocationCounts tree_batch = tree_batch_scope.counts();
+    EXPECT_EQ(tree_batch.allocations, 1);
+    EXPECT_EQ(tree_batch.bytes, predictions.size() * sizeof(double));
+
+    // A forest keeps its per-tree scratch per thread, so only the first prediction of a thread allocates
+    rf.predict(sample);
+    AllocationScope forest_scope;
+    rf.predict(sample);
+    AllocationCounts forest = forest_scope.counts();
+    EXPECT_EQ(forest.allocations, 0);
+
+    rf.set_inference_engine(InferenceEngine::Compact);
+    rf.predict(sample);
+    AllocationScope compact_scope;
+    rf.predict(sample);
+    AllocationCounts compact = compact_scope.counts();
+    EXPECT_EQ(compact.allocations, 0);
+
+    rf.set_inference_engine(InferenceEngine::QuickScorer);
+    rf.predict(sample);
+    AllocationScope quick_scope;
+    rf.predict(sample);
+    AllocationCounts quick = quick_scope.counts();
+    EXPECT_EQ(quick.allocations, 0);
+    rf.set_inference_engine(InferenceEngine::Pointer);
+
+    AllocationScope small_scope;
+    rf.predict_batch(small_batch, 4);
+    AllocationCounts small = small_scope.counts();
+    AllocationScope large_scope;
+    rf.predict_batch(large_batch, 4);
+    AllocationCounts large = large_scope.counts();
+    EXPECT_EQ(large.allocations, small.allocations);
+
+    // The flat trees are collected by fit, so a warm one-row batch only allocates its result, like predict
+    rf.predict_batch(sample, 4);
+    AllocationScope one_row_scope;
+    vector<double> one_row = rf.predict_batch(sample, 4);
+    AllocationCounts one_row_counts = one_row_scope.counts();
+    EXPECT_EQ(one_row_counts.allocations, 1);
+    EXPECT_EQ(one_row_counts.bytes, sizeof(double));
+    EXPECT_EQ(one_row[0], rf.predict(sample));
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
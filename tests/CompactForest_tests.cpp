@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include "../src/Node.h"
+#include "../src/FlatTree.h"
+#include "../src/CompactForest.h"
+#include "RandomTrees.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using std::vector;
+using std::unique_ptr;
+
+
+/**
+ * @brief Unit Test for the CompactForest class
+ *
+ * @test Test that every encoding agrees with FlatTree::predict on random trees, and that the records are 3x smaller
+ */
+TEST(CompactForestTest, ScoreTest) {
+    std::mt19937 generator(123456);
+    size_t num_features = 5;
+
+    // Trees read the sample in reverse feature order
+    vector<FlatTree> trees;
+    vector<vector<size_t>> features;
+    size_t num_nodes = 0;
+    auto leaf_class = [&generator] { return double(generator() % 3); };
+    for (int t = 0; t < 20; ++t) {
+        trees.emplace_back(*random_tree(generator, num_features, 8, leaf_class));
+        features.push_back({4, 3, 2, 1, 0});
+        num_nodes += trees.back().size();
+    }
+
+    CompactForest binned(trees, features, num_features);
+    CompactForest floats(trees, features, num_features, ThresholdEncoding::Float32, LeafEncoding::Float32);
+    EXPECT_EQ(binned.get_num_trees(), 20);
+    EXPECT_EQ(binned.get_num_nodes(), num_nodes);
+    EXPECT_TRUE(CompactForest::fits_class_ids(trees));
+
+    std::uniform_real_distribution<double> value(-1.2, 1.2);
+    for (int i = 0; i < 500; ++i) {
+        vector<double> sample(num_features);
+        for (auto& x : sample) {
+            x = i % 2 ? std::round(value(generator) * 4) / 4 : value(generator);
+        }
+        if (i % 50 == 0) {
+            sample[i % num_features] = std::nan("");
+        }
+        vector<double> reversed(sample.rbegin(), sample.rend());
+
+        vector<double> binned_values(20), float_values(20);
+        binned.score(sample.data(), binned_values.data());
+        floats.score(sample.data(), float_values.data());
+        for (size_t t = 0; t < trees.size(); ++t) {
+            EXPECT_EQ(binned_values[t], trees[t].predict(reversed.data()));
+            EXPECT_EQ(float_values[t], trees[t].predict(reversed.data()));   // the thresholds are exact floats here
+        }
+    }
+
+    size_t flat_bytes = num_nodes * sizeof(FlatNode);
+    EXPECT_EQ(num_nodes * sizeof(CompactNode) * 3, flat_bytes);
+    EXPECT_LT(binned.memory_usage(), flat_bytes / 2);
+}
+
+/**
+ * @brief Unit Test for the CompactForest class
+ *
+ * @test Test that float32 thresholds round up, and that trees the encodings cannot hold are rejected
+ */
+TEST(CompactForestTest, EncodingTest) {
+    // 0.1 is not a float; rounding the threshold up keeps every value <= 0.1 on the left
+    auto root = std::make_unique<DecisionNode>(0, 0.1, std::make_unique<LeafNode>(1), std::make_unique<LeafNode>(2));
+    vector<FlatTree> trees;
+    trees.emplace_back(*root);
+    CompactForest floats(trees, {{}}, 1, ThresholdEncoding::Float32, LeafEncoding::Float32);
+    double value;
+    for (double x : {0.1, std::nextafter(0.1, 0.0), 0.2}) {
+        floats.score(&x, &value);
+        EXPECT_EQ(value, root->predict({x}));
+    }
+
+    // 300 distinct leaf values do not fit 8-bit class ids
+    vector<FlatTree> many;
+    for (int i = 0; i < 150; ++i) {
+        auto node = std::make_unique<DecisionNode>(0, 0.0, std::make_unique<LeafNode>(2 * i), std::make_unique<LeafNode>(2 * i + 1));
+        many.emplace_back(*node);
+    }
+    vector<vector<size_t>> no_features(many.size());
+    EXPECT_FALSE(CompactForest::fits_class_ids(many));
+    EXPECT_THROW(CompactForest(many, no_features, 1), std::invalid_argument);
+    EXPECT_NO_THROW(CompactForest(many, no_features, 1, ThresholdEncoding::Bin16, LeafEncoding::Float32));
+
+    EXPECT_THROW(CompactForest(trees, {{}}, 0), std::invalid_argument);
+    EXPECT_THROW(CompactForest(trees, {}, 1), std::invalid_argument);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
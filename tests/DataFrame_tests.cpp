@@ -214,6 +214,14 @@ TEST(DataFrameTest, DataFrameSeriesConversion) {
     df2.add_row({37.7, "Mon", "No", 10.2});
 
     EXPECT_THROW(DataFrame::int_cast(df2.retrieve(0, "Day")), std::invalid_argument);
+
+    // A range of rows converts in place, into every stride-th value of the output
+    double strided[6] = {-1, -1, -1, -1, -1, -1};
+    df2.view_column("Humidity").convert_to_numeric(1, 4, strided, 2);
+    EXPECT_EQ(vector<double>(strided, strided + 6), vector<double>({9.2, -1, 9.4, -1, 9.6, -1}));
+    EXPECT_THROW(df2.view_column("Day").convert_to_numeric(0, 1, strided), std::runtime_error);
+    EXPECT_THROW(df2.view_column("Humidity").convert_to_numeric(5, 11, strided), std::out_of_range);
+    EXPECT_THROW(df2.view_column("Pressure"), std::invalid_argument);
 }
 
 /**
@@ -413,6 +421,13 @@ TEST(SeriesTest, SeriesMode) {
     EXPECT_EQ(DataFrame::int_cast(col1.mode()), 0);
     EXPECT_EQ(DataFrame::int_cast(col2.mode()), 3);
     EXPECT_EQ(DataFrame::str_cast(col3.mode()), "Y");
+
+    // Weighted mode and entropy, as used for sample-weighted trees
+    Series weights = Series({5.0, 1.0, 1.0, 1.0, 1.0});
+    EXPECT_EQ(DataFrame::int_cast(Series({4, 2, 2, 0, 5}).mode(weights)), 4);
+    EXPECT_DOUBLE_EQ(Series({1, 1, 0, 0}).calculateEntropy(Series({1.0, 1.0, 1.0, 1.0})), 1.0);
+    EXPECT_DOUBLE_EQ(Series({1, 0}).calculateEntropy(Series({1.0, 0.0})), 0.0);
+    EXPECT_THROW(col1.mode(Series({1.0})), std::runtime_error);
 }
 
 /**
@@ -503,6 +518,47 @@ TEST(DataFrameTest, BootstrapSampleTest) {
 }
 
 
+/**
+ * @brief Unit tests for data frame operations
+ * 
+ * @test Test the row and column subsampling used by gradient boosting
+ */
+TEST(DataFrameTest, SubsampleTest) {
+    DataFrame df;
+
+    df.add_column("a");
+    df.add_column("d");
+    df.add_column("b");
+    df.add_column("c");
+
+    df.add_row({0,0,0,0});
+    df.add_row({1,0,1,1});
+    df.add_row({2,2,0,2});
+    df.add_row({3,3,3,3});
+    df.add_row({4,0,0,4});
+
+    // All rows and features keep their order, with the label moved last
+    unique_ptr<DataFrame> full = df.subsample(1.0, 3, "d", 42);
+    EXPECT_EQ(full->columns, vector<string>({"a", "b", "c", "d"}));
+    EXPECT_EQ(full->get_num_rows(), 5);
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_EQ(DataFrame::int_cast(full->retrieve(i, "a")), i);
+    }
+
+    // Rows are sampled without replacement and stay in their original order
+    unique_ptr<DataFrame> sample = df.subsample(0.6, 2, "c", 42);
+    EXPECT_EQ(sample->get_num_rows(), 3);
+    EXPECT_EQ(sample->get_num_columns(), 3);
+    EXPECT_EQ(sample->columns.back(), "c");
+    for (size_t i = 1; i < 3; ++i) {
+        EXPECT_LT(DataFrame::int_cast(sample->retrieve(i - 1, "c")), DataFrame::int_cast(sample->retrieve(i, "c")));
+    }
+
+    EXPECT_THROW(df.subsample(0.0, 2, "d", 42), std::invalid_argument);
+    EXPECT_THROW(df.subsample(1.5, 2, "d", 42), std::invalid_argument);
+}
+
+
 TEST(DataFrameTest, SplitKFoldTest) {
     DataFrame df2;
     df2.add_column("Temp");
@@ -2,6 +2,7 @@
 #include "../src/DataFrame.h"
 #include "../src/DecisionTree.h"
 #include "../src/Node.h"
+#include <limits>
 #include <vector>
 
 using std::vector;
@@ -177,6 +178,292 @@ TEST(DecisionTreeTest, DecisionTreePrint) {
     EXPECT_EQ(dt.print(columns), "\xE2\x94\x9C\xE2\x94\x80\xE2\x94\x80 [ A <= 3.5 ]\n\xE2\x94\x82   \xE2\x94\x9C\xE2\x94\x80\xE2\x94\x80 [ A <= 2.5 ]\n\xE2\x94\x82   \xE2\x94\x82   \xE2\x94\x9C\xE2\x94\x80\xE2\x94\x80 [ A <= 1.75 ]\n\xE2\x94\x82   \xE2\x94\x82   \xE2\x94\x82   \xE2\x94\x9C\xE2\x94\x80\xE2\x94\x80 ( 1 )\n\xE2\x94\x82   \xE2\x94\x82   \xE2\x94\x82   \xE2\x94\x94\xE2\x94\x80\xE2\x94\x80 ( 0 )\n\xE2\x94\x82   \xE2\x94\x82   \xE2\x94\x94\xE2\x94\x80\xE2\x94\x80 ( 0 )\n\xE2\x94\x82   \xE2\x94\x94\xE2\x94\x80\xE2\x94\x80 [ A <= 4.5 ]\n\xE2\x94\x82       \xE2\x94\x9C\xE2\x94\x80\xE2\x94\x80 ( 1 )\n\xE2\x94\x82       \xE2\x94\x94\xE2\x94\x80\xE2\x94\x80 ( 1 )\n");
 }
 
+/**
+ * @brief Unit Test for the DecisionTree class
+ * 
+ * @test test the DecisionTree save and load methods
+ */
+TEST(DecisionTreeTest, DecisionTreeSaveLoad) {
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {1.0, 3.0, 1},
+        {3.5, 2.0, 0},
+        {4.0, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+    string path = ::testing::TempDir() + "decision_tree_save_load.bin";
+
+    DecisionTree dt(3,1);
+    EXPECT_THROW(dt.save(path), std::runtime_error);
+    dt.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    dt.save(path);
+
+    unique_ptr<DecisionTree> loaded = DecisionTree::load(path);
+    EXPECT_EQ(loaded->get_num_nodes(), dt.get_num_nodes());
+    EXPECT_EQ(loaded->get_height(), dt.get_height());
+    EXPECT_EQ(loaded->print(columns), dt.print(columns));
+    for (const auto& row : data1) {
+        EXPECT_EQ(loaded->predict({row[0], row[1]}), dt.predict({row[0], row[1]}));
+    }
+
+    // Refitting a loaded tree replaces the mapped nodes
+    loaded->fit(std::make_unique<DataFrame>(data1, columns), "C");
+    EXPECT_EQ(loaded->print(columns), dt.print(columns));
+
+    std::remove(path.c_str());
+    EXPECT_THROW(DecisionTree::load(path), std::runtime_error);
+}
+
+/**
+ * @brief Unit Test for the DecisionTree class
+ * 
+ * @test test the DecisionTree predict_batch method
+ */
+TEST(DecisionTreeTest, DecisionTreePredictBatch) {
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {1.0, 3.0, 1},
+        {3.5, 2.0, 0},
+        {4.0, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+
+    DecisionTree dt(3,1);
+    EXPECT_THROW(dt.predict_batch({2.5, 1.5}, 2), std::runtime_error);
+    dt.fit(std::make_unique<DataFrame>(data1, columns), "C");
+
+    vector<double> samples;
+    for (const auto& row : data1) {
+        samples.insert(samples.end(), {row[0], row[1]});
+    }
+    vector<double> predictions = dt.predict_batch(samples, 2);
+    ASSERT_EQ(predictions.size(), data1.size());
+    for (size_t i = 0; i < data1.size(); ++i) {
+        EXPECT_EQ(predictions[i], dt.predict({data1[i][0], data1[i][1]}));
+    }
+
+    EXPECT_THROW(dt.predict_batch({2.5, 1.5, 1.0}, 2), std::invalid_argument);
+}
+
+/**
+ * @brief Unit Test for the DecisionTree class
+ * 
+ * @test test that fit records the number of training samples of every node, and that node layouts keep predictions
+ */
+TEST(DecisionTreeTest, DecisionTreeNodeLayout) {
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {1.0, 3.0, 1},
+        {3.5, 2.0, 0},
+        {4.0, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+    string path = ::testing::TempDir() + "decision_tree_node_layout.bin";
+
+    DecisionTree dt(3,1);
+    dt.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    FlatTree depth_first = dt.flatten();
+
+    // The root is reached by every row, and every decision node splits its rows between its children
+    EXPECT_EQ(depth_first.data()[0].num_samples, data1.size());
+    for (size_t i = 0; i < depth_first.size(); ++i) {
+        const FlatNode& node = depth_first.data()[i];
+        if (node.feature >= 0) {
+            EXPECT_EQ(depth_first.data()[node.left].num_samples + depth_first.data()[node.right].num_samples, node.num_samples);
+        }
+    }
+
+    vector<double> predictions;
+    for (const auto& row : data1) {
+        predictions.push_back(dt.predict({row[0], row[1]}));
+    }
+    vector<double> samples;
+    for (const auto& row : data1) {
+        samples.insert(samples.end(), {row[0], row[1]});
+    }
+
+    dt.set_node_layout(NodeLayout::HotPath);
+    EXPECT_EQ(dt.get_node_layout(), NodeLayout::HotPath);
+    EXPECT_EQ(dt.predict_batch(samples, 2), predictions);
+    EXPECT_EQ(dt.flatten().data()[0].num_samples, data1.size());
+
+    // A loaded tree keeps its sample counts and can be laid out again
+    dt.save(path);
+    unique_ptr<DecisionTree> loaded = DecisionTree::load(path);
+    loaded->set_node_layout(NodeLayout::BreadthFirst);
+    EXPECT_EQ(loaded->predict_batch(samples, 2), predictions);
+    EXPECT_EQ(loaded->print(columns), dt.print(columns));
+    loaded->set_node_layout(NodeLayout::HotPath);
+    FlatTree reloaded = loaded->flatten();
+    FlatTree hot_path = dt.flatten();
+    ASSERT_EQ(reloaded.size(), hot_path.size());
+    for (size_t i = 0; i < hot_path.size(); ++i) {
+        EXPECT_EQ(reloaded.data()[i].value, hot_path.data()[i].value);
+        EXPECT_EQ(reloaded.data()[i].num_samples, hot_path.data()[i].num_samples);
+    }
+    std::remove(path.c_str());
+}
+
+/**
+ * @brief Unit Test for the DecisionTree class
+ * 
+ * @test test that fit returns the shape of the tree it grew and the work done by the split search
+ */
+TEST(DecisionTreeTest, DecisionTreeTrainingStats) {
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {1.0, 3.0, 1},
+        {3.5, 2.0, 0},
+        {4.0, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+
+    DecisionTree dt(3,1);
+    TrainingStats stats = dt.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    EXPECT_EQ(stats.num_trees, 1);
+    EXPECT_EQ(stats.nodes, dt.get_num_nodes());
+    EXPECT_EQ(stats.leaves, (stats.nodes + 1) / 2);
+    EXPECT_EQ(stats.depth, dt.get_height());
+
+    // The root alone scans the 5 rows for both features and scores the 5 distinct values of each
+    EXPECT_GE(stats.rows_scanned, 10);
+    EXPECT_GE(stats.candidate_thresholds, 10);
+    EXPECT_LE(stats.candidate_thresholds, stats.rows_scanned);
+    EXPECT_GT(stats.bytes_allocated, 0);
+    EXPECT_GE(stats.split_search_seconds, 0.0);
+    EXPECT_LE(stats.split_search_seconds + stats.partition_seconds + stats.leaf_seconds, stats.fit_seconds);
+
+    // A tree that is not allowed to split does no split search
+    DecisionTree stump(0,1);
+    TrainingStats stump_stats = stump.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    EXPECT_EQ(stump_stats.nodes, 1);
+    EXPECT_EQ(stump_stats.leaves, 1);
+    EXPECT_EQ(stump_stats.depth, 0);
+    EXPECT_EQ(stump_stats.rows_scanned, 0);
+    EXPECT_EQ(stump_stats.candidate_thresholds, 0);
+
+    // An oblivious tree reports the complete tree it expands into
+    DecisionTree oblivious(2,1);
+    oblivious.set_oblivious(true);
+    TrainingStats oblivious_stats = oblivious.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    EXPECT_EQ(oblivious_stats.nodes, oblivious.get_num_nodes());
+    EXPECT_EQ(oblivious_stats.depth, oblivious.get_height());
+    EXPECT_GT(oblivious_stats.candidate_thresholds, 0);
+}
+
+TEST(DecisionTreeTest, DecisionTreeRefit) {
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {1.0, 3.0, 1},
+        {3.5, 2.0, 0},
+        {4.0, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+
+    // The nodes grown by fit live in one arena block, which a second fit replaces
+    DecisionTree dt(3,1);
+    dt.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    std::string first = dt.print(columns);
+    EXPECT_GE(dt.memory_usage(), sizeof(DecisionTree) + 4096);
+
+    dt.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    EXPECT_EQ(dt.print(columns), first);
+    EXPECT_EQ(dt.predict({1.0, 3.0}), 1);
+    EXPECT_EQ(dt.predict({2.5, 1.5}), 0);
+
+    // The feature lists of a fit are freed, so trees of the same shape use the same memory however they sampled
+    vector<vector<double>> pure = {{2.5, 1.5, 1}, {1.0, 3.0, 1}, {3.5, 2.0, 1}};
+    DecisionTree all_features(3, 1), sampled(3, 1, 0.5, 7);
+    all_features.fit(std::make_unique<DataFrame>(pure, columns), "C");
+    sampled.fit(std::make_unique<DataFrame>(pure, columns), "C");
+    EXPECT_EQ(sampled.memory_usage(), all_features.memory_usage());
+}
+
+TEST(DecisionTreeTest, DecisionTreeCriterion) {
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {1.0, 3.0, 1},
+        {3.5, 2.0, 0},
+        {4.0, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+
+    DecisionTree entropy(3,1);
+    EXPECT_EQ(entropy.get_criterion(), SplitCriterion::Entropy);
+    entropy.fit(std::make_unique<DataFrame>(data1, columns), "C");
+
+    // Both criteria separate the training rows
+    DecisionTree gini(3,1);
+    gini.set_criterion(SplitCriterion::Gini);
+    EXPECT_EQ(gini.get_criterion(), SplitCriterion::Gini);
+    gini.fit(std::make_unique<DataFrame>(data1, columns), "C");
+    for (const auto& row : data1) {
+        EXPECT_EQ(gini.predict({row[0], row[1]}), row[2]);
+        EXPECT_EQ(entropy.predict({row[0], row[1]}), row[2]);
+    }
+}
+
+TEST(DecisionTreeTest, DecisionTreeGrowthPolicy) {
+    std::shared_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(300);
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    vector<string> columns = df->columns;
+
+    // Level-wise growth grows the same tree as depth-first growth, with the same amount of work
+    for (double colsample_bylevel : {1.0, 0.5}) {
+        DecisionTree depth_first(8, 2, colsample_bylevel, 7);
+        DecisionTree level_wise(8, 2, colsample_bylevel, 7);
+        EXPECT_EQ(level_wise.get_growth_policy(), GrowthPolicy::DepthFirst);
+        level_wise.set_growth_policy(GrowthPolicy::LevelWise);
+        EXPECT_EQ(level_wise.get_growth_policy(), GrowthPolicy::LevelWise);
+
+        TrainingStats depth_first_stats = depth_first.fit(df, "weather");
+        TrainingStats level_wise_stats = level_wise.fit(df, "weather");
+        EXPECT_GT(level_wise.get_height(), 2);
+        EXPECT_EQ(level_wise.print(columns), depth_first.print(columns));
+        EXPECT_EQ(level_wise_stats.nodes, depth_first_stats.nodes);
+        EXPECT_EQ(level_wise_stats.leaves, depth_first_stats.leaves);
+        EXPECT_EQ(level_wise_stats.depth, depth_first_stats.depth);
+        EXPECT_EQ(level_wise_stats.rows_scanned, depth_first_stats.rows_scanned);
+        EXPECT_EQ(level_wise_stats.candidate_thresholds, depth_first_stats.candidate_thresholds);
+        EXPECT_EQ(level_wise.flatten().size(), depth_first.flatten().size());
+    }
+}
+
+TEST(DecisionTreeTest, DecisionTreeNaN) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    vector<vector<double>> data1 = {
+        {2.5, 1.5, 0},
+        {nan, 3.0, 1},
+        {3.5, 2.0, 0},
+        {nan, 3.5, 1},
+        {5.0, 2.5, 1}
+    };
+    vector<string> columns = {"A", "B", "C"};
+
+    // The NaNs of a feature, which compare false with everything, are one value of the split search
+    DataFrame df(data1, columns);
+    size_t num_values = 0;
+    EXPECT_EQ(df.selectBestAttribute("C", {"A"}, "", &num_values), "A");
+    EXPECT_EQ(num_values, 4);
+
+    // The NaNs sort last and go right of every split, so the fit finishes whatever the growth policy
+    for (GrowthPolicy growth : {GrowthPolicy::DepthFirst, GrowthPolicy::LevelWise}) {
+        DecisionTree tree(3, 1);
+        tree.set_growth_policy(growth);
+        tree.fit(std::make_unique<DataFrame>(data1, columns), "C");
+        EXPECT_EQ(tree.predict({2.5, 1.5}), 0);
+        EXPECT_EQ(tree.predict({5.0, 2.5}), 1);
+    }
+}
+
+
 
 int main(int argc, char* argv[])
 {
@@ -0,0 +1,160 @@
+#include <gtest/gtest.h>
+#include "../src/Node.h"
+#include "../src/FlatTree.h"
+#include <vector>
+
+using std::vector;
+using std::unique_ptr;
+
+
+// Builds the tree used by DecisionNodeTest.PredictTest2
+static unique_ptr<Node> make_tree() {
+    auto parent_1 = std::make_unique<DecisionNode>(1, 2.0, std::make_unique<LeafNode>(1), std::make_unique<LeafNode>(2));
+    auto parent_2 = std::make_unique<DecisionNode>(1, 6.0, std::make_unique<LeafNode>(3), std::make_unique<LeafNode>(4));
+    return std::make_unique<DecisionNode>(0, 3.0, std::move(parent_1), std::move(parent_2));
+}
+
+
+/**
+ * @brief Unit Test for the FlatTree class
+ * 
+ * @test Test that a flattened tree predicts like the tree of nodes it was built from
+ */
+TEST(FlatTreeTest, PredictTest) {
+    unique_ptr<Node> root = make_tree();
+    FlatTree flat(*root);
+
+    EXPECT_EQ(flat.size(), 7);
+    EXPECT_EQ(flat.get_height(), 2);
+    EXPECT_EQ(flat.max_feature(), 1);
+
+    vector<vector<double>> samples = {
+        {0, 1.0, 6.2}, {0, 3.0, 6.2}, {5.5, 5.0, 0}, {5.5, 7.0, 0}, {3.0, 2.0, 0}
+    };
+    for (const auto& sample : samples) {
+        EXPECT_EQ(flat.predict(sample.data()), root->predict(sample));
+    }
+
+    // Rebuilding the nodes gives the same tree back
+    unique_ptr<Node> rebuilt = flat.to_node();
+    EXPECT_EQ(rebuilt->print(), root->print());
+
+    // Moving keeps the nodes valid
+    FlatTree moved(std::move(flat));
+    EXPECT_EQ(moved.predict(samples[3].data()), 4);
+    EXPECT_TRUE(flat.empty());
+    EXPECT_THROW(flat.predict(samples[0].data()), std::runtime_error);
+}
+
+/**
+ * @brief Unit Test for the FlatTree class
+ * 
+ * @test Test that views reject child indices which do not point to a later node
+ */
+TEST(FlatTreeTest, ViewTest) {
+    unique_ptr<Node> root = make_tree();
+    FlatTree flat(*root);
+
+    FlatTree view(flat.data(), flat.size());
+    EXPECT_EQ(view.memory_usage(), 0);
+    EXPECT_EQ(view.predict(vector<double>{5.5, 5.0}.data()), 3);
+
+    vector<FlatNode> cyclic = {{3.0, 0, 0, 1, 0}, {1.0, -1, 0, 0, 0}};
+    EXPECT_THROW(FlatTree(cyclic.data(), cyclic.size()), std::runtime_error);
+
+    vector<FlatNode> out_of_range = {{3.0, 0, 1, 2, 0}, {1.0, -1, 0, 0, 0}};
+    EXPECT_THROW(FlatTree(out_of_range.data(), out_of_range.size()), std::runtime_error);
+}
+
+/**
+ * @brief Unit Test for the FlatTree class
+ * 
+ * @test Test that the batch traversal predicts like predict, including for partial blocks and remapped features
+ */
+TEST(FlatTreeTest, PredictBatchTest) {
+    unique_ptr<Node> root = make_tree();
+    FlatTree flat(*root);
+
+    // 37 rows of 3 columns: two full blocks and a partial one
+    vector<double> samples;
+    for (int i = 0; i < 37; ++i) {
+        samples.push_back((i * 7) % 9 - 1.0);
+        samples.push_back((i * 5) % 8);
+        samples.push_back(i);
+    }
+    vector<double> predictions(37);
+    flat.predict_batch(samples.data(), 37, 3, nullptr, predictions.data());
+    for (int i = 0; i < 37; ++i) {
+        EXPECT_EQ(predictions[i], flat.predict(samples.data() + 3 * i));
+    }
+
+    // Tree feature 0 reads column 2 and tree feature 1 reads column 0
+    size_t features[2] = {2, 0};
+    flat.predict_batch(samples.data(), 37, 3, features, predictions.data());
+    for (int i = 0; i < 37; ++i) {
+        vector<double> mapped = {samples[3 * i + 2], samples[3 * i]};
+        EXPECT_EQ(predictions[i], flat.predict(mapped.data()));
+    }
+}
+
+/**
+ * @brief Unit Test for the FlatTree class
+ * 
+ * @test Test that every node layout predicts alike, keeps the sample counts, and orders the nodes as documented
+ */
+TEST(FlatTreeTest, LayoutTest) {
+    unique_ptr<Node> root = make_tree();
+
+    // 10 samples: 3 go left (1 + 2) and 7 go right (6 + 1)
+    DecisionNode* parent_1 = dynamic_cast<DecisionNode*>(dynamic_cast<DecisionNode*>(root.get())->left.get());
+    DecisionNode* parent_2 = dynamic_cast<DecisionNode*>(dynamic_cast<DecisionNode*>(root.get())->right.get());
+    root->set_num_samples(10);
+    parent_1->set_num_samples(3);
+    parent_1->left->set_num_samples(1);
+    parent_1->right->set_num_samples(2);
+    parent_2->set_num_samples(7);
+    parent_2->left->set_num_samples(6);
+    parent_2->right->set_num_samples(1);
+
+    FlatTree depth_first(*root, NodeLayout::DepthFirst);
+    FlatTree breadth_first(*root, NodeLayout::BreadthFirst);
+    FlatTree hot_path(*root, NodeLayout::HotPath);
+
+    // Node values in storage order
+    auto values = [](const FlatTree& tree) {
+        vector<double> result;
+        for (size_t i = 0; i < tree.size(); ++i) {
+            result.push_back(tree.data()[i].value);
+        }
+        return result;
+    };
+    EXPECT_EQ(values(depth_first), (vector<double>{3.0, 2.0, 1, 2, 6.0, 3, 4}));
+    EXPECT_EQ(values(breadth_first), (vector<double>{3.0, 2.0, 6.0, 1, 2, 3, 4}));
+    EXPECT_EQ(values(hot_path), (vector<double>{3.0, 6.0, 3, 4, 2.0, 2, 1}));
+    EXPECT_EQ(hot_path.data()[0].num_samples, 10);
+    EXPECT_EQ(hot_path.data()[2].num_samples, 6);
+    EXPECT_EQ(hot_path.data()[5].num_samples, 2);
+
+    for (const FlatTree* tree : {&depth_first, &breadth_first, &hot_path}) {
+        EXPECT_EQ(tree->get_height(), 2);
+        EXPECT_EQ(tree->to_node()->print(), root->print());
+        EXPECT_EQ(tree->to_node()->get_num_samples(), 10);
+        for (int i = 0; i < 37; ++i) {
+            vector<double> sample = {(i * 7) % 9 - 1.0, static_cast<double>((i * 5) % 8)};
+            EXPECT_EQ(tree->predict(sample.data()), root->predict(sample));
+        }
+        FlatTree view(tree->data(), tree->size());   // parents still come before their children
+        EXPECT_EQ(view.size(), 7);
+    }
+
+    // Without sample counts the hot-path layout is depth-first
+    unique_ptr<Node> uncounted = make_tree();
+    EXPECT_EQ(values(FlatTree(*uncounted, NodeLayout::HotPath)), values(depth_first));
+}
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
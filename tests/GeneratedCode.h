@@ -0,0 +1,44 @@
+#ifndef GENERATEDCODE_H
+#define GENERATEDCODE_H
+
+#include <gtest/gtest.h>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <dlfcn.h>
+
+// Shared helpers of the tests that compile the C++ code generated by to_cpp()
+
+using PredictFunction = double (*)(const double*);
+
+// Checks whether a C++ compiler can be run; tests of generated code are skipped without one
+inline bool compiler_available() {
+    return std::system("c++ --version >/dev/null 2>&1") == 0;
+}
+
+// Compiles generated source code into a shared object and returns its entry point. A compile or load error fails the
+// calling test with the compiler's output and returns nullptr, so broken generated code is never skipped silently.
+inline PredictFunction compile_generated(const std::string& source, const std::string& name) {
+    std::string base = ::testing::TempDir() + name;
+    std::ofstream(base + ".cpp") << source;
+    std::string command = "c++ -O1 -shared -fPIC " + base + ".cpp -o " + base + ".so >" + base + ".log 2>&1";
+    if (std::system(command.c_str()) != 0) {
+        std::ifstream log(base + ".log");
+        ADD_FAILURE() << "Generated code does not compile:\n"
+                      << std::string((std::istreambuf_iterator<char>(log)), std::istreambuf_iterator<char>());
+        return nullptr;
+    }
+    void* handle = dlopen((base + ".so").c_str(), RTLD_NOW);
+    if (!handle) {
+        ADD_FAILURE() << "Could not load the generated code: " << dlerror();
+        return nullptr;
+    }
+    auto predict = reinterpret_cast<PredictFunction>(dlsym(handle, "predict"));
+    if (!predict) {
+        ADD_FAILURE() << "Generated code has no predict function";
+    }
+    return predict;
+}
+
+#endif // GENERATEDCODE_H
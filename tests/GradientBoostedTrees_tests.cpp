@@ -3,9 +3,13 @@
 #include "../src/DecisionTree.h"
 #include "../src/Node.h"
 #include "../src/GradientBoostedTrees.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <numeric>
+#include <set>
 #include <vector>
-
-
+#include "GeneratedCode.h"
 
 
 TEST(GradientBoostedTreesTest, FitTest) {
@@ -31,6 +35,252 @@ TEST(GradientBoostedTreesTest, FitTest) {
     EXPECT_THROW(gb.predict({0.0, 12.8, 5.0, 4.7, 0.0}), std::runtime_error);
 }
 
+TEST(GradientBoostedTreesTest, SubsampleTest) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(50);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    GradientBoostedTrees gb1(5, 0.1, 3, 1, 0.5, 0.5, 0.5, 123456);
+    GradientBoostedTrees gb2(5, 0.1, 3, 1, 0.5, 0.5, 0.5, 123456);
+    gb1.fit(data, "weather");
+    gb2.fit(data, "weather");
+
+    // The same seed gives the same model
+    EXPECT_EQ(gb1.predict({0.0, 12.8, 5.0, 4.7}), gb2.predict({0.0, 12.8, 5.0, 4.7}));
+    EXPECT_EQ(gb1.predict({4.0, 1.8, -3.0, 2.7}), gb2.predict({4.0, 1.8, -3.0, 2.7}));
+
+    // Subsampling without any fraction below 1 matches the deterministic model
+    GradientBoostedTrees full(5, 0.1, 3, 1);
+    GradientBoostedTrees sampled_full(5, 0.1, 3, 1, 1.0, 1.0, 1.0, 7);
+    full.fit(data, "weather");
+    sampled_full.fit(data, "weather");
+    EXPECT_EQ(full.predict({1.0, 9.8, -1.0, 6.7}), sampled_full.predict({1.0, 9.8, -1.0, 6.7}));
+
+    EXPECT_THROW(gb1.predict({0.0, 12.8, 5.0}), std::runtime_error);
+    EXPECT_THROW(GradientBoostedTrees(5, 0.1, 3, 1, 0.0, 0.5, 0.5, 1), std::invalid_argument);
+    EXPECT_THROW(GradientBoostedTrees(5, 0.1, 3, 1, 0.5, 1.5, 0.5, 1), std::invalid_argument);
+}
+
+TEST(GradientBoostedTreesTest, GossTest) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(50);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    GradientBoostedTrees gb1(5, 0.1, 3, 1, 1.0, 1.0, 1.0, 123456);
+    GradientBoostedTrees gb2(5, 0.1, 3, 1, 1.0, 1.0, 1.0, 123456);
+    gb1.set_goss(0.2, 0.1);
+    gb2.set_goss(0.2, 0.1);
+    gb1.fit(data, "weather");
+    gb2.fit(data, "weather");
+
+    // The same seed gives the same model
+    EXPECT_EQ(gb1.predict({0.0, 12.8, 5.0, 4.7}), gb2.predict({0.0, 12.8, 5.0, 4.7}));
+    EXPECT_EQ(gb1.predict({4.0, 1.8, -3.0, 2.7}), gb2.predict({4.0, 1.8, -3.0, 2.7}));
+
+    EXPECT_THROW(gb1.set_goss(1.0, 0.1), std::invalid_argument);
+    EXPECT_THROW(gb1.set_goss(0.2, 0.0), std::invalid_argument);
+    EXPECT_THROW(gb1.set_goss(0.6, 0.6), std::invalid_argument);
+}
+
+TEST(GradientBoostedTreesTest, GossSampleTest) {
+    // Distinct magnitudes, alternating in sign, so the largest absolute gradients are known
+    vector<double> gradients;
+    for (size_t row = 0; row < 100; ++row) {
+        double magnitude = static_cast<double>((row * 37) % 100) + 0.5;
+        gradients.push_back(row % 2 ? -magnitude : magnitude);
+    }
+    vector<size_t> by_magnitude(gradients.size());
+    std::iota(by_magnitude.begin(), by_magnitude.end(), 0);
+    std::sort(by_magnitude.begin(), by_magnitude.end(),
+              [&gradients](size_t a, size_t b) { return std::abs(gradients[a]) > std::abs(gradients[b]); });
+    std::set<size_t> top(by_magnitude.begin(), by_magnitude.begin() + 20);
+
+    std::set<size_t> sampled_rows;
+    for (size_t seed = 1; seed <= 10; ++seed) {
+        auto [rows, weights] = GradientBoostedTrees::goss_sample(gradients, 0.2, 0.1, seed);
+        ASSERT_EQ(rows.size(), 30);
+        ASSERT_EQ(weights.size(), rows.size());
+        EXPECT_TRUE(std::adjacent_find(rows.begin(), rows.end(), std::greater_equal<size_t>()) == rows.end());
+
+        // The 20 largest absolute gradients are always kept as they are; the other 10 rows stand in for the 80 rest
+        size_t kept = 0;
+        for (size_t k = 0; k < rows.size(); ++k) {
+            if (top.count(rows[k])) {
+                ++kept;
+                EXPECT_EQ(weights[k], 1.0);
+            } else {
+                EXPECT_DOUBLE_EQ(weights[k], (1.0 - 0.2) / 0.1);
+                sampled_rows.insert(rows[k]);
+            }
+        }
+        EXPECT_EQ(kept, top.size());
+    }
+    EXPECT_GT(sampled_rows.size(), 10);   // the seeds draw different small-gradient rows
+
+    // Without a top fraction every row is a sampled one
+    auto [rows, weights] = GradientBoostedTrees::goss_sample(gradients, 0.0, 0.5, 3);
+    EXPECT_EQ(rows.size(), 50);
+    for (double weight : weights) {
+        EXPECT_DOUBLE_EQ(weight, 2.0);
+    }
+}
+
+
+TEST(GradientBoostedTreesTest, MemoryUsageTest) {
+    vector<vector<double>> rows = {
+        {2.5, 1.5, 0}, {1.0, 3.0, 1}, {3.5, 2.0, 0}, {4.0, 3.5, 1}, {5.0, 2.5, 1}, {6.4, 2.0, 0}
+    };
+
+    // Repeating every row gives the same trees, so the footprint must not grow with the number of rows
+    vector<vector<double>> repeated_rows;
+    for (int i = 0; i < 50; ++i) {
+        repeated_rows.insert(repeated_rows.end(), rows.begin(), rows.end());
+    }
+
+    GradientBoostedTrees small(3, 0.1, 2, 1);
+    GradientBoostedTrees large(3, 0.1, 2, 1);
+    small.fit(std::make_shared<DataFrame>(rows, vector<string>{"A", "B", "C"}), "C");
+    large.fit(std::make_shared<DataFrame>(repeated_rows, vector<string>{"A", "B", "C"}), "C");
+
+    EXPECT_GT(small.memory_usage(), sizeof(GradientBoostedTrees));
+    EXPECT_EQ(small.memory_usage(), large.memory_usage());
+    EXPECT_DOUBLE_EQ(small.predict({2.5, 1.5}), large.predict({2.5, 1.5}));
+}
+
+TEST(GradientBoostedTreesTest, SaveLoadTest) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(50);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    GradientBoostedTrees gb(5, 0.1, 3, 1, 0.8, 0.5, 1.0, 123456);
+    string path = ::testing::TempDir() + "gradient_boosted_trees_save_load.bin";
+    EXPECT_THROW(gb.save(path), std::runtime_error);
+    gb.fit(data, "weather");
+    gb.save(path);
+
+    std::unique_ptr<GradientBoostedTrees> loaded = GradientBoostedTrees::load(path);
+    vector<vector<double>> samples = {{0.0, 12.8, 5.0, 4.7}, {1.0, 9.8, -1.0, 6.7}, {4.0, 1.8, -3.0, 2.7}, {0.3, 20.1, 11.2, 1.5}};
+    for (const auto& sample : samples) {
+        EXPECT_DOUBLE_EQ(loaded->predict(sample), gb.predict(sample));
+    }
+    EXPECT_THROW(loaded->predict({0.0, 12.8, 5.0}), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+TEST(GradientBoostedTreesTest, ToCppTest) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(50);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    GradientBoostedTrees model(5, 0.1, 3, 1, 0.8, 0.5, 1.0, 123456);
+    EXPECT_THROW(model.to_cpp(), std::runtime_error);
+    model.fit(data, "weather");
+
+    string source = model.to_cpp();
+    EXPECT_NE(source.find("extern \"C\" double predict(const double* x)"), string::npos);
+
+    if (!compiler_available()) {
+        GTEST_SKIP() << "No C++ compiler available to build the generated code";
+    }
+    PredictFunction predict = compile_generated(source, "gradientboostedtrees_to_cpp");
+    ASSERT_NE(predict, nullptr);
+    vector<vector<double>> samples = {{0.0, 12.8, 5.0, 4.7}, {1.0, 9.8, -1.0, 6.7}, {4.0, 1.8, -3.0, 2.7}, {0.3, 20.1, 11.2, 1.5}};
+    for (const auto& sample : samples) {
+        EXPECT_DOUBLE_EQ(predict(sample.data()), model.predict(sample));
+    }
+}
+
+TEST(GradientBoostedTreesTest, QuickScorerTest) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    GradientBoostedTrees gb(10, 0.1, 4, 1, 0.8, 0.75, 1.0, 123456);
+    gb.fit(data, "weather");
+
+    vector<vector<double>> samples = {{0.0, 12.8, 5.0, 4.7}, {1.0, 9.8, -1.0, 6.7}, {4.0, 1.8, -3.0, 2.7}, {0.3, 20.1, 11.2, 1.5}};
+    vector<double> pointer_predictions;
+    for (const auto& sample : samples) {
+        pointer_predictions.push_back(gb.predict(sample));
+    }
+
+    gb.set_inference_engine(InferenceEngine::QuickScorer);   // selected after fit: built right away
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(gb.predict(samples[i]), pointer_predictions[i]);
+    }
+    EXPECT_THROW(gb.predict({0.0, 12.8, 5.0}), std::runtime_error);
+
+    gb.set_inference_engine(InferenceEngine::Compact);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(gb.predict(samples[i]), pointer_predictions[i]);
+    }
+
+    // Trees with more than 64 leaves cannot use the QuickScorer
+    GradientBoostedTrees deep(2, 0.1, 8, 1);
+    deep.fit(data, "weather");
+    EXPECT_THROW(deep.set_inference_engine(InferenceEngine::QuickScorer), std::invalid_argument);
+
+    // A fit whose trees the QuickScorer cannot hold keeps the fitted model
+    GradientBoostedTrees refit(2, 0.1, 8, 1);
+    refit.set_inference_engine(InferenceEngine::QuickScorer);
+    refit.fit(data->head(10), "weather");
+    vector<double> fitted_predictions;
+    for (const auto& sample : samples) {
+        fitted_predictions.push_back(refit.predict(sample));
+    }
+    EXPECT_THROW(refit.fit(data, "weather"), std::invalid_argument);
+    EXPECT_EQ(refit.get_inference_engine(), InferenceEngine::QuickScorer);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(refit.predict(samples[i]), fitted_predictions[i]);
+    }
+}
+
+/**
+ * @brief Unit Test for the GradientBoostedTrees class
+ * 
+ * @test Test that oblivious trees predict alike through their level tables, their nodes, and the QuickScorer
+ */
+TEST(GradientBoostedTreesTest, ObliviousTest) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    GradientBoostedTrees gb(10, 0.1, 4, 1, 0.8, 0.75, 1.0, 123456);
+    gb.set_oblivious(true);
+    EXPECT_TRUE(gb.is_oblivious());
+    gb.fit(data, "weather");
+
+    vector<vector<double>> samples = {{0.0, 12.8, 5.0, 4.7}, {1.0, 9.8, -1.0, 6.7}, {4.0, 1.8, -3.0, 2.7}, {0.3, 20.1, 11.2, 1.5}};
+    vector<double> oblivious_predictions;
+    for (const auto& sample : samples) {
+        oblivious_predictions.push_back(gb.predict(sample));
+    }
+
+    // Depth 4 gives 16 leaves per tree, so the QuickScorer always applies
+    gb.set_inference_engine(InferenceEngine::QuickScorer);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(gb.predict(samples[i]), oblivious_predictions[i]);
+    }
+}
 
 int main(int argc, char* argv[])
 {
@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include "../src/Impurity.h"
+#include "../src/DataFrame.h"
+#include <cmath>
+#include <vector>
+
+using std::vector;
+
+
+/**
+ * @brief Unit Test for the LabelEncoder class
+ *
+ * @test Test that labels get dense ids in ascending order of their values
+ */
+TEST(LabelEncoderTest, EncodeTest) {
+    LabelEncoder labels(Series({"Y", "N", "Y", "M"}));
+    EXPECT_EQ(labels.num_classes(), 3);
+    EXPECT_EQ(labels.get_ids(), vector<ClassId>({2, 1, 2, 0}));
+    EXPECT_EQ(DataFrame::str_cast(labels.decode(0)), "M");
+    EXPECT_EQ(DataFrame::str_cast(labels.decode(2)), "Y");
+
+    LabelEncoder numeric(Series({3, 1, 3}));
+    EXPECT_EQ(numeric.get_ids(), vector<ClassId>({1, 0, 1}));
+    EXPECT_EQ(DataFrame::int_cast(numeric.decode(1)), 3);
+
+    // Doubles are encoded without a column of Cell, with the ids a column of them would get
+    LabelEncoder residuals(vector<double>({0.5, -1.25, 0.5, 2.0}));
+    EXPECT_EQ(residuals.num_classes(), 3);
+    EXPECT_EQ(residuals.get_ids(), vector<ClassId>({1, 0, 1, 2}));
+    EXPECT_EQ(residuals.get_ids(), LabelEncoder(Series({0.5, -1.25, 0.5, 2.0})).get_ids());
+    EXPECT_EQ(DataFrame::double_cast(residuals.decode(0)), -1.25);
+}
+
+/**
+ * @brief Unit Test for the ImpurityKernel class
+ *
+ * @test Test the entropy and Gini impurity of class counts and weights against the textbook formulas
+ */
+TEST(ImpurityKernelTest, ImpurityTest) {
+    ImpurityKernel entropy(SplitCriterion::Entropy, 10);
+    ImpurityKernel gini(SplitCriterion::Gini, 10);
+
+    // 4 rows of two equally common classes hold 1 bit each; a pure node holds none
+    uint32_t even[] = {2, 2};
+    uint32_t pure[] = {0, 5};
+    uint32_t none[] = {0, 0};
+    EXPECT_DOUBLE_EQ(entropy.weighted_impurity(even, 2), 4.0);
+    EXPECT_DOUBLE_EQ(entropy.weighted_impurity(pure, 2), 0.0);
+    EXPECT_DOUBLE_EQ(entropy.weighted_impurity(none, 2), 0.0);
+    EXPECT_DOUBLE_EQ(gini.weighted_impurity(even, 2), 2.0);
+    EXPECT_DOUBLE_EQ(gini.weighted_impurity(pure, 2), 0.0);
+    EXPECT_DOUBLE_EQ(gini.weighted_impurity(none, 2), 0.0);
+
+    // The table agrees with the entropy of a Series
+    uint32_t skewed[] = {1, 2, 7};
+    Series labels({0, 1, 1, 2, 2, 2, 2, 2, 2, 2});
+    EXPECT_NEAR(entropy.weighted_impurity(skewed, 3) / 10, labels.calculateEntropy(), 1e-12);
+
+    // Weights follow the same formulas, ignoring classes without weight
+    double weights[] = {1.5, 0.0, 1.5};
+    EXPECT_DOUBLE_EQ(entropy.weighted_impurity(weights, 3), 3.0);
+    EXPECT_DOUBLE_EQ(gini.weighted_impurity(weights, 3), 1.5);
+}
+
+/**
+ * @brief Unit Test for the ClassCounts class
+ *
+ * @test Test that the majority of counted and weighted rows breaks ties like Series::mode
+ */
+TEST(ClassCountsTest, MajorityTest) {
+    Series column({1, 2, 3, 3, 0, 1});
+    LabelEncoder labels(column);
+    const vector<ClassId>& ids = labels.get_ids();
+    ClassCounts counts(labels.num_classes());
+    EXPECT_THROW(counts.majority(false), std::runtime_error);
+
+    for (ClassId id : ids) {
+        counts.add(id);
+    }
+    EXPECT_EQ(counts.size(), 6);
+    EXPECT_EQ(DataFrame::int_cast(labels.decode(counts.majority(false))), DataFrame::int_cast(column.mode()));
+    counts.clear();
+    EXPECT_EQ(counts.size(), 0);
+
+    // The heaviest class wins, and the smallest label among equally heavy ones
+    vector<double> weights = {1.0, 2.0, 1.0, 1.0, 0.5, 0.0};
+    for (size_t row = 0; row < ids.size(); ++row) {
+        counts.add(ids[row], weights[row]);
+    }
+    EXPECT_EQ(DataFrame::int_cast(labels.decode(counts.majority(true))), 2);
+    counts.clear();
+
+    weights[1] = 1.0;
+    weights[3] = 0.0;
+    for (size_t row = 0; row < ids.size(); ++row) {
+        counts.add(ids[row], weights[row]);
+    }
+    EXPECT_EQ(DataFrame::int_cast(labels.decode(counts.majority(true))), 1);
+}
+
+/**
+ * @brief Unit Test for the ClassCounts class
+ *
+ * @test Test that a label column with a class per row, as boosting rounds see, gives the same impurity as the kernel
+ */
+TEST(ClassCountsTest, ManyClassesTest) {
+    vector<double> targets(1000);
+    for (size_t i = 0; i < targets.size(); ++i) {
+        targets[i] = i * 0.5;
+    }
+    LabelEncoder labels(targets);
+    EXPECT_EQ(labels.num_classes(), 1000);
+
+    ImpurityKernel kernel(SplitCriterion::Entropy, 1000);
+    ClassCounts counts(labels.num_classes());
+    counts.add(labels.get_ids()[10]);
+    counts.add(labels.get_ids()[20]);
+    counts.add(labels.get_ids()[20], 1.0);
+    uint32_t dense[] = {1, 2};
+    EXPECT_DOUBLE_EQ(counts.weighted_impurity(kernel, false), kernel.weighted_impurity(dense, 2));
+    EXPECT_EQ(counts.majority(false), labels.get_ids()[20]);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
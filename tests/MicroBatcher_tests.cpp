@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include "../src/MicroBatcher.h"
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using std::vector;
+
+
+// Predicts the sum of every row and records the number of rows of every batch
+struct SumModel {
+    std::mutex mutex;
+    vector<size_t> batch_rows;
+
+    vector<double> operator()(const vector<double>& samples, size_t num_columns) {
+        vector<double> sums(samples.size() / num_columns, 0.0);
+        for (size_t i = 0; i < samples.size(); ++i) {
+            sums[i / num_columns] += samples[i];
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        batch_rows.push_back(sums.size());
+        return sums;
+    }
+};
+
+
+/**
+ * @brief Unit Test for the MicroBatcher class
+ *
+ * @test Test that queued requests are coalesced into batches of at most max_rows rows and get their own predictions
+ */
+TEST(MicroBatcherTest, BatchingTest) {
+    SumModel model;
+    {
+        // A long delay, so the batches are closed by the row limit
+        MicroBatcher batcher([&model](const vector<double>& samples, size_t num_columns) { return model(samples, num_columns); },
+                             2, 4, std::chrono::seconds(1));
+        EXPECT_EQ(batcher.get_num_columns(), 2);
+
+        vector<std::future<vector<double>>> results;
+        for (int i = 0; i < 10; ++i) {
+            results.push_back(batcher.submit({double(i), 1.0}));
+        }
+        results.push_back(batcher.submit({1.0, 1.0, 2.0, 2.0, 3.0, 3.0, 4.0, 4.0, 5.0, 5.0}));   // larger than max_rows
+
+        for (int i = 0; i < 10; ++i) {
+            EXPECT_EQ(results[i].get(), vector<double>{i + 1.0});
+        }
+        EXPECT_EQ(results[10].get(), (vector<double>{2.0, 4.0, 6.0, 8.0, 10.0}));
+        EXPECT_EQ(batcher.get_num_batches(), model.batch_rows.size());
+
+        EXPECT_THROW(batcher.submit({1.0, 2.0, 3.0}), std::invalid_argument);
+        EXPECT_THROW(batcher.submit({}), std::invalid_argument);
+    }
+
+    size_t total = 0;
+    for (size_t rows : model.batch_rows) {
+        EXPECT_TRUE(rows <= 4 || rows == 5);
+        total += rows;
+    }
+    EXPECT_EQ(total, 15);
+    EXPECT_LT(model.batch_rows.size(), 11);
+}
+
+/**
+ * @brief Unit Test for the MicroBatcher class
+ *
+ * @test Test that a lone request is answered after the delay, and that errors reach every request of the batch
+ */
+TEST(MicroBatcherTest, DelayAndErrorTest) {
+    MicroBatcher batcher([](const vector<double>& samples, size_t) -> vector<double> {
+        if (samples[0] < 0) {
+            throw std::runtime_error("negative feature");
+        }
+        return vector<double>(samples.size(), 7.0);
+    }, 1, 100, std::chrono::microseconds(500));
+
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(batcher.submit({1.0}).get(), vector<double>{7.0});
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::microseconds(500));
+
+    auto first = batcher.submit({-1.0});
+    auto second = batcher.submit({2.0});
+    EXPECT_THROW(first.get(), std::runtime_error);
+    EXPECT_THROW(second.get(), std::runtime_error);
+
+    EXPECT_THROW(MicroBatcher([](const vector<double>& samples, size_t) { return samples; }, 0, 1, std::chrono::microseconds(1)),
+                 std::invalid_argument);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "../src/ModelRegistry.h"
+#include "../src/DecisionTree.h"
+#include "../src/DataFrame.h"
+#include <atomic>
+#include <future>
+#include <memory>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+
+
+// A tree trained on rows that all carry the given label, so it always predicts that label
+static std::shared_ptr<DecisionTree> constant_tree(double label) {
+    vector<vector<double>> data = {{1.0, 2.0, label}, {2.0, 1.0, label}, {3.0, 0.0, label}};
+    auto tree = std::make_shared<DecisionTree>(3, 1);
+    tree->fit(std::make_unique<DataFrame>(data, vector<string>{"A", "B", "label"}), "label");
+    return tree;
+}
+
+
+/**
+ * @brief Unit Test for the ModelRegistry class
+ *
+ * @test Test that publishing swaps the model, returns the previous one, and releases it once nobody holds it
+ */
+TEST(ModelRegistryTest, PublishTest) {
+    ModelRegistry registry;
+    EXPECT_EQ(registry.acquire(), nullptr);
+    EXPECT_THROW(registry.predict({1.0, 1.0}), std::runtime_error);
+    EXPECT_THROW(registry.publish(nullptr), std::invalid_argument);
+
+    std::weak_ptr<DecisionTree> first;
+    {
+        auto tree = constant_tree(1.0);
+        first = tree;
+        EXPECT_EQ(registry.publish(std::move(tree)), nullptr);
+    }
+    EXPECT_EQ(registry.predict({1.0, 1.0}), 1.0);
+    EXPECT_EQ(registry.get_version(), 1);
+
+    // A request that acquired the first model keeps it after the swap
+    std::shared_ptr<const Classifier> in_flight = registry.acquire();
+    EXPECT_NE(registry.publish(constant_tree(2.0)), nullptr);
+    EXPECT_EQ(registry.predict({1.0, 1.0}), 2.0);
+    EXPECT_EQ(in_flight->predict({1.0, 1.0}), 1.0);
+    EXPECT_FALSE(first.expired());
+    in_flight.reset();
+    EXPECT_TRUE(first.expired());
+    EXPECT_EQ(registry.get_version(), 2);
+}
+
+/**
+ * @brief Unit Test for the ModelRegistry class
+ *
+ * @test Test that readers keep predicting with a valid model while another thread publishes new ones
+ */
+TEST(ModelRegistryTest, ConcurrentSwapTest) {
+    ModelRegistry registry(constant_tree(1.0));
+    vector<std::shared_ptr<const Classifier>> models = {constant_tree(1.0), constant_tree(2.0)};
+
+    std::atomic<bool> done(false);
+    vector<std::future<size_t>> readers;
+    for (int r = 0; r < 4; ++r) {
+        readers.push_back(std::async(std::launch::async, [&registry, &done]() {
+            size_t bad = 0;
+            do {
+                double prediction = registry.predict({1.0, 1.0});
+                bad += prediction != 1.0 && prediction != 2.0;
+            } while (!done.load());
+            return bad;
+        }));
+    }
+
+    for (int i = 0; i < 2000; ++i) {
+        registry.publish(models[i % 2]);
+    }
+    done.store(true);
+    for (auto& reader : readers) {
+        EXPECT_EQ(reader.get(), 0);
+    }
+    EXPECT_EQ(registry.get_version(), 2001);
+    EXPECT_EQ(registry.predict({1.0, 1.0}), 2.0);
+}
+
+/**
+ * @brief Unit Test for the ModelRegistry class
+ *
+ * @test Test that a thread's cached reference is refreshed by its next read after a publication, and dropped once the
+ *       registry is destroyed
+ */
+TEST(ModelRegistryTest, CachedReferenceTest) {
+    std::weak_ptr<DecisionTree> first, second;
+    auto registry = std::make_unique<ModelRegistry>();
+    {
+        auto tree = constant_tree(1.0);
+        first = tree;
+        registry->publish(std::move(tree));
+    }
+    EXPECT_EQ(registry->predict({1.0, 1.0}), 1.0);
+
+    // This thread still holds the first model until it reads the registry again
+    {
+        auto tree = constant_tree(2.0);
+        second = tree;
+        registry->publish(std::move(tree));
+    }
+    EXPECT_FALSE(first.expired());
+    EXPECT_EQ(registry->predict({1.0, 1.0}), 2.0);
+    EXPECT_TRUE(first.expired());
+
+    // Another thread's reference does not keep the model alive after that thread exits
+    std::async(std::launch::async, [&registry]() { return registry->predict({1.0, 1.0}); }).get();
+
+    // The reference cached for a destroyed registry is dropped at the next read of another registry
+    registry.reset();
+    EXPECT_FALSE(second.expired());
+    ModelRegistry other(constant_tree(3.0));
+    EXPECT_EQ(other.predict({1.0, 1.0}), 3.0);
+    EXPECT_TRUE(second.expired());
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
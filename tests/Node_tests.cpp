@@ -92,6 +92,60 @@ TEST(DecisionNodeTest, AccessorMutatorTest1) {
     EXPECT_EQ(root->predict(sample), 3);
 }
 
+TEST(DecisionNodeTest, MemoryUsageTest) {
+    LeafNode leaf(1);
+    EXPECT_EQ(leaf.memory_usage(), sizeof(LeafNode));
+
+    auto root = std::make_unique<DecisionNode>(0, 3.0, std::make_unique<LeafNode>(3), std::make_unique<LeafNode>(8));
+    EXPECT_EQ(root->memory_usage(), sizeof(DecisionNode) + 2 * sizeof(LeafNode));
+}
+
+TEST(DecisionNodeTest, ToCppTest) {
+    auto root = std::make_unique<DecisionNode>(1, 2.5, std::make_unique<LeafNode>(3), std::make_unique<LeafNode>(0.1));
+
+    std::ostringstream oss;
+    root->to_cpp(oss, {}, "");
+    EXPECT_EQ(oss.str(), "if (x[1] <= 0x1.4p+1) {\n    return 0x1.8p+1;\n} else {\n    return 0x1.999999999999ap-4;\n}\n");
+
+    // Feature indices are remapped to positions in the sample
+    std::ostringstream remapped;
+    root->to_cpp(remapped, {4, 7}, "  ");
+    EXPECT_EQ(remapped.str().substr(0, 11), "  if (x[7] ");
+}
+
+TEST(NodeArenaTest, ArenaTest) {
+    NodeArena arena;
+    unique_ptr<Node> root;
+    {
+        NodeArena::Scope scope(arena);
+        auto left = std::make_unique<LeafNode>(3);
+        auto right = std::make_unique<LeafNode>(8);
+        EXPECT_GT(reinterpret_cast<char*>(right.get()), reinterpret_cast<char*>(left.get()));   // creation order
+        EXPECT_LT(reinterpret_cast<char*>(right.get()) - reinterpret_cast<char*>(left.get()), 64);
+        root = std::make_unique<DecisionNode>(0, 3.0, std::move(left), std::move(right));
+    }
+    EXPECT_EQ(NodeArena::active(), nullptr);
+    EXPECT_EQ(arena.get_num_blocks(), 1);
+    EXPECT_EQ(arena.memory_usage(), 4096);
+    EXPECT_EQ(root->predict({5.0}), 8);
+
+    // Nodes created outside a scope come from the heap and are freed as usual
+    auto heap_leaf = std::make_unique<LeafNode>(1);
+    EXPECT_EQ(arena.get_num_blocks(), 1);
+    heap_leaf.reset();
+
+    // Blocks grow as the tree does; deleting arena nodes leaves their memory to the arena
+    {
+        NodeArena::Scope scope(arena);
+        for (int i = 0; i < 1000; ++i) {
+            root = std::make_unique<DecisionNode>(0, i, std::move(root), std::make_unique<LeafNode>(i));
+        }
+    }
+    EXPECT_GT(arena.get_num_blocks(), 1);
+    EXPECT_EQ(root->get_num_nodes(), 2003);
+    root.reset();
+}
+
 
 
 
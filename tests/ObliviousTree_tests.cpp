@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include "../src/ObliviousTree.h"
+#include "../src/FlatTree.h"
+#include "../src/DataFrame.h"
+#include <cmath>
+#include <vector>
+#include <string>
+
+using std::vector;
+using std::string;
+using std::unique_ptr;
+
+
+/**
+ * @brief Unit Test for the ObliviousTree class
+ *
+ * @test Test that a tree learns two independent thresholds exactly, and that every prediction path agrees
+ */
+TEST(ObliviousTreeTest, FitPredictTest) {
+    // The label is 2 * (A > 5) + (B > 5); C is noise
+    vector<vector<double>> data;
+    for (int i = 0; i < 40; ++i) {
+        double a = (i * 7) % 11;
+        double b = (i * 3) % 10;
+        double c = (i * 13) % 17;
+        data.push_back({a, b, c, 2.0 * (a > 5) + (b > 5)});
+    }
+    vector<string> columns = {"A", "B", "C", "label"};
+
+    ObliviousTree tree(3, 2);
+    EXPECT_THROW(tree.predict({0.0, 0.0, 0.0}), std::runtime_error);
+    tree.fit(std::make_unique<DataFrame>(data, columns), "label");
+    EXPECT_LE(tree.get_depth(), 3);
+
+    vector<double> samples;
+    for (const auto& row : data) {
+        EXPECT_EQ(tree.predict({row[0], row[1], row[2]}), row[3]);
+        samples.insert(samples.end(), {row[0], row[1], row[2]});
+    }
+
+    // The expanded nodes, their flat form, and the batch predict all agree with predict, including for NaN
+    samples.insert(samples.end(), {NAN, 1.0, 2.0, 8.0, NAN, 0.0});
+    unique_ptr<Node> root = tree.to_node_tree();
+    FlatTree flat(*root);
+    EXPECT_EQ(flat.size(), (size_t(2) << tree.get_depth()) - 1);
+    EXPECT_EQ(root->get_num_samples(), data.size());
+
+    vector<double> predictions = tree.predict_batch(samples, 3);
+    ASSERT_EQ(predictions.size(), samples.size() / 3);
+    for (size_t i = 0; i < predictions.size(); ++i) {
+        vector<double> sample(samples.begin() + 3 * i, samples.begin() + 3 * i + 3);
+        EXPECT_EQ(predictions[i], tree.predict(sample));
+        EXPECT_EQ(root->predict(sample), tree.predict(sample));
+        EXPECT_EQ(flat.predict(sample.data()), tree.predict(sample));
+    }
+
+    EXPECT_THROW(tree.predict_batch(samples, 4), std::invalid_argument);
+    EXPECT_THROW(tree.predict({1.0}), std::invalid_argument);
+    EXPECT_GT(tree.memory_usage(), sizeof(ObliviousTree));
+}
+
+/**
+ * @brief Unit Test for the ObliviousTree class
+ *
+ * @test Test that growth stops when no threshold separates a leaf, and that invalid settings are rejected
+ */
+TEST(ObliviousTreeTest, ValidationTest) {
+    vector<vector<double>> constant = {{1.0, 0}, {1.0, 1}, {1.0, 1}};
+    ObliviousTree tree(4, 1);
+    tree.fit(std::make_unique<DataFrame>(constant, vector<string>{"A", "label"}), "label");
+    EXPECT_EQ(tree.get_depth(), 0);
+    EXPECT_EQ(tree.predict({5.0}), 1);
+
+    EXPECT_THROW(ObliviousTree(25, 1), std::invalid_argument);
+    EXPECT_THROW(ObliviousTree(3, 1, 0.0, 0), std::invalid_argument);
+    EXPECT_THROW(tree.fit(std::make_unique<DataFrame>(constant, vector<string>{"A", "label"}), "label", "weight"),
+                 std::invalid_argument);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
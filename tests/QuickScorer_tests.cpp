@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+#include "../src/Node.h"
+#include "../src/FlatTree.h"
+#include "../src/QuickScorer.h"
+#include "RandomTrees.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using std::vector;
+using std::unique_ptr;
+
+
+/**
+ * @brief Unit Test for the QuickScorer class
+ * 
+ * @test Test that both the SIMD and the scalar code agree with FlatTree::predict on random trees
+ */
+TEST(QuickScorerTest, ScoreTest) {
+    std::mt19937 generator(123456);
+    size_t num_features = 5;
+
+    vector<FlatTree> trees;
+    vector<vector<size_t>> features;
+    for (int t = 0; t < 20; ++t) {
+        double next_value = 100.0 * t;
+        auto next_leaf = [&next_value] { return next_value += 1.0; };
+        trees.emplace_back(*random_tree(generator, num_features, 6, next_leaf));
+        features.push_back({});
+    }
+
+    QuickScorer simd(trees, features, num_features);
+    QuickScorer scalar(trees, features, num_features, false);
+    EXPECT_FALSE(scalar.uses_avx2());
+    EXPECT_EQ(simd.get_num_trees(), 20);
+
+    std::uniform_real_distribution<double> value(-1.2, 1.2);
+    for (int i = 0; i < 500; ++i) {
+        vector<double> sample(num_features);
+        for (auto& x : sample) {
+            x = i % 2 ? std::round(value(generator) * 4) / 4 : value(generator);
+        }
+        if (i % 50 == 0) {
+            sample[i % num_features] = std::nan("");
+        }
+
+        vector<double> simd_values(trees.size());
+        vector<double> scalar_values(trees.size());
+        simd.score(sample.data(), simd_values.data());
+        scalar.score(sample.data(), scalar_values.data());
+        for (size_t t = 0; t < trees.size(); ++t) {
+            EXPECT_EQ(simd_values[t], trees[t].predict(sample.data()));
+            EXPECT_EQ(scalar_values[t], trees[t].predict(sample.data()));
+        }
+    }
+}
+
+/**
+ * @brief Unit Test for the QuickScorer class
+ * 
+ * @test Test the feature mapping and the limits on the trees
+ */
+TEST(QuickScorerTest, ValidationTest) {
+    auto root = std::make_unique<DecisionNode>(1, 2.5, std::make_unique<LeafNode>(7), std::make_unique<LeafNode>(9));
+    vector<FlatTree> trees;
+    trees.emplace_back(*root);
+
+    // The tree's feature 1 is the sample's feature 3
+    QuickScorer scorer(trees, {{0, 3}}, 4);
+    double value;
+    scorer.score(vector<double>{0.0, 9.0, 9.0, 2.5}.data(), &value);
+    EXPECT_EQ(value, 7);
+    scorer.score(vector<double>{0.0, 0.0, 0.0, 3.0}.data(), &value);
+    EXPECT_EQ(value, 9);
+
+    EXPECT_THROW(QuickScorer(trees, {{0, 4}}, 4), std::invalid_argument);
+    EXPECT_THROW(QuickScorer(trees, {}, 4), std::invalid_argument);
+
+    // A complete tree of depth 7 has 128 leaves
+    std::mt19937 generator(1);
+    unique_ptr<Node> deep = std::make_unique<LeafNode>(0);
+    for (int depth = 0; depth < 7; ++depth) {
+        auto copy = FlatTree(*deep).to_node();
+        deep = std::make_unique<DecisionNode>(0, depth, std::move(deep), std::move(copy));
+    }
+    vector<FlatTree> deep_trees;
+    deep_trees.emplace_back(*deep);
+    EXPECT_THROW(QuickScorer(deep_trees, {{}}, 1), std::invalid_argument);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
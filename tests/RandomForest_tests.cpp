@@ -4,6 +4,10 @@
 #include "../src/Node.h"
 #include "../src/RandomForest.h"
 #include <vector>
+#include <numeric>
+#include <algorithm>
+#include <future>
+#include "GeneratedCode.h"
 
 
 /**
@@ -101,6 +105,504 @@ TEST(RandomForestTest, RandomForestHypertune) {
     EXPECT_EQ(best_num_features, 2);
 }
 
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that a saved and loaded RandomForest predicts like the original
+ */
+TEST(RandomForestTest, RandomForestSaveLoad) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(50);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(5, 3, 1, 2, 123456);
+    string path = ::testing::TempDir() + "random_forest_save_load.bin";
+    EXPECT_THROW(rf.save(path), std::runtime_error);
+    rf.fit(data, "weather");
+    rf.save(path);
+
+    std::unique_ptr<RandomForest> loaded = RandomForest::load(path);
+    vector<vector<double>> samples = {{0.0, 12.8, 5.0, 4.7}, {1.0, 9.8, -1.0, 6.7}, {4.0, 1.8, -3.0, 2.7}, {0.3, 20.1, 11.2, 1.5}};
+    for (const auto& sample : samples) {
+        EXPECT_EQ(loaded->predict(sample), rf.predict(sample));
+    }
+    EXPECT_EQ(loaded->print(), rf.print());
+    EXPECT_EQ(loaded->get_classes(), rf.get_classes());
+    EXPECT_EQ(loaded->predict_votes(samples[0]), rf.predict_votes(samples[0]));
+    EXPECT_THROW(loaded->predict({0.0, 12.8, 5.0}), std::runtime_error);
+
+    // A forest file does not hold a single decision tree
+    EXPECT_THROW(DecisionTree::load(path), std::runtime_error);
+    std::remove(path.c_str());
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that the generated C++ code predicts like the RandomForest
+ */
+TEST(RandomForestTest, RandomForestToCpp) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(50);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest model(5, 3, 1, 2, 123456);
+    EXPECT_THROW(model.to_cpp(), std::runtime_error);
+    model.fit(data, "weather");
+
+    string source = model.to_cpp();
+    EXPECT_NE(source.find("extern \"C\" double predict(const double* x)"), string::npos);
+
+    if (!compiler_available()) {
+        GTEST_SKIP() << "No C++ compiler available to build the generated code";
+    }
+    PredictFunction predict = compile_generated(source, "randomforest_to_cpp");
+    ASSERT_NE(predict, nullptr);
+    vector<vector<double>> samples = {{0.0, 12.8, 5.0, 4.7}, {1.0, 9.8, -1.0, 6.7}, {4.0, 1.8, -3.0, 2.7}, {0.3, 20.1, 11.2, 1.5}};
+    for (const auto& sample : samples) {
+        EXPECT_EQ(predict(sample.data()), model.predict(sample));
+    }
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that the QuickScorer engine predicts like the pointer-based engine
+ */
+TEST(RandomForestTest, RandomForestQuickScorer) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(8, 4, 1, 2, 123456);
+    rf.set_inference_engine(InferenceEngine::QuickScorer);   // selected before fit: built at the end of fit
+    rf.fit(data, "weather");
+    EXPECT_EQ(rf.get_inference_engine(), InferenceEngine::QuickScorer);
+
+    vector<vector<double>> samples;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        vector<double> sample;
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                sample.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+        samples.push_back(sample);
+    }
+
+    vector<double> quick_predictions;
+    for (const auto& sample : samples) {
+        quick_predictions.push_back(rf.predict(sample));
+    }
+    rf.set_inference_engine(InferenceEngine::Pointer);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(rf.predict(samples[i]), quick_predictions[i]);
+    }
+    EXPECT_THROW(rf.predict({0.0, 12.8, 5.0}), std::runtime_error);
+
+    // A fit whose trees the QuickScorer cannot hold keeps the fitted forest
+    RandomForest refit(4, 20, 1, 4, 123456);
+    refit.set_inference_engine(InferenceEngine::QuickScorer);
+    refit.fit(data->head(10), "weather");
+    string fitted = refit.print();
+    double fitted_prediction = refit.predict(samples[0]);
+    // A bootstrap of 100 rows has fewer than 64 distinct rows, so the deep trees need the whole data set
+    std::shared_ptr<DataFrame> full = DataFrame::read_csv("../../samples/seattle-weather.csv");
+    full->drop_column("date");
+    full->one_hot_encode("weather");
+    EXPECT_THROW(refit.fit(full, "weather"), std::invalid_argument);
+    EXPECT_EQ(refit.get_inference_engine(), InferenceEngine::QuickScorer);
+    EXPECT_EQ(refit.print(), fitted);
+    EXPECT_EQ(refit.predict(samples[0]), fitted_prediction);
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that the batch predict agrees with predict for both inference engines
+ */
+TEST(RandomForestTest, RandomForestPredictBatch) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(8, 4, 1, 2, 123456);
+    EXPECT_THROW(rf.predict_batch({0.0, 12.8, 5.0, 4.7}, 4), std::runtime_error);
+    rf.fit(data, "weather");
+
+    vector<double> samples;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                samples.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+    }
+
+    vector<double> predictions = rf.predict_batch(samples, 4);
+    ASSERT_EQ(predictions.size(), data->get_num_rows());
+    for (size_t i = 0; i < predictions.size(); ++i) {
+        EXPECT_EQ(predictions[i], rf.predict(vector<double>(samples.begin() + 4 * i, samples.begin() + 4 * i + 4)));
+    }
+
+    // A slice of the buffer is predicted in place into a slice of the output
+    vector<double> slice(predictions.size(), -1.0);
+    rf.predict_batch(samples.data() + 4 * 10, 20, 4, slice.data() + 10);
+    for (size_t i = 0; i < slice.size(); ++i) {
+        EXPECT_EQ(slice[i], i >= 10 && i < 30 ? predictions[i] : -1.0);
+    }
+
+    rf.set_inference_engine(InferenceEngine::QuickScorer);
+    EXPECT_EQ(rf.predict_batch(samples, 4), predictions);
+
+    EXPECT_THROW(rf.predict_batch(samples, 3), std::runtime_error);
+    EXPECT_THROW(rf.predict_batch({0.0, 12.8, 5.0}, 4), std::invalid_argument);
+}
+
+/**
+ * @brief Unit Test for the RandomForest class
+ * 
+ * @test Test that a forest of oblivious trees predicts alike through every evaluation path
+ */
+TEST(RandomForestTest, RandomForestOblivious) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(8, 3, 2, 2, 123456);
+    rf.set_oblivious(true);
+    EXPECT_TRUE(rf.is_oblivious());
+    rf.fit(data, "weather");
+
+    vector<double> samples;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                samples.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+    }
+
+    // predict uses the level tables of the trees, predict_batch and the QuickScorer use their expanded nodes
+    vector<double> predictions = rf.predict_batch(samples, 4);
+    for (size_t i = 0; i < predictions.size(); ++i) {
+        EXPECT_EQ(predictions[i], rf.predict(vector<double>(samples.begin() + 4 * i, samples.begin() + 4 * i + 4)));
+    }
+    rf.set_inference_engine(InferenceEngine::QuickScorer);
+    EXPECT_EQ(rf.predict_batch(samples, 4), predictions);
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that the compact engine predicts like walking the trees, in less memory than the QuickScorer
+ */
+TEST(RandomForestTest, RandomForestCompact) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(8, 4, 1, 2, 123456);
+    rf.fit(data, "weather");
+
+    vector<double> samples;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                samples.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+    }
+    vector<double> predictions = rf.predict_batch(samples, 4);
+    size_t pointer_bytes = rf.memory_usage();
+
+    rf.set_inference_engine(InferenceEngine::QuickScorer);
+    size_t quick_bytes = rf.memory_usage() - pointer_bytes;
+    rf.set_inference_engine(InferenceEngine::Compact);
+    size_t compact_bytes = rf.memory_usage() - pointer_bytes;
+    EXPECT_LT(compact_bytes, quick_bytes);
+
+    EXPECT_EQ(rf.predict_batch(samples, 4), predictions);
+    for (size_t i = 0; i < predictions.size(); ++i) {
+        EXPECT_EQ(rf.predict(vector<double>(samples.begin() + 4 * i, samples.begin() + 4 * i + 4)), predictions[i]);
+    }
+
+    // Too many classes for 8-bit class ids: the leaves are kept as float32 instead
+    vector<vector<double>> many_classes;
+    for (size_t i = 0; i < 1200; ++i) {
+        many_classes.push_back({static_cast<double>(i), static_cast<double>(i % 7), static_cast<double>(i / 3)});
+    }
+    std::shared_ptr<DataFrame> many = std::make_shared<DataFrame>(many_classes, vector<string>({"x", "y", "label"}));
+    RandomForest wide(2, 12, 2, 2, 123456);
+    wide.fit(many, "label");
+    ASSERT_GT(wide.get_classes().size(), 256);
+    vector<double> wide_samples = {10.0, 3.0, 500.0, 1.0, 1199.0, 2.0};
+    vector<double> wide_predictions = wide.predict_batch(wide_samples, 2);
+    ASSERT_NO_THROW(wide.set_inference_engine(InferenceEngine::Compact));
+    EXPECT_EQ(wide.predict_batch(wide_samples, 2), wide_predictions);
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that the votes and probabilities agree with predict and with every inference engine
+ */
+TEST(RandomForestTest, RandomForestPredictProba) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(9, 4, 1, 2, 123456);
+    EXPECT_THROW(rf.predict_proba({0.0, 12.8, 5.0, 4.7}), std::runtime_error);
+    rf.fit(data, "weather");
+
+    // The class table holds every training label, whether or not a leaf predicts it
+    vector<double> classes = rf.get_classes();
+    vector<double> labels = data->get_column("weather").convert_to_numeric();
+    std::sort(labels.begin(), labels.end());
+    labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+    EXPECT_EQ(classes, labels);
+
+    RandomForest stump(1, 1, 1, 2, 123456);
+    stump.fit(data, "weather");
+    EXPECT_EQ(stump.get_classes(), labels);
+    EXPECT_EQ(stump.predict_votes({0.0, 12.8, 5.0, 4.7}).size(), labels.size());
+
+    for (size_t i = 0; i < data->get_num_rows(); i += 7) {
+        vector<double> sample;
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                sample.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+
+        vector<size_t> votes = rf.predict_votes(sample);
+        vector<double> proba = rf.predict_proba(sample);
+        ASSERT_EQ(votes.size(), classes.size());
+        ASSERT_EQ(proba.size(), classes.size());
+        EXPECT_EQ(std::accumulate(votes.begin(), votes.end(), size_t(0)), 9);
+        EXPECT_DOUBLE_EQ(std::accumulate(proba.begin(), proba.end(), 0.0), 1.0);
+
+        // The first class with the most votes is the prediction
+        size_t best = std::max_element(votes.begin(), votes.end()) - votes.begin();
+        EXPECT_EQ(rf.predict(sample), classes[best]);
+        EXPECT_DOUBLE_EQ(proba[best], votes[best] / 9.0);
+
+        rf.set_inference_engine(InferenceEngine::Compact);
+        EXPECT_EQ(rf.predict_votes(sample), votes);
+        rf.set_inference_engine(InferenceEngine::Pointer);
+    }
+    EXPECT_THROW(rf.predict_votes({0.0, 12.8, 5.0}), std::runtime_error);
+}
+
+/**
+ * @brief Unit Test for the RandomForest class
+ *
+ * @test Test that the exact early exit gives the predictions of the full vote while evaluating fewer trees
+ */
+TEST(RandomForestTest, RandomForestEarlyExit) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(15, 4, 1, 2, 123456);
+    EXPECT_THROW(rf.set_early_exit(true, 1.0), std::invalid_argument);
+    EXPECT_THROW(rf.set_early_exit(true, -0.1), std::invalid_argument);
+    rf.set_early_exit(true);
+    EXPECT_TRUE(rf.is_early_exit());
+    rf.fit(data, "weather");
+
+    vector<vector<double>> samples;
+    vector<double> buffer;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        vector<double> sample;
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                sample.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+        samples.push_back(sample);
+        buffer.insert(buffer.end(), sample.begin(), sample.end());
+    }
+
+    rf.set_early_exit(false);
+    vector<double> expected;
+    for (const auto& sample : samples) {
+        expected.push_back(rf.predict(sample));
+    }
+    EXPECT_EQ(rf.get_mean_trees_evaluated(), 0.0);
+
+    // The trees evaluated are only counted on request
+    rf.set_early_exit(true);
+    for (const auto& sample : samples) {
+        rf.predict(sample);
+    }
+    EXPECT_EQ(rf.get_mean_trees_evaluated(), 0.0);
+
+    // The exact early exit never changes a prediction, and most votes on the training data are clear
+    rf.set_early_exit_stats(true);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(rf.predict(samples[i]), expected[i]);
+    }
+    double exact_trees = rf.get_mean_trees_evaluated();
+    EXPECT_GT(exact_trees, 0.0);
+    EXPECT_LT(exact_trees, 15.0);
+
+    // A margin stops at least as soon
+    rf.reset_early_exit_stats();
+    rf.set_early_exit(true, 0.5);
+    for (const auto& sample : samples) {
+        rf.predict(sample);
+    }
+    EXPECT_LE(rf.get_mean_trees_evaluated(), exact_trees);
+
+    // Ranking the trees again keeps the predictions of every engine
+    rf.set_early_exit(true);
+    rf.rank_trees(buffer, samples.front().size());
+    rf.set_inference_engine(InferenceEngine::Compact);
+    for (size_t i = 0; i < samples.size(); i += 9) {
+        EXPECT_EQ(rf.predict(samples[i]), expected[i]);
+    }
+    rf.set_inference_engine(InferenceEngine::Pointer);
+    for (size_t i = 0; i < samples.size(); ++i) {
+        EXPECT_EQ(rf.predict(samples[i]), expected[i]);
+    }
+    EXPECT_THROW(rf.rank_trees(buffer, 3), std::runtime_error);
+    EXPECT_THROW(rf.predict({0.0, 12.8, 5.0}), std::runtime_error);
+}
+
+/**
+ * @brief Unit Test for the RandomForest class
+ *
+ * @test Test that the sharded score and predict_all match predict row by row, and leave the data untouched
+ */
+TEST(RandomForestTest, RandomForestShardedScore) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+
+    // Clean data
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> data = std::move(df);
+
+    RandomForest rf(7, 4, 1, 2, 123456);
+    EXPECT_THROW(rf.score(data, "weather"), std::runtime_error);
+    rf.fit(data, "weather");
+
+    vector<double> expected;
+    double correct = 0.0;
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        vector<double> sample;
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                sample.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+        expected.push_back(rf.predict(sample));
+        correct += expected.back() == DataFrame::double_cast(data->get_column("weather").retrieve(i));
+    }
+
+    vector<string> columns = data->columns;
+    for (size_t num_threads : {1, 3, 0}) {
+        EXPECT_EQ(rf.predict_all(*data, "weather", num_threads), expected);
+        EXPECT_DOUBLE_EQ(rf.score(data, "weather", num_threads), correct / data->get_num_rows());
+    }
+    EXPECT_EQ(data->columns, columns);
+
+    // Two threads can score the same frame at once
+    auto first = std::async(std::launch::async, [&]() { return rf.score(data, "weather", 2); });
+    auto second = std::async(std::launch::async, [&]() { return rf.score(data, "weather", 2); });
+    EXPECT_DOUBLE_EQ(first.get(), second.get());
+
+    // Without the label column every column is a feature
+    std::unique_ptr<DataFrame> features = data->copy();
+    features->drop_column("weather");
+    EXPECT_EQ(rf.predict_all(*features, "weather"), expected);
+    features->drop_column("wind");
+    EXPECT_THROW(rf.predict_all(*features, "weather"), std::runtime_error);
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that fit adds up the training statistics of its trees
+ */
+TEST(RandomForestTest, RandomForestTrainingStats) {
+    unique_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(40);
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+
+    RandomForest rf(4, 3, 2, 2, 123456);
+    TrainingStats stats = rf.fit(std::move(df), "weather");
+
+    EXPECT_EQ(stats.num_trees, 4);
+    EXPECT_EQ(stats.nodes, 2 * stats.leaves - stats.num_trees);   // every tree is a full binary tree
+    EXPECT_LE(stats.depth, 3);
+    EXPECT_GT(stats.rows_scanned, 0);
+    EXPECT_GT(stats.candidate_thresholds, 0);
+    EXPECT_GT(stats.fit_seconds, 0.0);
+}
+
+/**
+ * @brief Unit Tests for the RandomForest class
+ * 
+ * @test Test that a second fit replaces the trees and classes of the first, so the forest predicts like a new one
+ */
+TEST(RandomForestTest, RandomForestRefit) {
+    std::shared_ptr<DataFrame> data = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+    data->drop_column("date");
+    data->one_hot_encode("weather");
+    std::shared_ptr<DataFrame> subset = data->head(13);   // no snow in the first 13 days
+
+    RandomForest rf(6, 4, 2, 2, 123456), fresh(6, 4, 2, 2, 123456);
+    rf.set_inference_engine(InferenceEngine::Compact);
+    fresh.set_inference_engine(InferenceEngine::Compact);
+    rf.fit(data, "weather");
+    rf.fit(subset, "weather");
+    fresh.fit(subset, "weather");
+    ASSERT_LT(rf.get_classes().size(), 4);   // the subset lacks a label of the first fit
+    EXPECT_EQ(rf.get_classes(), fresh.get_classes());
+    EXPECT_EQ(rf.print(), fresh.print());
+
+    for (size_t i = 0; i < data->get_num_rows(); ++i) {
+        vector<double> sample;
+        for (const auto& col : data->columns) {
+            if (col != "weather") {
+                sample.push_back(DataFrame::double_cast(data->get_column(col).retrieve(i)));
+            }
+        }
+        vector<size_t> votes = rf.predict_votes(sample);
+        EXPECT_EQ(std::accumulate(votes.begin(), votes.end(), size_t(0)), 6);
+        EXPECT_EQ(rf.predict(sample), fresh.predict(sample));
+        rf.set_inference_engine(InferenceEngine::Pointer);
+        EXPECT_EQ(rf.predict(sample), fresh.predict(sample));
+        rf.set_inference_engine(InferenceEngine::Compact);
+    }
+}
+
 
 
 int main(int argc, char* argv[])
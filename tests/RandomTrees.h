@@ -0,0 +1,27 @@
+#ifndef RANDOMTREES_H
+#define RANDOMTREES_H
+
+#include "../src/Node.h"
+#include <cmath>
+#include <functional>
+#include <memory>
+#include <random>
+
+// Shared helpers of the tests that check the inference engines against FlatTree::predict on random trees
+
+// Builds a random tree over num_features features with the given depth; each leaf predicts the next leaf_value()
+inline std::unique_ptr<Node> random_tree(std::mt19937& generator, size_t num_features, int depth,
+                                         const std::function<double()>& leaf_value) {
+    std::uniform_real_distribution<double> threshold(-1.0, 1.0);
+    if (depth == 0 || generator() % 5 == 0) {
+        return std::make_unique<LeafNode>(leaf_value());
+    }
+    // Thresholds are rounded so that samples often hit them exactly
+    int feature = generator() % num_features;
+    double value = std::round(threshold(generator) * 4) / 4;
+    auto left = random_tree(generator, num_features, depth - 1, leaf_value);
+    auto right = random_tree(generator, num_features, depth - 1, leaf_value);
+    return std::make_unique<DecisionNode>(feature, value, std::move(left), std::move(right));
+}
+
+#endif
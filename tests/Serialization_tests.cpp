@@ -0,0 +1,148 @@
+#include <gtest/gtest.h>
+#include "../src/Node.h"
+#include "../src/FlatTree.h"
+#include "../src/Serialization.h"
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+using std::vector;
+using std::string;
+
+
+// Header of a small random forest model file
+static ModelHeader make_header(uint32_t num_trees) {
+    ModelHeader header{};
+    header.model_type = static_cast<uint32_t>(ModelType::RandomForest);
+    header.num_trees = num_trees;
+    header.num_names = 3;
+    header.max_depth = 2;
+    header.min_samples_split = 1;
+    header.num_features = 2;
+    header.random_state = 42;
+    return header;
+}
+
+
+/**
+ * @brief Unit Test for the ModelWriter and ModelReader classes
+ * 
+ * @test Test that the sections of a model file are read back as they were written
+ */
+TEST(SerializationTest, RoundTripTest) {
+    string path = ::testing::TempDir() + "serialization_round_trip.bin";
+    auto root = std::make_unique<DecisionNode>(1, 2.5, std::make_unique<LeafNode>(7), std::make_unique<LeafNode>(9));
+
+    ModelHeader header = make_header(2);
+    header.num_classes = 3;
+    ModelWriter writer(header);
+    EXPECT_THROW(writer.write_tree(FlatTree(*root), {0, 2}), std::runtime_error);   // names come first
+    EXPECT_THROW(writer.write_classes({3, 7, 9}), std::runtime_error);
+    writer.write_names({"alpha", "b", "label"});
+    EXPECT_THROW(writer.write_tree(FlatTree(*root), {0, 2}), std::runtime_error);   // then the classes
+    EXPECT_THROW(writer.write_classes({3, 7}), std::runtime_error);
+    writer.write_classes({3, 7, 9});
+    writer.write_tree(FlatTree(*root), {0, 2});
+    EXPECT_THROW(writer.save(path), std::runtime_error);   // one tree missing
+    writer.write_tree(FlatTree(LeafNode(3)), {});
+    writer.save(path);
+
+    ModelReader reader(path, ModelType::RandomForest);
+    EXPECT_EQ(reader.header().num_trees, 2);
+    EXPECT_EQ(reader.header().random_state, 42);
+    EXPECT_EQ(reader.names(), vector<string>({"alpha", "b", "label"}));
+    EXPECT_EQ(reader.classes(), vector<double>({3, 7, 9}));
+
+    vector<size_t> features;
+    FlatTree tree = reader.read_tree(features);
+    EXPECT_EQ(features, vector<size_t>({0, 2}));
+    EXPECT_EQ(tree.size(), 3);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(tree.data()) % alignof(FlatNode), 0);
+    EXPECT_EQ(tree.predict(vector<double>{0.0, 2.0}.data()), 7);
+    EXPECT_EQ(tree.predict(vector<double>{0.0, 3.0}.data()), 9);
+
+    FlatTree leaf = reader.read_tree(features);
+    EXPECT_TRUE(features.empty());
+    EXPECT_EQ(leaf.predict(nullptr), 3);
+    EXPECT_THROW(reader.read_tree(features), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+/**
+ * @brief Unit Test for the ModelReader class
+ * 
+ * @test Test that files which are not valid model files are rejected
+ */
+TEST(SerializationTest, InvalidFileTest) {
+    string path = ::testing::TempDir() + "serialization_invalid.bin";
+    EXPECT_THROW(ModelReader(path, ModelType::RandomForest), std::runtime_error);   // missing
+
+    ModelWriter writer(make_header(1));
+    writer.write_names({"alpha", "b", "label"});
+    writer.write_tree(FlatTree(LeafNode(3)), {});
+    writer.save(path);
+    EXPECT_THROW(ModelReader(path, ModelType::DecisionTree), std::runtime_error);   // wrong kind of model
+
+    // Truncate the file in the middle of the tree section
+    std::ifstream in(path, std::ios::binary);
+    string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    in.close();
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size() - 8);
+    ModelReader truncated(path, ModelType::RandomForest);
+    vector<size_t> features;
+    EXPECT_THROW(truncated.read_tree(features), std::runtime_error);
+
+    // Corrupt the magic
+    bytes[0] = 'X';
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(bytes.data(), bytes.size());
+    EXPECT_THROW(ModelReader(path, ModelType::RandomForest), std::runtime_error);
+
+    std::remove(path.c_str());
+}
+
+/**
+ * @brief Unit Test for the ModelWriter class
+ * 
+ * @test Test that overwriting a model file leaves the models mapped from the old file intact
+ */
+TEST(SerializationTest, OverwriteMappedTest) {
+    string path = ::testing::TempDir() + "serialization_overwrite.bin";
+    auto root = std::make_unique<DecisionNode>(1, 2.5, std::make_unique<LeafNode>(7), std::make_unique<LeafNode>(9));
+    ModelWriter writer(make_header(2));
+    writer.write_names({"alpha", "b", "label"});
+    writer.write_tree(FlatTree(*root), {0, 2});
+    writer.write_tree(FlatTree(*root), {0, 2});
+    writer.save(path);
+
+    ModelReader reader(path, ModelType::RandomForest);
+    vector<size_t> features;
+    reader.read_tree(features);
+    FlatTree tree = reader.read_tree(features);
+
+    // Replace the file with a smaller model while the old one is still mapped
+    ModelWriter smaller(make_header(1));
+    smaller.write_names({"a", "b", "c"});
+    smaller.write_tree(FlatTree(LeafNode(3)), {});
+    smaller.save(path);
+
+    EXPECT_EQ(tree.predict(vector<double>{0.0, 2.0}.data()), 7);
+    EXPECT_EQ(tree.predict(vector<double>{0.0, 3.0}.data()), 9);
+    EXPECT_EQ(reader.names(), vector<string>({"alpha", "b", "label"}));
+
+    // The new file is complete
+    ModelReader replaced(path, ModelType::RandomForest);
+    EXPECT_EQ(replaced.header().num_trees, 1);
+    EXPECT_EQ(replaced.read_tree(features).predict(nullptr), 3);
+    std::remove(path.c_str());
+
+    EXPECT_THROW(smaller.save(::testing::TempDir() + "missing_directory/model.bin"), std::runtime_error);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+#include "../src/SortedIndex.h"
+#include "../src/DataFrame.h"
+#include "../src/DecisionTree.h"
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+/**
+ * @brief Unit Test for the SortedIndex class
+ *
+ * @test Test that every feature's rows are sorted by value, with ties in their original order
+ */
+TEST(SortedIndexTest, IndexTest) {
+    vector<vector<double>> data = {
+        {2.0, 1.5, 0},
+        {1.0, 3.0, 1},
+        {2.0, 2.0, 0},
+        {0.5, 3.5, 1},
+        {2.0, 2.5, 1}
+    };
+    DataFrame df(data, {"A", "B", "C"});
+
+    SortedIndex index(df, {"B", "A"});
+    EXPECT_EQ(index.get_num_rows(), 5);
+    EXPECT_EQ(index.get_num_features(), 2);
+    EXPECT_EQ(index.find("A"), 1);
+    EXPECT_EQ(index.get_values(1), vector<double>({2.0, 1.0, 2.0, 0.5, 2.0}));
+    EXPECT_EQ(index.get_order(0), vector<uint32_t>({0, 2, 4, 1, 3}));
+    EXPECT_EQ(index.get_order(1), vector<uint32_t>({3, 1, 0, 2, 4}));
+    EXPECT_GT(index.memory_usage(), sizeof(SortedIndex));
+
+    EXPECT_THROW(index.find("C"), std::invalid_argument);
+    EXPECT_THROW(SortedIndex(df, {"D"}), std::invalid_argument);
+}
+
+/**
+ * @brief Unit Test for the SortedIndex class
+ *
+ * @test Test that NaN values sort after all others, in their original order, so every row is listed once
+ */
+TEST(SortedIndexTest, NaNTest) {
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    vector<vector<double>> data = {
+        {nan, 0},
+        {2.0, 1},
+        {nan, 0},
+        {-1.0, 1},
+        {2.0, 0}
+    };
+    DataFrame df(data, {"A", "C"});
+
+    SortedIndex index(df, {"A"});
+    EXPECT_EQ(index.get_order(0), vector<uint32_t>({3, 1, 4, 0, 2}));
+}
+
+/**
+ * @brief Unit Test for the draw methods of the DataFrame class
+ *
+ * @test Test that copying a draw gives the sample of the matching sampling method
+ */
+TEST(SortedIndexTest, DrawTest) {
+    std::shared_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(100);
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+
+    for (size_t seed = 1; seed <= 5; ++seed) {
+        SampleDraw bootstrap = df->draw_bootstrap(2, "weather", seed);
+        unique_ptr<DataFrame> copy = df->bootstrap_sample(2, "weather", seed);
+        vector<string> features(copy->columns.begin(), copy->columns.end() - 1);
+        EXPECT_EQ(bootstrap.features, features);
+        ASSERT_EQ(bootstrap.rows.size(), copy->get_num_rows());
+        for (size_t k = 0; k < bootstrap.rows.size(); ++k) {
+            EXPECT_EQ(df->get_row(bootstrap.rows[k])[df->get_column_index(features[0])], copy->get_row(k)[0]);
+        }
+
+        SampleDraw subsample = df->draw_subsample(0.5, 2, "weather", seed);
+        unique_ptr<DataFrame> subsample_copy = df->subsample(0.5, 2, "weather", seed);
+        EXPECT_EQ(subsample.features, vector<string>(subsample_copy->columns.begin(), subsample_copy->columns.end() - 1));
+        EXPECT_EQ(subsample.rows.size(), 50);
+    }
+    EXPECT_THROW(df->draw_subsample(vector<size_t>({100}), 2, "weather", 1), std::out_of_range);
+}
+
+/**
+ * @brief Unit Test for the DecisionTree class
+ *
+ * @test Test that a tree fit on a bootstrap draw of a SortedIndex is the tree fit on the copied bootstrap sample, with
+ *       and without weights, and for oblivious trees
+ */
+TEST(SortedIndexTest, PresortedFitTest) {
+    std::shared_ptr<DataFrame> df = DataFrame::read_csv("../../samples/seattle-weather.csv")->head(200);
+    df->drop_column("date");
+    df->one_hot_encode("weather");
+
+    vector<string> features = {"precipitation", "temp_max", "temp_min", "wind"};
+    SortedIndex index(*df, features);
+    Series labels = df->get_column("weather");
+    vector<double> weights;
+    for (size_t row = 0; row < df->get_num_rows(); ++row) {
+        weights.push_back(0.5 + row % 3);
+    }
+
+    for (size_t seed = 1; seed <= 3; ++seed) {
+        SampleDraw draw = df->draw_bootstrap(3, "weather", seed);
+        std::shared_ptr<DataFrame> copy = df->bootstrap_sample(3, "weather", seed);
+
+        DecisionTree presorted(5, 2), copied(5, 2);
+        presorted.fit(index, draw.features, labels, draw.rows);
+        copied.fit(copy, "weather");
+        EXPECT_EQ(presorted.print(draw.features), copied.print(draw.features));
+
+        // The weights are read by row of the index
+        vector<vector<double>> weight_rows;
+        for (size_t row : draw.rows) {
+            weight_rows.push_back({weights[row]});
+        }
+        copy->add_column("weight", DataFrame(weight_rows, {"weight"}).view_column("weight"));
+        presorted.fit(index, draw.features, labels, draw.rows, weights);
+        copied.fit(copy, "weather", "weight");
+        EXPECT_EQ(presorted.print(draw.features), copied.print(draw.features));
+
+        // Numeric labels grow the tree their column grows
+        DecisionTree numeric(5, 2);
+        numeric.fit(index, draw.features, labels.convert_to_numeric(), draw.rows, weights);
+        EXPECT_EQ(numeric.print(draw.features), presorted.print(draw.features));
+
+        presorted.set_oblivious(true);
+        copied.set_oblivious(true);
+        presorted.fit(index, draw.features, labels, draw.rows);
+        copied.fit(df->bootstrap_sample(3, "weather", seed), "weather");
+        EXPECT_EQ(presorted.print(draw.features), copied.print(draw.features));
+    }
+
+    DecisionTree dt(5, 2);
+    EXPECT_THROW(dt.fit(index, features, labels, {}), std::runtime_error);
+    EXPECT_THROW(dt.fit(index, {"weather"}, labels, {0, 1}), std::invalid_argument);
+    EXPECT_THROW(dt.fit(index, features, labels, {0, 200}), std::out_of_range);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+#include "../src/SyntheticData.h"
+#include "../src/DataFrame.h"
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::vector;
+using std::string;
+
+
+/**
+ * @brief Unit Test for the SyntheticData class
+ *
+ * @test Test the shape and determinism of the generated DataFrame, and the balance and noise of its classes
+ */
+TEST(SyntheticDataTest, DataFrameTest) {
+    SyntheticSpec spec;
+    spec.num_rows = 3000;
+    spec.num_numeric = 3;
+    spec.num_categorical = 2;
+    spec.cardinality = 4;
+    spec.num_classes = 3;
+    spec.seed = 7;
+
+    SyntheticData generator(spec);
+    EXPECT_EQ(generator.columns(), (vector<string>{"n0", "n1", "n2", "c0", "c1", "label"}));
+
+    std::unique_ptr<DataFrame> df = generator.to_dataframe();
+    EXPECT_EQ(df->get_num_rows(), 3000);
+    EXPECT_EQ(df->columns, generator.columns());
+    EXPECT_TRUE(SyntheticData(spec).to_dataframe()->get_column("n1") == df->get_column("n1"));
+
+    // Every class takes roughly a third of the rows, and the categories are the v0 ... v3 strings
+    std::map<int, size_t> counts;
+    for (const auto& cell : df->get_column("label")) {
+        counts[std::get<int>(cell)]++;
+    }
+    ASSERT_EQ(counts.size(), 3);
+    for (const auto& [label, count] : counts) {
+        EXPECT_GT(count, 700);
+    }
+    for (const auto& cell : df->get_column("c0")) {
+        string value = std::get<string>(cell);
+        EXPECT_TRUE(value == "v0" || value == "v1" || value == "v2" || value == "v3");
+    }
+
+    // A different seed gives different data; full noise changes about two thirds of the labels
+    spec.seed = 8;
+    EXPECT_FALSE(SyntheticData(spec).to_dataframe()->get_column("n0") == df->get_column("n0"));
+    spec.seed = 7;
+    spec.label_noise = 1.0;
+    Series noisy = SyntheticData(spec).to_dataframe()->get_column("label");
+    size_t changed = 0;
+    for (size_t i = 0; i < noisy.size(); ++i) {
+        changed += !(noisy.retrieve(i) == df->get_column("label").retrieve(i));
+    }
+    EXPECT_GT(changed, 1600);
+    EXPECT_LT(changed, 2400);
+}
+
+/**
+ * @brief Unit Test for the SyntheticData class
+ *
+ * @test Test that the CSV and binary files read back to the generated values
+ */
+TEST(SyntheticDataTest, FileTest) {
+    SyntheticSpec spec;
+    spec.num_rows = 200;
+    spec.num_numeric = 4;
+    spec.num_categorical = 1;
+    SyntheticData generator(spec);
+    std::unique_ptr<DataFrame> df = generator.to_dataframe();
+
+    generator.write_csv("synthetic_test.csv");
+    std::unique_ptr<DataFrame> csv = DataFrame::read_csv("synthetic_test.csv");
+    std::remove("synthetic_test.csv");
+    ASSERT_EQ(csv->get_num_rows(), 200);
+    for (const auto& col : df->columns) {
+        for (size_t i = 0; i < 200; i += 13) {
+            Cell expected = df->get_column(col).retrieve(i);
+            Cell actual = csv->get_column(col).retrieve(i);
+            if (col == "c0") {
+                EXPECT_EQ(std::get<string>(actual), std::get<string>(expected));
+            } else {
+                EXPECT_DOUBLE_EQ(DataFrame::double_cast(actual), DataFrame::double_cast(expected));
+            }
+        }
+    }
+
+    generator.write_binary("synthetic_test.bin");
+    std::unique_ptr<DataFrame> binary = SyntheticData::read_binary("synthetic_test.bin");
+    std::remove("synthetic_test.bin");
+    ASSERT_EQ(binary->columns, df->columns);
+    EXPECT_TRUE(binary->get_column("n3") == df->get_column("n3"));
+    EXPECT_TRUE(binary->get_column("label") == df->get_column("label"));
+    EXPECT_EQ(DataFrame::str_cast(df->get_column("c0").retrieve(5)), "v" + std::to_string(static_cast<int>(DataFrame::double_cast(binary->get_column("c0").retrieve(5)))));
+
+    EXPECT_THROW(SyntheticData::read_binary("missing.bin"), std::runtime_error);
+    spec.num_classes = 1;
+    EXPECT_THROW(SyntheticData{spec}, std::invalid_argument);
+    spec.num_classes = 2;
+    spec.label_noise = 1.5;
+    EXPECT_THROW(SyntheticData{spec}, std::invalid_argument);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
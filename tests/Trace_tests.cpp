@@ -0,0 +1,106 @@
+#include <gtest/gtest.h>
+#include "../src/Trace.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+
+/**
+ * @brief Unit Test for the TraceRecorder class
+ *
+ * @test Test that nested spans are recorded innermost first, with durations that nest, on the thread that ran them
+ */
+TEST(TraceTest, SpanTest) {
+#ifndef RF_ENABLE_TRACING
+    GTEST_SKIP() << "Trace_tests must be built with RF_ENABLE_TRACING";
+#endif
+    TraceRecorder& recorder = TraceRecorder::instance();
+    recorder.clear();
+    {
+        RF_TRACE_SCOPE("outer", "test");
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        {
+            RF_TRACE_SCOPE_ARG("inner", "test", "index", 7);
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+    }
+
+    vector<TraceEvent> events = recorder.get_events();
+    ASSERT_EQ(events.size(), 2);
+    EXPECT_EQ(string(events[0].name), "inner");
+    EXPECT_EQ(string(events[0].arg_name), "index");
+    EXPECT_EQ(events[0].arg_value, 7);
+    EXPECT_EQ(string(events[1].name), "outer");
+    EXPECT_EQ(events[1].arg_name, nullptr);
+    EXPECT_EQ(events[0].thread_id, TraceRecorder::thread_id());
+    EXPECT_EQ(events[1].thread_id, TraceRecorder::thread_id());
+
+    EXPECT_GE(events[0].duration_us, 2000);
+    EXPECT_GE(events[1].duration_us, 4000);
+    EXPECT_GE(events[0].start_us, events[1].start_us);
+    EXPECT_LE(events[0].start_us + events[0].duration_us, events[1].start_us + events[1].duration_us);
+    recorder.clear();
+}
+
+/**
+ * @brief Unit Test for the TraceRecorder class
+ *
+ * @test Test that spans of concurrent threads get their own thread ids and are written as Chrome trace events
+ */
+TEST(TraceTest, JsonTest) {
+#ifndef RF_ENABLE_TRACING
+    GTEST_SKIP() << "Trace_tests must be built with RF_ENABLE_TRACING";
+#endif
+    TraceRecorder& recorder = TraceRecorder::instance();
+    recorder.clear();
+
+    vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([i]() { RF_TRACE_SCOPE_ARG("task \"quoted\"", "test", "task", i); });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    vector<TraceEvent> events = recorder.get_events();
+    ASSERT_EQ(events.size(), 4);
+    for (size_t i = 0; i < events.size(); ++i) {
+        EXPECT_NE(events[i].thread_id, TraceRecorder::thread_id());
+        for (size_t j = 0; j < i; ++j) {
+            EXPECT_NE(events[i].thread_id, events[j].thread_id);
+        }
+    }
+
+    string path = "trace_test.json";
+    recorder.write_json(path);
+    std::ifstream file(path);
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    string json = buffer.str();
+    std::remove(path.c_str());
+
+    EXPECT_EQ(json, recorder.to_json());
+    EXPECT_EQ(json.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["), 0);
+    EXPECT_NE(json.find("\"name\": \"task \\\"quoted\\\"\", \"cat\": \"test\", \"ph\": \"X\", \"ts\": "), string::npos);
+    EXPECT_NE(json.find("\"args\": {\"task\": 3}"), string::npos);
+    EXPECT_NE(json.find("\"pid\": 1, \"tid\": " + std::to_string(events[0].thread_id)), string::npos);
+
+    recorder.clear();
+    EXPECT_EQ(recorder.to_json(), "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n]}\n");
+    EXPECT_THROW(recorder.write_json("/nonexistent/directory/trace.json"), std::runtime_error);
+}
+
+
+
+int main(int argc, char* argv[])
+{
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}